@@ -0,0 +1,415 @@
+/**
+ * @file Particle.h
+ * @author Simon Udsen
+ * @date 2026-10-18
+ * @brief Host stand-in of the Particle Device OS APIs
+ * @details Firmware modules include "Particle.h" for the RTOS primitives of
+ * Device OS. Host tools that link those modules put this directory on the
+ * include path instead, and get the same functions with the same signatures
+ * and return codes, implemented with the C++ standard library in particle.cpp:
+ * - os_semaphore_*, os_queue_* and os_mutex_*, which block the calling thread,
+ *   with timeouts in milliseconds
+ * - millis, micros and delay, on the monotonic clock
+ * - os_thread_current, a handle unique to the calling thread
+ *
+ * virtualtime.cpp and devices.cpp implement the same functions, and the
+ * threads, timers and peripherals, in virtual time instead, see virtualtime.h.
+ * A tool links one of the two. Both share Log of log.cpp, which writes to
+ * stderr, from LOG_LEVEL_INFO unless particle_setLogLevel changes it.
+ *
+ * Only the parts the firmware modules built on the host use are here.
+ */
+#ifndef PARTICLE_H
+#define PARTICLE_H
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include <stddef.h> // size_t
+#include <stdint.h> // Standard integer types
+#include <string.h> // memset, memcpy, as Device OS includes it
+
+#include <functional> // Timer callbacks
+#include <string>     // Text of String
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+#define CONCURRENT_WAIT_FOREVER ( ( system_tick_t )-1 ) // Timeout that never expires
+
+#define OS_THREAD_PRIORITY_DEFAULT 2              // Priority of the application thread
+#define OS_THREAD_PRIORITY_CRITICAL 9             // Highest priority
+#define OS_THREAD_STACK_SIZE_DEFAULT ( 3 * 1024 ) // Stack of a thread, in bytes
+
+#define LOG_LEVEL_ALL 1    // Log everything
+#define LOG_LEVEL_TRACE 1  // Trace messages and above
+#define LOG_LEVEL_INFO 30  // Information and above
+#define LOG_LEVEL_WARN 40  // Warnings and errors
+#define LOG_LEVEL_ERROR 50 // Errors only
+#define LOG_LEVEL_NONE 70  // Nothing
+
+#define D2 2 // Digital pin 2
+#define D3 3 // Digital pin 3
+#define D7 7 // Digital pin 7, the blue LED
+
+#define LOW 0  // Low pin level
+#define HIGH 1 // High pin level
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+typedef uint32_t system_tick_t;                  // Time in milliseconds
+typedef void* os_semaphore_t;                    // Counting semaphore
+typedef void* os_queue_t;                        // Queue of fixed size items
+typedef void* os_mutex_t;                        // Mutex
+typedef uint8_t os_thread_prio_t;                // Thread priority
+typedef void ( *os_thread_fn_t )( void* param ); // Thread function
+typedef void* os_thread_t;                       // Handle of a thread
+typedef uint16_t pin_t;                          // Pin number
+
+// Mode of a pin
+typedef enum PinMode
+{
+    INPUT,
+    OUTPUT,
+    INPUT_PULLUP,
+    INPUT_PULLDOWN,
+} PinMode;
+
+// Edge that triggers an interrupt
+typedef enum InterruptMode
+{
+    CHANGE,
+    RISING,
+    FALLING,
+} InterruptMode;
+
+// Logger, like the Log of Device OS
+class Logger
+{
+  public:
+    void trace( const char* format, ... ) __attribute__( ( format( printf, 2, 3 ) ) );
+    void info( const char* format, ... ) __attribute__( ( format( printf, 2, 3 ) ) );
+    void warn( const char* format, ... ) __attribute__( ( format( printf, 2, 3 ) ) );
+    void error( const char* format, ... ) __attribute__( ( format( printf, 2, 3 ) ) );
+};
+
+extern Logger Log;
+
+// Thread, started when constructed
+class Thread
+{
+  public:
+    Thread( const char* name,
+            os_thread_fn_t function,
+            void* function_param = NULL,
+            os_thread_prio_t priority = OS_THREAD_PRIORITY_DEFAULT,
+            size_t stack_size = OS_THREAD_STACK_SIZE_DEFAULT );
+    ~Thread();
+
+  private:
+    void* task; // Simulated thread
+};
+
+// Software timer, calling back from the timer thread
+class Timer
+{
+  public:
+    typedef std::function<void()> timer_callback_fn;
+
+    Timer( unsigned period, timer_callback_fn callback, bool one_shot = false );
+
+    template <typename T>
+    Timer( unsigned period, void ( T::*handler )(), T& instance, bool one_shot = false )
+        : Timer( period, std::bind( handler, &instance ), one_shot )
+    {
+    }
+
+    ~Timer();
+    bool start();
+    bool stop();
+    bool isActive();
+
+  private:
+    void* timer; // Simulated timer
+};
+
+// Text, as much of it as the firmware uses
+class String
+{
+  public:
+    String( const char* text = "" ) : text( text )
+    {
+    }
+
+    const char* c_str() const
+    {
+        return text.c_str();
+    }
+
+  private:
+    std::string text; // Characters
+};
+
+// IPv4 address
+class IPAddress
+{
+  public:
+    IPAddress();
+    IPAddress( uint8_t first, uint8_t second, uint8_t third, uint8_t fourth );
+
+  private:
+    uint8_t octets[4]; // Address, most significant first
+};
+
+// I2C bus master
+class TwoWire
+{
+  public:
+    void begin();
+    void beginTransmission( uint8_t address );
+    uint8_t endTransmission( bool stop = true );
+    size_t write( uint8_t data );
+    size_t requestFrom( uint8_t address, uint8_t quantity );
+    int available();
+    int read();
+
+  private:
+    uint8_t address;  // Device addressed
+    uint8_t reg;      // Register pointer of the device
+    uint8_t rx[32];   // Bytes requested
+    uint8_t rxLength; // Bytes in rx
+    uint8_t rxIndex;  // Next byte of rx to read
+    bool regWritten;  // First byte of this transmission was written
+};
+
+extern TwoWire Wire;
+
+// TCP connection
+class TCPClient
+{
+  public:
+    TCPClient();
+    ~TCPClient();
+    int connect( IPAddress ip, uint16_t port );
+    uint8_t connected();
+    size_t write( const uint8_t* buffer, size_t size );
+    int available();
+    int read( uint8_t* buffer, size_t size );
+    void stop();
+
+  private:
+    void* connection; // Simulated connection
+};
+
+// Device information
+class SystemClass
+{
+  public:
+    String deviceID();
+};
+
+extern SystemClass System;
+
+// Wi-Fi connection
+class WiFiClass
+{
+  public:
+    bool ready();
+};
+
+extern WiFiClass WiFi;
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+/**
+ * Creates a counting semaphore
+ * @param[out] semaphore Semaphore
+ * @param[in] max Highest count
+ * @param[in] initial Count to start at
+ * @returns 0 on success
+ */
+int os_semaphore_create( os_semaphore_t* semaphore, unsigned max, unsigned initial );
+
+/**************************************************************/
+/**
+ * Destroys a semaphore
+ * @param[in] semaphore Semaphore
+ * @returns 0 on success
+ */
+int os_semaphore_destroy( os_semaphore_t semaphore );
+
+/**************************************************************/
+/**
+ * Takes a semaphore, waiting for it to be given
+ * @param[in] semaphore Semaphore
+ * @param[in] timeout Milliseconds to wait, or CONCURRENT_WAIT_FOREVER
+ * @param[in] reserved Unused
+ * @returns 0 if taken, non-zero if timed out
+ */
+int os_semaphore_take( os_semaphore_t semaphore, system_tick_t timeout, bool reserved );
+
+/**************************************************************/
+/**
+ * Gives a semaphore
+ * @param[in] semaphore Semaphore
+ * @param[in] reserved Unused
+ * @returns 0 if given, non-zero if at its highest count
+ */
+int os_semaphore_give( os_semaphore_t semaphore, bool reserved );
+
+/**************************************************************/
+/**
+ * Creates a queue
+ * @param[out] queue Queue
+ * @param[in] itemSize Bytes per item
+ * @param[in] itemCount Items the queue holds
+ * @param[in] reserved Unused
+ * @returns 0 on success
+ */
+int os_queue_create( os_queue_t* queue, size_t itemSize, size_t itemCount, void* reserved );
+
+/**************************************************************/
+/**
+ * Destroys a queue
+ * @param[in] queue Queue
+ * @param[in] reserved Unused
+ * @returns 0 on success
+ */
+int os_queue_destroy( os_queue_t queue, void* reserved );
+
+/**************************************************************/
+/**
+ * Puts an item at the back of a queue, waiting for room
+ * @param[in] queue Queue
+ * @param[in] item Item to copy in
+ * @param[in] delay Milliseconds to wait, or CONCURRENT_WAIT_FOREVER
+ * @param[in] reserved Unused
+ * @returns 0 if put, non-zero if timed out
+ */
+int os_queue_put( os_queue_t queue, const void* item, system_tick_t delay, void* reserved );
+
+/**************************************************************/
+/**
+ * Takes the item at the front of a queue, waiting for one
+ * @param[in] queue Queue
+ * @param[out] item Item copied out
+ * @param[in] delay Milliseconds to wait, or CONCURRENT_WAIT_FOREVER
+ * @param[in] reserved Unused
+ * @returns 0 if taken, non-zero if timed out
+ */
+int os_queue_take( os_queue_t queue, void* item, system_tick_t delay, void* reserved );
+
+/**************************************************************/
+/**
+ * Creates a mutex
+ * @param[out] mutex Mutex
+ * @returns 0 on success
+ */
+int os_mutex_create( os_mutex_t* mutex );
+
+/**************************************************************/
+/**
+ * Destroys a mutex
+ * @param[in] mutex Mutex
+ * @returns 0 on success
+ */
+int os_mutex_destroy( os_mutex_t mutex );
+
+/**************************************************************/
+/**
+ * Locks a mutex, waiting for it
+ * @param[in] mutex Mutex
+ * @returns 0 on success
+ */
+int os_mutex_lock( os_mutex_t mutex );
+
+/**************************************************************/
+/**
+ * Unlocks a mutex
+ * @param[in] mutex Mutex
+ * @returns 0 on success
+ */
+int os_mutex_unlock( os_mutex_t mutex );
+
+/**************************************************************/
+/**
+ * Gets the handle of the calling thread
+ * @param[in] reserved Unused, NULL
+ * @returns Handle, the same for every call from a thread
+ */
+os_thread_t os_thread_current( void* reserved );
+
+/**************************************************************/
+/**
+ * Gets the time since the program started
+ * @returns Milliseconds
+ */
+system_tick_t millis();
+
+/**************************************************************/
+/**
+ * Gets the time since the program started
+ * @returns Microseconds, wrapping
+ */
+uint32_t micros();
+
+/**************************************************************/
+/**
+ * Sleeps the calling thread
+ * @param[in] ms Milliseconds to sleep
+ */
+void delay( uint32_t ms );
+
+/**************************************************************/
+/**
+ * Sets the mode of a pin
+ * @param[in] pin Pin
+ * @param[in] mode Mode
+ */
+void pinMode( pin_t pin, PinMode mode );
+
+/**************************************************************/
+/**
+ * Sets the level of an output pin
+ * @param[in] pin Pin
+ * @param[in] value LOW or HIGH
+ */
+void digitalWrite( pin_t pin, uint8_t value );
+
+/**************************************************************/
+/**
+ * Calls a function on an edge of an input pin
+ * @param[in] pin Pin
+ * @param[in] handler Interrupt handler
+ * @param[in] mode Edge
+ * @returns True if attached
+ */
+bool attachInterrupt( pin_t pin, void ( *handler )(), InterruptMode mode );
+
+/**************************************************************/
+/**
+ * Stops calling the interrupt handler of a pin
+ * @param[in] pin Pin
+ * @returns True if detached
+ */
+bool detachInterrupt( pin_t pin );
+
+/**************************************************************/
+/**
+ * Gets a random number from the hardware generator
+ * @returns Random number
+ */
+uint32_t HAL_RNG_GetRandomNumber();
+
+/**************************************************************/
+/**
+ * Sets the lowest level Log writes, host only
+ * @param[in] level LOG_LEVEL_*
+ */
+void particle_setLogLevel( int level );
+
+#endif // PARTICLE_H
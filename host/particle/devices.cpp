@@ -0,0 +1,296 @@
+/**
+ * @file devices.cpp
+ * @author Simon Udsen
+ * @date 2026-10-18
+ */
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include "virtualtime.h" // Simulation of Device OS
+
+#include <deque> // Reply bytes in flight
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+#define DEVICES_REPLY_SIZE 64                        // Largest reply of the server to one write
+#define DEVICES_DEVICE_ID "e00fce68a1b2c3d4e5f60718" // Device ID, 24 hexadecimal characters
+#define DEVICES_ONE_G 256                            // 1 g in ADXL343 full resolution units
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+// Byte of a reply, and the time it arrives
+typedef struct devices_reply_byte_
+{
+    uint64_t arrivalUs; // Time it can be read
+    uint8_t value;      // Byte
+} devices_reply_byte_t;
+
+// TCP connection to the simulated server
+typedef struct devices_connection_
+{
+    bool connected;                           // Connected to the server
+    std::deque<devices_reply_byte_t> replies; // Bytes sent by the server, oldest first
+} devices_connection_t;
+
+/**************************************************************/
+/*                          Private                           */
+/**************************************************************/
+TwoWire Wire;       // I2C bus of the accelerometer
+SystemClass System; // Device information
+WiFiClass WiFi;     // Wi-Fi connection
+
+static virtualtime_sensor_t sensor = NULL;  // Source of accelerometer samples
+static virtualtime_server_t server = NULL;  // TCP server
+static uint64_t roundTripUs = 0;            // Time from write to reply
+static uint32_t randomState = 0x2545F491UL; // State of the random number generator
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+void virtualtime_setSensor( virtualtime_sensor_t source )
+{
+    sensor = source;
+}
+
+/**************************************************************/
+void virtualtime_setServer( virtualtime_server_t tcpServer, uint32_t roundTripMs )
+{
+    server = tcpServer;
+    roundTripUs = ( uint64_t )roundTripMs * 1000;
+}
+
+/**************************************************************/
+void TwoWire::begin()
+{
+    rxLength = 0;
+    rxIndex = 0;
+}
+
+/**************************************************************/
+void TwoWire::beginTransmission( uint8_t deviceAddress )
+{
+    address = deviceAddress;
+    regWritten = false;
+}
+
+/**************************************************************/
+uint8_t TwoWire::endTransmission( bool stop )
+{
+    ( void )stop;
+    // 2 is a NACK of the address, like Device OS
+    return ( address == VIRTUALTIME_ADXL343_ADDRESS ) ? 0 : 2;
+}
+
+/**************************************************************/
+size_t TwoWire::write( uint8_t data )
+{
+    // The first byte sets the register pointer, register writes are ignored
+    if ( !regWritten )
+    {
+        reg = data;
+        regWritten = true;
+    }
+    return 1;
+}
+
+/**************************************************************/
+size_t TwoWire::requestFrom( uint8_t deviceAddress, uint8_t quantity )
+{
+    rxLength = 0;
+    rxIndex = 0;
+    if ( ( deviceAddress != VIRTUALTIME_ADXL343_ADDRESS ) || ( quantity > sizeof( rx ) ) )
+    {
+        return 0;
+    }
+
+    memset( rx, 0x00, quantity );
+    if ( reg == 0x00 )
+    {
+        rx[0] = VIRTUALTIME_ADXL343_DEVICE_ID;
+    }
+    else if ( ( reg == VIRTUALTIME_ADXL343_REG_DATAX0 ) && ( quantity >= 6 ) )
+    {
+        int16_t axes[3] = { 0, 0, DEVICES_ONE_G };
+        if ( sensor != NULL )
+        {
+            sensor( &( axes[0] ), &( axes[1] ), &( axes[2] ) );
+        }
+        for ( uint8_t i = 0; i < 3; i++ )
+        {
+            rx[2 * i] = ( uint8_t )( ( uint16_t )axes[i] & 0xFF );
+            rx[2 * i + 1] = ( uint8_t )( ( uint16_t )axes[i] >> 8 );
+        }
+    }
+    rxLength = quantity;
+    return quantity;
+}
+
+/**************************************************************/
+int TwoWire::available()
+{
+    return rxLength - rxIndex;
+}
+
+/**************************************************************/
+int TwoWire::read()
+{
+    return ( rxIndex < rxLength ) ? rx[rxIndex++] : -1;
+}
+
+/**************************************************************/
+IPAddress::IPAddress()
+{
+    memset( octets, 0x00, sizeof( octets ) );
+}
+
+/**************************************************************/
+IPAddress::IPAddress( uint8_t first, uint8_t second, uint8_t third, uint8_t fourth )
+{
+    octets[0] = first;
+    octets[1] = second;
+    octets[2] = third;
+    octets[3] = fourth;
+}
+
+/**************************************************************/
+TCPClient::TCPClient()
+{
+    connection = new devices_connection_t();
+}
+
+/**************************************************************/
+TCPClient::~TCPClient()
+{
+    delete ( devices_connection_t* )connection;
+}
+
+/**************************************************************/
+int TCPClient::connect( IPAddress ip, uint16_t port )
+{
+    ( void )ip;
+    ( void )port;
+    devices_connection_t* sim = ( devices_connection_t* )connection;
+    sim->replies.clear();
+    sim->connected = ( server != NULL );
+    return sim->connected ? 1 : 0;
+}
+
+/**************************************************************/
+uint8_t TCPClient::connected()
+{
+    return ( ( devices_connection_t* )connection )->connected ? 1 : 0;
+}
+
+/**************************************************************/
+size_t TCPClient::write( const uint8_t* buffer, size_t size )
+{
+    devices_connection_t* sim = ( devices_connection_t* )connection;
+    if ( !sim->connected )
+    {
+        return ( size_t )-1;
+    }
+
+    uint8_t reply[DEVICES_REPLY_SIZE];
+    size_t length = server( buffer, size, reply, sizeof( reply ) );
+    for ( size_t i = 0; i < length; i++ )
+    {
+        sim->replies.push_back( { virtualtime_now() + roundTripUs, reply[i] } );
+    }
+    return size;
+}
+
+/**************************************************************/
+int TCPClient::available()
+{
+    devices_connection_t* sim = ( devices_connection_t* )connection;
+    int count = 0;
+    for ( const devices_reply_byte_t& byte : sim->replies )
+    {
+        if ( byte.arrivalUs > virtualtime_now() )
+        {
+            break;
+        }
+        count++;
+    }
+    return count;
+}
+
+/**************************************************************/
+int TCPClient::read( uint8_t* buffer, size_t size )
+{
+    devices_connection_t* sim = ( devices_connection_t* )connection;
+    size_t count = 0;
+    while ( ( count < size ) && !sim->replies.empty() && ( sim->replies.front().arrivalUs <= virtualtime_now() ) )
+    {
+        buffer[count++] = sim->replies.front().value;
+        sim->replies.pop_front();
+    }
+    return ( count > 0 ) ? ( int )count : -1;
+}
+
+/**************************************************************/
+void TCPClient::stop()
+{
+    devices_connection_t* sim = ( devices_connection_t* )connection;
+    sim->connected = false;
+    sim->replies.clear();
+}
+
+/**************************************************************/
+String SystemClass::deviceID()
+{
+    return String( DEVICES_DEVICE_ID );
+}
+
+/**************************************************************/
+bool WiFiClass::ready()
+{
+    return true;
+}
+
+/**************************************************************/
+void pinMode( pin_t pin, PinMode mode )
+{
+    ( void )pin;
+    ( void )mode;
+}
+
+/**************************************************************/
+void digitalWrite( pin_t pin, uint8_t value )
+{
+    ( void )pin;
+    ( void )value;
+}
+
+/**************************************************************/
+bool attachInterrupt( pin_t pin, void ( *handler )(), InterruptMode mode )
+{
+    // No edges are simulated, so the handler is never called
+    ( void )pin;
+    ( void )handler;
+    ( void )mode;
+    return true;
+}
+
+/**************************************************************/
+bool detachInterrupt( pin_t pin )
+{
+    ( void )pin;
+    return true;
+}
+
+/**************************************************************/
+uint32_t HAL_RNG_GetRandomNumber()
+{
+    // Xorshift, so a run is the same every time
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
@@ -0,0 +1,87 @@
+/**
+ * @file log.cpp
+ * @author Simon Udsen
+ * @date 2026-10-18
+ */
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include "Particle.h" // Header file for this module
+
+#include <stdarg.h> // va_list
+#include <stdio.h>  // vfprintf
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+/**************************************************************/
+/*                          Private                           */
+/**************************************************************/
+Logger Log; // Log of the firmware modules
+
+static int logLevel = LOG_LEVEL_INFO; // Lowest level written
+
+/**************************************************************/
+// Write a log line, stamped with millis of the implementation linked
+static void writeLog( int level, const char* name, const char* format, va_list args )
+{
+    if ( level < logLevel )
+    {
+        return;
+    }
+    fprintf( stderr, "%010lu [app] %s: ", ( unsigned long )millis(), name );
+    vfprintf( stderr, format, args );
+    fputc( '\n', stderr );
+}
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+void Logger::trace( const char* format, ... )
+{
+    va_list args;
+    va_start( args, format );
+    writeLog( LOG_LEVEL_TRACE, "TRACE", format, args );
+    va_end( args );
+}
+
+/**************************************************************/
+void Logger::info( const char* format, ... )
+{
+    va_list args;
+    va_start( args, format );
+    writeLog( LOG_LEVEL_INFO, "INFO", format, args );
+    va_end( args );
+}
+
+/**************************************************************/
+void Logger::warn( const char* format, ... )
+{
+    va_list args;
+    va_start( args, format );
+    writeLog( LOG_LEVEL_WARN, "WARN", format, args );
+    va_end( args );
+}
+
+/**************************************************************/
+void Logger::error( const char* format, ... )
+{
+    va_list args;
+    va_start( args, format );
+    writeLog( LOG_LEVEL_ERROR, "ERROR", format, args );
+    va_end( args );
+}
+
+/**************************************************************/
+void particle_setLogLevel( int level )
+{
+    logLevel = level;
+}
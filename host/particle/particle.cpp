@@ -0,0 +1,229 @@
+/**
+ * @file particle.cpp
+ * @author Simon Udsen
+ * @date 2026-10-18
+ */
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include "Particle.h" // Header file for this module
+
+#include <chrono>             // Monotonic clock
+#include <condition_variable> // Waiting for semaphores and queues
+#include <deque>              // Items of a queue
+#include <mutex>              // Locks
+#include <thread>             // sleep_for
+#include <vector>             // Item bytes
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+// Counting semaphore
+typedef struct host_semaphore_
+{
+    std::mutex mutex;              // Guards count
+    std::condition_variable given; // Notified when given
+    unsigned count;                // Current count
+    unsigned max;                  // Highest count
+} host_semaphore_t;
+
+// Queue of fixed size items
+typedef struct host_queue_
+{
+    std::mutex mutex;                       // Guards items
+    std::condition_variable changed;        // Notified when an item is put or taken
+    std::deque<std::vector<uint8_t>> items; // Items, front first
+    size_t itemSize;                        // Bytes per item
+    size_t itemCount;                       // Items the queue holds
+} host_queue_t;
+
+/**************************************************************/
+/*                          Private                           */
+/**************************************************************/
+static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now(); // Program start
+
+/**************************************************************/
+// Wait on a condition until a predicate holds, for at most timeout milliseconds
+template <typename Predicate>
+static bool waitFor( std::condition_variable* condition,
+                     std::unique_lock<std::mutex>* lock,
+                     system_tick_t timeout,
+                     Predicate predicate )
+{
+    if ( timeout == CONCURRENT_WAIT_FOREVER )
+    {
+        condition->wait( *lock, predicate );
+        return true;
+    }
+    return condition->wait_for( *lock, std::chrono::milliseconds( timeout ), predicate );
+}
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+int os_semaphore_create( os_semaphore_t* semaphore, unsigned max, unsigned initial )
+{
+    host_semaphore_t* host = new host_semaphore_t;
+    host->count = initial;
+    host->max = max;
+    *semaphore = host;
+    return 0;
+}
+
+/**************************************************************/
+int os_semaphore_destroy( os_semaphore_t semaphore )
+{
+    delete ( host_semaphore_t* )semaphore;
+    return 0;
+}
+
+/**************************************************************/
+int os_semaphore_take( os_semaphore_t semaphore, system_tick_t timeout, bool reserved )
+{
+    ( void )reserved;
+    host_semaphore_t* host = ( host_semaphore_t* )semaphore;
+    std::unique_lock<std::mutex> lock( host->mutex );
+    if ( !waitFor( &( host->given ), &lock, timeout, [host]() { return host->count > 0; } ) )
+    {
+        return 1;
+    }
+    host->count--;
+    return 0;
+}
+
+/**************************************************************/
+int os_semaphore_give( os_semaphore_t semaphore, bool reserved )
+{
+    ( void )reserved;
+    host_semaphore_t* host = ( host_semaphore_t* )semaphore;
+    {
+        std::lock_guard<std::mutex> lock( host->mutex );
+        if ( host->count >= host->max )
+        {
+            return 1;
+        }
+        host->count++;
+    }
+    host->given.notify_one();
+    return 0;
+}
+
+/**************************************************************/
+int os_queue_create( os_queue_t* queue, size_t itemSize, size_t itemCount, void* reserved )
+{
+    ( void )reserved;
+    host_queue_t* host = new host_queue_t;
+    host->itemSize = itemSize;
+    host->itemCount = itemCount;
+    *queue = host;
+    return 0;
+}
+
+/**************************************************************/
+int os_queue_destroy( os_queue_t queue, void* reserved )
+{
+    ( void )reserved;
+    delete ( host_queue_t* )queue;
+    return 0;
+}
+
+/**************************************************************/
+int os_queue_put( os_queue_t queue, const void* item, system_tick_t delay, void* reserved )
+{
+    ( void )reserved;
+    host_queue_t* host = ( host_queue_t* )queue;
+    {
+        std::unique_lock<std::mutex> lock( host->mutex );
+        if ( !waitFor( &( host->changed ), &lock, delay, [host]() { return host->items.size() < host->itemCount; } ) )
+        {
+            return 1;
+        }
+        const uint8_t* bytes = ( const uint8_t* )item;
+        host->items.emplace_back( bytes, bytes + host->itemSize );
+    }
+    host->changed.notify_all();
+    return 0;
+}
+
+/**************************************************************/
+int os_queue_take( os_queue_t queue, void* item, system_tick_t delay, void* reserved )
+{
+    ( void )reserved;
+    host_queue_t* host = ( host_queue_t* )queue;
+    {
+        std::unique_lock<std::mutex> lock( host->mutex );
+        if ( !waitFor( &( host->changed ), &lock, delay, [host]() { return !host->items.empty(); } ) )
+        {
+            return 1;
+        }
+        memcpy( item, host->items.front().data(), host->itemSize );
+        host->items.pop_front();
+    }
+    host->changed.notify_all();
+    return 0;
+}
+
+/**************************************************************/
+int os_mutex_create( os_mutex_t* mutex )
+{
+    *mutex = new std::mutex;
+    return 0;
+}
+
+/**************************************************************/
+int os_mutex_destroy( os_mutex_t mutex )
+{
+    delete ( std::mutex* )mutex;
+    return 0;
+}
+
+/**************************************************************/
+int os_mutex_lock( os_mutex_t mutex )
+{
+    ( ( std::mutex* )mutex )->lock();
+    return 0;
+}
+
+/**************************************************************/
+int os_mutex_unlock( os_mutex_t mutex )
+{
+    ( ( std::mutex* )mutex )->unlock();
+    return 0;
+}
+
+/**************************************************************/
+os_thread_t os_thread_current( void* reserved )
+{
+    // Every thread has its own copy, so its address tells the threads apart
+    static thread_local uint8_t self;
+    ( void )reserved;
+    return &self;
+}
+
+/**************************************************************/
+system_tick_t millis()
+{
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return ( system_tick_t )std::chrono::duration_cast<std::chrono::milliseconds>( elapsed ).count();
+}
+
+/**************************************************************/
+uint32_t micros()
+{
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return ( uint32_t )std::chrono::duration_cast<std::chrono::microseconds>( elapsed ).count();
+}
+
+/**************************************************************/
+void delay( uint32_t ms )
+{
+    std::this_thread::sleep_for( std::chrono::milliseconds( ms ) );
+}
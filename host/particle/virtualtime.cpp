@@ -0,0 +1,715 @@
+/**
+ * @file virtualtime.cpp
+ * @author Simon Udsen
+ * @date 2026-10-18
+ */
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include "virtualtime.h" // Header file for this module
+
+#include "tracer.h" // Timeline of the threads and RTOS calls
+
+#include <stdio.h>    // fprintf
+#include <stdlib.h>   // abort
+#include <ucontext.h> // Thread contexts
+
+#include <deque>  // Items of a queue
+#include <vector> // Threads, timers and waiters
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+#define VIRTUALTIME_STACK_SIZE ( 256 * 1024 ) // Host stack of a simulated thread
+#define VIRTUALTIME_FOREVER UINT64_MAX        // Time that never comes
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+// Simulated thread
+typedef struct virtualtime_task_
+{
+    ucontext_t context;                        // Registers while not running
+    uint8_t* stack;                            // Host stack
+    os_thread_fn_t function;                   // Thread function
+    void* param;                               // Argument of thread function
+    os_thread_prio_t priority;                 // Priority
+    bool ready;                                // Running, or waiting to run
+    bool finished;                             // Thread function returned, or Thread deleted
+    uint64_t readySeq;                         // Position in round robin order among equal priorities
+    uint64_t remainingUs;                      // Time left of the cost being run
+    uint64_t wakeUs;                           // Time the wait times out
+    uint64_t waitSeq;                          // Position in order of waiters
+    std::vector<virtualtime_task_*>* waitList; // Waiters the thread is in, NULL if none
+    bool timedOut;                             // The last wait timed out
+    uint64_t busyUs;                           // Time spent running costs
+    uint32_t activations;                      // Times it was switched to
+} virtualtime_task_t;
+
+typedef std::vector<virtualtime_task_t*> virtualtime_waiters_t;
+
+// Counting semaphore
+typedef struct virtualtime_semaphore_
+{
+    unsigned count;                // Current count
+    unsigned max;                  // Highest count
+    virtualtime_waiters_t waiters; // Threads waiting to take
+} virtualtime_semaphore_t;
+
+// Queue of fixed size items
+typedef struct virtualtime_queue_
+{
+    std::deque<std::vector<uint8_t>> items; // Items, front first
+    size_t itemSize;                        // Bytes per item
+    size_t itemCount;                       // Items the queue holds
+    virtualtime_waiters_t takers;           // Threads waiting for an item
+    virtualtime_waiters_t putters;          // Threads waiting for room
+} virtualtime_queue_t;
+
+// Mutex
+typedef struct virtualtime_mutex_
+{
+    bool locked;                   // Locked by a thread
+    virtualtime_waiters_t waiters; // Threads waiting to lock
+} virtualtime_mutex_t;
+
+// Software timer
+typedef struct virtualtime_timer_
+{
+    Timer::timer_callback_fn callback; // Called when due
+    uint64_t periodUs;                 // Period
+    bool oneShot;                      // Stops after calling back once
+    bool active;                       // Started
+    uint64_t dueUs;                    // Time of next callback
+} virtualtime_timer_t;
+
+/**************************************************************/
+/*                          Private                           */
+/**************************************************************/
+static std::vector<virtualtime_task_t*> tasks;   // Every thread, in the order created
+static std::vector<virtualtime_timer_t*> timers; // Every timer, in the order created
+static ucontext_t schedulerContext;              // Registers of the scheduler while a thread runs
+static virtualtime_task_t* current = NULL;       // Running thread, NULL in the scheduler and timers
+static virtualtime_task_t* lastRun = NULL;       // Thread that ran last
+static uint64_t now = 0;                         // Virtual time
+static uint64_t seq = 0;                         // Counter of readySeq and waitSeq
+static uint32_t spinCount = 0;                   // Calls since time last passed
+static uint32_t contextSwitches = 0;             // Times a different thread was switched to
+static const void* traced = NULL;                // Thread last traced as running, NULL if idle
+
+/**************************************************************/
+// Record an event in the timeline of tracer.h
+static void trace( tracer_event_type_t type, const void* thread, const void* object, uint16_t value )
+{
+#if TRACER_ENABLED
+    tracer_record( type, thread, object, value );
+#else
+    ( void )type;
+    ( void )thread;
+    ( void )object;
+    ( void )value;
+#endif
+}
+
+/**************************************************************/
+// Count a call to the RTOS, and abort if the running thread spins without
+// letting time pass
+static void checkSpin()
+{
+    if ( ( current != NULL ) && ( ++spinCount > VIRTUALTIME_SPIN_LIMIT ) )
+    {
+        fprintf( stderr,
+                 "virtualtime: thread %p spins at %llu us without waiting\n",
+                 ( void* )current->function,
+                 ( unsigned long long )now );
+        abort();
+    }
+}
+
+/**************************************************************/
+// Move the clock forward
+static void advance( uint64_t time )
+{
+    if ( time > now )
+    {
+        now = time;
+        spinCount = 0;
+    }
+}
+
+/**************************************************************/
+// Return from the running thread to the scheduler
+static void yieldToScheduler()
+{
+    swapcontext( &( current->context ), &schedulerContext );
+}
+
+/**************************************************************/
+// Make a thread ready, at the back of its priority
+static void makeReady( virtualtime_task_t* task )
+{
+    if ( task->waitList != NULL )
+    {
+        virtualtime_waiters_t* list = task->waitList;
+        for ( size_t i = 0; i < list->size(); i++ )
+        {
+            if ( ( *list )[i] == task )
+            {
+                list->erase( list->begin() + i );
+                break;
+            }
+        }
+        task->waitList = NULL;
+    }
+    task->wakeUs = VIRTUALTIME_FOREVER;
+    task->ready = true;
+    task->readySeq = ++seq;
+}
+
+/**************************************************************/
+// Wait in a list of waiters of object, or only for time to pass if the list
+// is NULL. Returns false if the deadline passed first, or if called outside a
+// thread
+static bool waitUntil( virtualtime_waiters_t* list, const void* object, uint64_t deadlineUs )
+{
+    if ( ( current == NULL ) || ( deadlineUs <= now ) )
+    {
+        return false;
+    }
+
+    virtualtime_task_t* task = current;
+    task->ready = false;
+    task->wakeUs = deadlineUs;
+    task->waitSeq = ++seq;
+    task->timedOut = false;
+    task->waitList = list;
+    if ( list != NULL )
+    {
+        list->push_back( task );
+    }
+    trace( TRACER_EVENT_WAIT, task, object, 0 );
+    yieldToScheduler();
+    trace( TRACER_EVENT_WAKE, task, object, task->timedOut ? 1 : 0 );
+
+    return !task->timedOut;
+}
+
+/**************************************************************/
+// Deadline of a timeout in milliseconds from now
+static uint64_t deadline( system_tick_t timeoutMs )
+{
+    return ( timeoutMs == CONCURRENT_WAIT_FOREVER ) ? VIRTUALTIME_FOREVER : now + ( uint64_t )timeoutMs * 1000;
+}
+
+/**************************************************************/
+// Wake the first waiter of the highest priority, and switch to it if it has a
+// higher priority than the running thread
+static void wakeOne( virtualtime_waiters_t* list )
+{
+    virtualtime_task_t* next = NULL;
+    for ( virtualtime_task_t* task : *list )
+    {
+        if ( ( next == NULL ) || ( task->priority > next->priority ) ||
+             ( ( task->priority == next->priority ) && ( task->waitSeq < next->waitSeq ) ) )
+        {
+            next = task;
+        }
+    }
+    if ( next == NULL )
+    {
+        return;
+    }
+
+    makeReady( next );
+    if ( ( current != NULL ) && ( next->priority > current->priority ) )
+    {
+        yieldToScheduler();
+    }
+}
+
+/**************************************************************/
+// Start of every thread
+static void runTask()
+{
+    virtualtime_task_t* task = current;
+    task->function( task->param );
+
+    task->finished = true;
+    task->ready = false;
+    yieldToScheduler();
+}
+
+/**************************************************************/
+// Create a thread, ready to run
+static virtualtime_task_t* createTask( os_thread_fn_t function, void* param, os_thread_prio_t priority )
+{
+    virtualtime_task_t* task = new virtualtime_task_t();
+    task->stack = new uint8_t[VIRTUALTIME_STACK_SIZE];
+    task->function = function;
+    task->param = param;
+    task->priority = priority;
+    task->wakeUs = VIRTUALTIME_FOREVER;
+
+    getcontext( &( task->context ) );
+    task->context.uc_stack.ss_sp = task->stack;
+    task->context.uc_stack.ss_size = VIRTUALTIME_STACK_SIZE;
+    task->context.uc_link = NULL;
+    makecontext( &( task->context ), runTask, 0 );
+
+    tasks.push_back( task );
+    makeReady( task );
+
+    return task;
+}
+
+/**************************************************************/
+// Call the timers that are due, then time out the waits that are due
+static void fireDue()
+{
+    for ( virtualtime_timer_t* timer : timers )
+    {
+        while ( timer->active && ( timer->dueUs <= now ) )
+        {
+            timer->dueUs += timer->periodUs;
+            if ( timer->oneShot )
+            {
+                timer->active = false;
+            }
+            timer->callback();
+        }
+    }
+
+    for ( virtualtime_task_t* task : tasks )
+    {
+        if ( !task->ready && !task->finished && ( task->wakeUs <= now ) )
+        {
+            makeReady( task );
+            task->timedOut = true;
+        }
+    }
+}
+
+/**************************************************************/
+// Time of the next timer callback or timeout
+static uint64_t nextEvent()
+{
+    uint64_t next = VIRTUALTIME_FOREVER;
+    for ( virtualtime_timer_t* timer : timers )
+    {
+        if ( timer->active && ( timer->dueUs < next ) )
+        {
+            next = timer->dueUs;
+        }
+    }
+    for ( virtualtime_task_t* task : tasks )
+    {
+        if ( !task->ready && !task->finished && ( task->wakeUs < next ) )
+        {
+            next = task->wakeUs;
+        }
+    }
+    return next;
+}
+
+/**************************************************************/
+// Highest priority ready thread, first in round robin order
+static virtualtime_task_t* pickReady()
+{
+    virtualtime_task_t* next = NULL;
+    for ( virtualtime_task_t* task : tasks )
+    {
+        if ( !task->ready || task->finished )
+        {
+            continue;
+        }
+        if ( ( next == NULL ) || ( task->priority > next->priority ) ||
+             ( ( task->priority == next->priority ) && ( task->readySeq < next->readySeq ) ) )
+        {
+            next = task;
+        }
+    }
+    return next;
+}
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+void virtualtime_run( os_thread_fn_t setup, void* param, uint64_t durationUs )
+{
+    // Timer callbacks run outside the threads
+    TRACER_REGISTER( NULL, "timers" );
+    createTask( setup, param, OS_THREAD_PRIORITY_DEFAULT );
+    const uint64_t endUs = now + durationUs;
+
+    while ( now < endUs )
+    {
+        fireDue();
+
+        virtualtime_task_t* task = pickReady();
+        uint64_t event = nextEvent();
+        if ( task != traced )
+        {
+            trace( TRACER_EVENT_SWITCH, task, NULL, 0 );
+            traced = task;
+        }
+        if ( task == NULL )
+        {
+            // Every thread waits, so skip to the next event
+            advance( ( event < endUs ) ? event : endUs );
+            continue;
+        }
+
+        if ( task != lastRun )
+        {
+            task->activations++;
+            contextSwitches++;
+            lastRun = task;
+        }
+
+        if ( task->remainingUs > 0 )
+        {
+            // Run the cost until it is done, an event can preempt it, or the
+            // time slice ends
+            uint64_t until = now + task->remainingUs;
+            uint64_t sliceEnd = ( now / VIRTUALTIME_TICK_US + 1 ) * VIRTUALTIME_TICK_US;
+            until = ( event < until ) ? event : until;
+            until = ( sliceEnd < until ) ? sliceEnd : until;
+            until = ( endUs < until ) ? endUs : until;
+
+            task->remainingUs -= until - now;
+            task->busyUs += until - now;
+            advance( until );
+
+            // Let the other threads of equal priority have a turn
+            if ( ( task->remainingUs > 0 ) && ( now == sliceEnd ) )
+            {
+                task->readySeq = ++seq;
+            }
+            continue;
+        }
+
+        // Run the code of the thread until it waits or is charged a cost
+        current = task;
+        swapcontext( &schedulerContext, &( task->context ) );
+        current = NULL;
+    }
+}
+
+/**************************************************************/
+void virtualtime_consume( uint32_t us )
+{
+    if ( ( current == NULL ) || ( us == 0 ) )
+    {
+        return;
+    }
+    current->remainingUs += us;
+    yieldToScheduler();
+}
+
+/**************************************************************/
+uint64_t virtualtime_now()
+{
+    return now;
+}
+
+/**************************************************************/
+size_t virtualtime_threadCount()
+{
+    return tasks.size();
+}
+
+/**************************************************************/
+void virtualtime_getThread( size_t index, virtualtime_thread_t* thread )
+{
+    const virtualtime_task_t* task = tasks[index];
+    thread->function = task->function;
+    thread->priority = task->priority;
+    thread->busyUs = task->busyUs;
+    thread->activations = task->activations;
+    thread->finished = task->finished;
+}
+
+/**************************************************************/
+uint32_t virtualtime_contextSwitches()
+{
+    return contextSwitches;
+}
+
+/**************************************************************/
+Thread::Thread( const char* name,
+                os_thread_fn_t function,
+                void* function_param,
+                os_thread_prio_t priority,
+                size_t stack_size )
+{
+    ( void )name;
+    ( void )stack_size;
+    checkSpin();
+
+    virtualtime_task_t* created = createTask( function, function_param, priority );
+    task = created;
+
+    // A new thread of higher priority runs at once
+    if ( ( current != NULL ) && ( priority > current->priority ) )
+    {
+        yieldToScheduler();
+    }
+}
+
+/**************************************************************/
+Thread::~Thread()
+{
+    // The stack is kept, in case the thread deletes itself
+    virtualtime_task_t* deleted = ( virtualtime_task_t* )task;
+    deleted->finished = true;
+    deleted->ready = false;
+}
+
+/**************************************************************/
+Timer::Timer( unsigned period, timer_callback_fn callback, bool one_shot )
+{
+    virtualtime_timer_t* created = new virtualtime_timer_t();
+    created->callback = callback;
+    created->periodUs = ( uint64_t )period * 1000;
+    created->oneShot = one_shot;
+    created->active = false;
+    created->dueUs = 0;
+    timers.push_back( created );
+    timer = created;
+}
+
+/**************************************************************/
+Timer::~Timer()
+{
+    // Kept in the list of timers, but never due again
+    ( ( virtualtime_timer_t* )timer )->active = false;
+}
+
+/**************************************************************/
+bool Timer::start()
+{
+    checkSpin();
+    virtualtime_timer_t* started = ( virtualtime_timer_t* )timer;
+    started->active = true;
+    started->dueUs = now + started->periodUs;
+    return true;
+}
+
+/**************************************************************/
+bool Timer::stop()
+{
+    checkSpin();
+    ( ( virtualtime_timer_t* )timer )->active = false;
+    return true;
+}
+
+/**************************************************************/
+bool Timer::isActive()
+{
+    return ( ( virtualtime_timer_t* )timer )->active;
+}
+
+/**************************************************************/
+int os_semaphore_create( os_semaphore_t* semaphore, unsigned max, unsigned initial )
+{
+    virtualtime_semaphore_t* created = new virtualtime_semaphore_t();
+    created->count = initial;
+    created->max = max;
+    *semaphore = created;
+    return 0;
+}
+
+/**************************************************************/
+int os_semaphore_destroy( os_semaphore_t semaphore )
+{
+    delete ( virtualtime_semaphore_t* )semaphore;
+    return 0;
+}
+
+/**************************************************************/
+int os_semaphore_take( os_semaphore_t semaphore, system_tick_t timeout, bool reserved )
+{
+    ( void )reserved;
+    checkSpin();
+    virtualtime_semaphore_t* sim = ( virtualtime_semaphore_t* )semaphore;
+    uint64_t deadlineUs = deadline( timeout );
+
+    // A thread that wakes may find the count taken by one that ran first, and
+    // waits again
+    while ( sim->count == 0 )
+    {
+        if ( !waitUntil( &( sim->waiters ), semaphore, deadlineUs ) )
+        {
+            return 1;
+        }
+    }
+    sim->count--;
+    trace( TRACER_EVENT_SEMAPHORE_TAKE, current, semaphore, ( uint16_t )sim->count );
+    return 0;
+}
+
+/**************************************************************/
+int os_semaphore_give( os_semaphore_t semaphore, bool reserved )
+{
+    ( void )reserved;
+    checkSpin();
+    virtualtime_semaphore_t* sim = ( virtualtime_semaphore_t* )semaphore;
+    if ( sim->count >= sim->max )
+    {
+        return 1;
+    }
+    sim->count++;
+    trace( TRACER_EVENT_SEMAPHORE_GIVE, current, semaphore, ( uint16_t )sim->count );
+    wakeOne( &( sim->waiters ) );
+    return 0;
+}
+
+/**************************************************************/
+int os_queue_create( os_queue_t* queue, size_t itemSize, size_t itemCount, void* reserved )
+{
+    ( void )reserved;
+    virtualtime_queue_t* created = new virtualtime_queue_t();
+    created->itemSize = itemSize;
+    created->itemCount = itemCount;
+    *queue = created;
+    return 0;
+}
+
+/**************************************************************/
+int os_queue_destroy( os_queue_t queue, void* reserved )
+{
+    ( void )reserved;
+    delete ( virtualtime_queue_t* )queue;
+    return 0;
+}
+
+/**************************************************************/
+int os_queue_put( os_queue_t queue, const void* item, system_tick_t delay, void* reserved )
+{
+    ( void )reserved;
+    checkSpin();
+    virtualtime_queue_t* sim = ( virtualtime_queue_t* )queue;
+    uint64_t deadlineUs = deadline( delay );
+
+    while ( sim->items.size() >= sim->itemCount )
+    {
+        if ( !waitUntil( &( sim->putters ), queue, deadlineUs ) )
+        {
+            return 1;
+        }
+    }
+    const uint8_t* bytes = ( const uint8_t* )item;
+    sim->items.emplace_back( bytes, bytes + sim->itemSize );
+    trace( TRACER_EVENT_QUEUE_PUT, current, queue, ( uint16_t )sim->items.size() );
+    wakeOne( &( sim->takers ) );
+    return 0;
+}
+
+/**************************************************************/
+int os_queue_take( os_queue_t queue, void* item, system_tick_t delay, void* reserved )
+{
+    ( void )reserved;
+    checkSpin();
+    virtualtime_queue_t* sim = ( virtualtime_queue_t* )queue;
+    uint64_t deadlineUs = deadline( delay );
+
+    while ( sim->items.empty() )
+    {
+        if ( !waitUntil( &( sim->takers ), queue, deadlineUs ) )
+        {
+            return 1;
+        }
+    }
+    memcpy( item, sim->items.front().data(), sim->itemSize );
+    sim->items.pop_front();
+    trace( TRACER_EVENT_QUEUE_TAKE, current, queue, ( uint16_t )sim->items.size() );
+    wakeOne( &( sim->putters ) );
+    return 0;
+}
+
+/**************************************************************/
+int os_mutex_create( os_mutex_t* mutex )
+{
+    *mutex = new virtualtime_mutex_t();
+    return 0;
+}
+
+/**************************************************************/
+int os_mutex_destroy( os_mutex_t mutex )
+{
+    delete ( virtualtime_mutex_t* )mutex;
+    return 0;
+}
+
+/**************************************************************/
+int os_mutex_lock( os_mutex_t mutex )
+{
+    checkSpin();
+    virtualtime_mutex_t* sim = ( virtualtime_mutex_t* )mutex;
+    while ( sim->locked )
+    {
+        if ( !waitUntil( &( sim->waiters ), mutex, VIRTUALTIME_FOREVER ) )
+        {
+            // Outside a thread nothing else runs, so the lock can't be freed
+            fprintf( stderr, "virtualtime: mutex locked outside a thread\n" );
+            abort();
+        }
+    }
+    sim->locked = true;
+    trace( TRACER_EVENT_MUTEX_LOCK, current, mutex, 0 );
+    return 0;
+}
+
+/**************************************************************/
+int os_mutex_unlock( os_mutex_t mutex )
+{
+    checkSpin();
+    virtualtime_mutex_t* sim = ( virtualtime_mutex_t* )mutex;
+    sim->locked = false;
+    trace( TRACER_EVENT_MUTEX_UNLOCK, current, mutex, 0 );
+    wakeOne( &( sim->waiters ) );
+    return 0;
+}
+
+/**************************************************************/
+os_thread_t os_thread_current( void* reserved )
+{
+    ( void )reserved;
+    return current;
+}
+
+/**************************************************************/
+system_tick_t millis()
+{
+    checkSpin();
+    return ( system_tick_t )( now / 1000 );
+}
+
+/**************************************************************/
+uint32_t micros()
+{
+    checkSpin();
+    return ( uint32_t )now;
+}
+
+/**************************************************************/
+void delay( uint32_t ms )
+{
+    checkSpin();
+    if ( current == NULL )
+    {
+        return;
+    }
+    if ( ms == 0 )
+    {
+        // Go to the back of the priority, like a yield
+        current->readySeq = ++seq;
+        yieldToScheduler();
+        return;
+    }
+    waitUntil( NULL, NULL, now + ( uint64_t )ms * 1000 );
+}
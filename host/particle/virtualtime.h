@@ -0,0 +1,142 @@
+/**
+ * @file virtualtime.h
+ * @author Simon Udsen
+ * @date 2026-10-18
+ * @brief Device OS in virtual time, for simulating the firmware threads
+ * @details virtualtime.cpp implements the RTOS functions of Particle.h on a
+ * virtual clock, with a cooperative scheduler that runs one thread at a time
+ * on its own host stack. Code takes no virtual time. Time only passes when
+ * every thread waits, or when a thread is charged the cost of an operation
+ * with virtualtime_consume, so a run is the same every time, and takes a
+ * fraction of the virtual time.
+ *
+ * The scheduling rules are the ones of FreeRTOS on a single core, like
+ * tools/schedsim.cpp:
+ * - The highest priority ready thread runs. A thread made ready by a higher
+ *   priority one, or by a timer, preempts it at once, also in the middle of a
+ *   cost
+ * - Threads of equal priority take turns every VIRTUALTIME_TICK_US
+ * - Waiters of semaphores, queues and mutexes wake in priority order, then in
+ *   the order they started to wait. Mutexes don't inherit priority
+ * - Timer callbacks run at their due time, in the timer thread, which takes no
+ *   time
+ *
+ * A thread that calls the functions of Particle.h VIRTUALTIME_SPIN_LIMIT times
+ * without time passing is taken to spin forever, which would hang the
+ * simulation, and the program aborts. Busy waiting on micros() spins, so
+ * charge a cost instead.
+ *
+ * With TRACER_ENABLED, every thread switch, wait and semaphore, queue and
+ * mutex call is recorded in the timeline of tracer.h, with the threads as the
+ * handles of os_thread_current. Timer callbacks run outside the threads, with
+ * a NULL handle, named "timers".
+ *
+ * devices.cpp simulates an ADXL343 on Wire, reading samples from
+ * virtualtime_setSensor, and a TCP server, answering with
+ * virtualtime_setServer after a round trip.
+ */
+#ifndef VIRTUALTIME_H
+#define VIRTUALTIME_H
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include "Particle.h" // Particle Device OS APIs
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+#define VIRTUALTIME_TICK_US 1000            // FreeRTOS tick and time slice
+#define VIRTUALTIME_SPIN_LIMIT 10000000     // Calls without time passing that count as spinning
+#define VIRTUALTIME_ADXL343_ADDRESS 0x53    // I2C address of simulated accelerometer
+#define VIRTUALTIME_ADXL343_DEVICE_ID 0xE5  // Value of its DEVID register
+#define VIRTUALTIME_ADXL343_REG_DATAX0 0x32 // First of its six data registers
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+// Statistics of a simulated thread
+typedef struct virtualtime_thread_
+{
+    os_thread_fn_t function;   // Thread function
+    os_thread_prio_t priority; // Priority
+    uint64_t busyUs;           // Virtual time spent running costs
+    uint32_t activations;      // Times it was switched to
+    bool finished;             // Thread function returned
+} virtualtime_thread_t;
+
+// Source of the accelerometer samples, in ADXL343 full resolution units
+typedef void ( *virtualtime_sensor_t )( int16_t* x, int16_t* y, int16_t* z );
+
+// TCP server, answering data written with a reply of at most size bytes.
+// Returns the length of the reply
+typedef size_t ( *virtualtime_server_t )( const uint8_t* data, size_t length, uint8_t* reply, size_t size );
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+/**
+ * Runs the simulation, starting with a thread at OS_THREAD_PRIORITY_DEFAULT,
+ * like the application thread that calls setup. Can be called once
+ * @param[in] setup Function of first thread
+ * @param[in] param Argument of setup
+ * @param[in] durationUs Virtual time to run for
+ */
+void virtualtime_run( os_thread_fn_t setup, void* param, uint64_t durationUs );
+
+/**************************************************************/
+/**
+ * Charges a cost to the running thread. It continues when it has run for that
+ * long, which takes longer if it is preempted. Does nothing outside a thread
+ * @param[in] us Cost in microseconds
+ */
+void virtualtime_consume( uint32_t us );
+
+/**************************************************************/
+/**
+ * Gets the virtual time
+ * @returns Microseconds since the start of the simulation
+ */
+uint64_t virtualtime_now();
+
+/**************************************************************/
+/**
+ * Gets the number of threads created
+ * @returns Number of threads, including the setup thread
+ */
+size_t virtualtime_threadCount();
+
+/**************************************************************/
+/**
+ * Gets the statistics of a thread
+ * @param[in] index Index of thread, in the order they were created
+ * @param[out] thread Statistics
+ */
+void virtualtime_getThread( size_t index, virtualtime_thread_t* thread );
+
+/**************************************************************/
+/**
+ * Gets the number of times a different thread was switched to
+ * @returns Context switches
+ */
+uint32_t virtualtime_contextSwitches();
+
+/**************************************************************/
+/**
+ * Sets the source of the samples read from the simulated ADXL343
+ * @param[in] sensor Source, or NULL for 1 g on Z
+ */
+void virtualtime_setSensor( virtualtime_sensor_t sensor );
+
+/**************************************************************/
+/**
+ * Sets the simulated TCP server. Without one, connections fail
+ * @param[in] server Server, or NULL
+ * @param[in] roundTripMs Time from writing data to receiving the reply
+ */
+void virtualtime_setServer( virtualtime_server_t server, uint32_t roundTripMs );
+
+#endif // VIRTUALTIME_H
@@ -0,0 +1,275 @@
+/**
+ * @file codecratio.cpp
+ * @author Simon Udsen
+ * @date 2026-10-18
+ * @brief Compression ratio of the sample codec on recorded data
+ * @details Reads CSV recordings from the TCP server, splits them into blocks
+ * the size of the frames the datarouter sends, and encodes every block with
+ * samplecodec. Every block is decoded again and compared, so the codec is
+ * checked to be lossless.
+ * Sizes are reported for CSV text, packed frames and delta frames, per activity
+ * (the file name up to the first dot) and in total. Run it on every CSV file
+ * in ../tcp_server/out:
+ *
+ *     codecratio ../tcp_server/out/walk.00001.csv ...
+ *
+ * The recordings have millisecond timestamps, while the firmware sends
+ * microseconds, so timestamps are scaled by --timestamp-scale first.
+ *
+ * The exit code is 1 if a block did not decode to the original samples.
+ */
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include <stdint.h> // Standard integer types
+#include <stdio.h>  // printf, snprintf
+#include <stdlib.h> // strtoul
+#include <string.h> // strcmp
+
+#include <chrono> // Encode time
+#include <map>    // Totals per activity
+#include <string> // Activity names
+#include <vector> // Samples of a recording
+
+#include "frame.h"       // Binary frames of samples
+#include "recording.h"   // CSV recordings
+#include "samplecodec.h" // Sample codec
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+#define MAX_BLOCK_SAMPLES 1000 // Largest block that can be tested
+
+#define LATENCY_SAMPLES ( DATAROUTER_FLUSH_LATENCY_MS * ACCELEROMETER_SAMPLE_RATE_HZ / 1000 ) // Samples per latency
+
+// Samples per frame the datarouter sends, those that arrive within the flush
+// latency, unless they fill a batch first
+#define DEVICE_BLOCK_SAMPLES                                                                                        \
+    ( ( LATENCY_SAMPLES < DATAROUTER_BATCH_SAMPLES ) ? LATENCY_SAMPLES : DATAROUTER_BATCH_SAMPLES )
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+// Sizes of a set of recordings
+typedef struct codec_totals_
+{
+    uint64_t samples;     // Samples encoded
+    uint64_t blocks;      // Blocks encoded
+    uint64_t csvBytes;    // Bytes as CSV lines
+    uint64_t packedBytes; // Bytes as packed frames
+    uint64_t deltaBytes;  // Bytes as delta frames
+    double encodeNs;      // Time spent encoding
+} codec_totals_t;
+
+/**************************************************************/
+/*                          Private                           */
+/**************************************************************/
+
+/**************************************************************/
+// Length of a sample as a CSV line from the datarouter
+static uint32_t csvLength( const acceleration_sample_t* sample )
+{
+    char line[64];
+    return ( uint32_t )snprintf( line,
+                                 sizeof( line ),
+                                 "%lu,%d,%d,%d,%d\n",
+                                 ( unsigned long )sample->timestamp,
+                                 sample->acceleration[AXIS_X],
+                                 sample->acceleration[AXIS_Y],
+                                 sample->acceleration[AXIS_Z],
+                                 sample->step );
+}
+
+/**************************************************************/
+// Check that two samples are equal
+static bool sameSample( const acceleration_sample_t* a, const acceleration_sample_t* b )
+{
+    return ( a->timestamp == b->timestamp ) && ( a->acceleration[AXIS_X] == b->acceleration[AXIS_X] ) &&
+           ( a->acceleration[AXIS_Y] == b->acceleration[AXIS_Y] ) &&
+           ( a->acceleration[AXIS_Z] == b->acceleration[AXIS_Z] ) && ( a->step == b->step ) &&
+           ( a->dropped == b->dropped );
+}
+
+/**************************************************************/
+// Encode a recording in blocks, and check that it decodes
+static bool encodeRecording( const std::vector<acceleration_sample_t>& samples,
+                             uint16_t blockSize,
+                             codec_totals_t* totals )
+{
+    static uint8_t encoded[MAX_BLOCK_SAMPLES * 24];
+    static acceleration_sample_t decoded[MAX_BLOCK_SAMPLES];
+
+    for ( size_t start = 0; start < samples.size(); start += blockSize )
+    {
+        uint16_t count = ( uint16_t )( ( samples.size() - start < blockSize ) ? samples.size() - start : blockSize );
+        const acceleration_sample_t* block = &( samples[start] );
+
+        auto begin = std::chrono::steady_clock::now();
+        int length = samplecodec_encode( block, count, encoded, sizeof( encoded ) );
+        auto end = std::chrono::steady_clock::now();
+        totals->encodeNs += std::chrono::duration<double, std::nano>( end - begin ).count();
+
+        if ( ( length < 0 ) || ( samplecodec_decode( encoded, ( size_t )length, decoded, count ) != length ) )
+        {
+            printf( "Block at sample %zu failed to encode or decode\n", start );
+            return false;
+        }
+        for ( uint16_t i = 0; i < count; i++ )
+        {
+            if ( !sameSample( &( block[i] ), &( decoded[i] ) ) )
+            {
+                printf( "Sample %zu decoded wrong\n", start + i );
+                return false;
+            }
+            totals->csvBytes += csvLength( &( block[i] ) );
+        }
+
+        totals->samples += count;
+        totals->blocks++;
+        totals->packedBytes += FRAME_SIZE( count );
+        totals->deltaBytes += FRAME_HEADER_SIZE + ( uint32_t )length;
+    }
+
+    return true;
+}
+
+/**************************************************************/
+// Print a row of the report
+static void printTotals( const char* name, const codec_totals_t* totals )
+{
+    double samples = ( totals->samples > 0 ) ? ( double )totals->samples : 1.0;
+    printf( "%-12s %8llu %9.2f %9.2f %9.2f %7.2fx %7.2fx %8.1f\n",
+            name,
+            ( unsigned long long )totals->samples,
+            totals->csvBytes / samples,
+            totals->packedBytes / samples,
+            totals->deltaBytes / samples,
+            ( double )totals->csvBytes / ( totals->deltaBytes ? totals->deltaBytes : 1 ),
+            ( double )totals->packedBytes / ( totals->deltaBytes ? totals->deltaBytes : 1 ),
+            totals->encodeNs / samples );
+}
+
+/**************************************************************/
+// Print usage
+static void usage()
+{
+    printf( "Usage: codecratio [options] recording.csv...\n"
+            "  --block N                Samples per block (default: %u, what the datarouter sends)\n"
+            "  --timestamp-scale N      Multiply timestamps by N (default: 1000, ms to us)\n",
+            ( unsigned )DEVICE_BLOCK_SAMPLES );
+}
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+int main( int argc, char** argv )
+{
+    uint32_t blockSize = DEVICE_BLOCK_SAMPLES;
+    uint32_t timestampScale = 1000;
+    std::vector<const char*> paths;
+
+    for ( int i = 1; i < argc; i++ )
+    {
+        const char* arg = argv[i];
+        const char* value = ( i + 1 < argc ) ? argv[i + 1] : NULL;
+
+        if ( strcmp( arg, "--help" ) == 0 )
+        {
+            usage();
+            return 0;
+        }
+        if ( strncmp( arg, "--", 2 ) != 0 )
+        {
+            paths.push_back( arg );
+            continue;
+        }
+        if ( value == NULL )
+        {
+            usage();
+            return 1;
+        }
+
+        i++;
+        if ( strcmp( arg, "--block" ) == 0 )
+        {
+            blockSize = strtoul( value, NULL, 10 );
+        }
+        else if ( strcmp( arg, "--timestamp-scale" ) == 0 )
+        {
+            timestampScale = strtoul( value, NULL, 10 );
+        }
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    if ( paths.empty() || ( blockSize == 0 ) || ( blockSize > MAX_BLOCK_SAMPLES ) )
+    {
+        usage();
+        return 1;
+    }
+
+    std::map<std::string, codec_totals_t> activities;
+    codec_totals_t total = {};
+
+    for ( const char* path : paths )
+    {
+        std::vector<acceleration_sample_t> samples;
+        if ( !recording_read( path, timestampScale, &samples ) )
+        {
+            printf( "Failed to read %s\n", path );
+            return 1;
+        }
+
+        // Activity is the file name up to the first dot
+        const char* name = strrchr( path, '/' );
+        name = ( name != NULL ) ? name + 1 : path;
+        std::string activity( name, strcspn( name, "." ) );
+
+        codec_totals_t totals = {};
+        if ( !encodeRecording( samples, ( uint16_t )blockSize, &totals ) )
+        {
+            printf( "%s is not encoded losslessly\n", path );
+            return 1;
+        }
+
+        codec_totals_t* sum = &( activities[activity] );
+        for ( codec_totals_t* t : { sum, &total } )
+        {
+            t->samples += totals.samples;
+            t->blocks += totals.blocks;
+            t->csvBytes += totals.csvBytes;
+            t->packedBytes += totals.packedBytes;
+            t->deltaBytes += totals.deltaBytes;
+            t->encodeNs += totals.encodeNs;
+        }
+    }
+
+    printf( "block=%lu samples, timestamp scale=%lu, %zu recordings, all decoded losslessly\n"
+            "Sizes are bytes per sample with frame headers, ns is host encode time per sample\n",
+            ( unsigned long )blockSize,
+            ( unsigned long )timestampScale,
+            paths.size() );
+    printf( "%-12s %8s %9s %9s %9s %8s %8s %8s\n",
+            "activity",
+            "samples",
+            "csv",
+            "packed",
+            "delta",
+            "vs csv",
+            "vs pack",
+            "ns" );
+    for ( const auto& activity : activities )
+    {
+        printTotals( activity.first.c_str(), &( activity.second ) );
+    }
+    printTotals( "total", &total );
+
+    return 0;
+}
@@ -0,0 +1,296 @@
+/**
+ * @file columnfile.cpp
+ * @author Simon Udsen
+ * @date 2026-10-18
+ */
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include "columnfile.h" // Header file for this module
+
+#include <fcntl.h>    // open
+#include <stdio.h>    // rename, snprintf
+#include <string.h>   // memcpy, strncpy
+#include <sys/mman.h> // mmap
+#include <sys/stat.h> // fstat
+#include <unistd.h>   // write, close
+
+#include <vector> // File contents while writing
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+#define ALIGN_UP( value ) ( ( ( value ) + COLUMNFILE_ALIGNMENT - 1 ) & ~( ( uint64_t )COLUMNFILE_ALIGNMENT - 1 ) )
+
+static_assert( __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "Column files are mapped as little endian" );
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+/**************************************************************/
+/*                          Private                           */
+/**************************************************************/
+
+/**************************************************************/
+// Size in bytes of every column of a file with a number of samples
+static void columnSizes( uint64_t count, uint32_t blockSamples, uint64_t* sizes )
+{
+    sizes[COLUMNFILE_COLUMN_DELTAS] = count * sizeof( uint32_t );
+    sizes[COLUMNFILE_COLUMN_X] = count * sizeof( int16_t );
+    sizes[COLUMNFILE_COLUMN_Y] = count * sizeof( int16_t );
+    sizes[COLUMNFILE_COLUMN_Z] = count * sizeof( int16_t );
+    sizes[COLUMNFILE_COLUMN_STEPS] = ( ( count + 63 ) / 64 ) * sizeof( uint64_t );
+    sizes[COLUMNFILE_COLUMN_INDEX] =
+        ( blockSamples > 0 ) ? ( ( count + blockSamples - 1 ) / blockSamples ) * sizeof( columnfile_block_t ) : 0;
+}
+
+/**************************************************************/
+// Write all of a buffer to a file
+static bool writeAll( int fd, const uint8_t* buffer, size_t length )
+{
+    while ( length > 0 )
+    {
+        ssize_t written = write( fd, buffer, length );
+        if ( written <= 0 )
+        {
+            return false;
+        }
+        buffer += written;
+        length -= ( size_t )written;
+    }
+    return true;
+}
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+int columnfile_write( const char* path,
+                      const columnfile_info_t* info,
+                      const acceleration_sample_t* samples,
+                      size_t count )
+{
+    if ( count > UINT32_MAX )
+    {
+        return -1;
+    }
+
+    uint64_t sizes[COLUMNFILE_COLUMNS];
+    columnSizes( count, info->blockSamples, sizes );
+
+    columnfile_header_t header = {};
+    header.magic = COLUMNFILE_MAGIC;
+    header.version = COLUMNFILE_VERSION;
+    header.headerSize = COLUMNFILE_HEADER_SIZE;
+    header.sampleCount = ( uint32_t )count;
+    header.sampleRateHz = info->sampleRateHz;
+    header.timestampUnitUs = info->timestampUnitUs;
+    header.firstTimestamp = ( count > 0 ) ? samples[0].timestamp : 0;
+    header.startTimeMs = info->startTimeMs;
+    memcpy( header.deviceId, info->deviceId, FRAME_DEVICE_ID_SIZE );
+    header.blockSamples = info->blockSamples;
+    if ( info->label != NULL )
+    {
+        strncpy( header.label, info->label, COLUMNFILE_LABEL_SIZE - 1 );
+    }
+
+    uint64_t size = COLUMNFILE_HEADER_SIZE;
+    for ( uint8_t column = 0; column < COLUMNFILE_COLUMNS; column++ )
+    {
+        if ( sizes[column] > 0 )
+        {
+            header.offsets[column] = ALIGN_UP( size );
+            size = header.offsets[column] + sizes[column];
+        }
+    }
+
+    // Padding between columns stays zero
+    std::vector<uint8_t> contents( size, 0 );
+    memcpy( contents.data(), &header, sizeof( header ) );
+
+    uint32_t* deltas = ( uint32_t* )&( contents[header.offsets[COLUMNFILE_COLUMN_DELTAS]] );
+    int16_t* axes[3] = { ( int16_t* )&( contents[header.offsets[COLUMNFILE_COLUMN_X]] ),
+                         ( int16_t* )&( contents[header.offsets[COLUMNFILE_COLUMN_Y]] ),
+                         ( int16_t* )&( contents[header.offsets[COLUMNFILE_COLUMN_Z]] ) };
+    uint64_t* steps = ( uint64_t* )&( contents[header.offsets[COLUMNFILE_COLUMN_STEPS]] );
+    columnfile_block_t* blocks = ( columnfile_block_t* )&( contents[header.offsets[COLUMNFILE_COLUMN_INDEX]] );
+
+    for ( size_t i = 0; i < count; i++ )
+    {
+        deltas[i] = ( i > 0 ) ? samples[i].timestamp - samples[i - 1].timestamp : 0;
+        for ( uint8_t axis = AXIS_X; axis <= AXIS_Z; axis++ )
+        {
+            axes[axis][i] = samples[i].acceleration[axis];
+        }
+        if ( samples[i].step )
+        {
+            steps[i / 64] |= ( uint64_t )1 << ( i % 64 );
+        }
+
+        if ( info->blockSamples == 0 )
+        {
+            continue;
+        }
+        columnfile_block_t* block = &( blocks[i / info->blockSamples] );
+        if ( i % info->blockSamples == 0 )
+        {
+            block->timestamp = samples[i].timestamp;
+            for ( uint8_t axis = AXIS_X; axis <= AXIS_Z; axis++ )
+            {
+                block->min[axis] = samples[i].acceleration[axis];
+                block->max[axis] = samples[i].acceleration[axis];
+            }
+        }
+        for ( uint8_t axis = AXIS_X; axis <= AXIS_Z; axis++ )
+        {
+            block->min[axis] = ( samples[i].acceleration[axis] < block->min[axis] ) ? samples[i].acceleration[axis]
+                                                                                    : block->min[axis];
+            block->max[axis] = ( samples[i].acceleration[axis] > block->max[axis] ) ? samples[i].acceleration[axis]
+                                                                                    : block->max[axis];
+        }
+        block->steps += samples[i].step ? 1 : 0;
+    }
+
+    char temporary[4096];
+    if ( snprintf( temporary, sizeof( temporary ), "%s.tmp", path ) >= ( int )sizeof( temporary ) )
+    {
+        return -1;
+    }
+    int fd = open( temporary, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 );
+    if ( fd < 0 )
+    {
+        return -1;
+    }
+    bool written = writeAll( fd, contents.data(), contents.size() );
+    written = ( close( fd ) == 0 ) && written;
+    if ( !written || ( rename( temporary, path ) != 0 ) )
+    {
+        unlink( temporary );
+        return -1;
+    }
+    return 0;
+}
+
+/**************************************************************/
+int columnfile_open( columnfile_t* file, const char* path )
+{
+    memset( file, 0, sizeof( *file ) );
+
+    int fd = open( path, O_RDONLY | O_CLOEXEC );
+    if ( fd < 0 )
+    {
+        return -1;
+    }
+    struct stat status;
+    if ( fstat( fd, &status ) != 0 )
+    {
+        close( fd );
+        return -1;
+    }
+    if ( status.st_size < COLUMNFILE_HEADER_SIZE )
+    {
+        close( fd );
+        return -2;
+    }
+
+    // The mapping stays valid after the file is closed
+    void* map = mmap( NULL, ( size_t )status.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if ( map == MAP_FAILED )
+    {
+        return -1;
+    }
+    file->map = ( const uint8_t* )map;
+    file->mapSize = ( size_t )status.st_size;
+    file->header = ( const columnfile_header_t* )map;
+
+    const columnfile_header_t* header = file->header;
+    if ( ( header->magic != COLUMNFILE_MAGIC ) || ( header->version != COLUMNFILE_VERSION ) ||
+         ( header->headerSize != COLUMNFILE_HEADER_SIZE ) )
+    {
+        columnfile_close( file );
+        return -2;
+    }
+
+    uint64_t sizes[COLUMNFILE_COLUMNS];
+    columnSizes( header->sampleCount, header->blockSamples, sizes );
+    for ( uint8_t column = 0; column < COLUMNFILE_COLUMNS; column++ )
+    {
+        uint64_t offset = header->offsets[column];
+        if ( ( sizes[column] > 0 ) &&
+             ( ( offset < COLUMNFILE_HEADER_SIZE ) || ( offset % COLUMNFILE_ALIGNMENT != 0 ) ||
+               ( offset > file->mapSize ) || ( sizes[column] > file->mapSize - offset ) ) )
+        {
+            columnfile_close( file );
+            return -2;
+        }
+    }
+
+    size_t count = header->sampleCount;
+    file->deltas = { ( const uint32_t* )( file->map + header->offsets[COLUMNFILE_COLUMN_DELTAS] ), count };
+    file->acceleration[AXIS_X] = { ( const int16_t* )( file->map + header->offsets[COLUMNFILE_COLUMN_X] ), count };
+    file->acceleration[AXIS_Y] = { ( const int16_t* )( file->map + header->offsets[COLUMNFILE_COLUMN_Y] ), count };
+    file->acceleration[AXIS_Z] = { ( const int16_t* )( file->map + header->offsets[COLUMNFILE_COLUMN_Z] ), count };
+    file->steps = { ( const uint64_t* )( file->map + header->offsets[COLUMNFILE_COLUMN_STEPS] ),
+                    ( size_t )( sizes[COLUMNFILE_COLUMN_STEPS] / sizeof( uint64_t ) ) };
+    file->index = { ( const columnfile_block_t* )( file->map + header->offsets[COLUMNFILE_COLUMN_INDEX] ),
+                    ( size_t )( sizes[COLUMNFILE_COLUMN_INDEX] / sizeof( columnfile_block_t ) ) };
+    return 0;
+}
+
+/**************************************************************/
+void columnfile_close( columnfile_t* file )
+{
+    if ( file->map != NULL )
+    {
+        munmap( ( void* )file->map, file->mapSize );
+    }
+    memset( file, 0, sizeof( *file ) );
+}
+
+/**************************************************************/
+uint32_t columnfile_timestamp( const columnfile_t* file, size_t index )
+{
+    size_t first = 0;
+    uint32_t timestamp = file->header->firstTimestamp;
+    if ( file->index.size > 0 )
+    {
+        first = index - index % file->header->blockSamples;
+        timestamp = file->index[first / file->header->blockSamples].timestamp;
+    }
+    for ( size_t i = first + 1; i <= index; i++ )
+    {
+        timestamp += file->deltas[i];
+    }
+    return timestamp;
+}
+
+/**************************************************************/
+size_t columnfile_read( const columnfile_t* file, size_t first, acceleration_sample_t* samples, size_t count )
+{
+    size_t total = file->header->sampleCount;
+    if ( first >= total )
+    {
+        return 0;
+    }
+    count = ( count < total - first ) ? count : total - first;
+
+    uint32_t timestamp = columnfile_timestamp( file, first );
+    for ( size_t i = 0; i < count; i++ )
+    {
+        size_t index = first + i;
+        timestamp += ( i > 0 ) ? file->deltas[index] : 0;
+
+        acceleration_sample_t* sample = &( samples[i] );
+        *sample = {};
+        sample->timestamp = timestamp;
+        sample->acceleration[AXIS_X] = file->acceleration[AXIS_X][index];
+        sample->acceleration[AXIS_Y] = file->acceleration[AXIS_Y][index];
+        sample->acceleration[AXIS_Z] = file->acceleration[AXIS_Z][index];
+        sample->step = columnfile_step( file, index );
+    }
+    return count;
+}
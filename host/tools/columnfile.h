@@ -0,0 +1,215 @@
+/**
+ * @file columnfile.h
+ * @author Simon Udsen
+ * @date 2026-10-18
+ * @brief Columnar binary recordings
+ * @details A column file holds one recording as separate arrays of the same
+ * type, so a reader maps the file and uses the arrays in place, without parsing
+ * or copying anything. The layout, all little endian:
+ *
+ *     offset 0    columnfile_header_t, COLUMNFILE_HEADER_SIZE bytes
+ *     deltas      uint32_t[sampleCount], timestamp minus the one before, 0 first
+ *     x, y, z     int16_t[sampleCount] each, acceleration in LSB
+ *     steps       uint64_t[(sampleCount + 63) / 64], bit i % 64 of word i / 64
+ *                 is set if sample i is a step
+ *     index       columnfile_block_t[blockCount], optional
+ *
+ * Every column starts at a multiple of COLUMNFILE_ALIGNMENT bytes, at the
+ * offset given in the header, so readers don't depend on the order. Timestamps
+ * are 32 bit ticks of timestampUnitUs microseconds, which wrap like the
+ * firmware's, so timestamp i is firstTimestamp plus the deltas up to i, modulo
+ * 2^32.
+ *
+ * The index has a block of summary values for every blockSamples samples, with
+ * the timestamp of the first sample, so a reader can seek by time, or skip
+ * blocks by range, without touching the columns.
+ *
+ * The fixed layout is also easy to read from other languages, numpy.memmap
+ * with the offsets from the header for example.
+ */
+#ifndef COLUMNFILE_H
+#define COLUMNFILE_H
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include <stddef.h> // size_t
+#include <stdint.h> // Standard integer types
+
+#include "config.h" // Project configuration
+#include "frame.h"  // FRAME_DEVICE_ID_SIZE
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+#define COLUMNFILE_MAGIC 0x43505453UL // "STPC" read as little endian
+#define COLUMNFILE_VERSION 1          // Version of file layout
+#define COLUMNFILE_HEADER_SIZE 128    // Size of header in bytes
+#define COLUMNFILE_ALIGNMENT 64       // Alignment of every column in bytes
+#define COLUMNFILE_LABEL_SIZE 32      // Size of label, including zero termination
+#define COLUMNFILE_BLOCK_SAMPLES 1024 // Default samples per index block
+#define COLUMNFILE_EXTENSION ".stpc"  // Extension of column files
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+// Columns of a file, in the order of the header offsets
+typedef enum columnfile_column_
+{
+    COLUMNFILE_COLUMN_DELTAS,
+    COLUMNFILE_COLUMN_X,
+    COLUMNFILE_COLUMN_Y,
+    COLUMNFILE_COLUMN_Z,
+    COLUMNFILE_COLUMN_STEPS,
+    COLUMNFILE_COLUMN_INDEX,
+    COLUMNFILE_COLUMNS
+} columnfile_column_t;
+
+// Header at the start of a file
+typedef struct columnfile_header_
+{
+    uint32_t magic;                         // COLUMNFILE_MAGIC
+    uint16_t version;                       // COLUMNFILE_VERSION
+    uint16_t headerSize;                    // COLUMNFILE_HEADER_SIZE
+    uint32_t sampleCount;                   // Samples in file
+    uint32_t sampleRateHz;                  // Nominal sample rate
+    uint32_t timestampUnitUs;               // Microseconds per timestamp tick
+    uint32_t firstTimestamp;                // Timestamp of first sample in ticks
+    uint64_t startTimeMs;                   // Unix time of first sample in ms, 0 if unknown
+    uint8_t deviceId[FRAME_DEVICE_ID_SIZE]; // Device ID, zeros if unknown
+    uint32_t blockSamples;                  // Samples per index block, 0 without index
+    char label[COLUMNFILE_LABEL_SIZE];      // Activity label, zero terminated
+    uint64_t offsets[COLUMNFILE_COLUMNS];   // Offset of every column, 0 if not present
+} columnfile_header_t;
+
+static_assert( sizeof( columnfile_header_t ) == COLUMNFILE_HEADER_SIZE, "Column file header has wrong size" );
+
+// Summary of a block of samples in the index
+typedef struct columnfile_block_
+{
+    uint32_t timestamp; // Timestamp of first sample in block
+    int16_t min[3];     // Smallest acceleration per axis
+    int16_t max[3];     // Largest acceleration per axis
+    uint32_t steps;     // Steps in block
+} columnfile_block_t;
+
+static_assert( sizeof( columnfile_block_t ) == 20, "Column file block has wrong size" );
+
+// Array in a mapped file
+template <typename T> struct columnfile_span_t
+{
+    const T* data; // First element, in the mapped file
+    size_t size;   // Number of elements
+
+    const T* begin() const
+    {
+        return data;
+    }
+    const T* end() const
+    {
+        return data + size;
+    }
+    const T& operator[]( size_t i ) const
+    {
+        return data[i];
+    }
+};
+
+// Mapped column file
+typedef struct columnfile_
+{
+    const uint8_t* map;                          // Mapping of the whole file
+    size_t mapSize;                              // Size of mapping in bytes
+    const columnfile_header_t* header;           // Header, in the mapping
+    columnfile_span_t<uint32_t> deltas;          // Timestamp deltas
+    columnfile_span_t<int16_t> acceleration[3];  // Acceleration per axis, indexed by AXIS_T
+    columnfile_span_t<uint64_t> steps;           // Step bitmap
+    columnfile_span_t<columnfile_block_t> index; // Index blocks, empty without index
+} columnfile_t;
+
+// Information about a recording to write
+typedef struct columnfile_info_
+{
+    uint32_t sampleRateHz;                  // Nominal sample rate
+    uint32_t timestampUnitUs;               // Microseconds per timestamp tick
+    uint64_t startTimeMs;                   // Unix time of first sample in ms, 0 if unknown
+    uint8_t deviceId[FRAME_DEVICE_ID_SIZE]; // Device ID, zeros if unknown
+    uint32_t blockSamples;                  // Samples per index block, 0 without index
+    const char* label;                      // Activity label, truncated to fit
+} columnfile_info_t;
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+/**
+ * Writes samples to a column file. The file is written under a temporary name
+ * and renamed, so readers never see it half written
+ * @param[in] path Path of file
+ * @param[in] info Information about the recording
+ * @param[in] samples Samples, with timestamps in ticks. Dropped fields are not
+ * stored
+ * @param[in] count Number of samples
+ * @returns Status
+ * @retval 0: File written
+ * @retval -1: File could not be written
+ */
+int columnfile_write( const char* path,
+                      const columnfile_info_t* info,
+                      const acceleration_sample_t* samples,
+                      size_t count );
+
+/**************************************************************/
+/**
+ * Maps a column file, and checks that every column is inside it
+ * @param[out] file Mapped file
+ * @param[in] path Path of file
+ * @returns Status
+ * @retval 0: File mapped
+ * @retval -1: File could not be opened or mapped
+ * @retval -2: File is not a valid column file
+ */
+int columnfile_open( columnfile_t* file, const char* path );
+
+/**************************************************************/
+/**
+ * Unmaps a column file. Spans of the file are invalid afterwards
+ * @param[in,out] file Mapped file
+ */
+void columnfile_close( columnfile_t* file );
+
+/**************************************************************/
+/**
+ * Checks if a sample is a step
+ * @param[in] file Mapped file
+ * @param[in] index Index of sample
+ * @returns True if the sample is a step
+ */
+static inline bool columnfile_step( const columnfile_t* file, size_t index )
+{
+    return ( ( file->steps[index / 64] >> ( index % 64 ) ) & 1 ) != 0;
+}
+
+/**************************************************************/
+/**
+ * Gets the timestamp of a sample, starting from the closest index block
+ * @param[in] file Mapped file
+ * @param[in] index Index of sample
+ * @returns Timestamp in ticks
+ */
+uint32_t columnfile_timestamp( const columnfile_t* file, size_t index );
+
+/**************************************************************/
+/**
+ * Copies samples out of a column file
+ * @param[in] file Mapped file
+ * @param[in] first Index of first sample
+ * @param[out] samples Copies of samples, with dropped fields 0
+ * @param[in] count Number of samples to copy
+ * @returns Number of samples copied, less than count at the end of the file
+ */
+size_t columnfile_read( const columnfile_t* file, size_t first, acceleration_sample_t* samples, size_t count );
+
+#endif // COLUMNFILE_H
@@ -0,0 +1,266 @@
+/**
+ * @file csvbench.cpp
+ * @author Simon Udsen
+ * @date 2026-10-18
+ * @brief Benchmark of the CSV recording parser
+ * @details Parses CSV recordings with csvparse, and with a plain parser that
+ * reads lines with std::getline and converts fields with std::stoi, like most
+ * tools would. Both are run from memory, to measure the parsers alone, and
+ * from the files, with --repeat passes each, and their columns are compared,
+ * so the fast parser is checked against the plain one. Run it on every CSV
+ * file in ../tcp_server/out:
+ *
+ *     csvbench ../tcp_server/out/walk.00001.csv ...
+ *
+ * Files are read once before timing, so they are in the page cache.
+ *
+ * The exit code is 1 if the parsers disagree.
+ */
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include <stdint.h> // Standard integer types
+#include <stdio.h>  // printf
+#include <stdlib.h> // strtoul
+#include <string.h> // strcmp
+
+#include <chrono>   // Parse times
+#include <fstream>  // Plain parser from files
+#include <sstream>  // Plain parser from memory
+#include <string>   // Lines
+#include <vector>   // File contents
+
+#include "config.h"   // AXIS_T
+#include "csvparse.h" // Fast parser of CSV recordings
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+// Result of a parser
+typedef struct bench_result_
+{
+    double seconds;   // Time of every pass
+    uint64_t bytes;   // Bytes parsed in every pass
+    uint64_t samples; // Samples parsed in every pass
+} bench_result_t;
+
+/**************************************************************/
+/*                          Private                           */
+/**************************************************************/
+
+/**************************************************************/
+// Parse lines with std::getline and std::stoi, skipping lines that are not a
+// sample
+static void plainParse( std::istream& input, csvparse_columns_t* columns )
+{
+    std::string line;
+    while ( std::getline( input, line ) )
+    {
+        try
+        {
+            size_t start = 0;
+            int fields[5];
+            for ( int i = 0; i < 5; i++ )
+            {
+                size_t end = line.find( ',', start );
+                if ( ( end == std::string::npos ) != ( i == 4 ) )
+                {
+                    throw std::invalid_argument( "fields" );
+                }
+                fields[i] = std::stoi( line.substr( start, end - start ) );
+                start = end + 1;
+            }
+            columns->timestamp.push_back( ( uint32_t )fields[0] );
+            columns->acceleration[AXIS_X].push_back( ( int16_t )fields[1] );
+            columns->acceleration[AXIS_Y].push_back( ( int16_t )fields[2] );
+            columns->acceleration[AXIS_Z].push_back( ( int16_t )fields[3] );
+            columns->step.push_back( fields[4] != 0 );
+        }
+        catch ( const std::exception& )
+        {
+            columns->skippedLines++;
+        }
+    }
+}
+
+/**************************************************************/
+// Check that two parsers found the same samples
+static bool sameColumns( const csvparse_columns_t* a, const csvparse_columns_t* b )
+{
+    return ( a->timestamp == b->timestamp ) && ( a->acceleration[AXIS_X] == b->acceleration[AXIS_X] ) &&
+           ( a->acceleration[AXIS_Y] == b->acceleration[AXIS_Y] ) &&
+           ( a->acceleration[AXIS_Z] == b->acceleration[AXIS_Z] ) && ( a->step == b->step ) &&
+           ( a->skippedLines == b->skippedLines );
+}
+
+/**************************************************************/
+// Print a row of the report
+static void printResult( const char* name, const bench_result_t* result, uint32_t repeat, double baseline )
+{
+    double seconds = result->seconds / repeat;
+    printf( "%-24s %10.1f %10.2f %9.1fx\n",
+            name,
+            result->bytes / seconds / 1e6,
+            result->samples / seconds / 1e6,
+            baseline / seconds );
+}
+
+/**************************************************************/
+// Print usage
+static void usage()
+{
+    printf( "Usage: csvbench [options] recording.csv...\n"
+            "  --repeat N               Passes over the files per parser (default: 20)\n" );
+}
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+int main( int argc, char** argv )
+{
+    uint32_t repeat = 20;
+    std::vector<const char*> paths;
+
+    for ( int i = 1; i < argc; i++ )
+    {
+        const char* arg = argv[i];
+        const char* value = ( i + 1 < argc ) ? argv[i + 1] : NULL;
+
+        if ( strcmp( arg, "--help" ) == 0 )
+        {
+            usage();
+            return 0;
+        }
+        if ( strncmp( arg, "--", 2 ) != 0 )
+        {
+            paths.push_back( arg );
+            continue;
+        }
+        if ( value == NULL )
+        {
+            usage();
+            return 1;
+        }
+
+        i++;
+        if ( strcmp( arg, "--repeat" ) == 0 )
+        {
+            repeat = strtoul( value, NULL, 10 );
+        }
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    if ( paths.empty() || ( repeat == 0 ) )
+    {
+        usage();
+        return 1;
+    }
+
+    // Contents of every file, with padding for the fast parser
+    std::vector<std::string> contents;
+    uint64_t bytes = 0;
+    for ( const char* path : paths )
+    {
+        std::ifstream file( path, std::ios::binary );
+        if ( !file )
+        {
+            printf( "Failed to read %s\n", path );
+            return 1;
+        }
+        std::stringstream text;
+        text << file.rdbuf();
+        contents.push_back( text.str() );
+        bytes += contents.back().size();
+    }
+
+    bench_result_t results[4] = {};
+    const char* names[4] = { "getline+stoi, memory", "csvparse, memory", "getline+stoi, file", "csvparse, file" };
+    for ( bench_result_t& result : results )
+    {
+        result.bytes = bytes;
+    }
+
+    for ( size_t f = 0; f < paths.size(); f++ )
+    {
+        csvparse_columns_t columns[4] = {};
+        for ( uint32_t pass = 0; pass < repeat; pass++ )
+        {
+            // Columns keep their memory between passes, for both parsers
+            for ( csvparse_columns_t& column : columns )
+            {
+                column.timestamp.clear();
+                for ( std::vector<int16_t>& axis : column.acceleration )
+                {
+                    axis.clear();
+                }
+                column.step.clear();
+                column.skippedLines = 0;
+            }
+
+            auto t0 = std::chrono::steady_clock::now();
+            std::istringstream input( contents[f] );
+            plainParse( input, &( columns[0] ) );
+
+            auto t1 = std::chrono::steady_clock::now();
+            std::string padded = contents[f];
+            if ( !padded.empty() && ( padded.back() != '\n' ) )
+            {
+                padded += '\n';
+            }
+            size_t length = padded.size();
+            padded.append( CSVPARSE_PADDING, '\0' );
+            auto t2 = std::chrono::steady_clock::now();
+            csvparse_buffer( padded.data(), length, &( columns[1] ) );
+
+            auto t3 = std::chrono::steady_clock::now();
+            std::ifstream file( paths[f] );
+            plainParse( file, &( columns[2] ) );
+
+            auto t4 = std::chrono::steady_clock::now();
+            csvparse_file( paths[f], &( columns[3] ) );
+            auto t5 = std::chrono::steady_clock::now();
+
+            results[0].seconds += std::chrono::duration<double>( t1 - t0 ).count();
+            results[1].seconds += std::chrono::duration<double>( t3 - t2 ).count();
+            results[2].seconds += std::chrono::duration<double>( t4 - t3 ).count();
+            results[3].seconds += std::chrono::duration<double>( t5 - t4 ).count();
+        }
+
+        for ( uint8_t parser = 1; parser < 4; parser++ )
+        {
+            if ( !sameColumns( &( columns[0] ), &( columns[parser] ) ) )
+            {
+                printf( "%s: %s disagrees with %s\n", paths[f], names[parser], names[0] );
+                return 1;
+            }
+        }
+        for ( bench_result_t& result : results )
+        {
+            result.samples += columns[0].timestamp.size();
+        }
+    }
+
+    printf( "%zu files, %.2f MB, %llu samples, %lu passes, all parsers agree\n",
+            paths.size(),
+            bytes / 1e6,
+            ( unsigned long long )results[0].samples,
+            ( unsigned long )repeat );
+    printf( "%-24s %10s %10s %10s\n", "parser", "MB/s", "Msamples/s", "speedup" );
+    for ( uint8_t parser = 0; parser < 4; parser++ )
+    {
+        printResult( names[parser], &( results[parser] ), repeat, results[parser & 2].seconds / repeat );
+    }
+    return 0;
+}
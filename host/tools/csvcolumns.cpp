@@ -0,0 +1,301 @@
+/**
+ * @file csvcolumns.cpp
+ * @author Simon Udsen
+ * @date 2026-10-18
+ * @brief Converter of CSV recordings to column files
+ * @details Converts recordings of the TCP server to column files, see
+ * columnfile.h, next to the CSV files or in --out. Every file is mapped again
+ * after it is written, and compared with the CSV, so the conversion is checked
+ * to be lossless. Convert every recording in ../tcp_server/out:
+ *
+ *     csvcolumns ../tcp_server/out/walk.00001.csv ...
+ *
+ * The label is the file name up to the first dot, like the activity of
+ * codecratio. The CSV files have no device ID or wall clock time, so the device
+ * ID is --device, or zeros, and the start time is the modification time of
+ * the CSV file, which the server wrote last, minus the length of the
+ * recording.
+ *
+ * Finally, the time to parse every CSV file is compared with the time to map
+ * every column file and read all of its columns once.
+ *
+ * The exit code is 1 if a file could not be converted losslessly.
+ */
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include <stdint.h>   // Standard integer types
+#include <stdio.h>    // printf, snprintf
+#include <stdlib.h>   // strtoul
+#include <string.h>   // strcmp
+#include <sys/stat.h> // stat
+
+#include <chrono> // Load times
+#include <string> // Paths and labels
+#include <vector> // Samples of a recording
+
+#include "columnfile.h" // Columnar binary recordings
+#include "recording.h"  // CSV recordings
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+/**************************************************************/
+/*                          Private                           */
+/**************************************************************/
+
+/**************************************************************/
+// Parse a device ID of FRAME_DEVICE_ID_SIZE bytes in hex
+static bool parseDeviceId( const char* text, uint8_t* deviceId )
+{
+    if ( strlen( text ) != FRAME_DEVICE_ID_SIZE * 2 )
+    {
+        return false;
+    }
+    for ( uint8_t i = 0; i < FRAME_DEVICE_ID_SIZE; i++ )
+    {
+        char byte[3] = { text[i * 2], text[i * 2 + 1], 0 };
+        char* end = NULL;
+        deviceId[i] = ( uint8_t )strtoul( byte, &end, 16 );
+        if ( *end != 0 )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**************************************************************/
+// Check that a column file holds the samples it was written from
+static bool sameSamples( const columnfile_t* file, const std::vector<acceleration_sample_t>& samples )
+{
+    if ( file->header->sampleCount != samples.size() )
+    {
+        return false;
+    }
+
+    acceleration_sample_t sample;
+    for ( size_t i = 0; i < samples.size(); i++ )
+    {
+        columnfile_read( file, i, &sample, 1 );
+        if ( ( sample.timestamp != samples[i].timestamp ) ||
+             ( sample.acceleration[AXIS_X] != samples[i].acceleration[AXIS_X] ) ||
+             ( sample.acceleration[AXIS_Y] != samples[i].acceleration[AXIS_Y] ) ||
+             ( sample.acceleration[AXIS_Z] != samples[i].acceleration[AXIS_Z] ) || ( sample.step != samples[i].step ) )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**************************************************************/
+// Read every column of a file once, like a training run would
+static uint64_t touchColumns( const columnfile_t* file )
+{
+    uint64_t sum = 0;
+    for ( uint32_t delta : file->deltas )
+    {
+        sum += delta;
+    }
+    for ( uint8_t axis = AXIS_X; axis <= AXIS_Z; axis++ )
+    {
+        for ( int16_t value : file->acceleration[axis] )
+        {
+            sum += ( uint16_t )value;
+        }
+    }
+    for ( uint64_t word : file->steps )
+    {
+        sum += ( uint64_t )__builtin_popcountll( word );
+    }
+    return sum;
+}
+
+/**************************************************************/
+// Print usage
+static void usage()
+{
+    printf( "Usage: csvcolumns [options] recording.csv...\n"
+            "  --out DIR                Directory of column files (default: next to CSV files)\n"
+            "  --rate N                 Nominal sample rate in Hz (default: ACCELEROMETER_SAMPLE_RATE_HZ)\n"
+            "  --unit-us N              Microseconds per timestamp tick (default: 1000)\n"
+            "  --block N                Samples per index block, 0 for no index (default: 1024)\n"
+            "  --device HEX             Device ID of recordings, 24 hex digits (default: zeros)\n" );
+}
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+int main( int argc, char** argv )
+{
+    const char* outDir = NULL;
+    columnfile_info_t info = {};
+    info.sampleRateHz = ACCELEROMETER_SAMPLE_RATE_HZ;
+    info.timestampUnitUs = 1000;
+    info.blockSamples = COLUMNFILE_BLOCK_SAMPLES;
+    std::vector<const char*> paths;
+
+    for ( int i = 1; i < argc; i++ )
+    {
+        const char* arg = argv[i];
+        const char* value = ( i + 1 < argc ) ? argv[i + 1] : NULL;
+
+        if ( strcmp( arg, "--help" ) == 0 )
+        {
+            usage();
+            return 0;
+        }
+        if ( strncmp( arg, "--", 2 ) != 0 )
+        {
+            paths.push_back( arg );
+            continue;
+        }
+        if ( value == NULL )
+        {
+            usage();
+            return 1;
+        }
+
+        i++;
+        if ( strcmp( arg, "--out" ) == 0 )
+        {
+            outDir = value;
+        }
+        else if ( strcmp( arg, "--rate" ) == 0 )
+        {
+            info.sampleRateHz = strtoul( value, NULL, 10 );
+        }
+        else if ( strcmp( arg, "--unit-us" ) == 0 )
+        {
+            info.timestampUnitUs = strtoul( value, NULL, 10 );
+        }
+        else if ( strcmp( arg, "--block" ) == 0 )
+        {
+            info.blockSamples = strtoul( value, NULL, 10 );
+        }
+        else if ( strcmp( arg, "--device" ) == 0 )
+        {
+            if ( !parseDeviceId( value, info.deviceId ) )
+            {
+                usage();
+                return 1;
+            }
+        }
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    if ( paths.empty() || ( info.timestampUnitUs == 0 ) )
+    {
+        usage();
+        return 1;
+    }
+
+    std::vector<std::string> outPaths;
+    uint64_t csvBytes = 0;
+    uint64_t columnBytes = 0;
+    uint64_t sampleCount = 0;
+    double csvSeconds = 0;
+
+    printf( "%-28s %8s %10s %10s\n", "recording", "samples", "csv", "columns" );
+    for ( const char* path : paths )
+    {
+        struct stat status;
+        std::vector<acceleration_sample_t> samples;
+        auto begin = std::chrono::steady_clock::now();
+        if ( ( stat( path, &status ) != 0 ) || !recording_read( path, 1, &samples ) )
+        {
+            printf( "Failed to read %s\n", path );
+            return 1;
+        }
+        csvSeconds += std::chrono::duration<double>( std::chrono::steady_clock::now() - begin ).count();
+
+        // Label is the file name up to the first dot
+        const char* name = strrchr( path, '/' );
+        name = ( name != NULL ) ? name + 1 : path;
+        std::string label( name, strcspn( name, "." ) );
+        std::string base( name, ( strrchr( name, '.' ) != NULL ) ? ( size_t )( strrchr( name, '.' ) - name )
+                                                                 : strlen( name ) );
+        std::string dir = ( outDir != NULL ) ? outDir : std::string( path, ( size_t )( name - path ) );
+        if ( !dir.empty() && ( dir.back() != '/' ) )
+        {
+            dir += '/';
+        }
+        std::string outPath = dir + base + COLUMNFILE_EXTENSION;
+
+        info.label = label.c_str();
+        info.startTimeMs = 0;
+        if ( !samples.empty() )
+        {
+            uint64_t lengthMs =
+                ( uint64_t )( samples.back().timestamp - samples.front().timestamp ) * info.timestampUnitUs / 1000;
+            info.startTimeMs = ( uint64_t )status.st_mtim.tv_sec * 1000 + ( uint64_t )status.st_mtim.tv_nsec / 1000000;
+            info.startTimeMs = ( info.startTimeMs > lengthMs ) ? info.startTimeMs - lengthMs : 0;
+        }
+
+        columnfile_t file;
+        if ( columnfile_write( outPath.c_str(), &info, samples.data(), samples.size() ) != 0 )
+        {
+            printf( "Failed to write %s\n", outPath.c_str() );
+            return 1;
+        }
+        if ( columnfile_open( &file, outPath.c_str() ) != 0 )
+        {
+            printf( "Failed to map %s\n", outPath.c_str() );
+            return 1;
+        }
+        bool same = sameSamples( &file, samples );
+        size_t size = file.mapSize;
+        columnfile_close( &file );
+        if ( !same )
+        {
+            printf( "%s does not hold the samples of %s\n", outPath.c_str(), path );
+            return 1;
+        }
+
+        printf( "%-28s %8zu %10llu %10zu\n", name, samples.size(), ( unsigned long long )status.st_size, size );
+        outPaths.push_back( outPath );
+        csvBytes += ( uint64_t )status.st_size;
+        columnBytes += size;
+        sampleCount += samples.size();
+    }
+
+    // Map every file again, and read every column
+    auto begin = std::chrono::steady_clock::now();
+    uint64_t checksum = 0;
+    for ( const std::string& outPath : outPaths )
+    {
+        columnfile_t file;
+        if ( columnfile_open( &file, outPath.c_str() ) != 0 )
+        {
+            printf( "Failed to map %s\n", outPath.c_str() );
+            return 1;
+        }
+        checksum += touchColumns( &file );
+        columnfile_close( &file );
+    }
+    double columnSeconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - begin ).count();
+
+    printf( "%zu recordings, %llu samples converted losslessly: %.2f bytes/sample as CSV, %.2f as columns\n",
+            paths.size(),
+            ( unsigned long long )sampleCount,
+            ( double )csvBytes / ( sampleCount ? sampleCount : 1 ),
+            ( double )columnBytes / ( sampleCount ? sampleCount : 1 ) );
+    printf( "Load all: %.2f ms parsing CSV, %.3f ms mapping and reading columns (checksum %llu)\n",
+            csvSeconds * 1e3,
+            columnSeconds * 1e3,
+            ( unsigned long long )checksum );
+    return 0;
+}
@@ -0,0 +1,416 @@
+/**
+ * @file csvparse.cpp
+ * @author Simon Udsen
+ * @date 2026-10-18
+ */
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include "csvparse.h" // Header file for this module
+
+#include <fcntl.h>    // open, posix_fadvise
+#include <string.h>   // memcpy, memmove
+#include <sys/stat.h> // fstat
+#include <unistd.h>   // read, close
+
+#if defined( __SSE2__ )
+#include <immintrin.h> // SSE2 and AVX2 intrinsics
+#endif
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+#define DIGITS_ZERO 0x3030303030303030ULL  // '0' in every byte
+#define DIGITS_ABOVE 0x7676767676767676ULL // Added to a digit, sets the top bit if it is above 9
+#define BYTES_TOP 0x8080808080808080ULL    // Top bit of every byte
+#define MAX_UNSIGNED_DIGITS 10             // Digits of the largest 32 bit value
+#define MAX_SIGNED_DIGITS 5                // Digits of the largest 16 bit value
+#define TYPICAL_LINE_LENGTH 16             // Bytes per line to reserve samples for
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+/**************************************************************/
+/*                          Private                           */
+/**************************************************************/
+
+/**************************************************************/
+// Bitmask of the commas and newlines in 64 bytes, bit i for byte i
+static inline uint64_t delimiters( const char* data )
+{
+#if defined( __AVX2__ )
+    const __m256i comma = _mm256_set1_epi8( ',' );
+    const __m256i newline = _mm256_set1_epi8( '\n' );
+    __m256i low = _mm256_loadu_si256( ( const __m256i* )data );
+    __m256i high = _mm256_loadu_si256( ( const __m256i* )( data + 32 ) );
+    uint32_t lowMask = ( uint32_t )_mm256_movemask_epi8(
+        _mm256_or_si256( _mm256_cmpeq_epi8( low, comma ), _mm256_cmpeq_epi8( low, newline ) ) );
+    uint32_t highMask = ( uint32_t )_mm256_movemask_epi8(
+        _mm256_or_si256( _mm256_cmpeq_epi8( high, comma ), _mm256_cmpeq_epi8( high, newline ) ) );
+    return ( uint64_t )lowMask | ( ( uint64_t )highMask << 32 );
+#elif defined( __SSE2__ )
+    const __m128i comma = _mm_set1_epi8( ',' );
+    const __m128i newline = _mm_set1_epi8( '\n' );
+    uint64_t mask = 0;
+    for ( uint8_t i = 0; i < 4; i++ )
+    {
+        __m128i bytes = _mm_loadu_si128( ( const __m128i* )( data + i * 16 ) );
+        uint32_t found = ( uint32_t )_mm_movemask_epi8(
+            _mm_or_si128( _mm_cmpeq_epi8( bytes, comma ), _mm_cmpeq_epi8( bytes, newline ) ) );
+        mask |= ( uint64_t )found << ( i * 16 );
+    }
+    return mask;
+#else
+    uint64_t mask = 0;
+    for ( uint8_t i = 0; i < 64; i++ )
+    {
+        mask |= ( uint64_t )( ( data[i] == ',' ) | ( data[i] == '\n' ) ) << i;
+    }
+    return mask;
+#endif
+}
+
+/**************************************************************/
+// Find the positions of every comma and newline in data, and return the count.
+// Up to 64 positions past the count may be overwritten
+static size_t findDelimiters( const char* data, size_t length, uint32_t* positions )
+{
+    size_t count = 0;
+    for ( size_t base = 0; base < length; base += 64 )
+    {
+        uint64_t mask = delimiters( data + base );
+        if ( length - base < 64 )
+        {
+            // Ignore delimiters in the padding
+            mask &= ( ( uint64_t )1 << ( length - base ) ) - 1;
+        }
+
+        // Write 8 positions at a time without checking the mask, as a line has
+        // about 16 delimiters every 64 bytes, and only keep the real ones
+        uint32_t found = ( uint32_t )__builtin_popcountll( mask );
+        uint32_t* next = &( positions[count] );
+        while ( mask != 0 )
+        {
+#pragma GCC unroll 8
+            for ( uint8_t i = 0; i < 8; i++ )
+            {
+                next[i] = ( uint32_t )( base + ( size_t )__builtin_ctzll( mask | ( ( uint64_t )1 << 63 ) ) );
+                mask &= mask - 1;
+            }
+            next += 8;
+        }
+        count += found;
+    }
+    return count;
+}
+
+/**************************************************************/
+// Convert 1 to 8 digits at once, and set bits in error if they are not. The 8
+// bytes loaded may run past the field
+static inline uint32_t parseDigits( const char* text, size_t length, uint64_t* error )
+{
+    uint64_t digits;
+    memcpy( &digits, text, sizeof( digits ) );
+
+    // Move the digits to the top, so the bytes after them are dropped, and the
+    // bytes before them are leading zeros
+    *error |= ( length - 1 ) >> 3;
+    digits = ( digits - DIGITS_ZERO ) << ( ( ( 8 - length ) & 7 ) * 8 );
+    *error |= ( digits | ( digits + DIGITS_ABOVE ) ) & BYTES_TOP;
+
+    // Combine pairs of digits, then pairs of those, then the two halves
+    digits = ( ( digits * 10 ) + ( digits >> 8 ) ) & 0x00FF00FF00FF00FFULL;
+    digits = ( ( digits * 100 ) + ( digits >> 16 ) ) & 0x0000FFFF0000FFFFULL;
+    digits = ( ( digits * 10000 ) + ( digits >> 32 ) ) & 0x00000000FFFFFFFFULL;
+    return ( uint32_t )digits;
+}
+
+/**************************************************************/
+// Convert an unsigned 32 bit field
+static inline uint32_t parseUnsigned( const char* text, size_t length, uint64_t* error )
+{
+    if ( length <= 8 )
+    {
+        return parseDigits( text, length, error );
+    }
+
+    // More than 8 digits: the first ones, then the last 8
+    *error |= ( length > MAX_UNSIGNED_DIGITS );
+    uint64_t high = parseDigits( text, ( length - 8 ) & 7, error );
+    uint64_t combined = high * 100000000 + parseDigits( text + length - 8, 8, error );
+    *error |= combined >> 32;
+    return ( uint32_t )combined;
+}
+
+/**************************************************************/
+// Convert a signed 16 bit field
+static inline int16_t parseSigned( const char* text, size_t length, uint64_t* error )
+{
+    uint32_t negative = ( text[0] == '-' );
+    length -= negative;
+    *error |= ( length > MAX_SIGNED_DIGITS );
+
+    uint32_t magnitude = parseDigits( text + negative, length, error );
+    *error |= ( magnitude > ( uint32_t )INT16_MAX + negative );
+    return ( int16_t )( ( magnitude ^ -negative ) + negative );
+}
+
+/**************************************************************/
+// Convert the acceleration and step fields of a line at once, if none has more
+// than 4 digits, into values. Returns false if one has more
+static inline bool parseShortFields( const char* data,
+                                     const uint32_t* p,
+                                     size_t stepEnd,
+                                     int32_t* values,
+                                     uint64_t* error )
+{
+#if defined( __SSE2__ )
+    // Move the digits of every field to the top of a 32 bit lane, like
+    // parseDigits, with the signs of the acceleration fields
+    const size_t ends[4] = { p[1], p[2], p[3], stepEnd };
+    uint32_t lanes[4];
+    uint32_t negatives[4];
+    size_t lengths = 0;
+#pragma GCC unroll 4
+    for ( uint8_t field = 0; field < 4; field++ )
+    {
+        const char* text = data + p[field] + 1;
+        uint32_t negative = ( field < 3 ) & ( text[0] == '-' );
+        size_t length = ends[field] - p[field] - 1 - negative;
+        uint32_t digits;
+        memcpy( &digits, text + negative, sizeof( digits ) );
+        lanes[field] = ( digits - ( uint32_t )DIGITS_ZERO ) << ( ( ( 4 - length ) & 3 ) * 8 );
+        negatives[field] = -negative;
+        lengths |= ( length - 1 );
+    }
+    if ( lengths > 3 )
+    {
+        return false;
+    }
+
+    __m128i digits = _mm_set_epi32( ( int )lanes[3], ( int )lanes[2], ( int )lanes[1], ( int )lanes[0] );
+    __m128i nine = _mm_set1_epi8( 9 );
+    *error |= ( _mm_movemask_epi8( _mm_cmpeq_epi8( _mm_min_epu8( digits, nine ), digits ) ) != 0xFFFF );
+
+    // Weigh the digits of every lane, add pairs into 32 bits, narrow them to 16
+    // bits, and add pairs again
+    __m128i zero = _mm_setzero_si128();
+    __m128i weights = _mm_set_epi16( 1, 10, 100, 1000, 1, 10, 100, 1000 );
+    __m128i low = _mm_madd_epi16( _mm_unpacklo_epi8( digits, zero ), weights );
+    __m128i high = _mm_madd_epi16( _mm_unpackhi_epi8( digits, zero ), weights );
+    __m128i sums = _mm_madd_epi16( _mm_packs_epi32( low, high ), _mm_set1_epi16( 1 ) );
+
+    __m128i signs = _mm_set_epi32( ( int )negatives[3], ( int )negatives[2], ( int )negatives[1], ( int )negatives[0] );
+    _mm_storeu_si128( ( __m128i* )values, _mm_sub_epi32( _mm_xor_si128( sums, signs ), signs ) );
+    return true;
+#else
+    ( void )data;
+    ( void )p;
+    ( void )stepEnd;
+    ( void )values;
+    ( void )error;
+    return false;
+#endif
+}
+
+/**************************************************************/
+// Parse the lines of a window, and return the bytes of the complete lines
+static size_t parseWindow( const char* data,
+                           const uint32_t* positions,
+                           size_t count,
+                           csvparse_columns_t* columns,
+                           size_t* sampleCount )
+{
+    uint32_t* __restrict timestamps = columns->timestamp.data();
+    int16_t* __restrict x = columns->acceleration[0].data();
+    int16_t* __restrict y = columns->acceleration[1].data();
+    int16_t* __restrict z = columns->acceleration[2].data();
+    uint8_t* __restrict steps = columns->step.data();
+    size_t samples = *sampleCount;
+    size_t lineStart = 0;
+    size_t i = 0;
+
+    while ( i < count )
+    {
+        const uint32_t* p = &( positions[i] );
+        if ( ( i + 5 <= count ) && ( data[p[4]] == '\n' ) &&
+             ( ( data[p[0]] & data[p[1]] & data[p[2]] & data[p[3]] ) == ',' ) )
+        {
+            // Allow a carriage return before the newline
+            size_t stepEnd = p[4] - ( data[p[4] - 1] == '\r' );
+            uint64_t error = 0;
+            timestamps[samples] = parseUnsigned( data + lineStart, p[0] - lineStart, &error );
+            int32_t values[4];
+            if ( !parseShortFields( data, p, stepEnd, values, &error ) )
+            {
+                values[0] = parseSigned( data + p[0] + 1, p[1] - p[0] - 1, &error );
+                values[1] = parseSigned( data + p[1] + 1, p[2] - p[1] - 1, &error );
+                values[2] = parseSigned( data + p[2] + 1, p[3] - p[2] - 1, &error );
+                values[3] = ( parseUnsigned( data + p[3] + 1, stepEnd - p[3] - 1, &error ) != 0 );
+            }
+            x[samples] = ( int16_t )values[0];
+            y[samples] = ( int16_t )values[1];
+            z[samples] = ( int16_t )values[2];
+            steps[samples] = ( values[3] != 0 );
+
+            // Lines are nearly always valid, so a predicted branch lets the
+            // next line start before this one is checked
+            if ( __builtin_expect( error == 0, 1 ) )
+            {
+                samples++;
+            }
+            else
+            {
+                columns->skippedLines++;
+            }
+            lineStart = p[4] + 1;
+            i += 5;
+            continue;
+        }
+
+        // Not a sample, skip to the next line, if it is complete
+        while ( ( i < count ) && ( data[positions[i]] != '\n' ) )
+        {
+            i++;
+        }
+        if ( i == count )
+        {
+            break;
+        }
+        columns->skippedLines++;
+        lineStart = positions[i] + 1;
+        i++;
+    }
+
+    *sampleCount = samples;
+    return lineStart;
+}
+
+/**************************************************************/
+// Make room for a number of samples in every column
+static void reserveSamples( csvparse_columns_t* columns, size_t count )
+{
+    if ( count <= columns->timestamp.size() )
+    {
+        return;
+    }
+    count = ( count < columns->timestamp.size() * 2 ) ? columns->timestamp.size() * 2 : count;
+    columns->timestamp.resize( count );
+    for ( std::vector<int16_t>& axis : columns->acceleration )
+    {
+        axis.resize( count );
+    }
+    columns->step.resize( count );
+}
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+size_t csvparse_buffer( const char* data, size_t length, csvparse_columns_t* columns )
+{
+    static thread_local std::vector<uint32_t> positions;
+
+    size_t samples = columns->timestamp.size();
+    size_t start = 0;
+    size_t window = CSVPARSE_WINDOW;
+
+    // Make room for lines of a typical length at once, rather than growing
+    // the columns window by window
+    reserveSamples( columns, samples + length / TYPICAL_LINE_LENGTH );
+
+    while ( start < length )
+    {
+        size_t end = ( length - start < window ) ? length : start + window;
+        if ( positions.size() < end - start + 64 )
+        {
+            positions.resize( end - start + 64 );
+        }
+
+        size_t count = findDelimiters( data + start, end - start, positions.data() );
+        reserveSamples( columns, samples + count / 5 + 1 );
+        size_t parsed = parseWindow( data + start, positions.data(), count, columns, &samples );
+
+        // A line longer than the window needs a larger one
+        if ( parsed == 0 )
+        {
+            if ( end == length )
+            {
+                break;
+            }
+            window *= 2;
+            continue;
+        }
+        start += parsed;
+        window = CSVPARSE_WINDOW;
+    }
+
+    columns->timestamp.resize( samples );
+    for ( std::vector<int16_t>& axis : columns->acceleration )
+    {
+        axis.resize( samples );
+    }
+    columns->step.resize( samples );
+    return start;
+}
+
+/**************************************************************/
+int csvparse_file( const char* path, csvparse_columns_t* columns )
+{
+    int fd = open( path, O_RDONLY | O_CLOEXEC );
+    if ( fd < 0 )
+    {
+        return -1;
+    }
+    struct stat status;
+    if ( fstat( fd, &status ) != 0 )
+    {
+        close( fd );
+        return -1;
+    }
+    posix_fadvise( fd, 0, 0, POSIX_FADV_SEQUENTIAL );
+
+    // Unparsed bytes of a line are kept at the start for the next chunk, and
+    // there is room for a newline after the last line. Small files are read
+    // at once
+    size_t chunk = ( ( size_t )status.st_size < CSVPARSE_CHUNK ) ? ( size_t )status.st_size + 1 : CSVPARSE_CHUNK;
+    std::vector<char> buffer( 2 * chunk + 1 + CSVPARSE_PADDING );
+    size_t filled = 0;
+    int result = 0;
+
+    while ( true )
+    {
+        ssize_t count = read( fd, &( buffer[filled] ), 2 * chunk - filled );
+        if ( count < 0 )
+        {
+            result = -1;
+            break;
+        }
+        if ( count == 0 )
+        {
+            // Finish a last line without a newline
+            if ( filled > 0 )
+            {
+                buffer[filled++] = '\n';
+                csvparse_buffer( buffer.data(), filled, columns );
+            }
+            break;
+        }
+
+        filled += ( size_t )count;
+        size_t parsed = csvparse_buffer( buffer.data(), filled, columns );
+        if ( filled - parsed > chunk )
+        {
+            result = -1;
+            break;
+        }
+        memmove( buffer.data(), &( buffer[parsed] ), filled - parsed );
+        filled -= parsed;
+    }
+
+    close( fd );
+    return result;
+}
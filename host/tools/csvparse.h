@@ -0,0 +1,89 @@
+/**
+ * @file csvparse.h
+ * @author Simon Udsen
+ * @date 2026-10-18
+ * @brief Fast parser of CSV recordings
+ * @details Parses the "timestamp,accX,accY,accZ,step" lines the TCP server
+ * writes into one array per column. Data is parsed in windows of
+ * CSVPARSE_WINDOW bytes, small enough to stay in cache, in two passes:
+ * - The first pass finds every comma and newline of the window with SIMD
+ *   compares, 64 bytes at a time, and stores their positions
+ * - The second pass walks the positions five at a time. A line is valid if its
+ *   first four delimiters are commas and the fifth a newline. The timestamp is
+ *   converted by loading 8 bytes at once and combining the digits with three
+ *   multiplications, without a loop over the characters. The acceleration and
+ *   step fields get a 32 bit lane each of one SSE2 register, and are converted
+ *   together. Fields of more than 4 digits are converted one at a time
+ *
+ * Errors in every field are collected, and checked once per line, so valid
+ * lines don't branch on their contents.
+ *
+ * Lines that are not a sample, like the header, or fields that are too long or
+ * out of range, are counted and skipped, so files with or without a header
+ * are read the same way. A carriage return before the newline is allowed.
+ *
+ * The passes read up to CSVPARSE_PADDING bytes past the end of the data, so a
+ * caller of csvparse_buffer must make them readable. csvparse_file reads files
+ * in chunks into a padded buffer.
+ *
+ * SSE2 is used on x86-64, and AVX2 when the compiler targets it. Other
+ * architectures find delimiters one byte at a time.
+ */
+#ifndef CSVPARSE_H
+#define CSVPARSE_H
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include <stddef.h> // size_t
+#include <stdint.h> // Standard integer types
+
+#include <vector> // Columns
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+#define CSVPARSE_PADDING 64            // Bytes read past the end of the data
+#define CSVPARSE_WINDOW ( 16 * 1024 )  // Bytes parsed per window
+#define CSVPARSE_CHUNK ( 1024 * 1024 ) // Bytes read from a file at a time
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+// Columns of a recording, with an element per sample
+typedef struct csvparse_columns_
+{
+    std::vector<uint32_t> timestamp;      // Timestamps
+    std::vector<int16_t> acceleration[3]; // Acceleration per axis, indexed by AXIS_T
+    std::vector<uint8_t> step;            // 1 if sample is a step, otherwise 0
+    size_t skippedLines;                  // Lines that were not a sample
+} csvparse_columns_t;
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+/**
+ * Parses the complete lines of a buffer, and appends their samples
+ * @param[in] data Buffer, followed by CSVPARSE_PADDING readable bytes
+ * @param[in] length Length of buffer
+ * @param[in,out] columns Columns to append to
+ * @returns Bytes parsed, up to and including the last newline
+ */
+size_t csvparse_buffer( const char* data, size_t length, csvparse_columns_t* columns );
+
+/**************************************************************/
+/**
+ * Parses a file, and appends its samples. A last line without a newline is
+ * parsed too
+ * @param[in] path Path of file
+ * @param[in,out] columns Columns to append to
+ * @returns Status
+ * @retval 0: File parsed
+ * @retval -1: File could not be read, or has a line longer than CSVPARSE_CHUNK
+ */
+int csvparse_file( const char* path, csvparse_columns_t* columns );
+
+#endif // CSVPARSE_H
@@ -0,0 +1,46 @@
+/**
+ * @file eml_trees.h
+ * @author Simon Udsen
+ * @date 2026-10-18
+ * @brief Types of emlearn's trees, for host builds
+ * @details step_counter_model.h includes <eml_trees.h> for the types of its
+ * node table, which the firmware gets from the emlearn library. The host tools
+ * only call the inline tree functions, so these types are all they need, and
+ * the model compiles without emlearn. The layout is the one of emlearn.
+ */
+#ifndef EML_TREES_H
+#define EML_TREES_H
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include <stdint.h> // Standard integer types
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+// Node of a tree. Positive children are offsets, negative ones leaves
+typedef struct _EmlTreesNode
+{
+    int8_t feature; // Feature compared
+    int16_t value;  // Threshold, features below it go left
+    int16_t left;   // Left child
+    int16_t right;  // Right child
+} EmlTreesNode;
+
+// Forest of trees
+typedef struct _EmlTrees
+{
+    int32_t n_nodes;     // Nodes of all trees
+    EmlTreesNode* nodes; // Node table
+    int32_t n_trees;     // Number of trees
+    int32_t* tree_roots; // Root node of every tree
+    int32_t n_leaves;    // Bytes of leaves
+    uint8_t* leaves;     // Leaf values
+    int8_t leaf_bits;    // Bits per leaf value
+    int8_t n_features;   // Features per row
+    int8_t n_classes;    // Classes, 0 for a regressor
+} EmlTrees;
+
+#endif // EML_TREES_H
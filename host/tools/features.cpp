@@ -0,0 +1,159 @@
+/**
+ * @file features.cpp
+ * @author Simon Udsen
+ * @date 2026-10-18
+ * @brief Extractor of training features from recordings
+ * @details Calculates every candidate feature of every window of recordings
+ * with the firmware's feature code, see featureset.h, and writes them to a
+ * NumPy .npy file for the training notebook. Extract the features of every
+ * recording in ../tcp_server/out, with the windows of the notebook:
+ *
+ *     features --window 100 --hop 50 --out features.npy ../tcp_server/out/walk.00001.csv ...
+ *
+ * Load the file in Python with:
+ *
+ *     inputData = pd.DataFrame(np.load('features.npy'))
+ *
+ * Windows are at most WINDOW_MAX_SIZE samples, see window.h.
+ *
+ * The exit code is 1 if a recording could not be read, or the file written.
+ */
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include <stdint.h> // Standard integer types
+#include <stdio.h>  // printf
+#include <stdlib.h> // strtoul
+#include <string.h> // strcmp
+
+#include <chrono> // Extraction time
+#include <thread> // hardware_concurrency
+#include <vector> // Paths of recordings
+
+#include "config.h"     // DATA_BUFFER_SIZE, WINDOW_MAX_SIZE
+#include "featureset.h" // Training features of recordings
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+/**************************************************************/
+/*                          Private                           */
+/**************************************************************/
+
+/**************************************************************/
+// Print usage
+static void usage()
+{
+    printf( "Usage: features [options] recording...\n"
+            "  --out PATH               Output .npy file (default: features.npy)\n"
+            "  --window N               Samples per window, at most 65535 (default: DATA_BUFFER_SIZE)\n"
+            "  --hop N                  Samples between windows (default: half a window)\n"
+            "  --threads N              Threads to extract with (default: one per core)\n" );
+}
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+int main( int argc, char** argv )
+{
+    const char* outPath = "features.npy";
+    uint32_t windowSize = DATA_BUFFER_SIZE;
+    uint32_t hop = 0;
+    uint32_t threads = std::thread::hardware_concurrency();
+    std::vector<const char*> paths;
+
+    for ( int i = 1; i < argc; i++ )
+    {
+        const char* arg = argv[i];
+        const char* value = ( i + 1 < argc ) ? argv[i + 1] : NULL;
+
+        if ( strcmp( arg, "--help" ) == 0 )
+        {
+            usage();
+            return 0;
+        }
+        if ( strncmp( arg, "--", 2 ) != 0 )
+        {
+            paths.push_back( arg );
+            continue;
+        }
+        if ( value == NULL )
+        {
+            usage();
+            return 1;
+        }
+
+        i++;
+        if ( strcmp( arg, "--out" ) == 0 )
+        {
+            outPath = value;
+        }
+        else if ( strcmp( arg, "--window" ) == 0 )
+        {
+            windowSize = strtoul( value, NULL, 10 );
+        }
+        else if ( strcmp( arg, "--hop" ) == 0 )
+        {
+            hop = strtoul( value, NULL, 10 );
+        }
+        else if ( strcmp( arg, "--threads" ) == 0 )
+        {
+            threads = strtoul( value, NULL, 10 );
+        }
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    hop = ( hop == 0 ) ? windowSize / 2 : hop;
+    threads = ( threads == 0 ) ? 1 : threads;
+    if ( paths.empty() || ( windowSize < WINDOW_MIN_SIZE ) || ( windowSize > WINDOW_MAX_SIZE ) || ( hop == 0 ) ||
+         ( hop > UINT16_MAX ) )
+    {
+        usage();
+        return 1;
+    }
+
+    featureset_t set;
+    auto begin = std::chrono::steady_clock::now();
+    int status = featureset_extract( paths, ( uint16_t )windowSize, ( uint16_t )hop, threads, &set );
+    double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - begin ).count();
+    if ( status == -1 )
+    {
+        printf( "Failed to read a recording\n" );
+        return 1;
+    }
+    if ( status == -2 )
+    {
+        printf( "statisticalfeatures_getFeatures differs from its candidate features\n" );
+        return 1;
+    }
+
+    if ( featureset_writeNpy( &set, outPath ) != 0 )
+    {
+        printf( "Failed to write %s\n", outPath );
+        return 1;
+    }
+
+    printf( "%zu recordings, %zu windows of %lu samples every %lu, %u features, %lu threads: %.1f ms, %.0f windows/s\n",
+            paths.size(),
+            featureset_windows( &set ),
+            ( unsigned long )windowSize,
+            ( unsigned long )hop,
+            ( unsigned )STATISTICALFEATURES_CANDIDATES,
+            ( unsigned long )threads,
+            seconds * 1e3,
+            featureset_windows( &set ) / seconds );
+    printf( "Model features match their candidates in every window, written to %s\n", outPath );
+    return 0;
+}
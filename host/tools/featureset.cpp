@@ -0,0 +1,211 @@
+/**
+ * @file featureset.cpp
+ * @author Simon Udsen
+ * @date 2026-10-18
+ */
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include "featureset.h" // Header file for this module
+
+#include <stdio.h>  // fopen, fwrite
+#include <string.h> // strlen
+
+#include <algorithm> // std::min
+#include <atomic>    // Next recording to process
+#include <thread>    // Worker threads
+
+#include "recording.h" // Recordings
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+#define NPY_MAGIC "\x93NUMPY" // Start of a .npy file
+#define NPY_ALIGNMENT 64      // Alignment of the data of a .npy file
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+// Windows of one recording
+typedef struct recording_windows_
+{
+    std::vector<uint32_t> start;     // First sample of every window
+    std::vector<uint16_t> steps;     // Steps in every window
+    std::vector<int64_t> candidates; // Candidate features of every window
+    int status;                      // Status of featureset_extract for this recording
+} recording_windows_t;
+
+// Row of a .npy file, in the order of its fields
+#pragma pack( push, 1 )
+typedef struct npy_row_
+{
+    uint32_t recording;                                 // Recording of window
+    uint32_t start;                                     // First sample of window
+    uint16_t steps;                                     // Steps in window
+    char activity[FEATURESET_LABEL_SIZE];               // Activity of recording, zero padded
+    int64_t candidates[STATISTICALFEATURES_CANDIDATES]; // Candidate features
+} npy_row_t;
+#pragma pack( pop )
+
+/**************************************************************/
+/*                          Private                           */
+/**************************************************************/
+
+/**************************************************************/
+// Calculate the windows of one recording
+static void extractRecording( const char* path, uint16_t windowSize, uint16_t hop, recording_windows_t* windows )
+{
+    std::vector<acceleration_sample_t> samples;
+    if ( !recording_read( path, 1, &samples ) )
+    {
+        windows->status = -1;
+        return;
+    }
+
+    size_t count = ( samples.size() >= windowSize ) ? ( samples.size() - windowSize ) / hop + 1 : 0;
+    windows->start.resize( count );
+    windows->steps.resize( count );
+    windows->candidates.resize( count * STATISTICALFEATURES_CANDIDATES );
+    windows->status = 0;
+
+    for ( size_t window = 0; window < count; window++ )
+    {
+        acceleration_sample_t* first = &( samples[window * hop] );
+        int64_t* candidates = &( windows->candidates[window * STATISTICALFEATURES_CANDIDATES] );
+        statisticalfeatures_getCandidates( first, windowSize, candidates );
+
+        // The features of the model must be the same as their candidates
+        int16_t features[STATISTICALFEATURES_NUM_FEATURES];
+        statisticalfeatures_getFeatures( first, windowSize, features );
+        for ( uint8_t feature = 0; feature < STATISTICALFEATURES_NUM_FEATURES; feature++ )
+        {
+            if ( features[feature] != candidates[statisticalfeatures_modelCandidate( feature )] )
+            {
+                windows->status = -2;
+            }
+        }
+
+        uint16_t steps = 0;
+        for ( uint16_t i = 0; i < windowSize; i++ )
+        {
+            steps += first[i].step ? 1 : 0;
+        }
+        windows->start[window] = ( uint32_t )( window * hop );
+        windows->steps[window] = steps;
+    }
+}
+
+/**************************************************************/
+// Get the .npy header of a set, padded so the data is aligned
+static std::string npyHeader( const featureset_t* set )
+{
+    std::string descr = "[('recording', '<u4'), ('start', '<u4'), ('steps', '<u2'), ('activity', '|S" +
+                        std::to_string( FEATURESET_LABEL_SIZE ) + "')";
+    for ( uint8_t candidate = 0; candidate < STATISTICALFEATURES_CANDIDATES; candidate++ )
+    {
+        descr += ", ('";
+        descr += statisticalfeatures_candidateName( ( statisticalfeatures_candidate_t )candidate );
+        descr += "', '<i8')";
+    }
+    descr += "]";
+
+    std::string dict = "{'descr': " + descr + ", 'fortran_order': False, 'shape': (" +
+                       std::to_string( featureset_windows( set ) ) + ",), }";
+
+    // Magic, version 1.0 and 16 bit header length, then the padded dictionary
+    size_t prefix = strlen( NPY_MAGIC ) + 2 + 2;
+    size_t length = ( prefix + dict.size() + 1 + NPY_ALIGNMENT - 1 ) / NPY_ALIGNMENT * NPY_ALIGNMENT - prefix;
+    dict.append( length - dict.size() - 1, ' ' );
+    dict += '\n';
+
+    std::string header = NPY_MAGIC;
+    header += ( char )1;
+    header += ( char )0;
+    header += ( char )( length & 0xFF );
+    header += ( char )( length >> 8 );
+    return header + dict;
+}
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+int featureset_extract( const std::vector<const char*>& paths,
+                        uint16_t windowSize,
+                        uint16_t hop,
+                        uint32_t threads,
+                        featureset_t* set )
+{
+    std::vector<recording_windows_t> windows( paths.size() );
+    std::atomic<size_t> next( 0 );
+
+    // Recordings differ in length, so threads take the next one when they are done
+    auto worker = [&]()
+    {
+        for ( size_t i = next++; i < paths.size(); i = next++ )
+        {
+            extractRecording( paths[i], windowSize, hop, &( windows[i] ) );
+        }
+    };
+    std::vector<std::thread> workers;
+    for ( uint32_t i = 1; i < threads; i++ )
+    {
+        workers.emplace_back( worker );
+    }
+    worker();
+    for ( std::thread& thread : workers )
+    {
+        thread.join();
+    }
+
+    *set = featureset_t();
+    set->windowSize = windowSize;
+    set->hop = hop;
+    for ( size_t i = 0; i < paths.size(); i++ )
+    {
+        if ( windows[i].status != 0 )
+        {
+            return windows[i].status;
+        }
+        set->labels.push_back( recording_label( paths[i] ) );
+        set->recording.insert( set->recording.end(), windows[i].steps.size(), ( uint32_t )i );
+        set->start.insert( set->start.end(), windows[i].start.begin(), windows[i].start.end() );
+        set->steps.insert( set->steps.end(), windows[i].steps.begin(), windows[i].steps.end() );
+        set->candidates.insert( set->candidates.end(), windows[i].candidates.begin(), windows[i].candidates.end() );
+    }
+    return 0;
+}
+
+/**************************************************************/
+int featureset_writeNpy( const featureset_t* set, const char* path )
+{
+    FILE* file = fopen( path, "wb" );
+    if ( file == NULL )
+    {
+        return -1;
+    }
+
+    std::string header = npyHeader( set );
+    bool written = fwrite( header.data(), 1, header.size(), file ) == header.size();
+
+    npy_row_t row;
+    for ( size_t window = 0; written && ( window < featureset_windows( set ) ); window++ )
+    {
+        memset( &row, 0, sizeof( row ) );
+        row.recording = set->recording[window];
+        row.start = set->start[window];
+        row.steps = set->steps[window];
+        const std::string& label = set->labels[row.recording];
+        memcpy( row.activity, label.data(), std::min( label.size(), sizeof( row.activity ) ) );
+        memcpy( row.candidates,
+                &( set->candidates[window * STATISTICALFEATURES_CANDIDATES] ),
+                sizeof( row.candidates ) );
+        written = fwrite( &row, sizeof( row ), 1, file ) == 1;
+    }
+
+    written = ( fclose( file ) == 0 ) && written;
+    return written ? 0 : -1;
+}
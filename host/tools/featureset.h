@@ -0,0 +1,117 @@
+/**
+ * @file featureset.h
+ * @author Simon Udsen
+ * @date 2026-10-18
+ * @brief Training features of recordings
+ * @details Splits recordings into windows, like the training notebook, and
+ * calculates every candidate feature of every window with
+ * statisticalfeatures_getCandidates, the firmware's own code, so a model is
+ * trained on exactly the values the firmware calculates. Recordings are
+ * processed in parallel, one at a time per thread, and the windows are
+ * collected in the order of the recordings, so the result doesn't depend on the
+ * number of threads.
+ *
+ * Windows start every hop samples, and only whole windows are used. The steps
+ * of a window are the samples marked as a step in it.
+ *
+ * The features of statisticalfeatures_getFeatures are calculated for every
+ * window too, and compared with their candidate features, so the model
+ * features are known to be columns of the candidates.
+ */
+#ifndef FEATURESET_H
+#define FEATURESET_H
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include <stdint.h> // Standard integer types
+
+#include <string> // Labels
+#include <vector> // Windows
+
+#include "statisticalfeatures.h" // Candidate features
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+#define FEATURESET_LABEL_SIZE 32 // Size of label in a .npy file, including zero padding
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+// Windows of a set of recordings
+typedef struct featureset_
+{
+    uint16_t windowSize;             // Samples per window
+    uint16_t hop;                    // Samples between the starts of windows
+    std::vector<std::string> labels; // Activity of every recording, the file name up to the first dot
+    std::vector<uint32_t> recording; // Recording of every window, index of labels
+    std::vector<uint32_t> start;     // First sample of every window in its recording
+    std::vector<uint16_t> steps;     // Steps in every window
+    std::vector<int64_t> candidates; // STATISTICALFEATURES_CANDIDATES features per window, window after window
+} featureset_t;
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+/**
+ * Calculates the candidate features of every window of recordings
+ * @param[in] paths Paths of recordings, see recording_read
+ * @param[in] windowSize Samples per window
+ * @param[in] hop Samples between the starts of windows
+ * @param[in] threads Number of threads to calculate with
+ * @param[out] set Windows of recordings
+ * @returns Status
+ * @retval 0: Features calculated
+ * @retval -1: A recording could not be read
+ * @retval -2: A feature of statisticalfeatures_getFeatures differs from its candidate
+ */
+int featureset_extract( const std::vector<const char*>& paths,
+                        uint16_t windowSize,
+                        uint16_t hop,
+                        uint32_t threads,
+                        featureset_t* set );
+
+/**************************************************************/
+/**
+ * Gets the number of windows of a set
+ * @param[in] set Windows of recordings
+ * @returns Number of windows
+ */
+static inline size_t featureset_windows( const featureset_t* set )
+{
+    return set->steps.size();
+}
+
+/**************************************************************/
+/**
+ * Gets a candidate feature of a window
+ * @param[in] set Windows of recordings
+ * @param[in] window Index of window
+ * @param[in] candidate Candidate feature
+ * @returns Value of feature
+ */
+static inline int64_t featureset_get( const featureset_t* set,
+                                      size_t window,
+                                      statisticalfeatures_candidate_t candidate )
+{
+    return set->candidates[window * STATISTICALFEATURES_CANDIDATES + candidate];
+}
+
+/**************************************************************/
+/**
+ * Writes a set to a NumPy .npy file, as a structured array with a field per
+ * column: recording, start, steps, activity, and every candidate feature by
+ * name. Load it with numpy.load, and pandas.DataFrame for a table
+ * @param[in] set Windows of recordings
+ * @param[in] path Path of file
+ * @returns Status
+ * @retval 0: File written
+ * @retval -1: File could not be written
+ */
+int featureset_writeNpy( const featureset_t* set, const char* path );
+
+#endif // FEATURESET_H
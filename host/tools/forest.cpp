@@ -0,0 +1,614 @@
+/**
+ * @file forest.cpp
+ * @author Simon Udsen
+ * @date 2026-10-18
+ */
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include "forest.h" // Header file for this module
+
+#include <ctype.h>  // isdigit, isalnum, toupper
+#include <stdio.h>  // fopen, fprintf
+#include <stdlib.h> // strtol
+#include <string.h> // memcpy, strpbrk
+
+#include <algorithm> // std::sort, std::partition, std::transform
+#include <map>       // Leaves of the node table
+#include <string>    // Float literals
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+#define MIN_GAIN 1e-9      // Smallest relative decrease of squared error worth a split
+#define MAX_TABLE_DEPTH 64 // Deepest split read from a node table, so a bad table can't loop
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+// Row of the bootstrap sample of a tree
+typedef struct sample_row_
+{
+    uint32_t row;    // Index of row
+    uint32_t weight; // Times the row was drawn
+} sample_row_t;
+
+// Tree being trained
+typedef struct tree_builder_
+{
+    const forest_bins_t* bins;     // Binned rows
+    const float* targets;          // Target of every row
+    const forest_params_t* params; // Hyperparameters
+    uint64_t random;               // State of random number generator
+    forest_tree_t* tree;           // Tree to add nodes to
+} tree_builder_t;
+
+/**************************************************************/
+/*                          Private                           */
+/**************************************************************/
+
+/**************************************************************/
+// Get the next random number, with splitmix64, which is the same everywhere
+static uint64_t nextRandom( uint64_t* state )
+{
+    uint64_t z = ( *state += 0x9E3779B97F4A7C15ULL );
+    z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+    z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBULL;
+    return z ^ ( z >> 31 );
+}
+
+/**************************************************************/
+// Add a leaf with the mean target of rows
+static void addLeaf( tree_builder_t* builder, double weight, double sum )
+{
+    forest_node_t node = {};
+    node.feature = FOREST_LEAF;
+    node.value = ( float )( sum / weight );
+    builder->tree->nodes.push_back( node );
+}
+
+/**************************************************************/
+// Add the nodes of rows, a split and its children, or a leaf
+static void buildNode( tree_builder_t* builder, sample_row_t* begin, sample_row_t* end, uint8_t depth )
+{
+    const forest_bins_t* bins = builder->bins;
+    double weight = 0;
+    double sum = 0;
+    for ( sample_row_t* row = begin; row < end; row++ )
+    {
+        weight += row->weight;
+        sum += row->weight * ( double )builder->targets[row->row];
+    }
+
+    if ( ( depth >= builder->params->maxDepth ) || ( weight < 2 ) )
+    {
+        addLeaf( builder, weight, sum );
+        return;
+    }
+
+    // Draw maxFeatures features without replacement
+    uint8_t features[FOREST_MAX_FEATURES];
+    for ( uint8_t i = 0; i < bins->featureCount; i++ )
+    {
+        features[i] = i;
+    }
+    uint8_t featureCount = std::min( builder->params->maxFeatures, bins->featureCount );
+    for ( uint8_t i = 0; i < featureCount; i++ )
+    {
+        uint8_t j = i + ( uint8_t )( nextRandom( &( builder->random ) ) % ( bins->featureCount - i ) );
+        std::swap( features[i], features[j] );
+    }
+
+    // Maximizing the sum of squared sums over weights of both sides minimizes
+    // their squared error
+    double parentScore = sum * sum / weight;
+    double bestScore = parentScore + MIN_GAIN * ( parentScore > 0 ? parentScore : 1 );
+    int16_t bestFeature = FOREST_LEAF;
+    uint32_t bestBin = 0;
+    for ( uint8_t i = 0; i < featureCount; i++ )
+    {
+        uint8_t feature = features[i];
+        const uint8_t* rowBins = bins->bins[feature].data();
+        size_t binCount = bins->edges[feature].size();
+
+        double binWeight[FOREST_MAX_BINS] = {};
+        double binSum[FOREST_MAX_BINS] = {};
+        for ( sample_row_t* row = begin; row < end; row++ )
+        {
+            uint8_t bin = rowBins[row->row];
+            binWeight[bin] += row->weight;
+            binSum[bin] += row->weight * ( double )builder->targets[row->row];
+        }
+
+        double leftWeight = 0;
+        double leftSum = 0;
+        for ( uint32_t bin = 0; bin + 1 < binCount; bin++ )
+        {
+            leftWeight += binWeight[bin];
+            leftSum += binSum[bin];
+            double rightWeight = weight - leftWeight;
+            if ( leftWeight == 0 )
+            {
+                continue;
+            }
+            if ( rightWeight == 0 )
+            {
+                break;
+            }
+            double rightSum = sum - leftSum;
+            double score = leftSum * leftSum / leftWeight + rightSum * rightSum / rightWeight;
+            if ( score > bestScore )
+            {
+                bestScore = score;
+                bestFeature = feature;
+                bestBin = bin;
+            }
+        }
+    }
+
+    if ( bestFeature == FOREST_LEAF )
+    {
+        addLeaf( builder, weight, sum );
+        return;
+    }
+
+    const uint8_t* rowBins = bins->bins[bestFeature].data();
+    sample_row_t* middle =
+        std::partition( begin, end, [&]( const sample_row_t& row ) { return rowBins[row.row] <= bestBin; } );
+
+    size_t index = builder->tree->nodes.size();
+    forest_node_t node = {};
+    node.feature = bestFeature;
+    node.threshold = bins->edges[bestFeature][bestBin + 1];
+    builder->tree->nodes.push_back( node );
+
+    buildNode( builder, begin, middle, depth + 1 );
+    builder->tree->nodes[index].right = ( uint32_t )builder->tree->nodes.size();
+    buildNode( builder, middle, end, depth + 1 );
+}
+
+/**************************************************************/
+// Format a float as a C literal that reads back as the same float
+static std::string floatLiteral( float value )
+{
+    char text[32];
+    snprintf( text, sizeof( text ), "%.9g", value );
+    std::string literal = text;
+    if ( strpbrk( text, ".e" ) == NULL )
+    {
+        literal += ".0";
+    }
+    return literal + "f";
+}
+
+/**************************************************************/
+// Write the comparisons of a node and its children as nested ifs
+static void writeInline( FILE* file, const forest_tree_t* tree, uint32_t index, int indent )
+{
+    const forest_node_t* node = &( tree->nodes[index] );
+    if ( node->feature == FOREST_LEAF )
+    {
+        fprintf( file, "%*sreturn %s;\n", indent, "", floatLiteral( node->value ).c_str() );
+        return;
+    }
+    fprintf( file, "%*sif (features[%d] < %d) {\n", indent, "", node->feature, node->threshold );
+    writeInline( file, tree, index + 1, indent + 4 );
+    fprintf( file, "%*s} else {\n", indent, "" );
+    writeInline( file, tree, node->right, indent + 4 );
+    fprintf( file, "%*s}\n", indent, "" );
+}
+
+/**************************************************************/
+// Read the integers of a C array initializer, after marker, skipping numbers
+// in names
+static bool readArray( const std::string& text, const char* marker, std::vector<int32_t>* values )
+{
+    size_t start = text.find( marker );
+    start = ( start != std::string::npos ) ? text.find( '{', start ) : start;
+    size_t end = ( start != std::string::npos ) ? text.find( "};", start ) : start;
+    if ( end == std::string::npos )
+    {
+        return false;
+    }
+
+    values->clear();
+    for ( size_t i = start + 1; i < end; i++ )
+    {
+        bool name = isalnum( ( unsigned char )text[i - 1] ) || ( text[i - 1] == '_' );
+        bool number = isdigit( ( unsigned char )text[i] ) ||
+                      ( ( text[i] == '-' ) && isdigit( ( unsigned char )text[i + 1] ) );
+        if ( name || !number )
+        {
+            continue;
+        }
+        char* next = NULL;
+        values->push_back( ( int32_t )strtol( &( text[i] ), &next, 10 ) );
+        i = ( size_t )( next - text.data() ) - 1;
+    }
+    return true;
+}
+
+/**************************************************************/
+// Add a child from a node table, a leaf if negative, or a split relative to
+// its parent and its children
+static bool appendTableChild( const std::vector<int32_t>& nodes,
+                              const std::vector<float>& leaves,
+                              int32_t parent,
+                              int32_t child,
+                              uint8_t depth,
+                              forest_tree_t* tree );
+
+/**************************************************************/
+// Add a split from a node table, and its children
+static bool appendTableNode( const std::vector<int32_t>& nodes,
+                             const std::vector<float>& leaves,
+                             int32_t index,
+                             uint8_t depth,
+                             forest_tree_t* tree )
+{
+    if ( ( index < 0 ) || ( ( size_t )index >= nodes.size() / 4 ) || ( depth > MAX_TABLE_DEPTH ) )
+    {
+        return false;
+    }
+
+    size_t split = tree->nodes.size();
+    forest_node_t node = {};
+    node.feature = ( int16_t )nodes[index * 4];
+    node.threshold = ( int16_t )nodes[index * 4 + 1];
+    tree->nodes.push_back( node );
+
+    if ( !appendTableChild( nodes, leaves, index, nodes[index * 4 + 2], depth, tree ) )
+    {
+        return false;
+    }
+    tree->nodes[split].right = ( uint32_t )tree->nodes.size();
+    return appendTableChild( nodes, leaves, index, nodes[index * 4 + 3], depth, tree );
+}
+
+/**************************************************************/
+static bool appendTableChild( const std::vector<int32_t>& nodes,
+                              const std::vector<float>& leaves,
+                              int32_t parent,
+                              int32_t child,
+                              uint8_t depth,
+                              forest_tree_t* tree )
+{
+    if ( child >= 0 )
+    {
+        return ( child > 0 ) && appendTableNode( nodes, leaves, parent + child, depth + 1, tree );
+    }
+    if ( ( size_t )( -child - 1 ) >= leaves.size() )
+    {
+        return false;
+    }
+    forest_node_t leaf = {};
+    leaf.feature = FOREST_LEAF;
+    leaf.value = leaves[-child - 1];
+    tree->nodes.push_back( leaf );
+    return true;
+}
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+void forest_bin( const int16_t* features, size_t rowCount, uint8_t featureCount, forest_bins_t* bins )
+{
+    bins->featureCount = featureCount;
+    bins->rowCount = rowCount;
+
+    std::vector<int16_t> values( rowCount );
+    for ( uint8_t feature = 0; feature < featureCount; feature++ )
+    {
+        for ( size_t row = 0; row < rowCount; row++ )
+        {
+            values[row] = features[row * featureCount + feature];
+        }
+        std::sort( values.begin(), values.end() );
+
+        size_t distinct = ( rowCount > 0 ) ? 1 : 0;
+        for ( size_t row = 1; row < rowCount; row++ )
+        {
+            distinct += ( values[row] != values[row - 1] ) ? 1 : 0;
+        }
+
+        // Start a new bin at the next distinct value once a bin has its share
+        // of the rows, which makes every distinct value a bin if there are few
+        std::vector<int16_t>& edges = bins->edges[feature];
+        edges.clear();
+        size_t share = ( distinct <= FOREST_MAX_BINS ) ? 0 : rowCount / FOREST_MAX_BINS;
+        size_t binRows = 0;
+        for ( size_t row = 0; row < rowCount; row++ )
+        {
+            if ( ( row == 0 ) || ( ( values[row] != values[row - 1] ) && ( binRows >= share ) &&
+                                   ( edges.size() < FOREST_MAX_BINS ) ) )
+            {
+                edges.push_back( values[row] );
+                binRows = 0;
+            }
+            binRows++;
+        }
+
+        bins->bins[feature].resize( rowCount );
+        for ( size_t row = 0; row < rowCount; row++ )
+        {
+            int16_t value = features[row * featureCount + feature];
+            size_t bin = ( size_t )( std::upper_bound( edges.begin(), edges.end(), value ) - edges.begin() );
+            bins->bins[feature][row] = ( uint8_t )( ( bin > 0 ) ? bin - 1 : 0 );
+        }
+    }
+}
+
+/**************************************************************/
+void forest_trainTree( const forest_bins_t* bins,
+                       const float* targets,
+                       const std::vector<uint32_t>& rows,
+                       const forest_params_t* params,
+                       uint16_t index,
+                       forest_tree_t* tree )
+{
+    tree_builder_t builder = { bins, targets, params, params->seed ^ ( ( uint64_t )( index + 1 ) << 32 ), tree };
+    tree->nodes.clear();
+
+    // Bootstrap sample, as many draws as rows
+    std::vector<uint32_t> weights( rows.size(), 0 );
+    for ( size_t draw = 0; draw < rows.size(); draw++ )
+    {
+        weights[nextRandom( &( builder.random ) ) % rows.size()]++;
+    }
+    std::vector<sample_row_t> sample;
+    for ( size_t i = 0; i < rows.size(); i++ )
+    {
+        if ( weights[i] > 0 )
+        {
+            sample.push_back( { rows[i], weights[i] } );
+        }
+    }
+
+    if ( sample.empty() )
+    {
+        addLeaf( &builder, 1, 0 );
+        return;
+    }
+    buildNode( &builder, sample.data(), sample.data() + sample.size(), 0 );
+}
+
+/**************************************************************/
+const forest_node_t* forest_leaf( const forest_tree_t* tree, const int16_t* features, uint8_t* depth )
+{
+    uint32_t index = 0;
+    uint8_t splits = 0;
+    while ( tree->nodes[index].feature != FOREST_LEAF )
+    {
+        const forest_node_t* node = &( tree->nodes[index] );
+        index = ( features[node->feature] < node->threshold ) ? index + 1 : node->right;
+        splits++;
+    }
+    if ( depth != NULL )
+    {
+        *depth = splits;
+    }
+    return &( tree->nodes[index] );
+}
+
+/**************************************************************/
+float forest_predict( const forest_t* forest, const int16_t* features )
+{
+    float sum = 0;
+    for ( const forest_tree_t& tree : forest->trees )
+    {
+        sum += forest_leaf( &tree, features, NULL )->value;
+    }
+    return sum / forest->trees.size();
+}
+
+/**************************************************************/
+int32_t forest_predictFirmware( const forest_t* forest, const int16_t* features )
+{
+    int32_t sum = 0;
+    for ( const forest_tree_t& tree : forest->trees )
+    {
+        sum += ( int32_t )forest_leaf( &tree, features, NULL )->value;
+    }
+    return sum / ( int32_t )forest->trees.size();
+}
+
+/**************************************************************/
+int forest_writeHeader( const forest_t* forest, const char* name, const char* path )
+{
+    // The node table holds the splits, with leaves as negative children, and
+    // every distinct leaf value once
+    std::vector<std::string> nodes;
+    std::vector<int32_t> roots;
+    std::vector<float> leaves;
+    std::map<uint32_t, int32_t> leafIndex;
+    for ( const forest_tree_t& tree : forest->trees )
+    {
+        std::vector<int32_t> table( tree.nodes.size() );
+        int32_t first = ( int32_t )nodes.size();
+        for ( size_t i = 0; i < tree.nodes.size(); i++ )
+        {
+            const forest_node_t* node = &( tree.nodes[i] );
+            if ( node->feature == FOREST_LEAF )
+            {
+                uint32_t bits;
+                memcpy( &bits, &( node->value ), sizeof( bits ) );
+                if ( leafIndex.count( bits ) == 0 )
+                {
+                    leafIndex[bits] = ( int32_t )leaves.size();
+                    leaves.push_back( node->value );
+                }
+                table[i] = -leafIndex[bits] - 1;
+            }
+            else
+            {
+                table[i] = ( int32_t )nodes.size();
+                nodes.push_back( "" );
+            }
+        }
+
+        // A tree of one leaf gets a split with the leaf on both sides
+        roots.push_back( first );
+        if ( tree.nodes[0].feature == FOREST_LEAF )
+        {
+            nodes.push_back( "  { 0, 0, " + std::to_string( table[0] ) + ", " + std::to_string( table[0] ) + " }" );
+            continue;
+        }
+
+        // Children that are splits are relative to their parent
+        for ( size_t i = 0; i < tree.nodes.size(); i++ )
+        {
+            const forest_node_t* node = &( tree.nodes[i] );
+            if ( node->feature == FOREST_LEAF )
+            {
+                continue;
+            }
+            int32_t left = ( tree.nodes[i + 1].feature == FOREST_LEAF ) ? table[i + 1] : table[i + 1] - table[i];
+            int32_t right =
+                ( tree.nodes[node->right].feature == FOREST_LEAF ) ? table[node->right] : table[node->right] - table[i];
+            nodes[table[i]] = "  { " + std::to_string( node->feature ) + ", " + std::to_string( node->threshold ) +
+                              ", " + std::to_string( left ) + ", " + std::to_string( right ) + " }";
+        }
+    }
+
+    FILE* file = fopen( path, "w" );
+    if ( file == NULL )
+    {
+        return -1;
+    }
+
+    fprintf( file, "// !!! This file is generated by host/tools/trainforest, in the format of emlearn !!!\n\n" );
+    fprintf( file, "#include <eml_trees.h>\n\n" );
+
+    // Number of trees, for the firmware to size its tables by
+    std::string upperName = name;
+    std::transform( upperName.begin(), upperName.end(), upperName.begin(), ::toupper );
+    fprintf( file, "#define %s_TREE_COUNT %zu\n\n", upperName.c_str(), forest->trees.size() );
+
+    fprintf( file, "static const EmlTreesNode %s_nodes[%zu] = {\n", name, nodes.size() );
+    for ( size_t i = 0; i < nodes.size(); i++ )
+    {
+        fprintf( file, "%s%s\n", nodes[i].c_str(), ( i + 1 < nodes.size() ) ? "," : "" );
+    }
+    fprintf( file, "};\n\n" );
+
+    fprintf( file, "static const int32_t %s_tree_roots[%zu] = { ", name, roots.size() );
+    for ( size_t i = 0; i < roots.size(); i++ )
+    {
+        fprintf( file, "%s%d", ( i > 0 ) ? ", " : "", roots[i] );
+    }
+    fprintf( file, " };\n\n" );
+
+    fprintf( file, "static const uint8_t %s_leaves[%zu] = { ", name, leaves.size() * sizeof( float ) );
+    for ( size_t i = 0; i < leaves.size(); i++ )
+    {
+        uint8_t bytes[sizeof( float )];
+        memcpy( bytes, &( leaves[i] ), sizeof( bytes ) );
+        for ( size_t b = 0; b < sizeof( bytes ); b++ )
+        {
+            fprintf( file, "%s%u", ( i + b > 0 ) ? ", " : "", bytes[b] );
+        }
+    }
+    fprintf( file, " };\n\n" );
+
+    fprintf( file, "EmlTrees %s = {\n", name );
+    fprintf( file, "        %zu,\n", nodes.size() );
+    fprintf( file, "        (EmlTreesNode *)(%s_nodes),\n", name );
+    fprintf( file, "        %zu,\n", roots.size() );
+    fprintf( file, "        (int32_t *)(%s_tree_roots),\n", name );
+    fprintf( file, "        %zu,\n", leaves.size() * sizeof( float ) );
+    fprintf( file, "        (uint8_t *)(%s_leaves),\n", name );
+    fprintf( file, "        32,\n" );
+    fprintf( file, "        %u,\n", forest->featureCount );
+    fprintf( file, "        0,\n" );
+    fprintf( file, "    };\n\n" );
+
+    for ( size_t i = 0; i < forest->trees.size(); i++ )
+    {
+        fprintf( file,
+                 "static inline int32_t %s_tree_%zu(const int16_t *features, int32_t features_length) {\n",
+                 name,
+                 i );
+        writeInline( file, &( forest->trees[i] ), 0, 4 );
+        fprintf( file, "}\n\n" );
+    }
+
+    fprintf( file,
+             "static int32_t (*const %s_trees[%s_TREE_COUNT])(const int16_t *, int32_t) = {\n",
+             name,
+             upperName.c_str() );
+    for ( size_t i = 0; i < forest->trees.size(); i++ )
+    {
+        fprintf( file, "    %s_tree_%zu,\n", name, i );
+    }
+    fprintf( file, "};\n\n" );
+
+    fprintf( file, "float %s_predict(const int16_t *features, int32_t features_length) {\n", name );
+    fprintf( file, "    float avg = 0;\n" );
+    for ( size_t i = 0; i < forest->trees.size(); i++ )
+    {
+        fprintf( file, "    avg += %s_tree_%zu(features, features_length);\n", name, i );
+    }
+    fprintf( file, "    return avg/%zu;\n", forest->trees.size() );
+    fprintf( file, "}\n" );
+
+    return ( fclose( file ) == 0 ) ? 0 : -1;
+}
+
+/**************************************************************/
+int forest_readHeader( forest_t* forest, const char* path )
+{
+    FILE* file = fopen( path, "r" );
+    if ( file == NULL )
+    {
+        return -1;
+    }
+    std::string text;
+    char buffer[4096];
+    size_t length;
+    while ( ( length = fread( buffer, 1, sizeof( buffer ), file ) ) > 0 )
+    {
+        text.append( buffer, length );
+    }
+    fclose( file );
+
+    std::vector<int32_t> nodes;
+    std::vector<int32_t> roots;
+    std::vector<int32_t> leafBytes;
+    std::vector<int32_t> info;
+    if ( !readArray( text, "_nodes[", &nodes ) || !readArray( text, "_tree_roots[", &roots ) ||
+         !readArray( text, "_leaves[", &leafBytes ) || !readArray( text, "EmlTrees ", &info ) ||
+         ( nodes.size() % 4 != 0 ) || ( leafBytes.size() % sizeof( float ) != 0 ) || roots.empty() )
+    {
+        return -2;
+    }
+
+    std::vector<float> leaves( leafBytes.size() / sizeof( float ) );
+    for ( size_t i = 0; i < leaves.size(); i++ )
+    {
+        uint8_t bytes[sizeof( float )];
+        for ( size_t b = 0; b < sizeof( float ); b++ )
+        {
+            bytes[b] = ( uint8_t )leafBytes[i * sizeof( float ) + b];
+        }
+        memcpy( &( leaves[i] ), bytes, sizeof( float ) );
+    }
+
+    // The struct holds the node, tree and leaf counts, the leaf bits, and then
+    // the number of features
+    forest->featureCount = ( info.size() >= 5 ) ? ( uint8_t )info[4] : 0;
+    forest->trees.clear();
+    for ( int32_t root : roots )
+    {
+        forest_tree_t tree;
+        if ( !appendTableNode( nodes, leaves, root, 0, &tree ) )
+        {
+            return -2;
+        }
+        forest->trees.push_back( tree );
+    }
+    return 0;
+}
@@ -0,0 +1,179 @@
+/**
+ * @file forest.h
+ * @author Simon Udsen
+ * @date 2026-10-18
+ * @brief Random forest regressor for int16_t features
+ * @details Trains regression trees like scikit-learn's RandomForestRegressor:
+ * every tree is grown on a bootstrap sample of the rows, a node considers
+ * maxFeatures random features, and splits minimize the squared error, down to
+ * maxDepth levels. Splits are found with histograms instead of sorting:
+ * forest_bin puts the values of every feature in at most FOREST_MAX_BINS bins,
+ * every distinct value its own bin if there are few enough, and a node sums
+ * the targets of its rows per bin, so finding the best split of a feature
+ * costs one pass over the rows and one over the bins. Thresholds are the
+ * smallest value of a bin, so every split is "feature < threshold" on an
+ * int16_t, like the firmware compares.
+ *
+ * Trees are independent, and seeded from their index, so they can be trained
+ * in parallel and the forest doesn't depend on the order.
+ *
+ * forest_writeHeader writes a forest in the format of emlearn, the format of
+ * step_counter_model.h: a node table, a function per tree with the
+ * comparisons inlined, and the number of trees and a table of their functions,
+ * which the firmware evaluates and profiles the trees with. Those functions return int32_t, so the firmware
+ * truncates every leaf to an integer, and averages the trees with an integer
+ * division, see forest_predictFirmware. forest_readHeader reads the node table
+ * back, so the deployed model can be evaluated too.
+ */
+#ifndef FOREST_H
+#define FOREST_H
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include <stddef.h> // size_t
+#include <stdint.h> // Standard integer types
+
+#include <vector> // Nodes, rows and bins
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+#define FOREST_MAX_BINS 256    // Bins per feature, so a bin fits a uint8_t
+#define FOREST_MAX_FEATURES 32 // Features of a forest, like STATISTICALFEATURES_CANDIDATES
+#define FOREST_LEAF -1         // Feature of a leaf node
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+// Node of a tree. Nodes are stored depth first, so the left child of a split
+// follows it
+typedef struct forest_node_
+{
+    int16_t feature;   // Feature compared, FOREST_LEAF for a leaf
+    int16_t threshold; // Rows with feature < threshold go left
+    uint32_t right;    // Index of right child in the tree
+    float value;       // Prediction of a leaf, mean target of its rows
+} forest_node_t;
+
+// Tree of a forest
+typedef struct forest_tree_
+{
+    std::vector<forest_node_t> nodes; // Nodes depth first, root first
+} forest_tree_t;
+
+// Trained forest
+typedef struct forest_
+{
+    uint8_t featureCount;             // Features per row
+    std::vector<forest_tree_t> trees; // Trees, averaged
+} forest_t;
+
+// Hyperparameters of a forest
+typedef struct forest_params_
+{
+    uint16_t trees;      // Number of trees
+    uint8_t maxDepth;    // Deepest split, the root is at depth 0
+    uint8_t maxFeatures; // Features considered per split
+    uint64_t seed;       // Seed of bootstrap samples and feature choices
+} forest_params_t;
+
+// Rows of features, binned for training
+typedef struct forest_bins_
+{
+    uint8_t featureCount;                            // Features per row
+    size_t rowCount;                                 // Number of rows
+    std::vector<uint8_t> bins[FOREST_MAX_FEATURES];  // Bin of every row, per feature
+    std::vector<int16_t> edges[FOREST_MAX_FEATURES]; // Smallest value of every bin, per feature
+} forest_bins_t;
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+/**
+ * Bins the features of rows. Bin edges are chosen from the rows, so every bin
+ * holds about as many rows, and bins never split a value
+ * @param[in] features Features of every row, row after row
+ * @param[in] rowCount Number of rows
+ * @param[in] featureCount Features per row, at most FOREST_MAX_FEATURES
+ * @param[out] bins Binned rows
+ */
+void forest_bin( const int16_t* features, size_t rowCount, uint8_t featureCount, forest_bins_t* bins );
+
+/**************************************************************/
+/**
+ * Trains one tree of a forest. Trees with the same index and parameters are
+ * the same
+ * @param[in] bins Binned rows
+ * @param[in] targets Target of every row
+ * @param[in] rows Indices of the rows to train on
+ * @param[in] params Hyperparameters of the forest
+ * @param[in] index Index of the tree in the forest
+ * @param[out] tree Trained tree
+ */
+void forest_trainTree( const forest_bins_t* bins,
+                       const float* targets,
+                       const std::vector<uint32_t>& rows,
+                       const forest_params_t* params,
+                       uint16_t index,
+                       forest_tree_t* tree );
+
+/**************************************************************/
+/**
+ * Finds the leaf of a tree a row ends in
+ * @param[in] tree Tree
+ * @param[in] features Features of row
+ * @param[out] depth Number of splits on the way to the leaf, or NULL
+ * @returns Leaf node
+ */
+const forest_node_t* forest_leaf( const forest_tree_t* tree, const int16_t* features, uint8_t* depth );
+
+/**************************************************************/
+/**
+ * Predicts a row, as the mean of the leaves of the trees
+ * @param[in] forest Forest
+ * @param[in] features Features of row
+ * @returns Prediction
+ */
+float forest_predict( const forest_t* forest, const int16_t* features );
+
+/**************************************************************/
+/**
+ * Predicts a row like the firmware, as the integer mean of the leaves of the
+ * trees truncated to integers
+ * @param[in] forest Forest
+ * @param[in] features Features of row
+ * @returns Prediction
+ */
+int32_t forest_predictFirmware( const forest_t* forest, const int16_t* features );
+
+/**************************************************************/
+/**
+ * Writes a forest as a C header in the format of emlearn, with name_nodes,
+ * name_tree_N and name_predict, and NAME_TREE_COUNT and the table name_trees
+ * @param[in] forest Forest
+ * @param[in] name Name of model
+ * @param[in] path Path of file
+ * @returns Status
+ * @retval 0: File written
+ * @retval -1: File could not be written
+ */
+int forest_writeHeader( const forest_t* forest, const char* name, const char* path );
+
+/**************************************************************/
+/**
+ * Reads a forest from the node table of a C header in the format of emlearn,
+ * like step_counter_model.h
+ * @param[out] forest Forest
+ * @param[in] path Path of file
+ * @returns Status
+ * @retval 0: Forest read
+ * @retval -1: File could not be read
+ * @retval -2: File has no valid node table
+ */
+int forest_readHeader( forest_t* forest, const char* path );
+
+#endif // FOREST_H
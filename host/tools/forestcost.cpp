@@ -0,0 +1,241 @@
+/**
+ * @file forestcost.cpp
+ * @author Simon Udsen
+ * @date 2026-10-18
+ */
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include "forestcost.h" // Header file for this module
+
+#include <stdio.h>  // fopen, fgets
+#include <stdlib.h> // strtoul
+#include <string.h> // memcpy, strstr
+
+#include <algorithm> // std::max
+#include <set>       // Distinct leaves
+#include <vector>    // Profiled trees
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+#define SHORT_BRANCH_BYTES 254       // Farthest forward branch of a 16 bit conditional branch
+#define PROFILE_REGION "model_tree_" // Profiler region of a tree, followed by its index
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+/**************************************************************/
+/*                          Private                           */
+/**************************************************************/
+
+/**************************************************************/
+// Check if a value fits the modified immediate of a 32 bit Thumb-2 instruction
+static bool isModifiedImmediate( uint32_t value )
+{
+    uint32_t low = value & 0xFF;
+    uint32_t high = ( value >> 8 ) & 0xFF;
+    if ( ( value <= 0xFF ) || ( value == ( low | ( low << 16 ) ) ) || ( value == ( ( high << 8 ) | ( high << 24 ) ) ) ||
+         ( value == low * 0x01010101UL ) )
+    {
+        return true;
+    }
+
+    // Or an 8 bit value with the top bit set, rotated
+    for ( uint8_t rotation = 8; rotation < 32; rotation++ )
+    {
+        uint32_t rotated = ( value << rotation ) | ( value >> ( 32 - rotation ) );
+        if ( ( rotated >= 0x80 ) && ( rotated <= 0xFF ) )
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**************************************************************/
+// Get the bytes to compare with a threshold, with cmp, cmn, or movw and cmp
+static size_t compareBytes( int16_t threshold )
+{
+    if ( ( threshold >= 0 ) && ( threshold <= 0xFF ) )
+    {
+        return 2;
+    }
+    if ( isModifiedImmediate( ( uint32_t )( int32_t )threshold ) ||
+         isModifiedImmediate( ( uint32_t )( -( int32_t )threshold ) ) )
+    {
+        return 4;
+    }
+    return 6;
+}
+
+/**************************************************************/
+// Get the bytes of the inline code of a node and its children
+static size_t inlineBytes( const forest_tree_t* tree, uint32_t index )
+{
+    const forest_node_t* node = &( tree->nodes[index] );
+    if ( node->feature == FOREST_LEAF )
+    {
+        // The leaf is truncated to an integer, moved to r0, and returned
+        int32_t value = ( int32_t )node->value;
+        return ( ( ( value >= 0 ) && ( value <= 0xFF ) ) ? 2 : 4 ) + 2;
+    }
+
+    // Load the feature, compare, and branch over the left code to the right
+    size_t left = inlineBytes( tree, index + 1 );
+    size_t right = inlineBytes( tree, node->right );
+    return 4 + compareBytes( node->threshold ) + ( ( left <= SHORT_BRANCH_BYTES ) ? 2 : 4 ) + left + right;
+}
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+void forestcost_defaultModel( forestcost_model_t* model )
+{
+    model->inlineCallCycles = FORESTCOST_INLINE_CALL_CYCLES;
+    model->inlineSplitCycles = FORESTCOST_INLINE_SPLIT_CYCLES;
+    model->tableCallCycles = FORESTCOST_TABLE_CALL_CYCLES;
+    model->tableNodeCycles = FORESTCOST_TABLE_NODE_CYCLES;
+}
+
+/**************************************************************/
+void forestcost_measure( const forest_t* forest,
+                         const int16_t* rows,
+                         size_t rowCount,
+                         const forestcost_model_t* model,
+                         forestcost_t* cost )
+{
+    *cost = forestcost_t();
+
+    std::set<uint32_t> leaves;
+    size_t tableNodes = 0;
+    for ( const forest_tree_t& tree : forest->trees )
+    {
+        for ( const forest_node_t& node : tree.nodes )
+        {
+            if ( node.feature == FOREST_LEAF )
+            {
+                uint32_t bits;
+                memcpy( &bits, &( node.value ), sizeof( bits ) );
+                leaves.insert( bits );
+                cost->leaves++;
+            }
+            else
+            {
+                cost->splits++;
+            }
+        }
+        // A tree of one leaf still gets a node in the table
+        tableNodes += std::max( tree.nodes.size() / 2, ( size_t )1 );
+        cost->inlineFlash += inlineBytes( &tree, 0 ) + FORESTCOST_PREDICT_TREE_BYTES;
+    }
+    cost->distinctLeaves = leaves.size();
+    cost->inlineFlash += FORESTCOST_PREDICT_CODE_BYTES;
+    cost->tableFlash = tableNodes * FORESTCOST_TABLE_NODE_BYTES + cost->distinctLeaves * sizeof( float ) +
+                       forest->trees.size() * sizeof( int32_t ) + FORESTCOST_TABLE_CODE_BYTES +
+                       FORESTCOST_TABLE_STRUCT_BYTES;
+    cost->tableRam = FORESTCOST_TABLE_STRUCT_BYTES;
+
+    uint64_t totalDepth = 0;
+    size_t trees = forest->trees.size();
+    for ( size_t row = 0; row < rowCount; row++ )
+    {
+        uint32_t windowDepth = 0;
+        for ( const forest_tree_t& tree : forest->trees )
+        {
+            uint8_t depth = 0;
+            forest_leaf( &tree, &( rows[row * forest->featureCount] ), &depth );
+            windowDepth += depth;
+            cost->worstDepth = std::max( cost->worstDepth, depth );
+        }
+        totalDepth += windowDepth;
+
+        double inlineCycles = trees * model->inlineCallCycles + windowDepth * model->inlineSplitCycles;
+        double tableCycles = trees * model->tableCallCycles + windowDepth * model->tableNodeCycles;
+        cost->inlineWorstCycles = std::max( cost->inlineWorstCycles, inlineCycles );
+        cost->tableWorstCycles = std::max( cost->tableWorstCycles, tableCycles );
+    }
+
+    double windowDepth = ( rowCount > 0 ) ? ( double )totalDepth / rowCount : 0;
+    cost->averageDepth = ( trees > 0 ) ? windowDepth / trees : 0;
+    cost->inlineCycles = trees * model->inlineCallCycles + windowDepth * model->inlineSplitCycles;
+    cost->tableCycles = trees * model->tableCallCycles + windowDepth * model->tableNodeCycles;
+}
+
+/**************************************************************/
+int forestcost_calibrate( const char* path,
+                          const forest_t* deployed,
+                          const int16_t* rows,
+                          size_t rowCount,
+                          forestcost_model_t* model )
+{
+    FILE* file = fopen( path, "r" );
+    if ( file == NULL )
+    {
+        return -1;
+    }
+
+    // Average cycles of every tree, the last statistics in the log
+    std::vector<double> cycles( deployed->trees.size(), -1 );
+    char line[512];
+    while ( fgets( line, sizeof( line ), file ) != NULL )
+    {
+        const char* region = strstr( line, PROFILE_REGION );
+        const char* average = ( region != NULL ) ? strstr( region, "avg=" ) : NULL;
+        if ( average == NULL )
+        {
+            continue;
+        }
+        unsigned long tree = strtoul( region + strlen( PROFILE_REGION ), NULL, 10 );
+        if ( tree < cycles.size() )
+        {
+            cycles[tree] = strtoul( average + strlen( "avg=" ), NULL, 10 );
+        }
+    }
+    fclose( file );
+
+    // Fit cycles = call + split * depth over the profiled trees
+    double n = 0;
+    double sumDepth = 0;
+    double sumCycles = 0;
+    double sumDepthDepth = 0;
+    double sumDepthCycles = 0;
+    for ( size_t tree = 0; tree < cycles.size(); tree++ )
+    {
+        if ( cycles[tree] < 0 )
+        {
+            continue;
+        }
+        double depth = 0;
+        for ( size_t row = 0; row < rowCount; row++ )
+        {
+            uint8_t splits = 0;
+            forest_leaf( &( deployed->trees[tree] ), &( rows[row * deployed->featureCount] ), &splits );
+            depth += splits;
+        }
+        depth = ( rowCount > 0 ) ? depth / rowCount : 0;
+
+        n++;
+        sumDepth += depth;
+        sumCycles += cycles[tree];
+        sumDepthDepth += depth * depth;
+        sumDepthCycles += depth * cycles[tree];
+    }
+    if ( n < 2 )
+    {
+        return -2;
+    }
+
+    // Trees of the same depth only tell the total, so keep the split cost then
+    double variance = sumDepthDepth - sumDepth * sumDepth / n;
+    if ( variance > 1e-9 )
+    {
+        model->inlineSplitCycles = std::max( ( sumDepthCycles - sumDepth * sumCycles / n ) / variance, 0.0 );
+    }
+    model->inlineCallCycles = std::max( ( sumCycles - model->inlineSplitCycles * sumDepth ) / n, 0.0 );
+    return 0;
+}
@@ -0,0 +1,127 @@
+/**
+ * @file forestcost.h
+ * @author Simon Udsen
+ * @date 2026-10-18
+ * @brief Device cost of a random forest
+ * @details Estimates what a forest costs on the Cortex-M33 of the P2, for both
+ * ways emlearn can run it:
+ * - Inline: a function per tree of nested ifs, what stepcounter.cpp calls.
+ *   Every split is a load of the feature, a compare with the threshold and a
+ *   conditional branch, and every leaf a move of the integer result and a
+ *   return. Flash is counted per instruction with Thumb-2 encodings, which
+ *   depend on the threshold, the leaf value and the branch distance
+ * - Table: the node table walked by eml_trees_predict, 8 bytes per split, 4
+ *   per distinct leaf and per tree, plus the walking code, and the EmlTrees
+ *   struct, which is the only part in RAM
+ *
+ * Cycles are an affine function of the splits passed on the way to a leaf,
+ * per tree, so they depend on the windows. forestcost_measure walks every
+ * window of the corpus, and gives the average and worst case per window.
+ *
+ * The default cycle costs are estimates from the M33 instruction timings. The
+ * inline costs can be calibrated with forestcost_calibrate, from the profiler
+ * statistics of the model_tree_N regions on a device, see profiler.h, and the
+ * depths the deployed model reaches on the corpus.
+ */
+#ifndef FORESTCOST_H
+#define FORESTCOST_H
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include <stddef.h> // size_t
+#include <stdint.h> // Standard integer types
+
+#include "forest.h" // Random forest
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+#define FORESTCOST_INLINE_CALL_CYCLES 12 // Call, leaf, and return of an inline tree function
+#define FORESTCOST_INLINE_SPLIT_CYCLES 5 // Load, compare, and branch of an inline split
+#define FORESTCOST_TABLE_CALL_CYCLES 40  // Setup of a table walk, and conversion of the float leaf
+#define FORESTCOST_TABLE_NODE_CYCLES 12  // Loads of node and feature, compare, branch and next index
+#define FORESTCOST_TABLE_NODE_BYTES 8    // Size of an EmlTreesNode
+#define FORESTCOST_TABLE_CODE_BYTES 200  // Size of eml_trees_predict and the tree walk
+#define FORESTCOST_TABLE_STRUCT_BYTES 28 // Size of the EmlTrees struct
+#define FORESTCOST_PREDICT_TREE_BYTES 6  // Call and sum of a tree in the predict function
+#define FORESTCOST_PREDICT_CODE_BYTES 24 // Rest of the predict function
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+// Cycle costs of the parts of a prediction
+typedef struct forestcost_model_
+{
+    double inlineCallCycles;  // Per tree of an inline prediction
+    double inlineSplitCycles; // Per split passed in an inline prediction
+    double tableCallCycles;   // Per tree of a table prediction
+    double tableNodeCycles;   // Per split passed in a table prediction
+} forestcost_model_t;
+
+// Cost of a forest
+typedef struct forestcost_
+{
+    size_t splits;            // Split nodes
+    size_t leaves;            // Leaf nodes
+    size_t distinctLeaves;    // Distinct leaf values, stored once in the table
+    size_t inlineFlash;       // Bytes of flash of the inline functions
+    size_t tableFlash;        // Bytes of flash of the node table and its code
+    size_t tableRam;          // Bytes of RAM, the EmlTrees struct
+    double averageDepth;      // Average splits passed per tree and window
+    uint8_t worstDepth;       // Most splits passed in a tree in any window
+    double inlineCycles;      // Average cycles per window, inline
+    double inlineWorstCycles; // Most cycles of any window, inline
+    double tableCycles;       // Average cycles per window, table
+    double tableWorstCycles;  // Most cycles of any window, table
+} forestcost_t;
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+/**
+ * Gets the default cycle costs, estimated from instruction timings
+ * @param[out] model Cycle costs
+ */
+void forestcost_defaultModel( forestcost_model_t* model );
+
+/**************************************************************/
+/**
+ * Estimates the cost of a forest, with its depths on rows
+ * @param[in] forest Forest
+ * @param[in] rows Features of every row, row after row, forest->featureCount per row
+ * @param[in] rowCount Number of rows
+ * @param[in] model Cycle costs
+ * @param[out] cost Cost of forest
+ */
+void forestcost_measure( const forest_t* forest,
+                         const int16_t* rows,
+                         size_t rowCount,
+                         const forestcost_model_t* model,
+                         forestcost_t* cost );
+
+/**************************************************************/
+/**
+ * Fits the inline cycle costs to profiler statistics of a device, with lines
+ * like "Profiler: model_tree_0 n=120 avg=95 min=40 max=160", by least squares
+ * of the average cycles of every tree over its average depth on rows
+ * @param[in] path Path of a log with profiler statistics
+ * @param[in] deployed Forest the device ran, see forest_readHeader
+ * @param[in] rows Features of every row, row after row
+ * @param[in] rowCount Number of rows
+ * @param[in,out] model Cycle costs, with the inline costs fitted
+ * @returns Status
+ * @retval 0: Costs fitted
+ * @retval -1: Log could not be read
+ * @retval -2: Log has statistics of fewer than two trees of the forest
+ */
+int forestcost_calibrate( const char* path,
+                          const forest_t* deployed,
+                          const int16_t* rows,
+                          size_t rowCount,
+                          forestcost_model_t* model );
+
+#endif // FORESTCOST_H
@@ -0,0 +1,1178 @@
+/**
+ * @file ingestd.cpp
+ * @author Simon Udsen
+ * @date 2026-10-18
+ * @brief Ingest daemon for many devices sending to one TCP port
+ * @details A native alternative to the TCP server in ../tcp_server, for when
+ * thousands of devices send at the same time. Every connection is served by a
+ * single epoll loop, and the files written are the same as the TCP server
+ * writes: CSV text goes to a new file per connection, and frames go to the
+ * files of the recording session of their device, which outlives the
+ * connection. Frames are acknowledged, and frames sent again after a reconnect
+ * are only written once.
+ *
+ * Received data is parsed where it was read to. Frames are checked and decoded
+ * in the receive buffer of the connection, and only the incomplete frame at the
+ * end is moved to the front. Decoded samples are formatted into an output
+ * buffer per file, that is written when it is full, or INGEST_FLUSH_LATENCY_MS
+ * after it was first written to, so the number of writes does not grow with the
+ * number of frames. CSV text that does not fit in the output buffer is written
+ * together with it in one writev, without being copied.
+ *
+ * New files are numbered after the highest number in the output directory at
+ * startup, and created exclusively, so no file is probed more than once.
+ *
+ * Run it in place of the TCP server, and load it with loadgen:
+ *
+ *     ingestd --port 7123 --out ../tcp_server/out --label ingest
+ *
+ * SIGINT or SIGTERM writes every output buffer, closes the files and prints
+ * the totals.
+ */
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include <arpa/inet.h>    // inet_ntop
+#include <dirent.h>       // opendir, readdir
+#include <errno.h>        // errno
+#include <fcntl.h>        // open
+#include <netinet/in.h>   // sockaddr_in6
+#include <netinet/tcp.h>  // TCP_NODELAY
+#include <signal.h>       // sigaction
+#include <stdint.h>       // Standard integer types
+#include <stdio.h>        // printf, snprintf
+#include <stdlib.h>       // strtoul, malloc
+#include <string.h>       // memcpy, memmem
+#include <sys/epoll.h>    // epoll
+#include <sys/resource.h> // setrlimit
+#include <sys/socket.h>   // socket, accept4
+#include <sys/stat.h>     // mkdir
+#include <sys/uio.h>      // writev
+#include <time.h>         // clock_gettime
+#include <unistd.h>       // read, close
+
+#include <string>        // Paths and device IDs
+#include <unordered_map> // Sessions by device ID
+#include <vector>        // Outputs waiting to be written
+
+#include "frame.h"       // Binary frames of samples
+#include "samplecodec.h" // Sample codec
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+#define INGEST_DEFAULT_PORT 7123                                   // Same as the TCP server
+#define INGEST_MAX_EVENTS 256                                      // Events handled per epoll_wait
+#define INGEST_TICK_MS 100                                         // Longest wait for events
+#define INGEST_RECEIVE_SIZE 4096                                   // Initial receive buffer of a connection
+#define INGEST_MAX_FRAME ( FRAME_HEADER_SIZE + FRAME_MAX_PAYLOAD ) // Largest frame a receive buffer grows to
+#define INGEST_OUTPUT_SIZE 16384                                   // Output buffer of a file
+#define INGEST_MAX_LINE 96                                         // Longest CSV line formatted
+#define INGEST_FLUSH_LATENCY_MS 1000                               // Longest time text waits in an output buffer
+#define INGEST_SESSION_WINDOW 0x100000                             // Frames a session accepts around the expected one
+#define INGEST_SESSION_TIMEOUT_MS ( 60 * 1000 )                    // Time a session waits for its device to reconnect
+#define INGEST_STATS_MS ( 10 * 1000 )                              // Time between statistics
+#define INGEST_MAX_FILE_NUMBER 99999                               // Highest file number, as five digits
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+// Streams a device can send, with a file each
+typedef enum ingest_stream_
+{
+    INGEST_STREAM_SAMPLES,
+    INGEST_STREAM_RESULTS,
+    INGEST_STREAM_COUNT,
+} ingest_stream_t;
+
+// What a connection sends, decided by its first bytes
+typedef enum ingest_mode_
+{
+    INGEST_MODE_UNKNOWN,
+    INGEST_MODE_CSV,
+    INGEST_MODE_FRAMES,
+} ingest_mode_t;
+
+// File being written, with text waiting to be written to it
+typedef struct ingest_output_
+{
+    int fd;                          // File descriptor
+    std::string path;                // Path of file
+    char buffer[INGEST_OUTPUT_SIZE]; // Text not written yet
+    size_t length;                   // Bytes in buffer
+    uint64_t pendingSinceMs;         // Time buffer was first written to since it was written
+    bool queued;                     // In list of outputs waiting to be written
+} ingest_output_t;
+
+// Recording session of a device sending frames
+typedef struct ingest_session_
+{
+    uint8_t rawId[FRAME_DEVICE_ID_SIZE];           // Device ID as sent
+    std::string deviceId;                          // Device ID in hexadecimal
+    bool listed;                                   // In session table, not replaced by a newer session
+    ingest_output_t* outputs[INGEST_STREAM_COUNT]; // Files of streams, opened on first use
+    uint32_t nextSequence;                         // Sequence number of next frame expected
+    uint64_t frames;                               // Frames written
+    uint64_t lostFrames;                           // Frames skipped by the device
+    uint64_t duplicateFrames;                      // Frames received again
+    uint32_t connections;                          // Connections of the session
+    uint32_t activeConnections;                    // Connections open now
+    uint64_t idleSinceMs;                          // Time the last connection closed
+} ingest_session_t;
+
+// Connection of a device
+typedef struct ingest_connection_
+{
+    int fd;                      // Socket
+    char peer[INET6_ADDRSTRLEN]; // Address of device
+    ingest_mode_t mode;          // What the device sends
+    uint8_t* receive;            // Receive buffer
+    size_t receiveSize;          // Size of receive buffer
+    size_t receiveLength;        // Bytes in receive buffer
+    ingest_output_t* csvOutput;  // File of CSV text
+    ingest_session_t* session;   // Session of the last frame
+    uint8_t ack[FRAME_ACK_SIZE]; // Acknowledgement being sent
+    size_t ackOffset;            // Bytes of acknowledgement sent, FRAME_ACK_SIZE when done
+    uint32_t ackSequence;        // Sequence number of next acknowledgement
+    bool ackDue;                 // An acknowledgement must be sent after the current one
+    bool wantWrite;              // Waiting for the socket to be writable
+    uint64_t frames;             // Frames received
+    uint64_t crcErrors;          // Invalid frames skipped
+    uint64_t decodeErrors;       // Frames with a payload that did not decode
+} ingest_connection_t;
+
+// Totals of the daemon
+typedef struct ingest_totals_
+{
+    uint64_t connections;  // Connections accepted
+    uint64_t bytesRead;    // Bytes received
+    uint64_t reads;        // Calls to read
+    uint64_t frames;       // Frames written
+    uint64_t records;      // Samples and window results written
+    uint64_t csvBytes;     // CSV text received
+    uint64_t bytesWritten; // Bytes written to files
+    uint64_t writes;       // Calls to write and writev
+} ingest_totals_t;
+
+/**************************************************************/
+/*                          Private                           */
+/**************************************************************/
+
+// Suffix of the files of every stream, and their CSV header
+static const char* const streamSuffix[INGEST_STREAM_COUNT] = { "", ".results" };
+static const char* const streamHeader[INGEST_STREAM_COUNT] = {
+    "timestamp,accX,accY,accZ,step\n",
+    "timestamp,stdZ,madZ,minY,rangeX,rangeY,rangeZ,steps,dropped\n",
+};
+
+static std::string outputDir = "../tcp_server/out"; // Directory to write files to
+static const char* label = NULL;                    // Prefix of file names, or NULL
+static uint32_t nextFileNumber = 1;                 // Number of next file
+
+static std::unordered_map<std::string, ingest_session_t*> sessions; // Sessions by raw device ID
+static std::vector<ingest_output_t*> pendingOutputs;                // Outputs with text waiting
+static uint32_t openConnections = 0;                                // Connections open now
+static ingest_totals_t totals = {};                                 // Totals since start
+static volatile sig_atomic_t stopRequested = 0;                     // Set by SIGINT and SIGTERM
+
+// Samples of a delta frame, decoded before they are formatted
+static acceleration_sample_t decoded[UINT16_MAX];
+
+/**************************************************************/
+// Milliseconds of a monotonic clock
+static uint64_t nowMs()
+{
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return ( uint64_t )now.tv_sec * 1000 + ( uint64_t )now.tv_nsec / 1000000;
+}
+
+/**************************************************************/
+// Stop the loop on a signal
+static void stopHandler( int signal )
+{
+    ( void )signal;
+    stopRequested = 1;
+}
+
+/**************************************************************/
+// Format an unsigned value as decimal text, returning the end of the text
+static char* putUnsigned( char* text, uint32_t value )
+{
+    char digits[10];
+    int count = 0;
+    do
+    {
+        digits[count++] = ( char )( '0' + value % 10 );
+        value /= 10;
+    } while ( value != 0 );
+
+    while ( count > 0 )
+    {
+        *text++ = digits[--count];
+    }
+    return text;
+}
+
+/**************************************************************/
+// Format a signed value as decimal text, returning the end of the text
+static char* putSigned( char* text, int32_t value )
+{
+    if ( value < 0 )
+    {
+        *text++ = '-';
+        return putUnsigned( text, ( uint32_t )( -( int64_t )value ) );
+    }
+    return putUnsigned( text, ( uint32_t )value );
+}
+
+/**************************************************************/
+// Write every byte of a set of buffers to a file, in as few calls as possible
+static bool writeAll( int fd, struct iovec* iov, int count )
+{
+    while ( count > 0 )
+    {
+        ssize_t written = writev( fd, iov, count );
+        totals.writes++;
+        if ( written < 0 )
+        {
+            if ( errno == EINTR )
+            {
+                continue;
+            }
+            return false;
+        }
+        totals.bytesWritten += ( uint64_t )written;
+
+        // Skip the buffers that were written completely
+        while ( ( count > 0 ) && ( ( size_t )written >= iov->iov_len ) )
+        {
+            written -= ( ssize_t )iov->iov_len;
+            iov++;
+            count--;
+        }
+        if ( count > 0 )
+        {
+            iov->iov_base = ( char* )iov->iov_base + written;
+            iov->iov_len -= ( size_t )written;
+        }
+    }
+    return true;
+}
+
+/**************************************************************/
+// Find the highest file number in the output directory, so new files are
+// numbered after it
+static void scanFileNumbers()
+{
+    DIR* dir = opendir( outputDir.c_str() );
+    if ( dir == NULL )
+    {
+        return;
+    }
+
+    size_t labelLength = ( label != NULL ) ? strlen( label ) + 1 : 0;
+    struct dirent* entry;
+    while ( ( entry = readdir( dir ) ) != NULL )
+    {
+        const char* name = entry->d_name;
+        if ( label != NULL )
+        {
+            if ( ( strncmp( name, label, labelLength - 1 ) != 0 ) || ( name[labelLength - 1] != '.' ) )
+            {
+                continue;
+            }
+            name += labelLength;
+        }
+
+        char* end = NULL;
+        unsigned long number = strtoul( name, &end, 10 );
+        if ( ( end == name + 5 ) && ( number >= nextFileNumber ) && ( number < INGEST_MAX_FILE_NUMBER ) )
+        {
+            nextFileNumber = ( uint32_t )number + 1;
+        }
+    }
+    closedir( dir );
+}
+
+/**************************************************************/
+// Create the next numbered file of a stream, with its CSV header
+static ingest_output_t* openOutput( ingest_stream_t stream )
+{
+    while ( nextFileNumber < INGEST_MAX_FILE_NUMBER )
+    {
+        char name[256];
+        snprintf( name,
+                  sizeof( name ),
+                  "%s%s%05lu%s.csv",
+                  ( label != NULL ) ? label : "",
+                  ( label != NULL ) ? "." : "",
+                  ( unsigned long )nextFileNumber++,
+                  streamSuffix[stream] );
+
+        std::string path = outputDir + "/" + name;
+        int fd = open( path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644 );
+        if ( fd < 0 )
+        {
+            if ( errno == EEXIST )
+            {
+                continue;
+            }
+            printf( "Failed to create %s: %s\n", path.c_str(), strerror( errno ) );
+            return NULL;
+        }
+
+        ingest_output_t* output = new ingest_output_t;
+        output->fd = fd;
+        output->path = path;
+        output->length = strlen( streamHeader[stream] );
+        memcpy( output->buffer, streamHeader[stream], output->length );
+        output->pendingSinceMs = nowMs();
+        output->queued = true;
+        pendingOutputs.push_back( output );
+        return output;
+    }
+
+    printf( "Exceeded maximum file numbering range\n" );
+    return NULL;
+}
+
+/**************************************************************/
+// Write the text waiting in an output buffer
+static void flushOutput( ingest_output_t* output )
+{
+    if ( output->length == 0 )
+    {
+        return;
+    }
+
+    struct iovec iov = { output->buffer, output->length };
+    if ( !writeAll( output->fd, &iov, 1 ) )
+    {
+        printf( "Failed to write %s: %s\n", output->path.c_str(), strerror( errno ) );
+    }
+    output->length = 0;
+}
+
+/**************************************************************/
+// Remember that an output buffer has text waiting
+static void markPending( ingest_output_t* output )
+{
+    if ( !output->queued )
+    {
+        output->queued = true;
+        output->pendingSinceMs = nowMs();
+        pendingOutputs.push_back( output );
+    }
+}
+
+/**************************************************************/
+// Make room for a line in an output buffer, and return where to format it
+static char* reserveLine( ingest_output_t* output )
+{
+    if ( output->length + INGEST_MAX_LINE > INGEST_OUTPUT_SIZE )
+    {
+        flushOutput( output );
+    }
+    markPending( output );
+    return &( output->buffer[output->length] );
+}
+
+/**************************************************************/
+// Append received text to an output. Text that does not fit is written with
+// the buffer in one call, instead of being copied
+static void appendOutput( ingest_output_t* output, const uint8_t* data, size_t length )
+{
+    if ( output->length + length <= INGEST_OUTPUT_SIZE )
+    {
+        memcpy( &( output->buffer[output->length] ), data, length );
+        output->length += length;
+        markPending( output );
+        return;
+    }
+
+    struct iovec iov[2] = {
+        { output->buffer, output->length },
+        { ( void* )data, length },
+    };
+    if ( !writeAll( output->fd, iov, 2 ) )
+    {
+        printf( "Failed to write %s: %s\n", output->path.c_str(), strerror( errno ) );
+    }
+    output->length = 0;
+}
+
+/**************************************************************/
+// Write the rest of an output, and close its file
+static void closeOutput( ingest_output_t* output )
+{
+    flushOutput( output );
+    close( output->fd );
+    output->fd = -1;
+
+    // Removed from the pending list on its next pass
+    if ( !output->queued )
+    {
+        delete output;
+    }
+}
+
+/**************************************************************/
+// Write the outputs whose text has waited long enough, or all of them
+static void flushPending( uint64_t now, bool all )
+{
+    size_t kept = 0;
+    for ( ingest_output_t* output : pendingOutputs )
+    {
+        if ( output->fd < 0 )
+        {
+            delete output;
+            continue;
+        }
+        if ( all || ( now - output->pendingSinceMs >= INGEST_FLUSH_LATENCY_MS ) )
+        {
+            flushOutput( output );
+            output->queued = false;
+            continue;
+        }
+        pendingOutputs[kept++] = output;
+    }
+    pendingOutputs.resize( kept );
+}
+
+/**************************************************************/
+// Format a sample as a CSV line, the same as the datarouter sends
+static void writeSample( ingest_output_t* output, const acceleration_sample_t* sample )
+{
+    char* line = reserveLine( output );
+    char* text = putUnsigned( line, sample->timestamp );
+    *text++ = ',';
+    text = putSigned( text, sample->acceleration[AXIS_X] );
+    *text++ = ',';
+    text = putSigned( text, sample->acceleration[AXIS_Y] );
+    *text++ = ',';
+    text = putSigned( text, sample->acceleration[AXIS_Z] );
+    *text++ = ',';
+    *text++ = sample->step ? '1' : '0';
+    *text++ = '\n';
+    output->length += ( size_t )( text - line );
+}
+
+/**************************************************************/
+// Format a window result as a CSV line
+static void writeResult( ingest_output_t* output, const window_result_t* result )
+{
+    char* line = reserveLine( output );
+    char* text = putUnsigned( line, result->timestamp );
+    for ( uint8_t i = 0; i < WINDOW_RESULT_NUM_FEATURES; i++ )
+    {
+        *text++ = ',';
+        text = putSigned( text, result->features[i] );
+    }
+    *text++ = ',';
+    text = putUnsigned( text, result->steps );
+    *text++ = ',';
+    text = putUnsigned( text, result->dropped );
+    *text++ = '\n';
+    output->length += ( size_t )( text - line );
+}
+
+/**************************************************************/
+// Close a session, and list its files
+static void closeSession( ingest_session_t* session )
+{
+    printf( "Session of device %s: %llu frames, %llu lost, %llu duplicates, %lu connections. Data saved to",
+            session->deviceId.c_str(),
+            ( unsigned long long )session->frames,
+            ( unsigned long long )session->lostFrames,
+            ( unsigned long long )session->duplicateFrames,
+            ( unsigned long )session->connections );
+
+    bool any = false;
+    for ( int stream = 0; stream < INGEST_STREAM_COUNT; stream++ )
+    {
+        ingest_output_t* output = session->outputs[stream];
+        if ( output != NULL )
+        {
+            printf( "%s %s", any ? "," : "", output->path.c_str() );
+            closeOutput( output );
+            any = true;
+        }
+    }
+    printf( "%s\n", any ? "" : " nothing" );
+    delete session;
+}
+
+/**************************************************************/
+// Check if a frame belongs to a session
+static bool inSession( const ingest_session_t* session, const frame_header_t* header )
+{
+    uint32_t ahead = header->sequence - session->nextSequence;
+    uint32_t behind = session->nextSequence - header->sequence;
+    return ( ahead <= INGEST_SESSION_WINDOW ) || ( behind <= INGEST_SESSION_WINDOW );
+}
+
+/**************************************************************/
+// Find the session of a frame. A sequence number far from the expected one
+// starts a new session, as every session on a device starts at a random one
+static ingest_session_t* getSession( ingest_connection_t* connection, const frame_header_t* header )
+{
+    // Frames of a connection nearly always belong to the session of the last one
+    ingest_session_t* current = connection->session;
+    if ( ( current != NULL ) && current->listed &&
+         ( memcmp( current->rawId, header->deviceId, FRAME_DEVICE_ID_SIZE ) == 0 ) && inSession( current, header ) )
+    {
+        return current;
+    }
+
+    std::string key( ( const char* )header->deviceId, FRAME_DEVICE_ID_SIZE );
+    auto found = sessions.find( key );
+    if ( found != sessions.end() )
+    {
+        ingest_session_t* session = found->second;
+        if ( inSession( session, header ) )
+        {
+            return session;
+        }
+
+        // Connections still pointing at the old session move to the new one
+        // with their next frame, and the last of them closes it
+        session->listed = false;
+        if ( session->activeConnections == 0 )
+        {
+            closeSession( session );
+        }
+        sessions.erase( found );
+    }
+
+    ingest_session_t* session = new ingest_session_t();
+    memcpy( session->rawId, header->deviceId, FRAME_DEVICE_ID_SIZE );
+    session->listed = true;
+    char hex[2 * FRAME_DEVICE_ID_SIZE + 1];
+    for ( uint8_t i = 0; i < FRAME_DEVICE_ID_SIZE; i++ )
+    {
+        snprintf( &( hex[2 * i] ), 3, "%02x", header->deviceId[i] );
+    }
+    session->deviceId = hex;
+    session->nextSequence = header->sequence;
+    sessions[key] = session;
+    return session;
+}
+
+/**************************************************************/
+// Move a connection from one session to another
+static void switchSession( ingest_connection_t* connection, ingest_session_t* to )
+{
+    ingest_session_t* from = connection->session;
+    if ( from != NULL )
+    {
+        from->activeConnections--;
+        from->idleSinceMs = nowMs();
+
+        // A session replaced by a newer one is closed with its last connection
+        if ( ( from->activeConnections == 0 ) && !from->listed )
+        {
+            closeSession( from );
+        }
+    }
+    if ( to != NULL )
+    {
+        to->connections++;
+        to->activeConnections++;
+    }
+    connection->session = to;
+}
+
+/**************************************************************/
+// Write the records of a checked frame to the file of its stream
+static void writeFrame( ingest_connection_t* connection, const uint8_t* frame, const frame_header_t* header )
+{
+    ingest_session_t* session = getSession( connection, header );
+    if ( session != connection->session )
+    {
+        switchSession( connection, session );
+    }
+
+    uint32_t gap = header->sequence - session->nextSequence;
+    if ( gap > INGEST_SESSION_WINDOW )
+    {
+        session->duplicateFrames++;
+        return;
+    }
+
+    ingest_stream_t stream =
+        ( header->encoding == FRAME_ENCODING_RESULTS ) ? INGEST_STREAM_RESULTS : INGEST_STREAM_SAMPLES;
+    if ( ( header->encoding == FRAME_ENCODING_DELTA ) &&
+         ( samplecodec_decode(
+               frame + FRAME_HEADER_SIZE, header->payloadLength, decoded, header->sampleCount ) !=
+           ( int )header->payloadLength ) )
+    {
+        connection->decodeErrors++;
+        return;
+    }
+
+    if ( session->outputs[stream] == NULL )
+    {
+        session->outputs[stream] = openOutput( stream );
+        if ( session->outputs[stream] == NULL )
+        {
+            return;
+        }
+        printf( "Session of device %s: writing %s to %s\n",
+                session->deviceId.c_str(),
+                ( stream == INGEST_STREAM_RESULTS ) ? "results" : "samples",
+                session->outputs[stream]->path.c_str() );
+    }
+    ingest_output_t* output = session->outputs[stream];
+
+    for ( uint16_t i = 0; i < header->sampleCount; i++ )
+    {
+        if ( header->encoding == FRAME_ENCODING_RESULTS )
+        {
+            window_result_t result;
+            frame_getResult( frame, i, &result );
+            writeResult( output, &result );
+        }
+        else if ( header->encoding == FRAME_ENCODING_DELTA )
+        {
+            writeSample( output, &( decoded[i] ) );
+        }
+        else
+        {
+            acceleration_sample_t sample;
+            frame_getSample( frame, i, &sample );
+            writeSample( output, &sample );
+        }
+    }
+
+    session->lostFrames += gap;
+    session->frames++;
+    session->nextSequence = header->sequence + 1;
+    connection->frames++;
+    totals.frames++;
+    totals.records += header->sampleCount;
+}
+
+/**************************************************************/
+// Check if data starts like a frame
+static bool isFrameStart( const uint8_t* data, size_t length )
+{
+    static const uint8_t magic[4] = { 'S', 'T', 'P', 'F' };
+    return memcmp( data, magic, ( length < sizeof( magic ) ) ? length : sizeof( magic ) ) == 0;
+}
+
+/**************************************************************/
+// Decode every complete frame in the receive buffer, in place. Returns true if
+// a frame was received, so the session must be acknowledged
+static bool parseFrames( ingest_connection_t* connection )
+{
+    static const uint8_t magic[4] = { 'S', 'T', 'P', 'F' };
+    const uint8_t* data = connection->receive;
+    size_t length = connection->receiveLength;
+    size_t offset = 0;
+    bool received = false;
+
+    while ( length - offset >= FRAME_HEADER_SIZE )
+    {
+        frame_header_t header;
+        int size = frame_decodeHeader( &( data[offset] ), length - offset, &header );
+        if ( size > 0 )
+        {
+            writeFrame( connection, &( data[offset] ), &header );
+            offset += ( size_t )size;
+            received = true;
+            continue;
+        }
+        if ( size == 0 )
+        {
+            // Header is valid, so the frame is only incomplete
+            break;
+        }
+
+        // Skip to the next possible frame magic
+        connection->crcErrors++;
+        const void* next = memmem( &( data[offset + 1] ), length - offset - 1, magic, sizeof( magic ) );
+        offset = ( next != NULL ) ? ( size_t )( ( const uint8_t* )next - data ) : length - sizeof( magic ) + 1;
+    }
+
+    // Keep the incomplete frame for the next read
+    connection->receiveLength = length - offset;
+    if ( ( offset > 0 ) && ( connection->receiveLength > 0 ) )
+    {
+        memmove( connection->receive, &( data[offset] ), connection->receiveLength );
+    }
+    return received;
+}
+
+/**************************************************************/
+// Make room in the receive buffer for the frame at its start
+static bool growReceive( ingest_connection_t* connection )
+{
+    size_t needed = INGEST_MAX_FRAME;
+    if ( connection->receiveLength >= FRAME_HEADER_SIZE )
+    {
+        frame_header_t header;
+        if ( frame_decodeHeader( connection->receive, connection->receiveLength, &header ) == 0 )
+        {
+            needed = FRAME_HEADER_SIZE + header.payloadLength;
+        }
+    }
+    if ( needed <= connection->receiveSize )
+    {
+        return false;
+    }
+
+    uint8_t* receive = ( uint8_t* )realloc( connection->receive, needed );
+    if ( receive == NULL )
+    {
+        return false;
+    }
+    connection->receive = receive;
+    connection->receiveSize = needed;
+    return true;
+}
+
+/**************************************************************/
+// Update which events of a connection epoll reports
+static void watchConnection( int epollFd, ingest_connection_t* connection, bool wantWrite )
+{
+    if ( connection->wantWrite == wantWrite )
+    {
+        return;
+    }
+    struct epoll_event event = {};
+    event.events = EPOLLIN | EPOLLRDHUP | ( wantWrite ? ( uint32_t )EPOLLOUT : 0 );
+    event.data.ptr = connection;
+    epoll_ctl( epollFd, EPOLL_CTL_MOD, connection->fd, &event );
+    connection->wantWrite = wantWrite;
+}
+
+/**************************************************************/
+// Send the acknowledgements that are due, without blocking. Returns false if
+// the connection failed
+static bool sendAcks( int epollFd, ingest_connection_t* connection )
+{
+    while ( true )
+    {
+        if ( connection->ackOffset == FRAME_ACK_SIZE )
+        {
+            if ( !connection->ackDue )
+            {
+                watchConnection( epollFd, connection, false );
+                return true;
+            }
+            frame_putAck( connection->ack, connection->ackSequence );
+            connection->ackOffset = 0;
+            connection->ackDue = false;
+        }
+
+        ssize_t sent = send( connection->fd,
+                             &( connection->ack[connection->ackOffset] ),
+                             FRAME_ACK_SIZE - connection->ackOffset,
+                             MSG_NOSIGNAL | MSG_DONTWAIT );
+        if ( sent < 0 )
+        {
+            if ( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) )
+            {
+                watchConnection( epollFd, connection, true );
+                return true;
+            }
+            return false;
+        }
+        connection->ackOffset += ( size_t )sent;
+    }
+}
+
+/**************************************************************/
+// Close a connection, and print what it sent
+static void closeConnection( ingest_connection_t* connection )
+{
+    if ( connection->mode == INGEST_MODE_FRAMES )
+    {
+        printf( "Connection from %s: %llu frames, %llu CRC errors, %llu decode errors\n",
+                connection->peer,
+                ( unsigned long long )connection->frames,
+                ( unsigned long long )connection->crcErrors,
+                ( unsigned long long )connection->decodeErrors );
+    }
+    if ( connection->csvOutput != NULL )
+    {
+        printf( "Transmission complete. Data saved to %s\n", connection->csvOutput->path.c_str() );
+        closeOutput( connection->csvOutput );
+    }
+    switchSession( connection, NULL );
+
+    close( connection->fd );
+    free( connection->receive );
+    delete connection;
+    openConnections--;
+}
+
+/**************************************************************/
+// Read what a connection sent, and handle it. Returns false if the connection
+// is closed
+static bool readConnection( int epollFd, ingest_connection_t* connection )
+{
+    bool received = false;
+
+    while ( true )
+    {
+        if ( connection->receiveLength == connection->receiveSize )
+        {
+            // A full buffer without a complete frame must grow to fit it
+            if ( !growReceive( connection ) )
+            {
+                connection->crcErrors++;
+                connection->receiveLength = 0;
+            }
+        }
+
+        size_t space = connection->receiveSize - connection->receiveLength;
+        ssize_t count = read( connection->fd, &( connection->receive[connection->receiveLength] ), space );
+        totals.reads++;
+        if ( count == 0 )
+        {
+            return false;
+        }
+        if ( count < 0 )
+        {
+            if ( errno == EINTR )
+            {
+                continue;
+            }
+            if ( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) )
+            {
+                break;
+            }
+            return false;
+        }
+        totals.bytesRead += ( uint64_t )count;
+        connection->receiveLength += ( size_t )count;
+
+        // The first bytes tell if the device sends binary frames or CSV text
+        if ( connection->mode == INGEST_MODE_UNKNOWN )
+        {
+            if ( isFrameStart( connection->receive, connection->receiveLength ) )
+            {
+                if ( connection->receiveLength < 4 )
+                {
+                    continue;
+                }
+                connection->mode = INGEST_MODE_FRAMES;
+            }
+            else
+            {
+                connection->mode = INGEST_MODE_CSV;
+                connection->csvOutput = openOutput( INGEST_STREAM_SAMPLES );
+                if ( connection->csvOutput == NULL )
+                {
+                    return false;
+                }
+            }
+        }
+
+        if ( connection->mode == INGEST_MODE_CSV )
+        {
+            totals.csvBytes += connection->receiveLength;
+            appendOutput( connection->csvOutput, connection->receive, connection->receiveLength );
+            connection->receiveLength = 0;
+        }
+        else
+        {
+            received |= parseFrames( connection );
+        }
+
+        // A short read means the socket is drained
+        if ( ( size_t )count < space )
+        {
+            break;
+        }
+    }
+
+    // Acknowledge the frames once the data read is handled
+    if ( received && ( connection->session != NULL ) )
+    {
+        connection->ackSequence = connection->session->nextSequence;
+        connection->ackDue = true;
+        return sendAcks( epollFd, connection );
+    }
+    return true;
+}
+
+/**************************************************************/
+// Accept every pending connection
+static void acceptConnections( int epollFd, int listenFd )
+{
+    while ( true )
+    {
+        struct sockaddr_in6 address;
+        socklen_t addressLength = sizeof( address );
+        int fd = accept4( listenFd, ( struct sockaddr* )&address, &addressLength, SOCK_NONBLOCK | SOCK_CLOEXEC );
+        if ( fd < 0 )
+        {
+            if ( ( errno != EAGAIN ) && ( errno != EWOULDBLOCK ) && ( errno != EINTR ) )
+            {
+                printf( "Failed to accept connection: %s\n", strerror( errno ) );
+            }
+            return;
+        }
+
+        int noDelay = 1;
+        setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof( noDelay ) );
+
+        ingest_connection_t* connection = new ingest_connection_t();
+        connection->fd = fd;
+        inet_ntop( AF_INET6, &( address.sin6_addr ), connection->peer, sizeof( connection->peer ) );
+        connection->mode = INGEST_MODE_UNKNOWN;
+        connection->receive = ( uint8_t* )malloc( INGEST_RECEIVE_SIZE );
+        connection->receiveSize = INGEST_RECEIVE_SIZE;
+        connection->ackOffset = FRAME_ACK_SIZE;
+
+        struct epoll_event event = {};
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.ptr = connection;
+        if ( ( connection->receive == NULL ) || ( epoll_ctl( epollFd, EPOLL_CTL_ADD, fd, &event ) != 0 ) )
+        {
+            close( fd );
+            free( connection->receive );
+            delete connection;
+            continue;
+        }
+
+        openConnections++;
+        totals.connections++;
+    }
+}
+
+/**************************************************************/
+// Close the sessions whose device has not reconnected in time
+static void expireSessions( uint64_t now )
+{
+    for ( auto entry = sessions.begin(); entry != sessions.end(); )
+    {
+        ingest_session_t* session = entry->second;
+        if ( ( session->activeConnections == 0 ) && ( now - session->idleSinceMs >= INGEST_SESSION_TIMEOUT_MS ) )
+        {
+            closeSession( session );
+            entry = sessions.erase( entry );
+        }
+        else
+        {
+            ++entry;
+        }
+    }
+}
+
+/**************************************************************/
+// Print totals, and the rates since the last time
+static void printStats( double seconds, const ingest_totals_t* last )
+{
+    printf( "%lu connections, %zu sessions: %.0f frames/s, %.0f records/s, %.2f MB/s in, %.0f reads/s, "
+            "%.2f MB/s out, %.0f writes/s\n",
+            ( unsigned long )openConnections,
+            sessions.size(),
+            ( totals.frames - last->frames ) / seconds,
+            ( totals.records - last->records ) / seconds,
+            ( totals.bytesRead - last->bytesRead ) / seconds / 1e6,
+            ( totals.reads - last->reads ) / seconds,
+            ( totals.bytesWritten - last->bytesWritten ) / seconds / 1e6,
+            ( totals.writes - last->writes ) / seconds );
+    fflush( stdout );
+}
+
+/**************************************************************/
+// Open a non-blocking socket listening on every address
+static int listenOn( uint16_t port )
+{
+    int fd = socket( AF_INET6, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+    if ( fd < 0 )
+    {
+        return -1;
+    }
+
+    int on = 1;
+    int off = 0;
+    setsockopt( fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof( on ) );
+    setsockopt( fd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof( off ) );
+
+    struct sockaddr_in6 address = {};
+    address.sin6_family = AF_INET6;
+    address.sin6_addr = in6addr_any;
+    address.sin6_port = htons( port );
+    if ( ( bind( fd, ( struct sockaddr* )&address, sizeof( address ) ) != 0 ) || ( listen( fd, SOMAXCONN ) != 0 ) )
+    {
+        close( fd );
+        return -1;
+    }
+    return fd;
+}
+
+/**************************************************************/
+// Print usage
+static void usage()
+{
+    printf( "Usage: ingestd [options]\n"
+            "  --port N                 Port to listen on (default: 7123)\n"
+            "  --out DIR                Directory to write files to (default: ../tcp_server/out)\n"
+            "  --label NAME             Prefix of file names\n" );
+}
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+int main( int argc, char** argv )
+{
+    uint32_t port = INGEST_DEFAULT_PORT;
+
+    for ( int i = 1; i < argc; i++ )
+    {
+        const char* arg = argv[i];
+        const char* value = ( i + 1 < argc ) ? argv[i + 1] : NULL;
+
+        if ( strcmp( arg, "--help" ) == 0 )
+        {
+            usage();
+            return 0;
+        }
+        if ( value == NULL )
+        {
+            usage();
+            return 1;
+        }
+
+        i++;
+        if ( strcmp( arg, "--port" ) == 0 )
+        {
+            port = strtoul( value, NULL, 10 );
+        }
+        else if ( strcmp( arg, "--out" ) == 0 )
+        {
+            outputDir = value;
+        }
+        else if ( strcmp( arg, "--label" ) == 0 )
+        {
+            label = value;
+        }
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    if ( ( port == 0 ) || ( port > UINT16_MAX ) )
+    {
+        usage();
+        return 1;
+    }
+
+    // Every connection is a file descriptor, and so is every file
+    struct rlimit limit;
+    if ( getrlimit( RLIMIT_NOFILE, &limit ) == 0 )
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit( RLIMIT_NOFILE, &limit );
+    }
+
+    struct sigaction action = {};
+    action.sa_handler = stopHandler;
+    sigaction( SIGINT, &action, NULL );
+    sigaction( SIGTERM, &action, NULL );
+    signal( SIGPIPE, SIG_IGN );
+
+    mkdir( outputDir.c_str(), 0755 );
+    scanFileNumbers();
+
+    int listenFd = listenOn( ( uint16_t )port );
+    int epollFd = epoll_create1( EPOLL_CLOEXEC );
+    if ( ( listenFd < 0 ) || ( epollFd < 0 ) )
+    {
+        printf( "Failed to listen on port %lu: %s\n", ( unsigned long )port, strerror( errno ) );
+        return 1;
+    }
+
+    // The listening socket is the event without a connection
+    struct epoll_event listenEvent = {};
+    listenEvent.events = EPOLLIN;
+    listenEvent.data.ptr = NULL;
+    epoll_ctl( epollFd, EPOLL_CTL_ADD, listenFd, &listenEvent );
+
+    printf( "Ingest daemon listening on port %lu, writing to %s, up to %llu connections\n",
+            ( unsigned long )port,
+            outputDir.c_str(),
+            ( unsigned long long )limit.rlim_cur );
+    fflush( stdout );
+
+    static struct epoll_event events[INGEST_MAX_EVENTS];
+    ingest_totals_t last = totals;
+    uint64_t lastStatsMs = nowMs();
+
+    while ( !stopRequested )
+    {
+        int count = epoll_wait( epollFd, events, INGEST_MAX_EVENTS, INGEST_TICK_MS );
+        for ( int i = 0; i < count; i++ )
+        {
+            ingest_connection_t* connection = ( ingest_connection_t* )events[i].data.ptr;
+            if ( connection == NULL )
+            {
+                acceptConnections( epollFd, listenFd );
+                continue;
+            }
+
+            bool open = true;
+            if ( events[i].events & ( EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR ) )
+            {
+                open = readConnection( epollFd, connection );
+            }
+            if ( open && ( events[i].events & EPOLLOUT ) )
+            {
+                open = sendAcks( epollFd, connection );
+            }
+            if ( !open )
+            {
+                closeConnection( connection );
+            }
+        }
+
+        uint64_t now = nowMs();
+        flushPending( now, false );
+        expireSessions( now );
+        if ( now - lastStatsMs >= INGEST_STATS_MS )
+        {
+            if ( totals.bytesRead != last.bytesRead )
+            {
+                printStats( ( now - lastStatsMs ) / 1000.0, &last );
+            }
+            last = totals;
+            lastStatsMs = now;
+        }
+    }
+
+    // Write everything received, and close every session
+    flushPending( nowMs(), true );
+    for ( auto& entry : sessions )
+    {
+        closeSession( entry.second );
+    }
+    sessions.clear();
+    flushPending( nowMs(), true );
+
+    printf( "Totals: %llu connections, %llu frames, %llu records, %llu CSV bytes, %llu bytes in %llu reads, "
+            "%llu bytes out in %llu writes\n",
+            ( unsigned long long )totals.connections,
+            ( unsigned long long )totals.frames,
+            ( unsigned long long )totals.records,
+            ( unsigned long long )totals.csvBytes,
+            ( unsigned long long )totals.bytesRead,
+            ( unsigned long long )totals.reads,
+            ( unsigned long long )totals.bytesWritten,
+            ( unsigned long long )totals.writes );
+
+    close( epollFd );
+    close( listenFd );
+    return 0;
+}
@@ -0,0 +1,722 @@
+/**
+ * @file loadgen.cpp
+ * @author Simon Udsen
+ * @date 2026-10-18
+ * @brief Load generator replaying recordings as many simulated devices
+ * @details Every simulated device opens a TCP connection to the server, and
+ * sends a recording from ../tcp_server/out like the datarouter would: a batch
+ * of --batch samples every batch period at --rate samples per second, as CSV
+ * text, packed frames or delta frames. Devices replay the recordings in turn,
+ * starting at a different one each, and every device has its own device ID and
+ * random initial sequence number, so the server sees them as separate
+ * sessions. Acknowledgements are read and counted, so the server must keep up
+ * with both writing and acknowledging.
+ *
+ * Every device is served by a single epoll loop. Starts are spread over one
+ * batch period, so the load is even. With --rate 0, every device sends as fast
+ * as the server reads.
+ *
+ * Load the ingest daemon, or the TCP server, with 2000 devices for 30 seconds:
+ *
+ *     loadgen --devices 2000 --duration 30 $(find ../tcp_server/out -name '*.csv')
+ *
+ * The recordings have millisecond timestamps, while the firmware sends
+ * microseconds, so timestamps are scaled by --timestamp-scale first.
+ *
+ * The exit code is 1 if a device could not connect, or lost its connection.
+ */
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include <arpa/inet.h>    // inet_pton
+#include <errno.h>        // errno
+#include <netinet/in.h>   // sockaddr_in
+#include <netinet/tcp.h>  // TCP_NODELAY
+#include <stdint.h>       // Standard integer types
+#include <stdio.h>        // printf, snprintf
+#include <stdlib.h>       // strtoul
+#include <string.h>       // strcmp
+#include <sys/epoll.h>    // epoll
+#include <sys/resource.h> // setrlimit
+#include <sys/socket.h>   // socket, connect
+#include <time.h>         // clock_gettime
+#include <unistd.h>       // read, close
+
+#include <queue>  // Devices by time of next batch
+#include <random> // Initial sequence numbers
+#include <vector> // Recordings and devices
+
+#include "frame.h"       // Binary frames of samples
+#include "recording.h"   // CSV recordings
+#include "samplecodec.h" // Sample codec
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+#define LOADGEN_DEFAULT_PORT 7123                                       // Same as the TCP server
+#define LOADGEN_MAX_EVENTS 256                                          // Events handled per epoll_wait
+#define LOADGEN_MAX_BATCH 1000                                          // Largest batch of samples
+#define LOADGEN_CSV_LINE_SIZE 40                                        // Same as DATAROUTER_CSV_LINE_SIZE
+#define LOADGEN_MAX_BYTES ( LOADGEN_MAX_BATCH * LOADGEN_CSV_LINE_SIZE ) // Largest batch in bytes
+#define LOADGEN_SEND_LIMIT ( 64 * 1024 )                                // Unsent bytes before a device skips batches
+#define LOADGEN_FAST_BATCHES 16                                         // Batches per writable event with --rate 0
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+// Formats a device can send in
+typedef enum loadgen_format_
+{
+    LOADGEN_FORMAT_CSV,
+    LOADGEN_FORMAT_PACKED,
+    LOADGEN_FORMAT_DELTA,
+} loadgen_format_t;
+
+// Simulated device
+typedef struct loadgen_device_
+{
+    int fd;                                 // Socket
+    uint32_t index;                         // Index of device, the epoll data of its socket
+    bool connected;                         // Connection is established
+    uint8_t deviceId[FRAME_DEVICE_ID_SIZE]; // Device ID sent in frames
+    uint32_t firstSequence;                 // Sequence number of first frame
+    uint32_t nextSequence;                  // Sequence number of next frame
+    uint32_t ackedSequence;                 // Sequence number of next frame expected by the server
+    size_t recording;                       // Index of recording being replayed
+    size_t position;                        // Index of next sample in recording
+    std::vector<uint8_t> pending;           // Bytes not sent yet
+    size_t pendingOffset;                   // Bytes of pending sent
+    uint8_t ack[FRAME_ACK_SIZE];            // Acknowledgement being received
+    size_t ackLength;                       // Bytes in acknowledgement buffer
+    bool wantWrite;                         // Waiting for the socket to be writable
+} loadgen_device_t;
+
+// Totals of every device
+typedef struct loadgen_totals_
+{
+    uint64_t batches;         // Batches sent
+    uint64_t samples;         // Samples sent
+    uint64_t bytes;           // Bytes sent
+    uint64_t ackedFrames;     // Frames acknowledged
+    uint64_t skippedBatches;  // Batches not sent, as the device was too far behind
+    uint32_t connectFailures; // Devices that could not connect
+    uint32_t disconnects;     // Devices that lost their connection
+} loadgen_totals_t;
+
+// Time a device sends its next batch
+typedef struct loadgen_due_
+{
+    uint64_t timeUs; // Time of batch
+    uint32_t device; // Index of device
+    bool operator>( const loadgen_due_& other ) const
+    {
+        return timeUs > other.timeUs;
+    }
+} loadgen_due_t;
+
+/**************************************************************/
+/*                          Private                           */
+/**************************************************************/
+
+static std::vector<std::vector<acceleration_sample_t>> recordings; // Recordings to replay
+static loadgen_format_t format = LOADGEN_FORMAT_DELTA;             // Format devices send in
+static uint32_t batchSize = DATAROUTER_BATCH_SAMPLES;              // Samples per batch
+static loadgen_totals_t totals = {};                               // Totals of every device
+
+/**************************************************************/
+// Microseconds of a monotonic clock
+static uint64_t nowUs()
+{
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return ( uint64_t )now.tv_sec * 1000000 + ( uint64_t )now.tv_nsec / 1000;
+}
+
+/**************************************************************/
+// Take the next batch of samples of a device from its recording
+static uint16_t nextBatch( loadgen_device_t* device, acceleration_sample_t* batch )
+{
+    uint16_t count = 0;
+    while ( count < batchSize )
+    {
+        const std::vector<acceleration_sample_t>& recording = recordings[device->recording];
+        if ( device->position >= recording.size() )
+        {
+            // Continue with the next recording
+            device->recording = ( device->recording + 1 ) % recordings.size();
+            device->position = 0;
+            if ( count > 0 )
+            {
+                break;
+            }
+            continue;
+        }
+        batch[count++] = recording[device->position++];
+    }
+    return count;
+}
+
+/**************************************************************/
+// Add the next batch of a device to its unsent bytes, like the datarouter
+// builds its transmit buffer
+static void queueBatch( loadgen_device_t* device )
+{
+    static acceleration_sample_t batch[LOADGEN_MAX_BATCH];
+    static uint8_t buffer[LOADGEN_MAX_BYTES];
+
+    uint16_t count = nextBatch( device, batch );
+    size_t length = 0;
+
+    if ( format == LOADGEN_FORMAT_CSV )
+    {
+        for ( uint16_t i = 0; i < count; i++ )
+        {
+            length += ( size_t )snprintf( ( char* )&( buffer[length] ),
+                                          LOADGEN_CSV_LINE_SIZE,
+                                          "%lu,%d,%d,%d,%d\n",
+                                          ( unsigned long )batch[i].timestamp,
+                                          batch[i].acceleration[AXIS_X],
+                                          batch[i].acceleration[AXIS_Y],
+                                          batch[i].acceleration[AXIS_Z],
+                                          batch[i].step );
+        }
+    }
+    else
+    {
+        frame_encoding_t encoding = FRAME_ENCODING_PACKED;
+        size_t payloadLength = ( size_t )count * FRAME_SAMPLE_SIZE;
+
+        int encoded = -1;
+        if ( format == LOADGEN_FORMAT_DELTA )
+        {
+            encoded = samplecodec_encode(
+                batch, count, &( buffer[FRAME_HEADER_SIZE] ), sizeof( buffer ) - FRAME_HEADER_SIZE );
+        }
+        if ( ( encoded >= 0 ) && ( ( size_t )encoded < payloadLength ) )
+        {
+            encoding = FRAME_ENCODING_DELTA;
+            payloadLength = ( size_t )encoded;
+        }
+        else
+        {
+            for ( uint16_t i = 0; i < count; i++ )
+            {
+                frame_putSample( buffer, i, &( batch[i] ) );
+            }
+        }
+        length = frame_finish( buffer, device->deviceId, device->nextSequence++, encoding, count, payloadLength );
+    }
+
+    device->pending.insert( device->pending.end(), buffer, buffer + length );
+    totals.batches++;
+    totals.samples += count;
+}
+
+/**************************************************************/
+// Update which events of a device epoll reports
+static void watchDevice( int epollFd, loadgen_device_t* device, bool wantWrite )
+{
+    if ( device->wantWrite == wantWrite )
+    {
+        return;
+    }
+    struct epoll_event event = {};
+    event.events = EPOLLIN | EPOLLRDHUP | ( wantWrite ? ( uint32_t )EPOLLOUT : 0 );
+    event.data.u32 = device->index;
+    if ( epoll_ctl( epollFd, EPOLL_CTL_MOD, device->fd, &event ) == 0 )
+    {
+        device->wantWrite = wantWrite;
+    }
+}
+
+/**************************************************************/
+// Send the unsent bytes of a device, without blocking. Returns false if the
+// connection failed
+static bool sendPending( loadgen_device_t* device )
+{
+    while ( device->pendingOffset < device->pending.size() )
+    {
+        ssize_t sent = send( device->fd,
+                             &( device->pending[device->pendingOffset] ),
+                             device->pending.size() - device->pendingOffset,
+                             MSG_NOSIGNAL | MSG_DONTWAIT );
+        if ( sent < 0 )
+        {
+            return ( errno == EAGAIN ) || ( errno == EWOULDBLOCK );
+        }
+        device->pendingOffset += ( size_t )sent;
+        totals.bytes += ( uint64_t )sent;
+    }
+
+    device->pending.clear();
+    device->pendingOffset = 0;
+    return true;
+}
+
+/**************************************************************/
+// Read the acknowledgements of a device. Returns false if the connection closed
+static bool readAcks( loadgen_device_t* device )
+{
+    while ( true )
+    {
+        ssize_t count = read( device->fd, &( device->ack[device->ackLength] ), FRAME_ACK_SIZE - device->ackLength );
+        if ( count == 0 )
+        {
+            return false;
+        }
+        if ( count < 0 )
+        {
+            return ( errno == EAGAIN ) || ( errno == EWOULDBLOCK );
+        }
+
+        device->ackLength += ( size_t )count;
+        if ( device->ackLength < FRAME_ACK_SIZE )
+        {
+            continue;
+        }
+        device->ackLength = 0;
+
+        uint32_t sequence = 0;
+        if ( frame_decodeAck( device->ack, FRAME_ACK_SIZE, &sequence ) != FRAME_ACK_SIZE )
+        {
+            return false;
+        }
+        uint32_t acked = sequence - device->ackedSequence;
+        if ( acked <= device->nextSequence - device->ackedSequence )
+        {
+            totals.ackedFrames += acked;
+            device->ackedSequence = sequence;
+        }
+    }
+}
+
+/**************************************************************/
+// Start connecting a device
+static bool connectDevice( int epollFd, loadgen_device_t* device, const struct sockaddr_in* server )
+{
+    device->fd = socket( AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+    if ( device->fd < 0 )
+    {
+        return false;
+    }
+
+    int noDelay = 1;
+    setsockopt( device->fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof( noDelay ) );
+
+    if ( ( connect( device->fd, ( const struct sockaddr* )server, sizeof( *server ) ) != 0 ) &&
+         ( errno != EINPROGRESS ) )
+    {
+        close( device->fd );
+        device->fd = -1;
+        return false;
+    }
+
+    // Writable once connected
+    struct epoll_event event = {};
+    event.events = EPOLLIN | EPOLLRDHUP | EPOLLOUT;
+    event.data.u32 = device->index;
+    device->wantWrite = true;
+    return epoll_ctl( epollFd, EPOLL_CTL_ADD, device->fd, &event ) == 0;
+}
+
+/**************************************************************/
+// Close a device that failed
+static void closeDevice( loadgen_device_t* device )
+{
+    if ( device->fd >= 0 )
+    {
+        close( device->fd );
+        device->fd = -1;
+        if ( device->connected )
+        {
+            totals.disconnects++;
+        }
+        else
+        {
+            totals.connectFailures++;
+        }
+    }
+}
+
+/**************************************************************/
+// Print totals, and the rates since the last time
+static void printStats( double seconds, const loadgen_totals_t* last, uint32_t connected )
+{
+    printf( "%lu devices connected: %.0f batches/s, %.0f samples/s, %.2f MB/s, %.0f acks/s, %llu batches skipped\n",
+            ( unsigned long )connected,
+            ( totals.batches - last->batches ) / seconds,
+            ( totals.samples - last->samples ) / seconds,
+            ( totals.bytes - last->bytes ) / seconds / 1e6,
+            ( totals.ackedFrames - last->ackedFrames ) / seconds,
+            ( unsigned long long )( totals.skippedBatches - last->skippedBatches ) );
+    fflush( stdout );
+}
+
+/**************************************************************/
+// Print usage
+static void usage()
+{
+    printf( "Usage: loadgen [options] recording.csv...\n"
+            "  --host ADDRESS           IPv4 address of server (default: 127.0.0.1)\n"
+            "  --port N                 Port of server (default: 7123)\n"
+            "  --devices N              Simulated devices (default: 100)\n"
+            "  --format csv|packed|delta  Format devices send in (default: delta)\n"
+            "  --batch N                Samples per batch (default: DATAROUTER_BATCH_SAMPLES)\n"
+            "  --rate N                 Samples per second per device, 0 for as fast as possible\n"
+            "                           (default: ACCELEROMETER_SAMPLE_RATE_HZ)\n"
+            "  --duration N             Seconds to send for (default: 10)\n"
+            "  --seed N                 Seed of initial sequence numbers (default: 1)\n"
+            "  --timestamp-scale N      Multiply timestamps by N (default: 1000, ms to us)\n" );
+}
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+int main( int argc, char** argv )
+{
+    const char* host = "127.0.0.1";
+    uint32_t port = LOADGEN_DEFAULT_PORT;
+    uint32_t deviceCount = 100;
+    uint32_t rate = ACCELEROMETER_SAMPLE_RATE_HZ;
+    uint32_t duration = 10;
+    uint32_t seed = 1;
+    uint32_t timestampScale = 1000;
+    std::vector<const char*> paths;
+
+    for ( int i = 1; i < argc; i++ )
+    {
+        const char* arg = argv[i];
+        const char* value = ( i + 1 < argc ) ? argv[i + 1] : NULL;
+
+        if ( strcmp( arg, "--help" ) == 0 )
+        {
+            usage();
+            return 0;
+        }
+        if ( strncmp( arg, "--", 2 ) != 0 )
+        {
+            paths.push_back( arg );
+            continue;
+        }
+        if ( value == NULL )
+        {
+            usage();
+            return 1;
+        }
+
+        i++;
+        if ( strcmp( arg, "--host" ) == 0 )
+        {
+            host = value;
+        }
+        else if ( strcmp( arg, "--port" ) == 0 )
+        {
+            port = strtoul( value, NULL, 10 );
+        }
+        else if ( strcmp( arg, "--devices" ) == 0 )
+        {
+            deviceCount = strtoul( value, NULL, 10 );
+        }
+        else if ( strcmp( arg, "--format" ) == 0 )
+        {
+            if ( strcmp( value, "csv" ) == 0 )
+            {
+                format = LOADGEN_FORMAT_CSV;
+            }
+            else if ( strcmp( value, "packed" ) == 0 )
+            {
+                format = LOADGEN_FORMAT_PACKED;
+            }
+            else if ( strcmp( value, "delta" ) == 0 )
+            {
+                format = LOADGEN_FORMAT_DELTA;
+            }
+            else
+            {
+                usage();
+                return 1;
+            }
+        }
+        else if ( strcmp( arg, "--batch" ) == 0 )
+        {
+            batchSize = strtoul( value, NULL, 10 );
+        }
+        else if ( strcmp( arg, "--rate" ) == 0 )
+        {
+            rate = strtoul( value, NULL, 10 );
+        }
+        else if ( strcmp( arg, "--duration" ) == 0 )
+        {
+            duration = strtoul( value, NULL, 10 );
+        }
+        else if ( strcmp( arg, "--seed" ) == 0 )
+        {
+            seed = strtoul( value, NULL, 10 );
+        }
+        else if ( strcmp( arg, "--timestamp-scale" ) == 0 )
+        {
+            timestampScale = strtoul( value, NULL, 10 );
+        }
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    struct sockaddr_in server = {};
+    server.sin_family = AF_INET;
+    server.sin_port = htons( ( uint16_t )port );
+    if ( paths.empty() || ( deviceCount == 0 ) || ( batchSize == 0 ) || ( batchSize > LOADGEN_MAX_BATCH ) ||
+         ( port == 0 ) || ( port > UINT16_MAX ) || ( inet_pton( AF_INET, host, &( server.sin_addr ) ) != 1 ) )
+    {
+        usage();
+        return 1;
+    }
+
+    for ( const char* path : paths )
+    {
+        std::vector<acceleration_sample_t> samples;
+        if ( !recording_read( path, timestampScale, &samples ) )
+        {
+            printf( "Failed to read %s\n", path );
+            return 1;
+        }
+        if ( !samples.empty() )
+        {
+            recordings.push_back( samples );
+        }
+    }
+    if ( recordings.empty() )
+    {
+        printf( "No samples in recordings\n" );
+        return 1;
+    }
+
+    // Every device is a file descriptor
+    struct rlimit limit;
+    if ( getrlimit( RLIMIT_NOFILE, &limit ) == 0 )
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit( RLIMIT_NOFILE, &limit );
+    }
+
+    int epollFd = epoll_create1( EPOLL_CLOEXEC );
+    if ( epollFd < 0 )
+    {
+        printf( "Failed to create epoll instance\n" );
+        return 1;
+    }
+
+    // Devices start a batch period apart, spread evenly
+    uint64_t periodUs = ( rate > 0 ) ? ( uint64_t )batchSize * 1000000 / rate : 0;
+    uint64_t startUs = nowUs();
+    std::mt19937 random( seed );
+    std::vector<loadgen_device_t> devices( deviceCount );
+    std::priority_queue<loadgen_due_t, std::vector<loadgen_due_t>, std::greater<loadgen_due_t>> due;
+
+    for ( uint32_t i = 0; i < deviceCount; i++ )
+    {
+        loadgen_device_t* device = &( devices[i] );
+        device->index = i;
+        memcpy( device->deviceId, "LOADGEN", 7 );
+        device->deviceId[7] = 0;
+        device->deviceId[8] = ( uint8_t )( i >> 24 );
+        device->deviceId[9] = ( uint8_t )( i >> 16 );
+        device->deviceId[10] = ( uint8_t )( i >> 8 );
+        device->deviceId[11] = ( uint8_t )i;
+        device->firstSequence = ( uint32_t )random();
+        device->nextSequence = device->firstSequence;
+        device->ackedSequence = device->firstSequence;
+        device->recording = i % recordings.size();
+
+        if ( !connectDevice( epollFd, device, &server ) )
+        {
+            closeDevice( device );
+            continue;
+        }
+        if ( rate > 0 )
+        {
+            due.push( { startUs + periodUs * i / deviceCount, i } );
+        }
+    }
+
+    printf( "%lu devices sending %s batches of %lu samples %s, replaying %zu recordings\n",
+            ( unsigned long )deviceCount,
+            ( format == LOADGEN_FORMAT_CSV ) ? "CSV" : ( format == LOADGEN_FORMAT_PACKED ) ? "packed" : "delta",
+            ( unsigned long )batchSize,
+            ( rate > 0 ) ? "at the sample rate" : "as fast as possible",
+            recordings.size() );
+    fflush( stdout );
+
+    static struct epoll_event events[LOADGEN_MAX_EVENTS];
+    uint64_t endUs = startUs + ( uint64_t )duration * 1000000;
+    uint64_t lastStatsUs = startUs;
+    loadgen_totals_t last = totals;
+    uint32_t connected = 0;
+
+    while ( true )
+    {
+        uint64_t now = nowUs();
+        if ( now >= endUs )
+        {
+            break;
+        }
+
+        // Send the batches that are due
+        while ( !due.empty() && ( due.top().timeUs <= now ) )
+        {
+            loadgen_due_t next = due.top();
+            due.pop();
+            loadgen_device_t* device = &( devices[next.device] );
+            if ( device->fd < 0 )
+            {
+                continue;
+            }
+            due.push( { next.timeUs + periodUs, next.device } );
+
+            // A device that can't keep up skips batches, like a datarouter
+            // whose store is full
+            if ( device->pending.size() - device->pendingOffset > LOADGEN_SEND_LIMIT )
+            {
+                totals.skippedBatches++;
+                continue;
+            }
+            queueBatch( device );
+            if ( device->connected )
+            {
+                if ( !sendPending( device ) )
+                {
+                    closeDevice( device );
+                    continue;
+                }
+                watchDevice( epollFd, device, !device->pending.empty() );
+            }
+        }
+
+        int timeoutMs = 100;
+        if ( !due.empty() )
+        {
+            uint64_t wait = ( due.top().timeUs > now ) ? ( due.top().timeUs - now + 999 ) / 1000 : 0;
+            timeoutMs = ( wait < ( uint64_t )timeoutMs ) ? ( int )wait : timeoutMs;
+        }
+
+        int count = epoll_wait( epollFd, events, LOADGEN_MAX_EVENTS, timeoutMs );
+        for ( int i = 0; i < count; i++ )
+        {
+            loadgen_device_t* device = &( devices[events[i].data.u32] );
+            if ( device->fd < 0 )
+            {
+                continue;
+            }
+
+            bool open = true;
+            if ( events[i].events & ( EPOLLERR | EPOLLHUP ) )
+            {
+                open = false;
+            }
+            if ( open && ( events[i].events & EPOLLIN ) )
+            {
+                open = readAcks( device );
+            }
+            if ( open && ( events[i].events & EPOLLOUT ) )
+            {
+                if ( !device->connected )
+                {
+                    device->connected = true;
+                    connected++;
+                }
+
+                // Without a rate, a device sends whenever its socket has room
+                if ( rate == 0 )
+                {
+                    for ( uint8_t batch = 0; ( batch < LOADGEN_FAST_BATCHES ) && open; batch++ )
+                    {
+                        queueBatch( device );
+                        open = sendPending( device );
+                        if ( !device->pending.empty() )
+                        {
+                            break;
+                        }
+                    }
+                }
+                else
+                {
+                    open = sendPending( device );
+                }
+            }
+            if ( !open )
+            {
+                if ( device->connected )
+                {
+                    connected--;
+                }
+                closeDevice( device );
+                continue;
+            }
+
+            // With a rate, only wait for room while bytes are unsent
+            watchDevice( epollFd, device, ( rate == 0 ) || !device->pending.empty() );
+        }
+
+        now = nowUs();
+        if ( now - lastStatsUs >= 1000000 )
+        {
+            printStats( ( now - lastStatsUs ) / 1e6, &last, connected );
+            last = totals;
+            lastStatsUs = now;
+        }
+    }
+
+    // Give the server a moment to acknowledge the last frames
+    uint64_t drainEndUs = nowUs() + 1000000;
+    while ( ( format != LOADGEN_FORMAT_CSV ) && ( nowUs() < drainEndUs ) )
+    {
+        int count = epoll_wait( epollFd, events, LOADGEN_MAX_EVENTS, 10 );
+        for ( int i = 0; i < count; i++ )
+        {
+            loadgen_device_t* device = &( devices[events[i].data.u32] );
+            if ( ( device->fd >= 0 ) && ( events[i].events & EPOLLOUT ) && !sendPending( device ) )
+            {
+                closeDevice( device );
+            }
+            if ( ( device->fd >= 0 ) && ( events[i].events & EPOLLIN ) && !readAcks( device ) )
+            {
+                closeDevice( device );
+            }
+        }
+    }
+
+    uint64_t unsent = 0;
+    for ( loadgen_device_t& device : devices )
+    {
+        unsent += device.pending.size() - device.pendingOffset;
+        if ( device.fd >= 0 )
+        {
+            close( device.fd );
+        }
+    }
+
+    double seconds = ( nowUs() - startUs ) / 1e6;
+    printf( "Totals: %llu batches, %llu samples, %llu bytes sent in %.1f s (%.0f samples/s, %.2f MB/s), "
+            "%llu frames acknowledged, %llu batches skipped, %llu bytes unsent, %lu connect failures, "
+            "%lu disconnects\n",
+            ( unsigned long long )totals.batches,
+            ( unsigned long long )totals.samples,
+            ( unsigned long long )totals.bytes,
+            seconds,
+            totals.samples / seconds,
+            totals.bytes / seconds / 1e6,
+            ( unsigned long long )totals.ackedFrames,
+            ( unsigned long long )totals.skippedBatches,
+            ( unsigned long long )unsent,
+            ( unsigned long )totals.connectFailures,
+            ( unsigned long )totals.disconnects );
+
+    close( epollFd );
+    return ( ( totals.connectFailures > 0 ) || ( totals.disconnects > 0 ) ) ? 1 : 0;
+}
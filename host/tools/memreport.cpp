@@ -0,0 +1,117 @@
+/**
+ * @file memreport.cpp
+ * @author Simon Udsen
+ * @date 2026-10-18
+ * @brief Report of the RAM budget of the pipeline
+ * @details Prints the budget of every module of the firmware, as arena.cpp
+ * computes it from config.h: the bytes of its objects in the static arena, and
+ * the bytes of its thread stacks and RTOS objects on the Device OS heap. It is
+ * built and run by make memory, so the RAM of the pipeline is known before the
+ * firmware is flashed:
+ *
+ *     make memory
+ *     build/memreport --limit 40000
+ *
+ * The objects are sized by this compiler, where pointers are 8 bytes instead
+ * of the 4 of the P2, so the arena is somewhat larger here than on the device.
+ * The firmware logs its own report at the end of setup.
+ *
+ * The exit code is 1 if the total is over --limit.
+ */
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include <stdint.h> // Standard integer types
+#include <stdio.h>  // printf
+#include <stdlib.h> // strtoul
+#include <string.h> // strcmp
+
+#include "arena.h" // Static arena for the pipeline objects
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+/**************************************************************/
+/*                          Private                           */
+/**************************************************************/
+
+/**************************************************************/
+// Print how to run
+static void usage()
+{
+    printf( "Usage: memreport [options]\n"
+            "  --limit BYTES            Fail if the pipeline needs more (default: no limit)\n" );
+}
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+int main( int argc, char** argv )
+{
+    size_t limit = 0;
+
+    for ( int i = 1; i < argc; i++ )
+    {
+        const char* arg = argv[i];
+        const char* value = ( i + 1 < argc ) ? argv[i + 1] : NULL;
+
+        if ( strcmp( arg, "--help" ) == 0 )
+        {
+            usage();
+            return 0;
+        }
+        if ( value == NULL )
+        {
+            usage();
+            return 1;
+        }
+
+        i++;
+        if ( strcmp( arg, "--limit" ) == 0 )
+        {
+            limit = strtoul( value, NULL, 10 );
+        }
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    arena_budget_t total = { 0, 0, 0, 0 };
+
+    printf( "%-14s %8s %8s %8s %8s\n", "module", "arena", "stacks", "rtos", "total" );
+    for ( uint8_t i = 0; i < ARENA_MODULE_COUNT; i++ )
+    {
+        arena_budget_t budget;
+        arena_getBudget( ( arena_module_t )i, &budget );
+        printf( "%-14s %8zu %8zu %8zu %8zu\n",
+                arena_getName( ( arena_module_t )i ),
+                budget.arenaBytes,
+                budget.stackBytes,
+                budget.rtosBytes,
+                budget.arenaBytes + budget.stackBytes + budget.rtosBytes );
+        total.arenaBytes += budget.arenaBytes;
+        total.stackBytes += budget.stackBytes;
+        total.rtosBytes += budget.rtosBytes;
+    }
+
+    size_t bytes = total.arenaBytes + total.stackBytes + total.rtosBytes;
+    printf( "%-14s %8zu %8zu %8zu %8zu\n", "total", total.arenaBytes, total.stackBytes, total.rtosBytes, bytes );
+    printf( "Arena of %zu bytes, with %zu-byte pointers\n", arena_getSize(), sizeof( void* ) );
+
+    if ( ( limit > 0 ) && ( bytes > limit ) )
+    {
+        printf( "FAIL: %zu bytes is over the limit of %zu\n", bytes, limit );
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,505 @@
+/**
+ * @file microbench.cpp
+ * @author Simon Udsen
+ * @date 2026-10-18
+ * @brief Micro-benchmarks of the firmware's hot paths
+ * @details Times the firmware functions every sample or window goes through,
+ * on real windows of recordings, compiled for the host:
+ * - statisticalfeatures_*: each feature helper on its own, through
+ *   statisticalfeatures_getCandidate on the X axis, then
+ *   statisticalfeatures_getFeatures, for the window of config.h and for a
+ *   size given at run time, and statisticalfeatures_getCandidates
+ * - step_counter_model_tree_N and step_counter_model_predict, on the features
+ *   of the windows
+ * - datarouter_csv: datarouter_formatCsv, the line datarouter::appendItem
+ *   formats per sample with DATAROUTER_FORMAT_CSV, then frame_putSample, samplecodec_encode of a batch
+ *   of DATAROUTER_BATCH_SAMPLES and frame_finish of a packed batch, what the
+ *   other formats do per sample and per batch
+ * - samplestream_write_read: a sample written to and read from the sample
+ *   stream, the queue between the accelerometer and its readers. Its
+ *   semaphores are the host's, see particle/Particle.h, so they cost more
+ *   than on the device
+ *
+ * Every benchmark runs its operation on the inputs in turn, first to find how
+ * many iterations take --min-time, then --repetitions times that many. The
+ * median time per operation is reported, with the fastest and slowest
+ * repetition. Compare two builds with:
+ *
+ *     microbench --json before.json ../tcp_server/out/walk.00001.csv ...
+ *
+ * The JSON has the layout of Google Benchmark, so its compare.py reads it.
+ *
+ * The exit code is 1 if a recording could not be read, or has no window.
+ */
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include <math.h>   // sqrt
+#include <stdint.h> // Standard integer types
+#include <stdio.h>  // printf
+#include <stdlib.h> // strtoul, strtod
+#include <string.h> // strcmp, strstr
+#include <time.h>   // time, strftime
+
+#include <algorithm>  // std::sort
+#include <chrono>     // Timing
+#include <functional> // Benchmarks
+#include <string>     // Names
+#include <thread>     // hardware_concurrency
+#include <vector>     // Windows and results
+
+#include "datarouter.h"          // CSV lines of samples
+#include "frame.h"               // Binary frames
+#include "recording.h"           // Recordings
+#include "samplecodec.h"         // Sample compression
+#include "samplestream.h"        // Broadcast of samples to several readers
+#include "statisticalfeatures.h" // Features of the firmware
+
+// The generated trees take the feature count, and don't use it
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#include "step_counter_trees.h" // Model of the firmware, and its trees
+#pragma GCC diagnostic pop
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+// Benchmark of one operation
+typedef struct benchmark_
+{
+    std::string name;                    // Name of operation
+    std::function<void( uint64_t )> run; // Runs the operation a number of times
+} benchmark_t;
+
+// Timing of a benchmark
+typedef struct benchmark_result_
+{
+    std::string name;    // Name of operation
+    uint64_t iterations; // Operations per repetition
+    double medianNs;     // Median time per operation
+    double minNs;        // Fastest repetition, per operation
+    double maxNs;        // Slowest repetition, per operation
+    double stddevNs;     // Standard deviation of repetitions, per operation
+} benchmark_result_t;
+
+/**************************************************************/
+/*                          Private                           */
+/**************************************************************/
+
+/**************************************************************/
+// Keep the compiler from optimizing a result away
+template <typename T> static inline void keep( const T& value )
+{
+    asm volatile( "" : : "r,m"( value ) : "memory" );
+}
+
+/**************************************************************/
+// Time a number of iterations of a benchmark
+static double timeRun( const benchmark_t* benchmark, uint64_t iterations )
+{
+    auto begin = std::chrono::steady_clock::now();
+    benchmark->run( iterations );
+    return std::chrono::duration<double>( std::chrono::steady_clock::now() - begin ).count();
+}
+
+/**************************************************************/
+// Time a benchmark
+static benchmark_result_t measure( const benchmark_t* benchmark, double minTime, uint32_t repetitions )
+{
+    // Grow the iterations until a run is long enough to scale from
+    uint64_t iterations = 1;
+    double seconds = timeRun( benchmark, iterations );
+    while ( ( seconds < minTime / 10 ) && ( iterations < ( 1ULL << 40 ) ) )
+    {
+        iterations *= 10;
+        seconds = timeRun( benchmark, iterations );
+    }
+    iterations = std::max( ( uint64_t )( iterations * minTime / std::max( seconds, 1e-9 ) ), ( uint64_t )1 );
+
+    std::vector<double> times;
+    for ( uint32_t repetition = 0; repetition < repetitions; repetition++ )
+    {
+        times.push_back( timeRun( benchmark, iterations ) * 1e9 / iterations );
+    }
+    std::sort( times.begin(), times.end() );
+
+    double mean = 0;
+    for ( double time : times )
+    {
+        mean += time / times.size();
+    }
+    double variance = 0;
+    for ( double time : times )
+    {
+        variance += ( time - mean ) * ( time - mean ) / times.size();
+    }
+
+    benchmark_result_t result;
+    result.name = benchmark->name;
+    result.iterations = iterations;
+    result.medianNs = ( times[( times.size() - 1 ) / 2] + times[times.size() / 2] ) / 2;
+    result.minNs = times.front();
+    result.maxNs = times.back();
+    result.stddevNs = sqrt( variance );
+    return result;
+}
+
+/**************************************************************/
+// Write results as JSON, in the layout of Google Benchmark
+static bool writeJson( const char* path,
+                       const char* executable,
+                       size_t recordings,
+                       size_t windows,
+                       uint32_t repetitions,
+                       const std::vector<benchmark_result_t>& results )
+{
+    FILE* file = fopen( path, "w" );
+    if ( file == NULL )
+    {
+        return false;
+    }
+
+    char date[32];
+    time_t now = time( NULL );
+    strftime( date, sizeof( date ), "%Y-%m-%dT%H:%M:%S%z", localtime( &now ) );
+
+    fprintf( file, "{\n  \"context\": {\n" );
+    fprintf( file, "    \"date\": \"%s\",\n", date );
+    fprintf( file, "    \"executable\": \"%s\",\n", executable );
+    fprintf( file, "    \"num_cpus\": %u,\n", std::thread::hardware_concurrency() );
+    fprintf( file, "    \"recordings\": %zu,\n", recordings );
+    fprintf( file, "    \"windows\": %zu,\n", windows );
+    fprintf( file, "    \"window_size\": %u,\n", ( unsigned )DATA_BUFFER_SIZE );
+    fprintf( file, "    \"library_build_type\": \"release\"\n  },\n  \"benchmarks\": [\n" );
+    for ( size_t i = 0; i < results.size(); i++ )
+    {
+        const benchmark_result_t* result = &( results[i] );
+        fprintf( file,
+                 "    {\"name\": \"%s\", \"run_name\": \"%s\", \"run_type\": \"aggregate\", "
+                 "\"aggregate_name\": \"median\", \"repetitions\": %u, \"iterations\": %llu, "
+                 "\"real_time\": %.3f, \"cpu_time\": %.3f, \"time_unit\": \"ns\", "
+                 "\"min_time\": %.3f, \"max_time\": %.3f, \"stddev_time\": %.3f}%s\n",
+                 result->name.c_str(),
+                 result->name.c_str(),
+                 repetitions,
+                 ( unsigned long long )result->iterations,
+                 result->medianNs,
+                 result->medianNs,
+                 result->minNs,
+                 result->maxNs,
+                 result->stddevNs,
+                 ( i + 1 < results.size() ) ? "," : "" );
+    }
+    fprintf( file, "  ]\n}\n" );
+    return fclose( file ) == 0;
+}
+
+/**************************************************************/
+// Print usage
+static void usage()
+{
+    printf( "Usage: microbench [options] recording...\n"
+            "  --json PATH              Write the results as JSON\n"
+            "  --filter TEXT            Only run benchmarks with TEXT in their name\n"
+            "  --min-time SECONDS       Time of a repetition (default: 0.1)\n"
+            "  --repetitions N          Repetitions of every benchmark (default: 5)\n" );
+}
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+int main( int argc, char** argv )
+{
+    const char* jsonPath = NULL;
+    const char* filter = "";
+    double minTime = 0.1;
+    uint32_t repetitions = 5;
+    std::vector<const char*> paths;
+
+    for ( int i = 1; i < argc; i++ )
+    {
+        const char* arg = argv[i];
+        const char* value = ( i + 1 < argc ) ? argv[i + 1] : NULL;
+
+        if ( strcmp( arg, "--help" ) == 0 )
+        {
+            usage();
+            return 0;
+        }
+        if ( strncmp( arg, "--", 2 ) != 0 )
+        {
+            paths.push_back( arg );
+            continue;
+        }
+        if ( value == NULL )
+        {
+            usage();
+            return 1;
+        }
+
+        i++;
+        if ( strcmp( arg, "--json" ) == 0 )
+        {
+            jsonPath = value;
+        }
+        else if ( strcmp( arg, "--filter" ) == 0 )
+        {
+            filter = value;
+        }
+        else if ( strcmp( arg, "--min-time" ) == 0 )
+        {
+            minTime = strtod( value, NULL );
+        }
+        else if ( strcmp( arg, "--repetitions" ) == 0 )
+        {
+            repetitions = strtoul( value, NULL, 10 );
+        }
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    if ( paths.empty() || ( minTime <= 0 ) || ( repetitions == 0 ) )
+    {
+        usage();
+        return 1;
+    }
+
+    // Every sample, and every whole window, of the recordings
+    std::vector<acceleration_sample_t> samples;
+    for ( const char* path : paths )
+    {
+        size_t first = samples.size();
+        if ( !recording_read( path, 1, &samples ) )
+        {
+            printf( "Failed to read %s\n", path );
+            return 1;
+        }
+        // Windows don't span recordings
+        samples.resize( first + ( samples.size() - first ) / DATA_BUFFER_SIZE * DATA_BUFFER_SIZE );
+    }
+    size_t windowCount = samples.size() / DATA_BUFFER_SIZE;
+    if ( windowCount == 0 )
+    {
+        printf( "No whole window in the recordings\n" );
+        return 1;
+    }
+    std::vector<acceleration_sample_t*> windows( windowCount );
+    std::vector<int16_t> features( windowCount * STATISTICALFEATURES_NUM_FEATURES );
+    for ( size_t window = 0; window < windowCount; window++ )
+    {
+        windows[window] = &( samples[window * DATA_BUFFER_SIZE] );
+        statisticalfeatures_getFeatures<DATA_BUFFER_SIZE>( windows[window],
+                                                           &( features[window * STATISTICALFEATURES_NUM_FEATURES] ) );
+    }
+
+    std::vector<benchmark_t> benchmarks;
+
+    // Feature helpers, one per candidate group
+    static const struct
+    {
+        const char* name;
+        statisticalfeatures_candidate_t candidate;
+    } helpers[] = {
+        { "statisticalfeatures_mean", STATISTICALFEATURES_MEAN_X },
+        { "statisticalfeatures_std", STATISTICALFEATURES_STD_X },
+        { "statisticalfeatures_mean_abs_diff", STATISTICALFEATURES_MEAN_ABS_DIFF_X },
+        { "statisticalfeatures_min", STATISTICALFEATURES_MIN_X },
+        { "statisticalfeatures_max", STATISTICALFEATURES_MAX_X },
+        { "statisticalfeatures_max_min_diff", STATISTICALFEATURES_MAX_MIN_DIFF_X },
+        { "statisticalfeatures_neg_count", STATISTICALFEATURES_NEG_COUNT_X },
+        { "statisticalfeatures_pos_count", STATISTICALFEATURES_POS_COUNT_X },
+        { "statisticalfeatures_above_mean_count", STATISTICALFEATURES_ABOVE_MEAN_COUNT_X },
+        { "statisticalfeatures_energy", STATISTICALFEATURES_ENERGY_X },
+        { "statisticalfeatures_sma", STATISTICALFEATURES_SMA },
+    };
+    for ( const auto& helper : helpers )
+    {
+        statisticalfeatures_candidate_t candidate = helper.candidate;
+        benchmarks.push_back( { helper.name,
+                                [&windows, windowCount, candidate]( uint64_t iterations )
+                                {
+                                    for ( uint64_t i = 0; i < iterations; i++ )
+                                    {
+                                        keep( statisticalfeatures_getCandidate(
+                                            windows[i % windowCount], DATA_BUFFER_SIZE, candidate ) );
+                                    }
+                                } } );
+    }
+    benchmarks.push_back( { "statisticalfeatures_getFeatures",
+                            [&windows, windowCount]( uint64_t iterations )
+                            {
+                                int16_t result[STATISTICALFEATURES_NUM_FEATURES];
+                                for ( uint64_t i = 0; i < iterations; i++ )
+                                {
+                                    statisticalfeatures_getFeatures<DATA_BUFFER_SIZE>( windows[i % windowCount],
+                                                                                       result );
+                                    keep( result );
+                                }
+                            } } );
+    benchmarks.push_back( { "statisticalfeatures_getFeatures_any_size",
+                            [&windows, windowCount]( uint64_t iterations )
+                            {
+                                int16_t result[STATISTICALFEATURES_NUM_FEATURES];
+                                for ( uint64_t i = 0; i < iterations; i++ )
+                                {
+                                    statisticalfeatures_getFeatures(
+                                        windows[i % windowCount], DATA_BUFFER_SIZE, result );
+                                    keep( result );
+                                }
+                            } } );
+    benchmarks.push_back( { "statisticalfeatures_getCandidates",
+                            [&windows, windowCount]( uint64_t iterations )
+                            {
+                                int64_t result[STATISTICALFEATURES_CANDIDATES];
+                                for ( uint64_t i = 0; i < iterations; i++ )
+                                {
+                                    statisticalfeatures_getCandidates(
+                                        windows[i % windowCount], DATA_BUFFER_SIZE, result );
+                                    keep( result );
+                                }
+                            } } );
+
+    // Trees of the model, from its table like stepcounter.cpp evaluates them
+    for ( size_t tree = 0; tree < STEP_COUNTER_MODEL_TREE_COUNT; tree++ )
+    {
+        int32_t ( *function )( const int16_t*, int32_t ) = step_counter_model_trees[tree];
+        benchmarks.push_back( { "step_counter_model_tree_" + std::to_string( tree ),
+                                [&features, windowCount, function]( uint64_t iterations )
+                                {
+                                    for ( uint64_t i = 0; i < iterations; i++ )
+                                    {
+                                        const int16_t* row =
+                                            &( features[( i % windowCount ) * STATISTICALFEATURES_NUM_FEATURES] );
+                                        keep( function( row, STATISTICALFEATURES_NUM_FEATURES ) );
+                                    }
+                                } } );
+    }
+    benchmarks.push_back( { "step_counter_model_predict",
+                            [&features, windowCount]( uint64_t iterations )
+                            {
+                                for ( uint64_t i = 0; i < iterations; i++ )
+                                {
+                                    const int16_t* row =
+                                        &( features[( i % windowCount ) * STATISTICALFEATURES_NUM_FEATURES] );
+                                    keep( step_counter_model_predict( row, STATISTICALFEATURES_NUM_FEATURES ) );
+                                }
+                            } } );
+
+    // Formatting of samples for the server
+    size_t sampleCount = samples.size();
+    benchmarks.push_back( { "datarouter_csv",
+                            [&samples, sampleCount]( uint64_t iterations )
+                            {
+                                char line[DATAROUTER_CSV_LINE_SIZE];
+                                for ( uint64_t i = 0; i < iterations; i++ )
+                                {
+                                    keep( datarouter_formatCsv( line, &( samples[i % sampleCount] ) ) );
+                                    keep( line );
+                                }
+                            } } );
+    benchmarks.push_back( { "frame_putSample",
+                            [&samples, sampleCount]( uint64_t iterations )
+                            {
+                                static uint8_t buffer[FRAME_SIZE( DATAROUTER_BATCH_SAMPLES )];
+                                for ( uint64_t i = 0; i < iterations; i++ )
+                                {
+                                    uint16_t index = ( uint16_t )( i % DATAROUTER_BATCH_SAMPLES );
+                                    frame_putSample( buffer, index, &( samples[i % sampleCount] ) );
+                                    keep( buffer );
+                                }
+                            } } );
+
+    size_t batchCount = sampleCount / DATAROUTER_BATCH_SAMPLES;
+    benchmarks.push_back( { "samplecodec_encode/" + std::to_string( DATAROUTER_BATCH_SAMPLES ),
+                            [&samples, batchCount]( uint64_t iterations )
+                            {
+                                static uint8_t buffer[FRAME_SIZE( DATAROUTER_BATCH_SAMPLES )];
+                                for ( uint64_t i = 0; i < iterations; i++ )
+                                {
+                                    const acceleration_sample_t* batch =
+                                        &( samples[( i % batchCount ) * DATAROUTER_BATCH_SAMPLES] );
+                                    keep( samplecodec_encode( batch,
+                                                              DATAROUTER_BATCH_SAMPLES,
+                                                              &( buffer[FRAME_HEADER_SIZE] ),
+                                                              DATAROUTER_BATCH_SAMPLES * FRAME_SAMPLE_SIZE ) );
+                                    keep( buffer );
+                                }
+                            } } );
+    benchmarks.push_back( { "frame_finish/" + std::to_string( DATAROUTER_BATCH_SAMPLES ),
+                            [&samples]( uint64_t iterations )
+                            {
+                                static uint8_t buffer[FRAME_SIZE( DATAROUTER_BATCH_SAMPLES )];
+                                static const uint8_t deviceId[FRAME_DEVICE_ID_SIZE] = { 0 };
+                                for ( uint16_t i = 0; i < DATAROUTER_BATCH_SAMPLES; i++ )
+                                {
+                                    frame_putSample( buffer, i, &( samples[i] ) );
+                                }
+                                for ( uint64_t i = 0; i < iterations; i++ )
+                                {
+                                    keep( frame_finish( buffer,
+                                                        deviceId,
+                                                        ( uint32_t )i,
+                                                        FRAME_ENCODING_PACKED,
+                                                        DATAROUTER_BATCH_SAMPLES,
+                                                        DATAROUTER_BATCH_SAMPLES * FRAME_SAMPLE_SIZE ) );
+                                }
+                            } } );
+
+    // The queue every sample goes through
+    static samplestream_t stream;
+    samplestream_init( &stream );
+    int reader = samplestream_addReader( &stream, SAMPLESTREAM_POLICY_GATE );
+    benchmarks.push_back( { "samplestream_write_read",
+                            [&samples, sampleCount, reader]( uint64_t iterations )
+                            {
+                                acceleration_sample_t sample;
+                                for ( uint64_t i = 0; i < iterations; i++ )
+                                {
+                                    samplestream_write( &stream, &( samples[i % sampleCount] ) );
+                                    samplestream_read( &stream, ( uint8_t )reader, &sample, 0 );
+                                    keep( sample );
+                                }
+                            } } );
+
+    printf( "%zu windows of %u samples from %zu recordings, %u repetitions of %.2f s\n",
+            windowCount,
+            ( unsigned )DATA_BUFFER_SIZE,
+            paths.size(),
+            repetitions,
+            minTime );
+    printf( "%-40s %14s %12s %12s %12s\n", "benchmark", "iterations", "median ns", "min ns", "max ns" );
+    std::vector<benchmark_result_t> results;
+    for ( const benchmark_t& benchmark : benchmarks )
+    {
+        if ( strstr( benchmark.name.c_str(), filter ) == NULL )
+        {
+            continue;
+        }
+        results.push_back( measure( &benchmark, minTime, repetitions ) );
+        const benchmark_result_t* result = &( results.back() );
+        printf( "%-40s %14llu %12.1f %12.1f %12.1f\n",
+                result->name.c_str(),
+                ( unsigned long long )result->iterations,
+                result->medianNs,
+                result->minNs,
+                result->maxNs );
+    }
+
+    if ( ( jsonPath != NULL ) && !writeJson( jsonPath, argv[0], paths.size(), windowCount, repetitions, results ) )
+    {
+        printf( "Failed to write %s\n", jsonPath );
+        return 1;
+    }
+    return 0;
+}
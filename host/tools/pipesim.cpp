@@ -0,0 +1,747 @@
+/**
+ * @file pipesim.cpp
+ * @author Simon Udsen
+ * @date 2026-10-18
+ * @brief Simulation of the firmware pipeline in virtual time
+ * @details Runs the firmware's own thread functions, compiled for the host
+ * against the virtual-time Device OS of particle/virtualtime.h: getMeasurement,
+ * bufferPiping and predictSteps, and with --network dataRouterFunc and
+ * dataRouterUplinkFunc. Unlike schedsim, which models what the threads do,
+ * this runs their code with its semaphores, sample stream and overload policy,
+ * so threading bugs and stalls of the firmware show up on the host. Time only
+ * passes when the threads wait, or are charged a cost, so a run is the same
+ * every time, and a minute of sampling takes well under a second.
+ *
+ * Costs are charged at the end of the profiler regions of profiler.h, which is
+ * why the simulation is built with PROFILER_ENABLED, and its profiler is the
+ * one in this file, with the region names of profilernames.cpp:
+ * - --i2c-us: adxl343_read, reading a sample over I2C
+ * - --features-us and --tree-us: get_features and every model_tree_N, the
+ *   inference of a window
+ * - --tcp-us: datarouter_write, a write to the TCP server
+ * - --cost REGION=US: any region, by its name in the profiler dump
+ * The defaults are rough figures for a Photon 2. The profiler table printed
+ * has the virtual time of every region, including the time it was preempted.
+ *
+ * The accelerometer reads the samples of a recording given, over and over, or
+ * 1 g on Z. The TCP server acknowledges every frame after --rtt-ms. The
+ * pipeline is saturated when samples are lost, sampling misses a deadline, or
+ * the predictor falls more than a window behind.
+ *
+ * --find-saturation bisects the tree cost between 0 and the cost at which the
+ * trees alone take a window period, to find the most expensive model the
+ * pipeline keeps up with. Every probe runs in a child process, as the state of
+ * the firmware modules can't be reset. A load that only just saturates takes
+ * long to lose a sample, so the point found is for a run of --seconds.
+ *
+ * --trace writes the timeline of a run as Chrome trace JSON, to open in
+ * ui.perfetto.dev or chrome://tracing: which thread runs, the profiler regions,
+ * the waits for semaphores, queues and mutexes, and every give, take and put,
+ * see tracer.h. The timeline keeps the last 65536 events, a few seconds of a
+ * run with --network, so trace short runs.
+ *
+ * The sample rate and sample stream size are compiled in. make sweep builds
+ * pipesim for every rate in PIPESIM_RATES of the Makefile, and finds the
+ * saturation of each. The pipeline mode is compiled in too: pipesim-eventloop
+ * runs eventLoop of eventloop.h instead of the three threads, without
+ * --network, as the event loop pipeline only predicts:
+ *
+ *     pipesim --tree-us 500 ../tcp_server/out/walk.00001.csv
+ *     pipesim --network --tcp-us 5000 --find-saturation
+ *     pipesim --network --seconds 3 --trace pipeline.json
+ *     make sweep PIPESIM_FLAGS=--network
+ *     pipesim-eventloop --tree-us 500 --find-saturation
+ *
+ * The exit code is 2 if a run is saturated, and 1 on an error.
+ */
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include <stdint.h>   // Standard integer types
+#include <stdio.h>    // printf
+#include <stdlib.h>   // strtoul
+#include <string.h>   // strcmp, strchr
+#include <sys/wait.h> // waitpid
+#include <unistd.h>   // fork, pipe
+
+#include <vector> // Samples of recordings
+
+#include "accelerometer.h" // Accelerometer data collection
+#include "datarouter.h"    // Data router to TCP server
+#include "eventloop.h"     // Single thread prediction pipeline
+#include "frame.h"         // Binary frames
+#include "metrics.h"       // Runtime health metrics
+#include "profiler.h"      // Profiled regions
+#include "recording.h"     // Recordings
+#include "samplestream.h"  // Broadcast of samples to several readers
+#include "stepcounter.h"   // Step counter
+#include "tracer.h"        // Timeline of the pipeline
+#include "virtualtime.h"   // Simulation of Device OS
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+// Trees of the model, and the period of a window
+#define PIPESIM_TREE_COUNT ( stepcounter::getTreeCount() )
+#define PIPESIM_WINDOW_US ( ( uint64_t )DATA_BUFFER_SIZE * 1000000 / ACCELEROMETER_SAMPLE_RATE_HZ )
+
+#if !PROFILER_ENABLED
+#error "Costs are charged in the profiler regions, so build with -DPROFILER_ENABLED=true"
+#endif
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+// Simulation parameters
+typedef struct pipesim_config_
+{
+    uint32_t seconds;                       // Virtual time to run
+    uint32_t costUs[PROFILER_REGION_COUNT]; // Cost charged at the end of every region
+    bool network;                           // Run the datarouter, sending the samples
+    uint32_t roundTripMs;                   // Time from a write to its acknowledgement
+    bool verbose;                           // Show the firmware log
+    const char* tracePath;                  // File to write the timeline to, or NULL
+} pipesim_config_t;
+
+// Results of a simulation
+typedef struct pipesim_result_
+{
+    metrics_snapshot_t metrics; // Health metrics at the end
+    uint32_t samples;           // Samples read from the accelerometer
+    uint32_t windows;           // Windows predicted
+    uint32_t windowsDue;        // Windows full, less the first that is skipped
+    uint32_t steps;             // Steps counted
+    uint64_t busyUs;            // Time the threads ran costs
+    uint32_t contextSwitches;   // Times a different thread was switched to
+    uint32_t framesReceived;    // Frames the server received
+} pipesim_result_t;
+
+/**************************************************************/
+/*                          Private                           */
+/**************************************************************/
+
+// Thread functions of the firmware, which their classes declare as friends
+void getMeasurement( void* owner );
+void bufferPiping( void* owner );
+void predictSteps( void* owner );
+void eventLoop( void* owner );
+void dataRouterFunc( void* owner );
+#if DATAROUTER_TRANSPORT == DATAROUTER_TRANSPORT_TCP
+void dataRouterUplinkFunc( void* owner );
+#endif
+
+// Pipeline, as TinyML-step-counter.cpp sets it up
+#if PIPELINE_MODE == PIPELINE_MODE_EVENT_LOOP
+static accelerometer accel( ( samplestream_t* )NULL );         // Accelerometer, sampled by the event loop
+static stepcounter stepCounter( ( samplestream_t* )NULL, NULL ); // Step counter, driven by the event loop
+static eventloop loop( &accel, &stepCounter );                   // Event loop
+#else
+static samplestream_t sampleStream;                    // Stream of samples to the readers
+static accelerometer accel( &sampleStream );           // Accelerometer
+static datarouter router( &sampleStream );             // Data router, started with --network
+static stepcounter stepCounter( &sampleStream, NULL ); // Step counter
+#endif
+
+static std::vector<acceleration_sample_t> recording; // Samples the accelerometer reads, 1 g on Z if empty
+static size_t recordingIndex = 0;                    // Next sample of recording
+static uint32_t samplesRead = 0;                     // Samples read from the accelerometer
+static uint32_t framesReceived = 0;                  // Frames the server received
+
+static uint32_t regionCostUs[PROFILER_REGION_COUNT];         // Cost charged at the end of every region
+static profiler_stats_t profilerTable[PROFILER_REGION_COUNT]; // Virtual time of every region
+
+/**************************************************************/
+// Source of the simulated accelerometer
+static void readSensor( int16_t* x, int16_t* y, int16_t* z )
+{
+    samplesRead++;
+    if ( recording.empty() )
+    {
+        *x = 0;
+        *y = 0;
+        *z = 256;
+        return;
+    }
+
+    const acceleration_sample_t* sample = &( recording[recordingIndex] );
+    recordingIndex = ( recordingIndex + 1 ) % recording.size();
+    *x = sample->acceleration[AXIS_X];
+    *y = sample->acceleration[AXIS_Y];
+    *z = sample->acceleration[AXIS_Z];
+}
+
+/**************************************************************/
+// Simulated TCP server, acknowledging every frame
+static size_t serve( const uint8_t* data, size_t length, uint8_t* reply, size_t size )
+{
+    frame_header_t header;
+    if ( ( size < FRAME_ACK_SIZE ) || ( frame_decodeHeader( data, length, &header ) <= 0 ) )
+    {
+        return 0;
+    }
+    framesReceived++;
+    frame_putAck( reply, header.sequence + 1 );
+    return FRAME_ACK_SIZE;
+}
+
+/**************************************************************/
+// First thread, setting up and starting the pipeline like setup and loop do
+static void setupThread( void* param )
+{
+    const pipesim_config_t* config = ( const pipesim_config_t* )param;
+
+    TRACER_REGISTER_THREAD( "setup" );
+    if ( config->tracePath != NULL )
+    {
+        tracer_start();
+    }
+
+#if PIPELINE_MODE == PIPELINE_MODE_EVENT_LOOP
+    if ( ( accel.init() != 0 ) || ( stepCounter.init() != 0 ) || ( loop.init() != 0 ) )
+    {
+        fprintf( stderr, "Failed to set up the pipeline\n" );
+        exit( 1 );
+    }
+
+    metrics_reset();
+    profiler_reset();
+    if ( loop.start() != 0 )
+    {
+        fprintf( stderr, "Failed to start the pipeline\n" );
+        exit( 1 );
+    }
+#else
+    samplestream_init( &sampleStream );
+    if ( ( accel.init() != 0 ) || ( config->network && ( router.init() != 0 ) ) || ( stepCounter.init() != 0 ) )
+    {
+        fprintf( stderr, "Failed to set up the pipeline\n" );
+        exit( 1 );
+    }
+
+    metrics_reset();
+    profiler_reset();
+    if ( ( accel.start() != 0 ) || ( config->network && ( router.start() != 0 ) ) || ( stepCounter.start() != 0 ) )
+    {
+        fprintf( stderr, "Failed to start the pipeline\n" );
+        exit( 1 );
+    }
+#endif
+}
+
+/**************************************************************/
+// Run the pipeline for the configured time
+static void simulate( const pipesim_config_t* config, pipesim_result_t* result )
+{
+    particle_setLogLevel( config->verbose ? LOG_LEVEL_INFO : LOG_LEVEL_WARN );
+    memcpy( regionCostUs, config->costUs, sizeof( regionCostUs ) );
+    virtualtime_setSensor( readSensor );
+    if ( config->network )
+    {
+        virtualtime_setServer( serve, config->roundTripMs );
+    }
+
+    virtualtime_run( setupThread, ( void* )config, ( uint64_t )config->seconds * 1000000 );
+
+    memset( result, 0x00, sizeof( *result ) );
+    metrics_get( &( result->metrics ) );
+    result->samples = samplesRead;
+    result->windows = profilerTable[PROFILER_REGION_GET_FEATURES].count;
+    result->windowsDue = ( samplesRead >= DATA_BUFFER_SIZE ) ? samplesRead / DATA_BUFFER_SIZE - 1 : 0;
+    result->steps = stepCounter.stepCount;
+    for ( size_t i = 0; i < virtualtime_threadCount(); i++ )
+    {
+        virtualtime_thread_t thread;
+        virtualtime_getThread( i, &thread );
+        result->busyUs += thread.busyUs;
+    }
+    result->contextSwitches = virtualtime_contextSwitches();
+    result->framesReceived = framesReceived;
+}
+
+/**************************************************************/
+// Check if the pipeline failed to keep up. The last window may still be being
+// predicted when the run ends
+static bool isSaturated( const pipesim_result_t* result )
+{
+    return ( result->metrics.samplesDropped > 0 ) || ( result->metrics.overloadEvents > 0 ) ||
+           ( result->metrics.deadlineMisses > 0 ) || ( result->windows + 1 < result->windowsDue );
+}
+
+/**************************************************************/
+// Run a simulation in a child process, so the next one starts from scratch
+static bool simulateChild( const pipesim_config_t* config, pipesim_result_t* result )
+{
+    int fds[2];
+    if ( pipe( fds ) != 0 )
+    {
+        return false;
+    }
+
+    fflush( stdout );
+    pid_t child = fork();
+    if ( child < 0 )
+    {
+        close( fds[0] );
+        close( fds[1] );
+        return false;
+    }
+    if ( child == 0 )
+    {
+        close( fds[0] );
+        simulate( config, result );
+        bool written = ( write( fds[1], result, sizeof( *result ) ) == ( ssize_t )sizeof( *result ) );
+        _exit( written ? 0 : 1 );
+    }
+
+    close( fds[1] );
+    bool received = ( read( fds[0], result, sizeof( *result ) ) == ( ssize_t )sizeof( *result ) );
+    close( fds[0] );
+    int status = 0;
+    waitpid( child, &status, 0 );
+
+    return received && WIFEXITED( status ) && ( WEXITSTATUS( status ) == 0 );
+}
+
+/**************************************************************/
+// Name of a thread, by its function
+static const char* threadName( os_thread_fn_t function )
+{
+    static const struct
+    {
+        os_thread_fn_t function;
+        const char* name;
+    } names[] = {
+        { setupThread, "setup" },
+        { getMeasurement, "accelerometer" },
+        { bufferPiping, "buffer" },
+        { predictSteps, "predictor" },
+        { eventLoop, "eventloop" },
+        { dataRouterFunc, "datarouter" },
+#if DATAROUTER_TRANSPORT == DATAROUTER_TRANSPORT_TCP
+        { dataRouterUplinkFunc, "uplink" },
+#endif
+    };
+    for ( const auto& entry : names )
+    {
+        if ( entry.function == function )
+        {
+            return entry.name;
+        }
+    }
+    return "other";
+}
+
+/**************************************************************/
+// Write a piece of the timeline to its file
+static void writeTrace( const char* text, size_t length, void* context )
+{
+    fwrite( text, 1, length, ( FILE* )context );
+}
+
+/**************************************************************/
+// Write the timeline of the run
+static bool saveTrace( const char* path )
+{
+    tracer_stop();
+    FILE* file = fopen( path, "w" );
+    if ( file == NULL )
+    {
+        return false;
+    }
+    uint32_t events = tracer_export( writeTrace, file );
+    bool written = ( fclose( file ) == 0 );
+
+    printf( "trace: %lu events written to %s", ( unsigned long )events, path );
+    if ( tracer_getOverwritten() > 0 )
+    {
+        printf( ", the first %lu were overwritten", ( unsigned long )tracer_getOverwritten() );
+    }
+    printf( "\n" );
+    return written;
+}
+
+/**************************************************************/
+// Print the results of a single run
+static void printResult( const pipesim_config_t* config, const pipesim_result_t* result )
+{
+    const double runUs = ( double )config->seconds * 1000000;
+    const metrics_snapshot_t* metrics = &( result->metrics );
+
+    printf( "%-20s %8s %8s %8s %8s\n", "region", "cost us", "count", "avg us", "max us" );
+    for ( uint8_t i = 0; i < PROFILER_REGION_COUNT; i++ )
+    {
+        const profiler_stats_t* stats = &( profilerTable[i] );
+        if ( stats->count == 0 )
+        {
+            continue;
+        }
+        printf( "%-20s %8lu %8lu %8lu %8lu\n",
+                profiler_getName( ( profiler_region_t )i ),
+                ( unsigned long )config->costUs[i],
+                ( unsigned long )stats->count,
+                ( unsigned long )( stats->total / stats->count ),
+                ( unsigned long )stats->max );
+    }
+    printf( "\n" );
+
+    printf( "%-20s %8s %8s %8s\n", "thread", "priority", "cpu %", "switches" );
+    for ( size_t i = 0; i < virtualtime_threadCount(); i++ )
+    {
+        virtualtime_thread_t thread;
+        virtualtime_getThread( i, &thread );
+        printf( "%-20s %8u %8.1f %8lu\n",
+                threadName( thread.function ),
+                thread.priority,
+                100.0 * thread.busyUs / runUs,
+                ( unsigned long )thread.activations );
+    }
+    printf( "\n" );
+
+    printf( "samples %lu, windows %lu of %lu predicted, %lu steps\n",
+            ( unsigned long )result->samples,
+            ( unsigned long )result->windows,
+            ( unsigned long )result->windowsDue,
+            ( unsigned long )result->steps );
+    printf( "dropped %lu, overload events %lu, deadline misses %lu, longest tick latency %lu us, stream high "
+            "water %lu\n",
+            ( unsigned long )metrics->samplesDropped,
+            ( unsigned long )metrics->overloadEvents,
+            ( unsigned long )metrics->deadlineMisses,
+            ( unsigned long )metrics->latencyMaxUs,
+            ( unsigned long )metrics->queueHighWater );
+    if ( config->network )
+    {
+        printf( "network: %lu writes, %lu bytes, %lu frames received, %lu connects, %lu frames dropped\n",
+                ( unsigned long )metrics->networkWrites,
+                ( unsigned long )metrics->networkBytes,
+                ( unsigned long )result->framesReceived,
+                ( unsigned long )metrics->reconnects,
+                ( unsigned long )metrics->framesDropped );
+    }
+    printf( "cpu %.1f %%, %lu context switches\n",
+            100.0 * result->busyUs / runUs,
+            ( unsigned long )result->contextSwitches );
+    printf( "pipeline %s\n", isSaturated( result ) ? "SATURATED" : "keeps up" );
+}
+
+/**************************************************************/
+// Run with a tree cost in a child process, and print it as a row of the search
+static bool probe( pipesim_config_t* config, uint32_t treeUs, bool* saturated )
+{
+    for ( uint8_t i = 0; i < PIPESIM_TREE_COUNT; i++ )
+    {
+        config->costUs[PROFILER_REGION_MODEL_TREE_0 + i] = treeUs;
+    }
+
+    pipesim_result_t result;
+    if ( !simulateChild( config, &result ) )
+    {
+        printf( "Simulation with tree cost %lu us failed\n", ( unsigned long )treeUs );
+        return false;
+    }
+
+    *saturated = isSaturated( &result );
+    printf( "%10lu %10lu %8.1f %8lu %8lu %8lu  %s\n",
+            ( unsigned long )treeUs,
+            ( unsigned long )( config->costUs[PROFILER_REGION_GET_FEATURES] + PIPESIM_TREE_COUNT * treeUs ),
+            100.0 * result.busyUs / ( ( double )config->seconds * 1000000 ),
+            ( unsigned long )result.windows,
+            ( unsigned long )result.metrics.samplesDropped,
+            ( unsigned long )result.metrics.deadlineMisses,
+            *saturated ? "saturated" : "keeps up" );
+    return true;
+}
+
+/**************************************************************/
+// Bisect the tree cost to find the highest the pipeline keeps up with
+static int findSaturation( pipesim_config_t* config, uint32_t resolutionUs )
+{
+    printf( "%10s %10s %8s %8s %8s %8s\n", "tree us", "window us", "cpu %", "windows", "dropped", "misses" );
+
+    bool saturated = false;
+    uint32_t low = 0;
+    uint32_t high = ( uint32_t )( PIPESIM_WINDOW_US / PIPESIM_TREE_COUNT ) + 1;
+    if ( !probe( config, low, &saturated ) )
+    {
+        return 1;
+    }
+    if ( saturated )
+    {
+        printf( "Saturated without inference, lower the other costs\n" );
+        return 0;
+    }
+    if ( !probe( config, high, &saturated ) )
+    {
+        return 1;
+    }
+    if ( !saturated )
+    {
+        printf( "Keeps up with the trees alone taking a window period, run for longer\n" );
+        return 0;
+    }
+
+    while ( high - low > resolutionUs )
+    {
+        uint32_t middle = low + ( high - low ) / 2;
+        if ( !probe( config, middle, &saturated ) )
+        {
+            return 1;
+        }
+        if ( saturated )
+        {
+            high = middle;
+        }
+        else
+        {
+            low = middle;
+        }
+    }
+
+    uint64_t inferenceUs = config->costUs[PROFILER_REGION_GET_FEATURES] + ( uint64_t )PIPESIM_TREE_COUNT * low;
+    printf( "Keeps up with trees of %lu us, %lu us of inference per window, %.1f %% of the window period\n",
+            ( unsigned long )low,
+            ( unsigned long )inferenceUs,
+            100.0 * inferenceUs / PIPESIM_WINDOW_US );
+    return 0;
+}
+
+/**************************************************************/
+// Parse REGION=US into a cost
+static bool parseCost( const char* text, pipesim_config_t* config )
+{
+    const char* equals = strchr( text, '=' );
+    if ( equals == NULL )
+    {
+        return false;
+    }
+    for ( uint8_t i = 0; i < PROFILER_REGION_COUNT; i++ )
+    {
+        const char* name = profiler_getName( ( profiler_region_t )i );
+        if ( ( strlen( name ) == ( size_t )( equals - text ) ) && ( strncmp( name, text, equals - text ) == 0 ) )
+        {
+            config->costUs[i] = strtoul( equals + 1, NULL, 10 );
+            return true;
+        }
+    }
+    return false;
+}
+
+/**************************************************************/
+// Print usage
+static void usage()
+{
+    printf( "Usage: pipesim [options] [recording...]\n"
+            "  --seconds N          Virtual time to run (default: 60)\n"
+            "  --i2c-us N           Cost of reading a sample (default: 250)\n"
+            "  --features-us N      Cost of the features of a window (default: 100)\n"
+            "  --tree-us N          Cost of every tree of the model (default: 20)\n"
+            "  --tcp-us N           Cost of a write to the TCP server (default: 1000)\n"
+            "  --cost REGION=US     Cost of any profiler region\n"
+            "  --network            Run the datarouter too\n"
+            "  --rtt-ms N           Round trip to the TCP server (default: 20)\n"
+            "  --find-saturation    Find the highest tree cost the pipeline keeps up with\n"
+            "  --resolution-us N    Resolution of the tree cost found (default: 10)\n"
+            "  --trace PATH         Write the timeline of the run as Chrome trace JSON\n"
+            "  --verbose            Show the firmware log\n" );
+}
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+// The profiler functions the firmware calls, charging the cost of the region.
+// Times are in virtual microseconds
+uint32_t profiler_now()
+{
+    return micros();
+}
+
+/**************************************************************/
+void profiler_record( profiler_region_t region, uint32_t cycles )
+{
+    uint32_t start = micros() - cycles;
+    virtualtime_consume( regionCostUs[region] );
+    uint32_t elapsed = micros() - start;
+
+    profiler_stats_t* stats = &( profilerTable[region] );
+    stats->count++;
+    stats->total += elapsed;
+    if ( elapsed < stats->min )
+    {
+        stats->min = elapsed;
+    }
+    if ( elapsed > stats->max )
+    {
+        stats->max = elapsed;
+    }
+}
+
+/**************************************************************/
+void profiler_reset()
+{
+    for ( uint8_t i = 0; i < PROFILER_REGION_COUNT; i++ )
+    {
+        profilerTable[i].count = 0;
+        profilerTable[i].total = 0;
+        profilerTable[i].min = UINT32_MAX;
+        profilerTable[i].max = 0;
+    }
+}
+
+/**************************************************************/
+int main( int argc, char** argv )
+{
+    pipesim_config_t config = {};
+    config.seconds = 60;
+    config.costUs[PROFILER_REGION_ADXL343_READ] = 250;
+    config.costUs[PROFILER_REGION_GET_FEATURES] = 100;
+    for ( uint8_t i = 0; i < PIPESIM_TREE_COUNT; i++ )
+    {
+        config.costUs[PROFILER_REGION_MODEL_TREE_0 + i] = 20;
+    }
+    config.costUs[PROFILER_REGION_DATAROUTER_WRITE] = 1000;
+    config.roundTripMs = 20;
+    bool findPoint = false;
+    uint32_t resolutionUs = 10;
+    std::vector<const char*> paths;
+
+    for ( int i = 1; i < argc; i++ )
+    {
+        const char* arg = argv[i];
+        const char* value = ( i + 1 < argc ) ? argv[i + 1] : NULL;
+
+        if ( strcmp( arg, "--help" ) == 0 )
+        {
+            usage();
+            return 0;
+        }
+        if ( strncmp( arg, "--", 2 ) != 0 )
+        {
+            paths.push_back( arg );
+            continue;
+        }
+        if ( strcmp( arg, "--network" ) == 0 )
+        {
+            config.network = true;
+            continue;
+        }
+        if ( strcmp( arg, "--find-saturation" ) == 0 )
+        {
+            findPoint = true;
+            continue;
+        }
+        if ( strcmp( arg, "--verbose" ) == 0 )
+        {
+            config.verbose = true;
+            continue;
+        }
+        if ( value == NULL )
+        {
+            usage();
+            return 1;
+        }
+
+        i++;
+        if ( strcmp( arg, "--seconds" ) == 0 )
+        {
+            config.seconds = strtoul( value, NULL, 10 );
+        }
+        else if ( strcmp( arg, "--i2c-us" ) == 0 )
+        {
+            config.costUs[PROFILER_REGION_ADXL343_READ] = strtoul( value, NULL, 10 );
+        }
+        else if ( strcmp( arg, "--features-us" ) == 0 )
+        {
+            config.costUs[PROFILER_REGION_GET_FEATURES] = strtoul( value, NULL, 10 );
+        }
+        else if ( strcmp( arg, "--tree-us" ) == 0 )
+        {
+            for ( uint8_t tree = 0; tree < PIPESIM_TREE_COUNT; tree++ )
+            {
+                config.costUs[PROFILER_REGION_MODEL_TREE_0 + tree] = strtoul( value, NULL, 10 );
+            }
+        }
+        else if ( strcmp( arg, "--tcp-us" ) == 0 )
+        {
+            config.costUs[PROFILER_REGION_DATAROUTER_WRITE] = strtoul( value, NULL, 10 );
+        }
+        else if ( strcmp( arg, "--cost" ) == 0 )
+        {
+            if ( !parseCost( value, &config ) )
+            {
+                printf( "Unknown cost %s\n", value );
+                return 1;
+            }
+        }
+        else if ( strcmp( arg, "--rtt-ms" ) == 0 )
+        {
+            config.roundTripMs = strtoul( value, NULL, 10 );
+        }
+        else if ( strcmp( arg, "--resolution-us" ) == 0 )
+        {
+            resolutionUs = strtoul( value, NULL, 10 );
+        }
+        else if ( strcmp( arg, "--trace" ) == 0 )
+        {
+            config.tracePath = value;
+        }
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    // The timeline is of a single run
+    if ( ( config.seconds == 0 ) || ( resolutionUs == 0 ) || ( findPoint && ( config.tracePath != NULL ) ) )
+    {
+        usage();
+        return 1;
+    }
+#if PIPELINE_MODE == PIPELINE_MODE_EVENT_LOOP
+    if ( config.network )
+    {
+        printf( "The event loop pipeline only predicts, so --network needs the threads pipeline\n" );
+        return 1;
+    }
+#endif
+
+    for ( const char* path : paths )
+    {
+        if ( !recording_read( path, 1, &recording ) )
+        {
+            printf( "Failed to read %s\n", path );
+            return 1;
+        }
+    }
+
+    printf( "pipesim: %s pipeline, %u Hz, windows of %u samples, sample stream of %u, %lu s%s\n",
+            ( PIPELINE_MODE == PIPELINE_MODE_EVENT_LOOP ) ? "event loop" : "threads",
+            ( unsigned )ACCELEROMETER_SAMPLE_RATE_HZ,
+            ( unsigned )DATA_BUFFER_SIZE,
+            ( unsigned )SAMPLESTREAM_SIZE,
+            ( unsigned long )config.seconds,
+            config.network ? ", with network" : "" );
+
+    if ( findPoint )
+    {
+        return findSaturation( &config, resolutionUs );
+    }
+
+    pipesim_result_t result;
+    simulate( &config, &result );
+    printResult( &config, &result );
+    if ( ( config.tracePath != NULL ) && !saveTrace( config.tracePath ) )
+    {
+        printf( "Failed to write %s\n", config.tracePath );
+        fflush( stdout );
+        _exit( 1 );
+    }
+
+    // The threads never return, so leave without destroying what they use
+    fflush( stdout );
+    _exit( isSaturated( &result ) ? 2 : 0 );
+}
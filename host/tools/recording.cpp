@@ -0,0 +1,98 @@
+/**
+ * @file recording.cpp
+ * @author Simon Udsen
+ * @date 2026-10-18
+ */
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include "recording.h" // Header file for this module
+
+#include <string.h> // strlen, strcmp, strrchr, strcspn
+
+#include "columnfile.h" // Columnar binary recordings
+#include "csvparse.h"   // Fast parser of CSV recordings
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+/**************************************************************/
+/*                          Private                           */
+/**************************************************************/
+
+/**************************************************************/
+// Check if a path has the column file extension
+static bool isColumnFile( const char* path )
+{
+    size_t length = strlen( path );
+    size_t extension = strlen( COLUMNFILE_EXTENSION );
+    return ( length >= extension ) && ( strcmp( path + length - extension, COLUMNFILE_EXTENSION ) == 0 );
+}
+
+/**************************************************************/
+// Read the samples of a column file
+static bool readColumnFile( const char* path, uint32_t timestampScale, std::vector<acceleration_sample_t>* samples )
+{
+    columnfile_t file;
+    if ( columnfile_open( &file, path ) != 0 )
+    {
+        return false;
+    }
+
+    size_t first = samples->size();
+    samples->resize( first + file.header->sampleCount );
+    columnfile_read( &file, 0, &( ( *samples )[first] ), file.header->sampleCount );
+    for ( size_t i = first; i < samples->size(); i++ )
+    {
+        ( *samples )[i].timestamp *= timestampScale;
+    }
+
+    columnfile_close( &file );
+    return true;
+}
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+bool recording_read( const char* path, uint32_t timestampScale, std::vector<acceleration_sample_t>* samples )
+{
+    if ( isColumnFile( path ) )
+    {
+        return readColumnFile( path, timestampScale, samples );
+    }
+
+    csvparse_columns_t columns = {};
+    if ( csvparse_file( path, &columns ) != 0 )
+    {
+        return false;
+    }
+
+    size_t first = samples->size();
+    samples->resize( first + columns.timestamp.size() );
+    for ( size_t i = 0; i < columns.timestamp.size(); i++ )
+    {
+        acceleration_sample_t* sample = &( ( *samples )[first + i] );
+        sample->timestamp = columns.timestamp[i] * timestampScale;
+        sample->acceleration[AXIS_X] = columns.acceleration[AXIS_X][i];
+        sample->acceleration[AXIS_Y] = columns.acceleration[AXIS_Y][i];
+        sample->acceleration[AXIS_Z] = columns.acceleration[AXIS_Z][i];
+        sample->step = ( columns.step[i] != 0 );
+    }
+    return true;
+}
+
+/**************************************************************/
+std::string recording_label( const char* path )
+{
+    const char* name = strrchr( path, '/' );
+    name = ( name != NULL ) ? name + 1 : path;
+    return std::string( name, strcspn( name, "." ) );
+}
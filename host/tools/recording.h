@@ -0,0 +1,59 @@
+/**
+ * @file recording.h
+ * @author Simon Udsen
+ * @date 2026-10-18
+ * @brief CSV recordings of the TCP server
+ * @details The TCP server writes every measurement to a CSV file with the
+ * header "timestamp,accX,accY,accZ,step", and one sample per line. They are
+ * parsed with csvparse.h, and lines that are not a sample, like the header,
+ * are skipped.
+ *
+ * Recordings converted to column files, see columnfile.h, are read from the
+ * mapped columns instead, so tools take either.
+ */
+#ifndef RECORDING_H
+#define RECORDING_H
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include <stdint.h> // Standard integer types
+
+#include <string> // Label of a recording
+#include <vector> // Samples of a recording
+
+#include "config.h" // Project configuration
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+/**
+ * Reads a CSV recording, or a column file if the path ends in
+ * COLUMNFILE_EXTENSION
+ * @param[in] path Path of recording
+ * @param[in] timestampScale Factor to multiply timestamps by
+ * @param[out] samples Samples of recording, appended to
+ * @returns True if the file could be read
+ */
+bool recording_read( const char* path, uint32_t timestampScale, std::vector<acceleration_sample_t>* samples );
+
+/**************************************************************/
+/**
+ * Gets the activity of a recording, the file name up to the first dot, like
+ * "walk" of "out/walk.00001.csv"
+ * @param[in] path Path of recording
+ * @returns Activity of recording
+ */
+std::string recording_label( const char* path );
+
+#endif // RECORDING_H
@@ -0,0 +1,557 @@
+/**
+ * @file schedsim.cpp
+ * @author Simon Udsen
+ * @date 2026-10-18
+ * @brief Host simulation of the pipeline thread schedule
+ * @details Simulates the four pipeline threads on a single core with the
+ * FreeRTOS scheduling rules used by Device OS: fixed priority preemption, and
+ * round robin with a 1 ms time slice between ready threads of equal priority.
+ * The sample timer ticks every sample period, and the threads behave like the
+ * firmware:
+ * - Sampling: takes one sample per timer tick and puts it in the data queue,
+ *   dropping it if the queue is full
+ * - Buffer piping: moves samples from the queue to the window buffer, and waits
+ *   for the predictor when the window is full
+ * - Inference: processes a full window
+ * - Network: optionally sends every sample, in place of buffer piping
+ * - Background: optional CPU-bound threads at default priority, standing in for
+ *   application loop, logging and cloud work
+ *
+ * With the event loop plan, the sampling thread also moves every sample to the
+ * window buffer, and runs one slice of the inference of the previous window
+ * per tick, like PIPELINE_MODE_EVENT_LOOP. Buffer piping and inference threads
+ * are not used.
+ *
+ * The sampling deadline is missed when a sample is taken after the next timer
+ * tick. Compare the default plan, where all threads have the same priority, to
+ * the real-time plan from config.h with a CPU-hog inference load that saturates
+ * the predictor:
+ *
+ *     schedsim --plan default --rate 500 --inference-us 600000 --background 2
+ *     schedsim --plan rt --rate 500 --inference-us 600000 --background 2
+ *
+ * Compare the context switches of the two pipeline modes:
+ *
+ *     schedsim --plan rt
+ *     schedsim --plan event
+ *
+ * The exit code is 2 if any deadline was missed.
+ */
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include <stdint.h> // Standard integer types
+#include <stdio.h>  // printf
+#include <stdlib.h> // strtoul
+#include <string.h> // strcmp
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+#define OS_TICK_US 1000        // FreeRTOS tick and time slice
+#define SEMAPHORE_MAX_COUNT 10 // Same as config.h
+#define PRIORITY_DEFAULT 2     // OS_THREAD_PRIORITY_DEFAULT
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+// Simulated threads
+typedef enum sim_thread_
+{
+    SIM_THREAD_SAMPLING,
+    SIM_THREAD_BUFFER,
+    SIM_THREAD_INFERENCE,
+    SIM_THREAD_NETWORK,
+    SIM_THREAD_BACKGROUND_0,
+    SIM_THREAD_BACKGROUND_1,
+    SIM_THREAD_COUNT
+} sim_thread_t;
+
+// Simulation parameters
+typedef struct sim_config_
+{
+    uint32_t sampleRateHz;              // Sample timer rate
+    uint32_t windowSize;                // Samples per window
+    uint32_t queueSize;                 // Capacity of data queue
+    uint32_t readUs;                    // Cost of reading the sensor and putting a sample in the queue
+    uint32_t pipeUs;                    // Cost of moving a sample to the window buffer
+    uint32_t inferenceUs;               // Cost of features and model for a window
+    uint32_t networkUs;                 // Cost of sending a sample
+    bool network;                       // Network thread consumes the queue instead of buffer piping
+    bool eventLoop;                     // Sampling thread also pipes samples and runs inference slices
+    uint32_t slices;                    // Inference slices per window in the event loop
+    uint32_t background;                // Number of CPU-bound background threads
+    uint32_t seconds;                   // Simulated time
+    uint8_t priority[SIM_THREAD_COUNT]; // Priority of every thread
+} sim_config_t;
+
+// State of a simulated thread
+typedef struct sim_task_
+{
+    const char* name;   // Name for printing
+    bool inJob;         // Thread is in the middle of a job
+    uint32_t remaining; // Time left of current job
+    uint64_t readySeq;  // Position in round robin order among equal priorities
+    uint64_t busyUs;    // Total time spent running
+} sim_task_t;
+
+// Results of a simulation
+typedef struct sim_result_
+{
+    uint32_t samples;         // Samples taken
+    uint32_t deadlineMisses;  // Samples taken after the next tick
+    uint32_t latencyMaxUs;    // Longest time from tick to sample
+    uint64_t latencySumUs;    // Sum of tick to sample times
+    uint32_t dropped;         // Samples dropped by a full queue
+    uint32_t queueHighWater;  // Maximum queue depth
+    uint32_t windows;         // Windows processed by the predictor
+    uint32_t sent;            // Samples sent by the network thread
+    uint32_t contextSwitches; // Number of times a different thread was scheduled
+} sim_result_t;
+
+/**************************************************************/
+/*                          Private                           */
+/**************************************************************/
+
+/**************************************************************/
+// Check if a thread can run
+static bool isReady( const sim_task_t* task,
+                     sim_thread_t thread,
+                     const sim_config_t* config,
+                     uint32_t samplerSemaphore,
+                     uint32_t queueDepth,
+                     bool waitingForPredictor,
+                     uint32_t readySemaphore )
+{
+    if ( task->inJob )
+    {
+        return true;
+    }
+
+    switch ( thread )
+    {
+    case SIM_THREAD_SAMPLING:
+        return samplerSemaphore > 0;
+    case SIM_THREAD_BUFFER:
+        return !config->network && !config->eventLoop && !waitingForPredictor && ( queueDepth > 0 );
+    case SIM_THREAD_INFERENCE:
+        return !config->network && !config->eventLoop && ( readySemaphore > 0 );
+    case SIM_THREAD_NETWORK:
+        return config->network && ( queueDepth > 0 );
+    case SIM_THREAD_BACKGROUND_0:
+    case SIM_THREAD_BACKGROUND_1:
+        return ( uint32_t )( thread - SIM_THREAD_BACKGROUND_0 ) < config->background;
+    default:
+        return false;
+    }
+}
+
+/**************************************************************/
+// Run the simulation
+static void simulate( const sim_config_t* config, sim_task_t* tasks, sim_result_t* result )
+{
+    const uint32_t period = 1000000 / config->sampleRateHz;
+    const uint64_t end = ( uint64_t )config->seconds * 1000000;
+
+    uint64_t now = 0;
+    uint64_t nextSampleTick = period;
+    uint64_t nextOsTick = OS_TICK_US;
+    uint64_t seq = 0;
+
+    uint32_t samplerSemaphore = 0;
+    uint32_t tickCount = 0;
+    uint32_t ticksServed = 0;
+    uint64_t tickTime = 0;
+    uint32_t queueDepth = 0;
+    uint32_t windowFill = 0;
+    bool waitingForPredictor = false;
+    uint32_t readySemaphore = 0;
+    uint32_t slicesLeft = 0;
+    bool sliceInJob = false;
+    bool wasReady[SIM_THREAD_COUNT] = { false };
+    int running = -1;
+
+    while ( now < end )
+    {
+        // Timer daemon gives the sample semaphore
+        if ( now >= nextSampleTick )
+        {
+            tickCount++;
+            tickTime = nextSampleTick;
+            if ( samplerSemaphore < SEMAPHORE_MAX_COUNT )
+            {
+                samplerSemaphore++;
+            }
+            nextSampleTick += period;
+        }
+
+        // Time slice expired, move running thread to the back of its priority
+        bool sliceExpired = false;
+        if ( now >= nextOsTick )
+        {
+            sliceExpired = true;
+            nextOsTick += OS_TICK_US;
+        }
+
+        // Threads that became ready go to the back of their priority
+        bool ready[SIM_THREAD_COUNT];
+        for ( int i = 0; i < SIM_THREAD_COUNT; i++ )
+        {
+            ready[i] = isReady( &tasks[i],
+                                ( sim_thread_t )i,
+                                config,
+                                samplerSemaphore,
+                                queueDepth,
+                                waitingForPredictor,
+                                readySemaphore );
+            if ( ready[i] && !wasReady[i] )
+            {
+                tasks[i].readySeq = ++seq;
+            }
+            wasReady[i] = ready[i];
+        }
+        if ( sliceExpired && ( running >= 0 ) && ready[running] )
+        {
+            tasks[running].readySeq = ++seq;
+        }
+
+        // Pick highest priority ready thread, first in round robin order
+        int next = -1;
+        for ( int i = 0; i < SIM_THREAD_COUNT; i++ )
+        {
+            if ( !ready[i] )
+            {
+                continue;
+            }
+            if ( ( next < 0 ) || ( config->priority[i] > config->priority[next] ) ||
+                 ( ( config->priority[i] == config->priority[next] ) && ( tasks[i].readySeq < tasks[next].readySeq ) ) )
+            {
+                next = i;
+            }
+        }
+
+        if ( ( next >= 0 ) && ( next != running ) )
+        {
+            result->contextSwitches++;
+        }
+        running = next;
+
+        // Start a new job if the thread is not in one
+        if ( ( running >= 0 ) && !tasks[running].inJob )
+        {
+            sim_task_t* task = &tasks[running];
+            task->inJob = true;
+
+            switch ( ( sim_thread_t )running )
+            {
+            case SIM_THREAD_SAMPLING:
+            {
+                samplerSemaphore--;
+                ticksServed++;
+                result->samples++;
+                if ( tickCount != ticksServed )
+                {
+                    result->deadlineMisses++;
+                }
+                else
+                {
+                    uint32_t latency = ( uint32_t )( now - tickTime );
+                    result->latencySumUs += latency;
+                    if ( latency > result->latencyMaxUs )
+                    {
+                        result->latencyMaxUs = latency;
+                    }
+                }
+                task->remaining = config->readUs;
+
+                // Event loop pipes the sample, and runs a slice of inference
+                if ( config->eventLoop )
+                {
+                    task->remaining += config->pipeUs;
+                    sliceInJob = ( slicesLeft > 0 );
+                    if ( sliceInJob )
+                    {
+                        task->remaining += config->inferenceUs / config->slices;
+                        slicesLeft--;
+                    }
+                }
+                break;
+            }
+            case SIM_THREAD_BUFFER:
+                queueDepth--;
+                task->remaining = config->pipeUs;
+                break;
+            case SIM_THREAD_INFERENCE:
+                readySemaphore--;
+                task->remaining = config->inferenceUs;
+                break;
+            case SIM_THREAD_NETWORK:
+                queueDepth--;
+                task->remaining = config->networkUs;
+                break;
+            case SIM_THREAD_BACKGROUND_0:
+            case SIM_THREAD_BACKGROUND_1:
+                task->remaining = OS_TICK_US;
+                break;
+            default:
+                break;
+            }
+        }
+
+        // Run until the next event
+        uint64_t step = ( nextSampleTick < nextOsTick ? nextSampleTick : nextOsTick ) - now;
+        if ( running >= 0 )
+        {
+            sim_task_t* task = &tasks[running];
+            if ( task->remaining < step )
+            {
+                step = task->remaining;
+            }
+            task->remaining -= ( uint32_t )step;
+            task->busyUs += step;
+
+            // Finish job
+            if ( task->remaining == 0 )
+            {
+                task->inJob = false;
+
+                switch ( ( sim_thread_t )running )
+                {
+                case SIM_THREAD_SAMPLING:
+                    if ( config->eventLoop )
+                    {
+                        if ( sliceInJob && ( slicesLeft == 0 ) )
+                        {
+                            result->windows++;
+                        }
+                        windowFill++;
+                        if ( windowFill == config->windowSize )
+                        {
+                            windowFill = 0;
+                            slicesLeft = config->slices;
+                        }
+                    }
+                    else if ( queueDepth < config->queueSize )
+                    {
+                        queueDepth++;
+                        if ( queueDepth > result->queueHighWater )
+                        {
+                            result->queueHighWater = queueDepth;
+                        }
+                    }
+                    else
+                    {
+                        result->dropped++;
+                    }
+                    break;
+                case SIM_THREAD_BUFFER:
+                    windowFill++;
+                    if ( windowFill == config->windowSize )
+                    {
+                        windowFill = 0;
+                        readySemaphore++;
+                        waitingForPredictor = true;
+                    }
+                    break;
+                case SIM_THREAD_INFERENCE:
+                    result->windows++;
+                    waitingForPredictor = false;
+                    break;
+                case SIM_THREAD_NETWORK:
+                    result->sent++;
+                    break;
+                default:
+                    break;
+                }
+            }
+        }
+
+        now += step;
+    }
+}
+
+/**************************************************************/
+// Print usage
+static void usage()
+{
+    printf( "Usage: schedsim [options]\n"
+            "  --plan default|rt|event  Thread priorities, or event loop pipeline (default: rt)\n"
+            "  --rate HZ                Sample rate, must divide 1000 (default: 100)\n"
+            "  --window N               Samples per window (default: 100)\n"
+            "  --queue N                Data queue capacity (default: window)\n"
+            "  --read-us US             Sensor read cost (default: 250)\n"
+            "  --pipe-us US             Buffer piping cost per sample (default: 10)\n"
+            "  --inference-us US        Inference cost per window (default: 400)\n"
+            "  --slices N               Inference slices per window with the event loop (default: 8)\n"
+            "  --network                Send samples over the network instead of predicting\n"
+            "  --network-us US          Network cost per sample (default: 300)\n"
+            "  --background N           CPU-bound threads at default priority, 0-2 (default: 0)\n"
+            "  --seconds S              Simulated time (default: 60)\n" );
+}
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+int main( int argc, char** argv )
+{
+    sim_config_t config = {};
+    config.sampleRateHz = 100;
+    config.windowSize = 100;
+    config.queueSize = 0;
+    config.readUs = 250;
+    config.pipeUs = 10;
+    config.inferenceUs = 400;
+    config.networkUs = 300;
+    config.network = false;
+    config.eventLoop = false;
+    config.slices = 8;
+    config.background = 0;
+    config.seconds = 60;
+    bool realtime = true;
+
+    for ( int i = 1; i < argc; i++ )
+    {
+        const char* arg = argv[i];
+        const char* value = ( i + 1 < argc ) ? argv[i + 1] : NULL;
+
+        if ( strcmp( arg, "--network" ) == 0 )
+        {
+            config.network = true;
+            continue;
+        }
+        if ( ( strcmp( arg, "--help" ) == 0 ) || ( value == NULL ) )
+        {
+            usage();
+            return ( strcmp( arg, "--help" ) == 0 ) ? 0 : 1;
+        }
+
+        i++;
+        if ( strcmp( arg, "--plan" ) == 0 )
+        {
+            realtime = ( strcmp( value, "default" ) != 0 );
+            config.eventLoop = ( strcmp( value, "event" ) == 0 );
+        }
+        else if ( strcmp( arg, "--rate" ) == 0 )
+        {
+            config.sampleRateHz = strtoul( value, NULL, 10 );
+        }
+        else if ( strcmp( arg, "--window" ) == 0 )
+        {
+            config.windowSize = strtoul( value, NULL, 10 );
+        }
+        else if ( strcmp( arg, "--queue" ) == 0 )
+        {
+            config.queueSize = strtoul( value, NULL, 10 );
+        }
+        else if ( strcmp( arg, "--read-us" ) == 0 )
+        {
+            config.readUs = strtoul( value, NULL, 10 );
+        }
+        else if ( strcmp( arg, "--pipe-us" ) == 0 )
+        {
+            config.pipeUs = strtoul( value, NULL, 10 );
+        }
+        else if ( strcmp( arg, "--inference-us" ) == 0 )
+        {
+            config.inferenceUs = strtoul( value, NULL, 10 );
+        }
+        else if ( strcmp( arg, "--slices" ) == 0 )
+        {
+            config.slices = strtoul( value, NULL, 10 );
+        }
+        else if ( strcmp( arg, "--network-us" ) == 0 )
+        {
+            config.networkUs = strtoul( value, NULL, 10 );
+        }
+        else if ( strcmp( arg, "--background" ) == 0 )
+        {
+            config.background = strtoul( value, NULL, 10 );
+        }
+        else if ( strcmp( arg, "--seconds" ) == 0 )
+        {
+            config.seconds = strtoul( value, NULL, 10 );
+        }
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    if ( ( config.sampleRateHz == 0 ) || ( ( 1000 % config.sampleRateHz ) != 0 ) || ( config.windowSize == 0 ) )
+    {
+        printf( "Sample rate must divide 1000, and window must not be empty\n" );
+        return 1;
+    }
+    if ( config.background > ( SIM_THREAD_COUNT - SIM_THREAD_BACKGROUND_0 ) )
+    {
+        printf( "At most %d background threads are supported\n", SIM_THREAD_COUNT - SIM_THREAD_BACKGROUND_0 );
+        return 1;
+    }
+    if ( config.eventLoop && ( config.network || ( config.slices == 0 ) || ( config.slices >= config.windowSize ) ) )
+    {
+        printf( "Event loop needs prediction, and between 1 and window - 1 slices\n" );
+        return 1;
+    }
+    if ( config.queueSize == 0 )
+    {
+        config.queueSize = config.windowSize;
+    }
+
+    // Same plans as config.h
+    for ( int i = 0; i < SIM_THREAD_COUNT; i++ )
+    {
+        config.priority[i] = PRIORITY_DEFAULT;
+    }
+    if ( realtime )
+    {
+        config.priority[SIM_THREAD_SAMPLING] = PRIORITY_DEFAULT + 3;
+        config.priority[SIM_THREAD_BUFFER] = PRIORITY_DEFAULT + 1;
+    }
+
+    sim_task_t tasks[SIM_THREAD_COUNT] = {
+        { "sampling", false, 0, 0, 0 },
+        { "buffer", false, 0, 0, 0 },
+        { "inference", false, 0, 0, 0 },
+        { "network", false, 0, 0, 0 },
+        { "background", false, 0, 0, 0 },
+        { "background", false, 0, 0, 0 },
+    };
+    sim_result_t result = {};
+
+    simulate( &config, tasks, &result );
+
+    const uint64_t totalUs = ( uint64_t )config.seconds * 1000000;
+    printf( "plan=%s rate=%luHz window=%lu queue=%lu inference=%luus\n",
+            config.eventLoop ? "event" : ( realtime ? "rt" : "default" ),
+            ( unsigned long )config.sampleRateHz,
+            ( unsigned long )config.windowSize,
+            ( unsigned long )config.queueSize,
+            ( unsigned long )config.inferenceUs );
+    printf( "samples=%lu deadline_misses=%lu latency_avg=%luus latency_max=%luus\n",
+            ( unsigned long )result.samples,
+            ( unsigned long )result.deadlineMisses,
+            ( unsigned long )( result.samples > result.deadlineMisses
+                                   ? result.latencySumUs / ( result.samples - result.deadlineMisses )
+                                   : 0 ),
+            ( unsigned long )result.latencyMaxUs );
+    printf( "dropped=%lu queue_high_water=%lu windows=%lu sent=%lu context_switches_per_s=%lu\n",
+            ( unsigned long )result.dropped,
+            ( unsigned long )result.queueHighWater,
+            ( unsigned long )result.windows,
+            ( unsigned long )result.sent,
+            ( unsigned long )( result.contextSwitches / config.seconds ) );
+    for ( int i = 0; i < SIM_THREAD_COUNT; i++ )
+    {
+        printf( "  %-10s prio=%u cpu=%5.1f%%\n",
+                tasks[i].name,
+                config.priority[i],
+                100.0 * ( double )tasks[i].busyUs / ( double )totalUs );
+    }
+
+    return ( result.deadlineMisses == 0 ) ? 0 : 2;
+}
@@ -0,0 +1,452 @@
+/**
+ * @file stepcheck.cpp
+ * @author Simon Udsen
+ * @date 2026-10-18
+ * @brief Accuracy and throughput regression check of the step counter
+ * @details Replays recordings through the firmware's prediction code, like
+ * stepcounter.cpp runs it: every DATA_BUFFER_SIZE samples make a window,
+ * statisticalfeatures_getFeatures calculates its features, and the trees of
+ * step_counter_model.h predict its steps, truncated to an integer. The device
+ * also skips its first window after a reset, which is left out here, so every
+ * whole window of a recording counts.
+ *
+ * Predictions are compared with the step column of the recordings, per
+ * activity, the file name up to the first dot, as the mean absolute error per
+ * window and the error of the total steps. Throughput is the windows per
+ * second of features and prediction alone, the fastest of --repeat passes
+ * over every window, with the recordings already in memory.
+ *
+ * The results are compared with a baseline, and any activity whose mean
+ * absolute error or total step error grew more than the tolerances fails the
+ * check. Throughput depends on the machine and its load, so it is only
+ * printed next to the one of the baseline, unless --speed-tolerance is given:
+ * then a throughput more than that many percent below the baseline fails the
+ * check too, which is only meaningful on the machine the baseline was written
+ * on. make check runs this on the recordings of STEPCHECK_CORPUS in the
+ * Makefile, a fixed list, so recordings the server adds to ../tcp_server/out
+ * don't change the check. A deliberate change of the model or features writes
+ * a new baseline with:
+ *
+ *     make check STEPCHECK_FLAGS=--update
+ *
+ * The exit code is 1 if a recording or the baseline could not be read, or the
+ * check failed.
+ */
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include <math.h>   // fabs
+#include <stdint.h> // Standard integer types
+#include <stdio.h>  // printf, fopen
+#include <stdlib.h> // strtoul, strtod
+#include <string.h> // strcmp
+
+#include <chrono> // Throughput
+#include <string> // Activities
+#include <vector> // Recordings and windows
+
+#include "recording.h"           // Recordings
+#include "statisticalfeatures.h" // Features of the firmware
+
+// The generated trees take the feature count, and don't use it
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#include "step_counter_model.h" // Model of the firmware
+#pragma GCC diagnostic pop
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+#define TOTAL_LABEL "total" // Label of the results of every activity together
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+// Results of the windows of an activity
+typedef struct activity_result_
+{
+    std::string label;    // Activity
+    size_t windows;       // Windows predicted
+    double absoluteError; // Sum of absolute errors of windows, in steps
+    uint64_t steps;       // Steps marked in the recordings
+    uint64_t predicted;   // Steps predicted
+} activity_result_t;
+
+// Results of a check
+typedef struct check_result_
+{
+    std::vector<activity_result_t> activities; // Activities, then TOTAL_LABEL
+    double windowsPerSecond;                   // Throughput of features and prediction
+} check_result_t;
+
+/**************************************************************/
+/*                          Private                           */
+/**************************************************************/
+
+/**************************************************************/
+// Predict the steps of a window, like stepcounter does
+static int32_t predictWindow( acceleration_sample_t* window )
+{
+    int16_t features[STATISTICALFEATURES_NUM_FEATURES] = { 0 };
+    statisticalfeatures_getFeatures<DATA_BUFFER_SIZE>( window, features );
+    return ( int32_t )step_counter_model_predict( features, STATISTICALFEATURES_NUM_FEATURES );
+}
+
+/**************************************************************/
+// Get the mean absolute error of an activity, in steps per window
+static double meanAbsoluteError( const activity_result_t* result )
+{
+    return ( result->windows > 0 ) ? result->absoluteError / result->windows : 0;
+}
+
+/**************************************************************/
+// Get the error of the total steps of an activity, in percent of its steps
+static double stepError( const activity_result_t* result )
+{
+    double error = ( double )result->predicted - ( double )result->steps;
+    return ( result->steps > 0 ) ? 100.0 * error / result->steps : 0;
+}
+
+/**************************************************************/
+// Format the total step error of an activity, "-" for an activity without steps
+static void formatStepError( const activity_result_t* result, char* text, size_t size )
+{
+    if ( result->steps > 0 )
+    {
+        snprintf( text, size, "%.2f", stepError( result ) );
+    }
+    else
+    {
+        snprintf( text, size, "-" );
+    }
+}
+
+/**************************************************************/
+// Find the results of an activity
+static const activity_result_t* findActivity( const check_result_t* results, const std::string& label )
+{
+    for ( const activity_result_t& result : results->activities )
+    {
+        if ( result.label == label )
+        {
+            return &result;
+        }
+    }
+    return NULL;
+}
+
+/**************************************************************/
+// Read a baseline written by writeBaseline
+static bool readBaseline( const char* path, check_result_t* baseline )
+{
+    FILE* file = fopen( path, "r" );
+    if ( file == NULL )
+    {
+        return false;
+    }
+
+    baseline->activities.clear();
+    baseline->windowsPerSecond = 0;
+    char line[256];
+    bool valid = true;
+    while ( valid && ( fgets( line, sizeof( line ), file ) != NULL ) )
+    {
+        char label[64];
+        unsigned long windows;
+        double absoluteError;
+        unsigned long long steps;
+        unsigned long long predicted;
+        double windowsPerSecond;
+        if ( ( line[0] == '#' ) || ( line[0] == '\n' ) )
+        {
+            continue;
+        }
+        if ( sscanf( line,
+                     "activity %63s windows %lu error %lf steps %llu predicted %llu",
+                     label,
+                     &windows,
+                     &absoluteError,
+                     &steps,
+                     &predicted ) == 5 )
+        {
+            baseline->activities.push_back( { label, windows, absoluteError, steps, predicted } );
+        }
+        else if ( sscanf( line, "throughput %lf", &windowsPerSecond ) == 1 )
+        {
+            baseline->windowsPerSecond = windowsPerSecond;
+        }
+        else
+        {
+            valid = false;
+        }
+    }
+    fclose( file );
+    return valid;
+}
+
+/**************************************************************/
+// Write results as a baseline
+static bool writeBaseline( const char* path, const check_result_t* results )
+{
+    FILE* file = fopen( path, "w" );
+    if ( file == NULL )
+    {
+        return false;
+    }
+
+    fprintf( file, "# Baseline of stepcheck, written with --update. Error is the sum of absolute\n" );
+    fprintf( file, "# errors of windows, throughput is in windows per second on the machine it ran,\n" );
+    fprintf( file, "# and only checked with --speed-tolerance\n" );
+    for ( const activity_result_t& result : results->activities )
+    {
+        fprintf( file,
+                 "activity %s windows %zu error %.1f steps %llu predicted %llu\n",
+                 result.label.c_str(),
+                 result.windows,
+                 result.absoluteError,
+                 ( unsigned long long )result.steps,
+                 ( unsigned long long )result.predicted );
+    }
+    fprintf( file, "throughput %.0f\n", results->windowsPerSecond );
+    return fclose( file ) == 0;
+}
+
+/**************************************************************/
+// Print usage
+static void usage()
+{
+    printf( "Usage: stepcheck [options] recording...\n"
+            "  --baseline PATH          Baseline to compare with (default: none)\n"
+            "  --update                 Write the results to the baseline instead\n"
+            "  --mae-tolerance N        Steps per window the mean absolute error may grow (default: 0.02)\n"
+            "  --step-tolerance N       Percentage points the total step error may grow (default: 1)\n"
+            "  --speed-tolerance N      Percent the throughput may drop (default: not checked)\n"
+            "  --repeat N               Passes to time, the fastest counts (default: 5)\n" );
+}
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+int main( int argc, char** argv )
+{
+    const char* baselinePath = NULL;
+    bool update = false;
+    double maeTolerance = 0.02;
+    double stepTolerance = 1;
+    double speedTolerance = -1;
+    uint32_t repeat = 5;
+    std::vector<const char*> paths;
+
+    for ( int i = 1; i < argc; i++ )
+    {
+        const char* arg = argv[i];
+        const char* value = ( i + 1 < argc ) ? argv[i + 1] : NULL;
+
+        if ( strcmp( arg, "--help" ) == 0 )
+        {
+            usage();
+            return 0;
+        }
+        if ( strcmp( arg, "--update" ) == 0 )
+        {
+            update = true;
+            continue;
+        }
+        if ( strncmp( arg, "--", 2 ) != 0 )
+        {
+            paths.push_back( arg );
+            continue;
+        }
+        if ( value == NULL )
+        {
+            usage();
+            return 1;
+        }
+
+        i++;
+        if ( strcmp( arg, "--baseline" ) == 0 )
+        {
+            baselinePath = value;
+        }
+        else if ( strcmp( arg, "--mae-tolerance" ) == 0 )
+        {
+            maeTolerance = strtod( value, NULL );
+        }
+        else if ( strcmp( arg, "--step-tolerance" ) == 0 )
+        {
+            stepTolerance = strtod( value, NULL );
+        }
+        else if ( strcmp( arg, "--speed-tolerance" ) == 0 )
+        {
+            speedTolerance = strtod( value, NULL );
+        }
+        else if ( strcmp( arg, "--repeat" ) == 0 )
+        {
+            repeat = strtoul( value, NULL, 10 );
+        }
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    if ( paths.empty() || ( repeat == 0 ) || ( update && ( baselinePath == NULL ) ) )
+    {
+        usage();
+        return 1;
+    }
+
+    // Every whole window of every recording, and the activity it belongs to
+    std::vector<std::vector<acceleration_sample_t>> recordings( paths.size() );
+    std::vector<acceleration_sample_t*> windows;
+    std::vector<size_t> windowActivity;
+    check_result_t results = {};
+    for ( size_t r = 0; r < paths.size(); r++ )
+    {
+        if ( !recording_read( paths[r], 1, &( recordings[r] ) ) )
+        {
+            printf( "Failed to read %s\n", paths[r] );
+            return 1;
+        }
+
+        std::string label = recording_label( paths[r] );
+        size_t activity = 0;
+        while ( ( activity < results.activities.size() ) && ( results.activities[activity].label != label ) )
+        {
+            activity++;
+        }
+        if ( activity == results.activities.size() )
+        {
+            results.activities.push_back( { label, 0, 0, 0, 0 } );
+        }
+
+        for ( size_t start = 0; start + DATA_BUFFER_SIZE <= recordings[r].size(); start += DATA_BUFFER_SIZE )
+        {
+            windows.push_back( &( recordings[r][start] ) );
+            windowActivity.push_back( activity );
+        }
+    }
+
+    // Accuracy
+    activity_result_t total = { TOTAL_LABEL, 0, 0, 0, 0 };
+    for ( size_t window = 0; window < windows.size(); window++ )
+    {
+        int32_t predicted = predictWindow( windows[window] );
+        uint32_t steps = 0;
+        for ( uint16_t i = 0; i < DATA_BUFFER_SIZE; i++ )
+        {
+            steps += windows[window][i].step ? 1 : 0;
+        }
+
+        activity_result_t* result = &( results.activities[windowActivity[window]] );
+        for ( activity_result_t* sum : { result, &total } )
+        {
+            sum->windows++;
+            sum->absoluteError += fabs( ( double )predicted - steps );
+            sum->steps += steps;
+            sum->predicted += predicted;
+        }
+    }
+    results.activities.push_back( total );
+
+    // Throughput, the fastest pass, so other load on the machine counts less
+    double bestSeconds = 0;
+    int64_t checksum = 0;
+    for ( uint32_t pass = 0; pass < repeat; pass++ )
+    {
+        auto begin = std::chrono::steady_clock::now();
+        for ( acceleration_sample_t* window : windows )
+        {
+            checksum += predictWindow( window );
+        }
+        double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - begin ).count();
+        bestSeconds = ( ( pass == 0 ) || ( seconds < bestSeconds ) ) ? seconds : bestSeconds;
+    }
+    results.windowsPerSecond = ( bestSeconds > 0 ) ? windows.size() / bestSeconds : 0;
+
+    if ( update )
+    {
+        if ( !writeBaseline( baselinePath, &results ) )
+        {
+            printf( "Failed to write %s\n", baselinePath );
+            return 1;
+        }
+    }
+
+    check_result_t baseline = {};
+    bool compare = ( baselinePath != NULL ) && !update;
+    if ( compare && !readBaseline( baselinePath, &baseline ) )
+    {
+        printf( "Failed to read %s\n", baselinePath );
+        return 1;
+    }
+
+    printf( "%-16s %7s %7s %7s %9s %8s", "activity", "windows", "mae", "steps", "predicted", "error %" );
+    if ( compare )
+    {
+        printf( " %9s %9s", "base mae", "base err" );
+    }
+    printf( "\n" );
+    bool passed = true;
+    for ( const activity_result_t& result : results.activities )
+    {
+        char error[16];
+        formatStepError( &result, error, sizeof( error ) );
+        printf( "%-16s %7zu %7.3f %7llu %9llu %8s",
+                result.label.c_str(),
+                result.windows,
+                meanAbsoluteError( &result ),
+                ( unsigned long long )result.steps,
+                ( unsigned long long )result.predicted,
+                error );
+
+        const activity_result_t* before = compare ? findActivity( &baseline, result.label ) : NULL;
+        if ( before == NULL )
+        {
+            printf( "%s\n", compare ? " new" : "" );
+            continue;
+        }
+
+        // Errors may shrink, or change sign, but not grow
+        bool maeRegressed = meanAbsoluteError( &result ) > meanAbsoluteError( before ) + maeTolerance;
+        bool stepRegressed = fabs( stepError( &result ) ) > fabs( stepError( before ) ) + stepTolerance;
+        formatStepError( before, error, sizeof( error ) );
+        printf( " %9.3f %9s%s\n",
+                meanAbsoluteError( before ),
+                error,
+                ( maeRegressed || stepRegressed ) ? "  REGRESSED" : "" );
+        passed = passed && !maeRegressed && !stepRegressed;
+    }
+
+    printf( "Throughput: %.0f windows/s, %.0f ns/window, best of %u passes (checksum %lld)\n",
+            results.windowsPerSecond,
+            ( results.windowsPerSecond > 0 ) ? 1e9 / results.windowsPerSecond : 0,
+            repeat,
+            ( long long )checksum );
+    if ( compare && ( baseline.windowsPerSecond > 0 ) )
+    {
+        double change = 100.0 * ( results.windowsPerSecond - baseline.windowsPerSecond ) / baseline.windowsPerSecond;
+        bool speedRegressed = ( speedTolerance >= 0 ) && ( change < -speedTolerance );
+        printf( "Baseline: %.0f windows/s, %.0f ns/window, %+.1f %%%s\n",
+                baseline.windowsPerSecond,
+                1e9 / baseline.windowsPerSecond,
+                change,
+                speedRegressed ? "  REGRESSED" : ( ( speedTolerance < 0 ) ? ", not checked" : "" ) );
+        passed = passed && !speedRegressed;
+    }
+
+    if ( update )
+    {
+        printf( "Wrote %s\n", baselinePath );
+    }
+    else if ( compare )
+    {
+        printf( "%s\n", passed ? "Check passed" : "Check failed" );
+    }
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,703 @@
+/**
+ * @file trainforest.cpp
+ * @author Simon Udsen
+ * @date 2026-10-18
+ * @brief Trainer of the step counter model
+ * @details Does what the training notebook does, natively: extracts the
+ * features of every window of recordings with the firmware's code, see
+ * featureset.h, holds out a test split stratified by activity, and searches a
+ * grid of trees, max depth and max features with k-fold cross validation,
+ * scored by r2. Every configuration is also trained on the whole training
+ * split, and its device cost estimated on every window, see forestcost.h:
+ * flash of the inline trees and of the node table, and cycles per window,
+ * which depend on how deep the windows go. The configurations on the Pareto
+ * front of accuracy against worst case cycles are listed, and the most
+ * accurate one within --budget-cycles and --budget-flash is scored on the test
+ * split and written as step_counter_model.h, see forest.h. Train a model for
+ * the firmware from every recording in ../tcp_server/out, which must run in
+ * 200 cycles per window:
+ *
+ *     trainforest --budget-cycles 200 --out ../src/step_counter_model.h ../tcp_server/out/walk.00001.csv ...
+ *
+ * The cycle costs are estimates, unless --profile gives the profiler
+ * statistics of the deployed model on a device, which calibrate them.
+ *
+ * Every tree of every configuration and fold is a task for a pool of threads,
+ * and trees are seeded by configuration, fold and index, so the model only
+ * depends on the data and --seed.
+ *
+ * The features default to the ones statisticalfeatures_getFeatures calculates,
+ * in its order. Other candidate features can be trained on with --features,
+ * but the firmware only calculates its own.
+ *
+ * The exit code is 1 if the recordings could not be read, no configuration
+ * fits the budget, or the model could not be written.
+ */
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include <math.h>   // fabs
+#include <stdint.h> // Standard integer types
+#include <stdio.h>  // printf
+#include <stdlib.h> // strtoul
+#include <string.h> // strcmp
+
+#include <algorithm>  // std::find, std::min, std::max_element
+#include <atomic>     // Next task
+#include <chrono>     // Training time
+#include <functional> // Tasks
+#include <random>     // Splits
+#include <string>     // Feature names
+#include <thread>     // Worker threads
+#include <vector>     // Rows and configurations
+
+#include "config.h"     // DATA_BUFFER_SIZE, WINDOW_MAX_SIZE
+#include "featureset.h" // Training features of recordings
+#include "forest.h"     // Random forest
+#include "forestcost.h" // Device cost of a forest
+#include "profiler.h"   // PROFILER_MODEL_TREE_MAX
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+// Configuration of the grid search
+typedef struct search_config_
+{
+    forest_params_t params;      // Hyperparameters
+    std::vector<forest_t> folds; // Forest trained without each fold, then on every training row
+    double r2;                   // Mean r2 of folds
+    forestcost_t cost;           // Device cost of the forest trained on every training row
+    bool pareto;                 // No other configuration is more accurate and at most as slow
+} search_config_t;
+
+/**************************************************************/
+/*                          Private                           */
+/**************************************************************/
+
+/**************************************************************/
+// Parse a comma separated list of numbers
+static bool parseList( const char* text, std::vector<uint32_t>* values )
+{
+    values->clear();
+    while ( *text != 0 )
+    {
+        char* end = NULL;
+        values->push_back( strtoul( text, &end, 10 ) );
+        if ( ( end == text ) || ( ( *end != ',' ) && ( *end != 0 ) ) || ( values->back() == 0 ) )
+        {
+            return false;
+        }
+        text = ( *end == ',' ) ? end + 1 : end;
+    }
+    return !values->empty();
+}
+
+/**************************************************************/
+// Parse a comma separated list of candidate feature names
+static bool parseFeatures( const char* text, std::vector<statisticalfeatures_candidate_t>* features )
+{
+    features->clear();
+    std::string list = text;
+    size_t start = 0;
+    while ( start <= list.size() )
+    {
+        size_t end = list.find( ',', start );
+        end = ( end == std::string::npos ) ? list.size() : end;
+        std::string name = list.substr( start, end - start );
+
+        uint8_t candidate = 0;
+        while ( ( candidate < STATISTICALFEATURES_CANDIDATES ) &&
+                ( name != statisticalfeatures_candidateName( ( statisticalfeatures_candidate_t )candidate ) ) )
+        {
+            candidate++;
+        }
+        if ( candidate == STATISTICALFEATURES_CANDIDATES )
+        {
+            printf( "Unknown feature %s\n", name.c_str() );
+            return false;
+        }
+        features->push_back( ( statisticalfeatures_candidate_t )candidate );
+        start = end + 1;
+    }
+    return features->size() <= FOREST_MAX_FEATURES;
+}
+
+/**************************************************************/
+// Run tasks on a pool of threads
+static void runParallel( size_t taskCount, uint32_t threads, const std::function<void( size_t )>& task )
+{
+    std::atomic<size_t> next( 0 );
+    auto worker = [&]()
+    {
+        for ( size_t i = next++; i < taskCount; i = next++ )
+        {
+            task( i );
+        }
+    };
+    std::vector<std::thread> workers;
+    for ( uint32_t i = 1; i < threads; i++ )
+    {
+        workers.emplace_back( worker );
+    }
+    worker();
+    for ( std::thread& thread : workers )
+    {
+        thread.join();
+    }
+}
+
+/**************************************************************/
+// Shuffle rows, the same way everywhere
+static void shuffle( std::vector<uint32_t>* rows, std::mt19937_64* random )
+{
+    for ( size_t i = rows->size(); i > 1; i-- )
+    {
+        std::swap( ( *rows )[i - 1], ( *rows )[( *random )() % i] );
+    }
+}
+
+/**************************************************************/
+// Calculate r2 of a forest on rows, like scikit-learn's r2_score
+static double score( const forest_t* forest,
+                     const std::vector<int16_t>& features,
+                     const std::vector<float>& targets,
+                     const std::vector<uint32_t>& rows )
+{
+    double mean = 0;
+    for ( uint32_t row : rows )
+    {
+        mean += targets[row];
+    }
+    mean /= rows.size();
+
+    double residual = 0;
+    double total = 0;
+    for ( uint32_t row : rows )
+    {
+        double error = targets[row] - forest_predict( forest, &( features[row * forest->featureCount] ) );
+        residual += error * error;
+        total += ( targets[row] - mean ) * ( targets[row] - mean );
+    }
+    return ( total > 0 ) ? 1 - residual / total : 0;
+}
+
+/**************************************************************/
+// Count the nodes of a forest
+static size_t countNodes( const forest_t* forest )
+{
+    size_t nodes = 0;
+    for ( const forest_tree_t& tree : forest->trees )
+    {
+        nodes += tree.nodes.size();
+    }
+    return nodes;
+}
+
+/**************************************************************/
+// Print a configuration with its cost
+static void printCost( const search_config_t* config )
+{
+    printf( "%5u %5u %5u %6.3f %5zu %6zu %6zu %5.2f %5u %7.0f %7.0f %7.0f %s\n",
+            config->params.trees,
+            config->params.maxDepth,
+            config->params.maxFeatures,
+            config->r2,
+            config->cost.splits + config->cost.leaves,
+            config->cost.inlineFlash,
+            config->cost.tableFlash,
+            config->cost.averageDepth,
+            config->cost.worstDepth,
+            config->cost.inlineCycles,
+            config->cost.inlineWorstCycles,
+            config->cost.tableWorstCycles,
+            config->pareto ? "*" : "" );
+}
+
+/**************************************************************/
+// Print usage
+static void usage()
+{
+    printf( "Usage: trainforest [options] recording...\n"
+            "  --out PATH               Model header (default: step_counter_model.h)\n"
+            "  --name NAME              Name of model (default: step_counter_model)\n"
+            "  --features A,B,...       Candidate features (default: the firmware's features)\n"
+            "  --window N               Samples per window, at most 65535 (default: DATA_BUFFER_SIZE)\n"
+            "  --hop N                  Samples between windows (default: half a window)\n"
+            "  --trees N,...            Trees to search (default: 3,5,7)\n"
+            "  --depth N,...            Max depths to search (default: 3,5,7)\n"
+            "  --max-features N,...     Features per split to search (default: 2,4,6)\n"
+            "  --folds N                Cross validation folds (default: 5)\n"
+            "  --test PERCENT           Windows held out for testing (default: 20)\n"
+            "  --seed N                 Seed of splits and trees (default: 1)\n"
+            "  --threads N              Threads to train with (default: one per core)\n"
+            "  --deployed PATH          Deployed model header (default: ../src/step_counter_model.h)\n"
+            "  --profile PATH           Device log with profiler statistics of the deployed trees\n"
+            "  --budget-cycles N        Most inline cycles of any window (default: no limit)\n"
+            "  --budget-flash N         Most bytes of inline trees (default: no limit)\n" );
+}
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+int main( int argc, char** argv )
+{
+    const char* outPath = "step_counter_model.h";
+    const char* name = "step_counter_model";
+    uint32_t windowSize = DATA_BUFFER_SIZE;
+    uint32_t hop = 0;
+    std::vector<uint32_t> treeCounts = { 3, 5, 7 };
+    std::vector<uint32_t> depths = { 3, 5, 7 };
+    std::vector<uint32_t> maxFeatures = { 2, 4, 6 };
+    uint32_t folds = 5;
+    uint32_t testPercent = 20;
+    uint64_t seed = 1;
+    uint32_t threads = std::thread::hardware_concurrency();
+    std::vector<statisticalfeatures_candidate_t> features;
+    std::vector<const char*> paths;
+    const char* deployedPath = "../src/step_counter_model.h";
+    const char* profilePath = NULL;
+    double budgetCycles = 0;
+    size_t budgetFlash = 0;
+
+    for ( uint8_t feature = 0; feature < STATISTICALFEATURES_NUM_FEATURES; feature++ )
+    {
+        features.push_back( statisticalfeatures_modelCandidate( feature ) );
+    }
+
+    for ( int i = 1; i < argc; i++ )
+    {
+        const char* arg = argv[i];
+        const char* value = ( i + 1 < argc ) ? argv[i + 1] : NULL;
+
+        if ( strcmp( arg, "--help" ) == 0 )
+        {
+            usage();
+            return 0;
+        }
+        if ( strncmp( arg, "--", 2 ) != 0 )
+        {
+            paths.push_back( arg );
+            continue;
+        }
+        if ( value == NULL )
+        {
+            usage();
+            return 1;
+        }
+
+        i++;
+        bool valid = true;
+        if ( strcmp( arg, "--out" ) == 0 )
+        {
+            outPath = value;
+        }
+        else if ( strcmp( arg, "--name" ) == 0 )
+        {
+            name = value;
+        }
+        else if ( strcmp( arg, "--features" ) == 0 )
+        {
+            valid = parseFeatures( value, &features );
+        }
+        else if ( strcmp( arg, "--window" ) == 0 )
+        {
+            windowSize = strtoul( value, NULL, 10 );
+        }
+        else if ( strcmp( arg, "--hop" ) == 0 )
+        {
+            hop = strtoul( value, NULL, 10 );
+        }
+        else if ( strcmp( arg, "--trees" ) == 0 )
+        {
+            valid = parseList( value, &treeCounts );
+        }
+        else if ( strcmp( arg, "--depth" ) == 0 )
+        {
+            valid = parseList( value, &depths );
+        }
+        else if ( strcmp( arg, "--max-features" ) == 0 )
+        {
+            valid = parseList( value, &maxFeatures );
+        }
+        else if ( strcmp( arg, "--folds" ) == 0 )
+        {
+            folds = strtoul( value, NULL, 10 );
+        }
+        else if ( strcmp( arg, "--test" ) == 0 )
+        {
+            testPercent = strtoul( value, NULL, 10 );
+        }
+        else if ( strcmp( arg, "--seed" ) == 0 )
+        {
+            seed = strtoull( value, NULL, 10 );
+        }
+        else if ( strcmp( arg, "--threads" ) == 0 )
+        {
+            threads = strtoul( value, NULL, 10 );
+        }
+        else if ( strcmp( arg, "--deployed" ) == 0 )
+        {
+            deployedPath = value;
+        }
+        else if ( strcmp( arg, "--profile" ) == 0 )
+        {
+            profilePath = value;
+        }
+        else if ( strcmp( arg, "--budget-cycles" ) == 0 )
+        {
+            budgetCycles = strtoul( value, NULL, 10 );
+        }
+        else if ( strcmp( arg, "--budget-flash" ) == 0 )
+        {
+            budgetFlash = strtoul( value, NULL, 10 );
+        }
+        else
+        {
+            valid = false;
+        }
+        if ( !valid )
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    hop = ( hop == 0 ) ? windowSize / 2 : hop;
+    threads = ( threads == 0 ) ? 1 : threads;
+    if ( paths.empty() || ( windowSize < WINDOW_MIN_SIZE ) || ( windowSize > WINDOW_MAX_SIZE ) || ( hop == 0 ) ||
+         ( hop > UINT16_MAX ) || ( folds < 2 ) || ( testPercent >= 100 ) )
+    {
+        usage();
+        return 1;
+    }
+    if ( *std::max_element( treeCounts.begin(), treeCounts.end() ) > PROFILER_MODEL_TREE_MAX )
+    {
+        printf( "The firmware profiles at most %u trees, see profiler.h\n", PROFILER_MODEL_TREE_MAX );
+        return 1;
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    featureset_t set;
+    if ( featureset_extract( paths, ( uint16_t )windowSize, ( uint16_t )hop, threads, &set ) != 0 )
+    {
+        printf( "Failed to extract features\n" );
+        return 1;
+    }
+
+    // Rows of the chosen features, which must fit the int16_t thresholds of the
+    // firmware
+    uint8_t featureCount = ( uint8_t )features.size();
+    size_t windows = featureset_windows( &set );
+    std::vector<int16_t> rows( windows * featureCount );
+    std::vector<float> targets( windows );
+    for ( size_t window = 0; window < windows; window++ )
+    {
+        for ( uint8_t feature = 0; feature < featureCount; feature++ )
+        {
+            int64_t value = featureset_get( &set, window, features[feature] );
+            if ( ( value < INT16_MIN ) || ( value > INT16_MAX ) )
+            {
+                printf( "Feature %s does not fit int16_t\n", statisticalfeatures_candidateName( features[feature] ) );
+                return 1;
+            }
+            rows[window * featureCount + feature] = ( int16_t )value;
+        }
+        targets[window] = set.steps[window];
+    }
+
+    // Hold out the same share of every activity for testing
+    std::mt19937_64 random( seed );
+    std::vector<uint32_t> trainRows;
+    std::vector<uint32_t> testRows;
+    std::vector<std::string> activities;
+    for ( const std::string& label : set.labels )
+    {
+        if ( std::find( activities.begin(), activities.end(), label ) == activities.end() )
+        {
+            activities.push_back( label );
+        }
+    }
+    for ( const std::string& activity : activities )
+    {
+        std::vector<uint32_t> activityRows;
+        for ( size_t window = 0; window < windows; window++ )
+        {
+            if ( set.labels[set.recording[window]] == activity )
+            {
+                activityRows.push_back( ( uint32_t )window );
+            }
+        }
+        shuffle( &activityRows, &random );
+        size_t testCount = ( activityRows.size() * testPercent + 50 ) / 100;
+        testRows.insert( testRows.end(), activityRows.begin(), activityRows.begin() + testCount );
+        trainRows.insert( trainRows.end(), activityRows.begin() + testCount, activityRows.end() );
+    }
+    shuffle( &trainRows, &random );
+    if ( trainRows.size() < folds )
+    {
+        printf( "Too few windows to train on\n" );
+        return 1;
+    }
+
+    // Bins come from the training rows only
+    std::vector<int16_t> trainFeatures( trainRows.size() * featureCount );
+    std::vector<float> trainTargets( trainRows.size() );
+    for ( size_t i = 0; i < trainRows.size(); i++ )
+    {
+        memcpy( &( trainFeatures[i * featureCount] ),
+                &( rows[trainRows[i] * featureCount] ),
+                featureCount * sizeof( int16_t ) );
+        trainTargets[i] = targets[trainRows[i]];
+    }
+    forest_bins_t bins;
+    forest_bin( trainFeatures.data(), trainRows.size(), featureCount, &bins );
+
+    // Training rows of every fold, and the rows it is validated on
+    std::vector<std::vector<uint32_t>> foldTrain( folds );
+    std::vector<std::vector<uint32_t>> foldValidate( folds );
+    for ( uint32_t row = 0; row < trainRows.size(); row++ )
+    {
+        for ( uint32_t fold = 0; fold < folds; fold++ )
+        {
+            ( ( row % folds == fold ) ? foldValidate : foldTrain )[fold].push_back( row );
+        }
+    }
+
+    std::vector<uint32_t> allTrain( trainRows.size() );
+    for ( uint32_t row = 0; row < trainRows.size(); row++ )
+    {
+        allTrain[row] = row;
+    }
+
+    // The deployed model is only comparable on the features it was trained on
+    forest_t deployed;
+    if ( ( forest_readHeader( &deployed, deployedPath ) != 0 ) || ( deployed.featureCount != featureCount ) )
+    {
+        deployed.trees.clear();
+    }
+    forestcost_model_t costModel;
+    forestcost_defaultModel( &costModel );
+    if ( profilePath != NULL )
+    {
+        if ( deployed.trees.empty() ||
+             ( forestcost_calibrate( profilePath, &deployed, rows.data(), windows, &costModel ) != 0 ) )
+        {
+            printf( "Failed to calibrate with %s and %s\n", profilePath, deployedPath );
+            return 1;
+        }
+    }
+
+    // Every configuration gets a forest per fold, and one trained on every
+    // training row, the one it would be deployed as
+    std::vector<search_config_t> configs;
+    for ( uint32_t trees : treeCounts )
+    {
+        for ( uint32_t depth : depths )
+        {
+            for ( uint32_t maxFeature : maxFeatures )
+            {
+                search_config_t config = {};
+                config.params.trees = ( uint16_t )trees;
+                config.params.maxDepth = ( uint8_t )std::min( depth, ( uint32_t )UINT8_MAX );
+                config.params.maxFeatures = ( uint8_t )std::min( maxFeature, ( uint32_t )featureCount );
+                config.params.seed = seed + configs.size();
+                config.folds.resize( folds + 1 );
+                for ( forest_t& forest : config.folds )
+                {
+                    forest.featureCount = featureCount;
+                    forest.trees.resize( trees );
+                }
+                configs.push_back( config );
+            }
+        }
+    }
+
+    // Every tree of every configuration and fold is a task
+    std::vector<uint32_t> taskConfig;
+    std::vector<uint32_t> taskFold;
+    std::vector<uint16_t> taskTree;
+    for ( uint32_t c = 0; c < configs.size(); c++ )
+    {
+        for ( uint32_t fold = 0; fold <= folds; fold++ )
+        {
+            for ( uint16_t tree = 0; tree < configs[c].params.trees; tree++ )
+            {
+                taskConfig.push_back( c );
+                taskFold.push_back( fold );
+                taskTree.push_back( tree );
+            }
+        }
+    }
+    auto searchBegin = std::chrono::steady_clock::now();
+    runParallel( taskConfig.size(),
+                 threads,
+                 [&]( size_t task )
+                 {
+                     search_config_t* config = &( configs[taskConfig[task]] );
+                     uint32_t fold = taskFold[task];
+                     forest_params_t params = config->params;
+                     params.seed += ( uint64_t )fold << 48;
+                     forest_trainTree( &bins,
+                                       trainTargets.data(),
+                                       ( fold < folds ) ? foldTrain[fold] : allTrain,
+                                       &params,
+                                       taskTree[task],
+                                       &( config->folds[fold].trees[taskTree[task]] ) );
+                 } );
+    double searchSeconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - searchBegin ).count();
+
+    // Score every configuration, and estimate its cost on every window
+    for ( search_config_t& config : configs )
+    {
+        config.r2 = 0;
+        for ( uint32_t fold = 0; fold < folds; fold++ )
+        {
+            config.r2 += score( &( config.folds[fold] ), trainFeatures, trainTargets, foldValidate[fold] ) / folds;
+        }
+        forestcost_measure( &( config.folds[folds] ), rows.data(), windows, &costModel, &( config.cost ) );
+    }
+
+    // A configuration is on the Pareto front if no other is as accurate and
+    // cheaper, or more accurate and as cheap
+    for ( search_config_t& config : configs )
+    {
+        config.pareto = true;
+        for ( const search_config_t& other : configs )
+        {
+            double cycles = config.cost.inlineWorstCycles;
+            bool asGood = ( other.r2 >= config.r2 ) && ( other.cost.inlineWorstCycles <= cycles );
+            bool better = ( other.r2 > config.r2 ) || ( other.cost.inlineWorstCycles < cycles );
+            config.pareto = config.pareto && !( asGood && better );
+        }
+    }
+
+    printf( "%zu windows, %zu for training, %zu for testing, %u features\n",
+            windows,
+            trainRows.size(),
+            testRows.size(),
+            featureCount );
+    printf( "Cycle costs%s: inline %.1f per tree + %.1f per split, table %.1f per tree + %.1f per split\n",
+            ( profilePath != NULL ) ? " calibrated from the profile" : "",
+            costModel.inlineCallCycles,
+            costModel.inlineSplitCycles,
+            costModel.tableCallCycles,
+            costModel.tableNodeCycles );
+    printf( "%5s %5s %5s %6s %5s %6s %6s %5s %5s %7s %7s %7s %6s\n",
+            "trees",
+            "depth",
+            "maxf",
+            "cv r2",
+            "nodes",
+            "inline",
+            "table",
+            "avg",
+            "worst",
+            "inline",
+            "inline",
+            "table",
+            "pareto" );
+    printf( "%5s %5s %5s %6s %5s %6s %6s %5s %5s %7s %7s %7s\n",
+            "",
+            "",
+            "",
+            "",
+            "",
+            "flash",
+            "flash",
+            "depth",
+            "depth",
+            "cycles",
+            "worst",
+            "worst" );
+    const search_config_t* best = NULL;
+    for ( const search_config_t& config : configs )
+    {
+        printCost( &config );
+
+        bool fits = ( ( budgetCycles == 0 ) || ( config.cost.inlineWorstCycles <= budgetCycles ) ) &&
+                    ( ( budgetFlash == 0 ) || ( config.cost.inlineFlash <= budgetFlash ) );
+        best = ( fits && ( ( best == NULL ) || ( config.r2 > best->r2 ) ) ) ? &config : best;
+    }
+    printf( "Searched %zu configurations x %u folds and a final forest each, %zu trees, in %.2f s with %lu threads\n",
+            configs.size(),
+            folds,
+            taskConfig.size(),
+            searchSeconds,
+            ( unsigned long )threads );
+
+    // Pareto front from cheapest to most accurate
+    std::vector<const search_config_t*> front;
+    for ( const search_config_t& config : configs )
+    {
+        if ( config.pareto )
+        {
+            front.push_back( &config );
+        }
+    }
+    std::sort( front.begin(),
+               front.end(),
+               []( const search_config_t* a, const search_config_t* b )
+               { return a->cost.inlineWorstCycles < b->cost.inlineWorstCycles; } );
+    printf( "Pareto front of cv r2 against worst case inline cycles per window:\n" );
+    for ( const search_config_t* config : front )
+    {
+        printCost( config );
+    }
+
+    if ( deployed.trees.size() > 0 )
+    {
+        forestcost_t cost;
+        forestcost_measure( &deployed, rows.data(), windows, &costModel, &cost );
+        printf( "Deployed %s: %zu trees, %zu nodes, %zu bytes inline, %.0f cycles per window, %.0f worst\n",
+                deployedPath,
+                deployed.trees.size(),
+                countNodes( &deployed ),
+                cost.inlineFlash,
+                cost.inlineCycles,
+                cost.inlineWorstCycles );
+    }
+
+    if ( best == NULL )
+    {
+        printf( "No configuration fits the budget\n" );
+        return 1;
+    }
+
+    const forest_t& forest = best->folds[folds];
+    double absoluteError = 0;
+    for ( uint32_t row : testRows )
+    {
+        absoluteError += fabs( targets[row] - forest_predictFirmware( &forest, &( rows[row * featureCount] ) ) );
+    }
+    printf( "Best%s: %u trees, depth %u, %u max features, cv r2 %.3f, %.0f worst case cycles, %zu bytes\n",
+            ( ( budgetCycles > 0 ) || ( budgetFlash > 0 ) ) ? " in budget" : "",
+            best->params.trees,
+            best->params.maxDepth,
+            best->params.maxFeatures,
+            best->r2,
+            best->cost.inlineWorstCycles,
+            best->cost.inlineFlash );
+    printf( "Test: r2 %.3f, firmware mean absolute error %.3f steps/window, %zu nodes\n",
+            score( &forest, rows, targets, testRows ),
+            testRows.empty() ? 0 : absoluteError / testRows.size(),
+            countNodes( &forest ) );
+
+    if ( forest_writeHeader( &forest, name, outPath ) != 0 )
+    {
+        printf( "Failed to write %s\n", outPath );
+        return 1;
+    }
+    printf( "Wrote %s in %.2f s\n",
+            outPath,
+            std::chrono::duration<double>( std::chrono::steady_clock::now() - begin ).count() );
+
+    return 0;
+}
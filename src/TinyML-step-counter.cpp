@@ -4,11 +4,16 @@
  * @date 2025-03-26
  * @brief Main file for the TinyML step counter project
  * @details This project implements ************ by machine learning. The system
- * uses 3 threads, one for writing accelerometer data to a queue, one for
- * putting this data into 2 overlapping buffers, and a third for running the
- * machine learning algorithm. If PREDICTION_ENABLED is false and
- * DATA_COLLECTION_ENABLED is true, the second of these threads will write the
- * data to a TCP server, and the third thread is never enabled
+ * uses 3 threads, one for writing accelerometer data to a sample stream, one
+ * for putting this data into 2 overlapping buffers, and a third for running the
+ * machine learning algorithm. If DATA_COLLECTION_ENABLED is true, the
+ * datarouter reads the same samples from the stream, and writes them to a TCP
+ * server, while the step counter predicts, see samplestream.h. With
+ * PIPELINE_MODE_EVENT_LOOP, a single thread samples and predicts instead, see
+ * eventloop.h. With RESULT_STREAMING_ENABLED, the step counter puts the result
+ * of every window in a second queue, and the datarouter sends those to the
+ * server instead of samples. The pipeline objects are placed in a static arena
+ * during setup, and nothing is allocated after it, see arena.h
  */
 
 /**************************************************************/
@@ -26,9 +31,16 @@ SerialLogHandler logHandler( LOG_LEVEL_INFO );
 
 #include "accelerometer.h" // Accelerometer data collection
 #include "adxl343.h"       // ADXL343 accelerometer sensor
+#include "arena.h"         // Static arena for the pipeline objects
 #include "config.h"        // Project configuration
+#include "metrics.h"       // Runtime health metrics
+#include "profiler.h"      // Cycle counter profiling
+#include "samplestream.h"  // Broadcast of samples to several readers
+#include "tracer.h"        // Timeline of the pipeline
 
-#if DATA_COLLECTION_ENABLED
+#include <stdio.h> // snprintf
+
+#if DATAROUTER_ENABLED
 #include "datarouter.h" // Data router to TCP server
 #endif
 
@@ -36,9 +48,18 @@ SerialLogHandler logHandler( LOG_LEVEL_INFO );
 #include "stepcounter.h" // Step counter
 #endif
 
+#if PIPELINE_MODE == PIPELINE_MODE_EVENT_LOOP
+#include "eventloop.h" // Single thread prediction pipeline
+#endif
+
 /**************************************************************/
 /*                     Defines and macros                     */
 /**************************************************************/
+#if RESULT_STREAMING_ENABLED
+#define STEPCOUNTER_RESULT_QUEUE ( &resultQueue ) // Queue for the step counter to put window results in
+#else
+#define STEPCOUNTER_RESULT_QUEUE ( ( os_queue_t* )NULL ) // Window results are not streamed
+#endif
 
 /**************************************************************/
 /*                     Typedefs and enums                     */
@@ -62,25 +83,92 @@ static MEASURING_STATE_T measuringState = MEASURING_STATE_IDLE;
 // Semaphore for waking up state machine from idle
 static os_semaphore_t stateUpdateSemaphore;
 
-// Queue for tunneling data between modules
-static os_queue_t dataQueue;
+#if RESULT_STREAMING_ENABLED
+// Queue for tunneling window results from the step counter to the data router
+static os_queue_t resultQueue;
+
+// Data router object, sending window results
+static datarouter* router = NULL;
+#endif
+
+#if PIPELINE_MODE == PIPELINE_MODE_EVENT_LOOP
+// Accelerometer object, sampled by the event loop
+static accelerometer* accel = NULL;
+
+// Step counter object, driven by the event loop
+static stepcounter* stepCounter = NULL;
+
+// Event loop object
+static eventloop* eventLoopPipeline = NULL;
+#else
+// Stream of samples from the accelerometer to the data router and step counter
+static samplestream_t* sampleStream = NULL;
 
 // Accelerometer object
-static accelerometer accel( &dataQueue );
+static accelerometer* accel = NULL;
 
 #if DATA_COLLECTION_ENABLED
 // Data router object
-static datarouter router( &dataQueue );
+static datarouter* router = NULL;
 #endif
 
 #if PREDICTION_ENABLED
 // Step counter object
-static stepcounter stepCounter( &dataQueue );
+static stepcounter* stepCounter = NULL;
+#endif
 #endif
 
 // Button handler predefine
 static void buttonHandler( system_event_t event, int data );
 
+/**************************************************************/
+// Publish health metrics as compact JSON to the log, and to the cloud if connected
+static void publishMetrics()
+{
+    char json[448]; // Fits every metric at its maximum value
+    if ( metrics_toJson( json, sizeof( json ) ) < 0 )
+    {
+        Log.error( "Metrics: buffer too small" );
+        return;
+    }
+
+    Log.info( "Metrics: %s", json );
+
+    // Catch objects writing past the arena, and allocations after setup
+    arena_check();
+
+#if PARTICLE_CONNECTION
+    if ( Particle.connected() )
+    {
+        Particle.publish( "metrics", json );
+    }
+#endif
+}
+
+#if TRACER_ENABLED
+/**************************************************************/
+// Write a piece of the trace JSON over USB serial
+static void writeTrace( const char* text, size_t length, void* context )
+{
+    ( void )context;
+    Serial.write( ( const uint8_t* )text, length );
+}
+#endif
+
+#if PROFILER_ENABLED && PARTICLE_CONNECTION
+/**************************************************************/
+// Cloud function to dump the profiler table on demand
+static int profilerDumpHandler( String command )
+{
+    profiler_dump();
+    if ( command == "reset" )
+    {
+        profiler_reset();
+    }
+    return 0;
+}
+#endif
+
 /**************************************************************/
 /*                           Public                           */
 /**************************************************************/
@@ -96,6 +184,14 @@ void setup()
 
     int status = 0;
 
+#if PROFILER_ENABLED
+    // Enable cycle counter before anything is profiled
+    profiler_init();
+#if PARTICLE_CONNECTION
+    Particle.function( "profilerDump", profilerDumpHandler );
+#endif
+#endif
+
 #if PARTICLE_CONNECTION
     // Connect to particle cloud
     Particle.connect();
@@ -133,20 +229,62 @@ void setup()
         Log.error( "Failed to initialize state update semaphore" );
         System.reset();
     }
+    TRACER_REGISTER_THREAD( "application" );
+    TRACER_REGISTER( stateUpdateSemaphore, "application_state" );
+
+    // Place the pipeline objects in the arena, see arena.h. A failed
+    // allocation has already been logged
+#if PIPELINE_MODE == PIPELINE_MODE_EVENT_LOOP
+    accel = arena_new<accelerometer>( ARENA_MODULE_ACCELEROMETER, ( samplestream_t* )NULL );
+    stepCounter =
+        arena_new<stepcounter>( ARENA_MODULE_STEPCOUNTER, ( samplestream_t* )NULL, STEPCOUNTER_RESULT_QUEUE );
+    eventLoopPipeline = arena_new<eventloop>( ARENA_MODULE_EVENTLOOP, accel, stepCounter );
+    bool allocated = ( accel != NULL ) && ( stepCounter != NULL ) && ( eventLoopPipeline != NULL );
+#else
+    sampleStream = arena_new<samplestream_t>( ARENA_MODULE_SAMPLESTREAM );
+    accel = arena_new<accelerometer>( ARENA_MODULE_ACCELEROMETER, sampleStream );
+    bool allocated = ( sampleStream != NULL ) && ( accel != NULL );
+#if DATA_COLLECTION_ENABLED
+    router = arena_new<datarouter>( ARENA_MODULE_DATAROUTER, sampleStream );
+    allocated = allocated && ( router != NULL );
+#endif
+#if PREDICTION_ENABLED
+    stepCounter = arena_new<stepcounter>( ARENA_MODULE_STEPCOUNTER, sampleStream, STEPCOUNTER_RESULT_QUEUE );
+    allocated = allocated && ( stepCounter != NULL );
+#endif
+#endif
+#if RESULT_STREAMING_ENABLED
+    router = arena_new<datarouter>( ARENA_MODULE_DATAROUTER, &resultQueue );
+    allocated = allocated && ( router != NULL );
+#endif
+    if ( !allocated )
+    {
+        Log.error( "Failed to allocate the pipeline" );
+        System.reset();
+    }
+
+#if PIPELINE_MODE == PIPELINE_MODE_THREADS
+    // Initialize stream for accelerometer data. Its readers are added when the
+    // data router and step counter are initialized
+    samplestream_init( sampleStream );
+#endif
 
-    // Initialize queue for accelerometer data
-    status = os_queue_create( &dataQueue, sizeof( acceleration_sample_t ), DATA_BUFFER_SIZE, NULL );
-    if ( ( status != 0 ) || ( dataQueue == NULL ) )
+#if RESULT_STREAMING_ENABLED
+    // Initialize queue for window results
+    status = os_queue_create( &resultQueue, sizeof( window_result_t ), RESULT_QUEUE_SIZE, NULL );
+    if ( ( status != 0 ) || ( resultQueue == NULL ) )
     {
-        Log.error( "Failed to create queue" );
+        Log.error( "Failed to create result queue" );
         System.reset();
     }
+    TRACER_REGISTER( resultQueue, "resultQueue" );
+#endif
 
     // Initialize accelerometer
 #if DATA_COLLECTION_ENABLED
-    status = accel.init( true );
+    status = accel->init( true );
 #else
-    status = accel.init();
+    status = accel->init();
 #endif
     if ( status != 0 )
     {
@@ -155,9 +293,9 @@ void setup()
     }
 
     // Initialize datarouter
-#if DATA_COLLECTION_ENABLED
+#if DATAROUTER_ENABLED
     Log.info( "Initializing datarouter" );
-    status = router.init();
+    status = router->init();
     if ( status != 0 )
     {
         Log.error( "Failed to initialize datarouter" );
@@ -168,7 +306,7 @@ void setup()
     // Initialize step counter
 #if PREDICTION_ENABLED
     Log.info( "Starting step counter" );
-    status = stepCounter.init();
+    status = stepCounter->init();
     if ( status != 0 )
     {
         Log.error( "Failed to initialize step counter" );
@@ -176,6 +314,22 @@ void setup()
     }
 #endif
 
+    // Initialize event loop
+#if PIPELINE_MODE == PIPELINE_MODE_EVENT_LOOP
+    Log.info( "Starting event loop" );
+    status = eventLoopPipeline->init();
+    if ( status != 0 )
+    {
+        Log.error( "Failed to initialize event loop" );
+        System.reset();
+    }
+#endif
+
+    // Everything is allocated, so the pipeline can't allocate while it runs
+    arena_seal();
+    arena_report();
+    Log.info( "Memory: %lu bytes of heap free after setup", ( unsigned long )System.freeMemory() );
+
     Log.info( "Completed setup" );
 }
 
@@ -195,8 +349,33 @@ void loop()
         // Set state to running
         measuringState = MEASURING_STATE_RUNNING;
 
+        // Count metrics per measurement
+        metrics_reset();
+
+#if TRACER_ENABLED
+        // Trace the measurement from the start, the ring keeps the end of it
+        tracer_start();
+#endif
+
+#if RESULT_STREAMING_ENABLED
+        // Start data router before the step counter puts results in its queue
+        if ( ( router->start() ) != 0 )
+        {
+            Log.error( "Failed to start datarouter" );
+            System.reset();
+        }
+#endif
+
+#if PIPELINE_MODE == PIPELINE_MODE_EVENT_LOOP
+        // Start sampling and step counting
+        if ( ( eventLoopPipeline->start() ) != 0 )
+        {
+            Log.error( "Failed to start event loop" );
+            System.reset();
+        }
+#else
         // Start accelerometer
-        if ( ( accel.start() ) != 0 )
+        if ( ( accel->start() ) != 0 )
         {
             Log.error( "Failed to start accelerometer" );
             System.reset();
@@ -205,7 +384,7 @@ void loop()
 #if DATA_COLLECTION_ENABLED
 
         // Start data router
-        if ( ( router.start() ) != 0 )
+        if ( ( router->start() ) != 0 )
         {
             Log.error( "Failed to start datarouter" );
             System.reset();
@@ -214,11 +393,12 @@ void loop()
 
 #if PREDICTION_ENABLED
         // Start step counter
-        if ( ( stepCounter.start() ) != 0 )
+        if ( ( stepCounter->start() ) != 0 )
         {
             Log.error( "Failed to start step counter" );
             System.reset();
         }
+#endif
 #endif
 
         break;
@@ -226,8 +406,16 @@ void loop()
     case MEASURING_STATE_FINISH:
     {
         Log.info( "Finishing..." );
+#if PIPELINE_MODE == PIPELINE_MODE_EVENT_LOOP
+        // Stop sampling and step counting
+        if ( ( eventLoopPipeline->stop() ) != 0 )
+        {
+            Log.error( "Failed to stop event loop" );
+            System.reset();
+        }
+#else
         // Stop accelerometer
-        if ( ( accel.stop() ) != 0 )
+        if ( ( accel->stop() ) != 0 )
         {
             Log.error( "Failed to stop accelerometer" );
             System.reset();
@@ -235,7 +423,7 @@ void loop()
 
 #if DATA_COLLECTION_ENABLED
         // Stop data router
-        if ( ( router.stop() ) != 0 )
+        if ( ( router->stop() ) != 0 )
         {
             Log.error( "Failed to stop datarouter" );
             System.reset();
@@ -244,21 +432,54 @@ void loop()
 
 #if PREDICTION_ENABLED
         // Stop step counter
-        if ( ( stepCounter.stop() ) != 0 )
+        if ( ( stepCounter->stop() ) != 0 )
         {
             Log.error( "Failed to stop step counter" );
             System.reset();
         }
+#endif
+#endif
 
+#if RESULT_STREAMING_ENABLED
+        // Stop data router after the step counter, so it sends the last results
+        if ( ( router->stop() ) != 0 )
+        {
+            Log.error( "Failed to stop datarouter" );
+            System.reset();
+        }
+#endif
+
+#if PREDICTION_ENABLED
         // Print the number of steps detected
-        Log.info( "Current step count: %ld", stepCounter.stepCount );
+        Log.info( "Current step count: %ld", stepCounter->stepCount );
 
 #if PARTICLE_CONNECTION
-        // Publish step count to Particle Cloud
-        Particle.publish( "stepCount", String( stepCounter.stepCount ) );
+        // Publish step count to Particle Cloud, formatted on the stack
+        char stepText[11]; // Fits any uint32_t
+        snprintf( stepText, sizeof( stepText ), "%lu", ( unsigned long )stepCounter->stepCount );
+        Particle.publish( "stepCount", stepText );
 #endif
 #endif
 
+        // Print health of the measurement
+        publishMetrics();
+
+#if PROFILER_ENABLED
+        // Print time spent in hot functions during the measurement
+        profiler_dump();
+#endif
+
+#if TRACER_ENABLED
+        // Write the timeline of the measurement as Chrome trace JSON, between
+        // two log lines, so it can be cut from the serial output
+        tracer_stop();
+        Log.info( "Trace: begin" );
+        uint32_t traced = tracer_export( writeTrace, NULL );
+        Log.info( "Trace: end, %lu events, %lu overwritten",
+                  ( unsigned long )traced,
+                  ( unsigned long )tracer_getOverwritten() );
+#endif
+
         // Turn off LED
         digitalWrite( LED_PIN, LOW );
         // Set state to idle
@@ -270,10 +491,20 @@ void loop()
     case MEASURING_STATE_RUNNING:
     default:
     {
-        // If we are not running, go to sleep
-        if ( os_semaphore_take( stateUpdateSemaphore, CONCURRENT_WAIT_FOREVER, 0 ) != 0 )
+        // Sleep until the state is updated. While running, wake up
+        // periodically to publish health metrics
+        bool running = ( measuringState == MEASURING_STATE_RUNNING );
+        if ( os_semaphore_take(
+                 stateUpdateSemaphore, running ? METRICS_PUBLISH_INTERVAL_MS : CONCURRENT_WAIT_FOREVER, 0 ) != 0 )
         {
-            Log.error( "Loop: error in semaphore" );
+            if ( running )
+            {
+                publishMetrics();
+            }
+            else
+            {
+                Log.error( "Loop: error in semaphore" );
+            }
         }
         break;
     }
@@ -8,18 +8,31 @@
 /*                          Includes                          */
 /**************************************************************/
 #include "accelerometer.h"
+#include <math.h>     // sqrtf
+#include "arena.h"    // Static arena for the pipeline objects
+#include "metrics.h"  // Runtime health metrics
+#include "overload.h" // Handling of full sample stream
+#include "tracer.h"   // Timeline of the pipeline
 
 /**************************************************************/
 /*                     Defines and macros                     */
 /**************************************************************/
-#define SAMPLE_DELAY_MS 1000 / ACCELEROMETER_SAMPLE_RATE_HZ
-#define RUNCHECK_DELAY_MS 100 // Delay between checks if state is "running"
-#define QUEUE_TIMEOUT_MS 500  // Timeout for queue operations
+#define SAMPLE_PERIOD_MS ( 1000 / ACCELEROMETER_SAMPLE_RATE_HZ )     // Period of sample timer
+#define SAMPLE_PERIOD_US ( 1000000 / ACCELEROMETER_SAMPLE_RATE_HZ )  // Ideal sample interval
+#define OVERRUN_LIMIT_US ( SAMPLE_PERIOD_US + SAMPLE_PERIOD_US / 2 ) // Sample interval counted as an overrun
+#define TIMING_PUBLISH_INTERVAL ACCELEROMETER_SAMPLE_RATE_HZ         // Intervals between timing updates
+#define RUNCHECK_DELAY_MS 100                                        // Delay between checks if state is "running"
+
+// The sample timer ticks in whole milliseconds
+#if ( 1000 % ACCELEROMETER_SAMPLE_RATE_HZ ) != 0
+#error "ACCELEROMETER_SAMPLE_RATE_HZ must divide 1000, as the sample timer has millisecond resolution"
+#endif
 
 /**************************************************************/
 /*                     Typedefs and enums                     */
 /**************************************************************/
 
+
 /**************************************************************/
 /*                          Private                           */
 /**************************************************************/
@@ -34,6 +47,62 @@ void stepDetectedInterrupt()
     detachInterrupt( STEP_PIN ); // Detach interrupt to pin to avoid bouncing
 }
 
+/**************************************************************/
+// Forget timing of previous measurement
+static void resetTiming( sample_timing_t* timing )
+{
+    memset( timing, 0x00, sizeof( *timing ) );
+    timing->min = UINT32_MAX;
+}
+
+/**************************************************************/
+// Add the interval since the previous sample to the timing statistics, and
+// publish them to the health metrics once in a while
+static void updateTiming( sample_timing_t* timing, uint32_t timestamp )
+{
+    if ( !timing->started )
+    {
+        timing->started = true;
+        timing->first = timestamp;
+        timing->previous = timestamp;
+        return;
+    }
+
+    uint32_t interval = timestamp - timing->previous;
+    int32_t deviation = ( int32_t )interval - SAMPLE_PERIOD_US;
+    timing->previous = timestamp;
+
+    timing->count++;
+    timing->sumDeviation += deviation;
+    timing->sumSquaredDeviation += ( uint64_t )( ( int64_t )deviation * deviation );
+    if ( interval < timing->min )
+    {
+        timing->min = interval;
+    }
+    if ( interval > timing->max )
+    {
+        timing->max = interval;
+    }
+
+    if ( interval > OVERRUN_LIMIT_US )
+    {
+        metrics_periodOverrun();
+    }
+
+    if ( ( timing->count % TIMING_PUBLISH_INTERVAL ) == 0 )
+    {
+        float mean = ( float )timing->sumDeviation / timing->count;
+        float variance = ( float )timing->sumSquaredDeviation / timing->count - mean * mean;
+        uint32_t stddev = ( uint32_t )sqrtf( ( variance > 0 ) ? variance : 0 );
+
+        // Drift is how far the last sample is from where an ideal clock would
+        // have put it
+        int32_t drift = ( int32_t )( ( timestamp - timing->first ) - timing->count * ( uint32_t )SAMPLE_PERIOD_US );
+
+        metrics_setSampleTiming( timing->min, timing->max, stddev, drift );
+    }
+}
+
 /**************************************************************/
 /*                           Public                           */
 /**************************************************************/
@@ -45,7 +114,10 @@ void getMeasurement( void* arg )
     // Get self pointer
     accelerometer* self = ( accelerometer* )arg;
 
-    // Sample to send to queue
+    metrics_threadStart( METRICS_THREAD_ACCELEROMETER, ACCELEROMETER_THREAD_STACK_SIZE );
+    TRACER_REGISTER_THREAD( "accelerometer" );
+
+    // Sample to write to stream
     acceleration_sample_t sample = { 0 };
 
     while ( true )
@@ -54,31 +126,16 @@ void getMeasurement( void* arg )
         {
         case ACCELEROMETER_STATE_RUNNING:
         {
-            // Get sample from accelerometer, built in timer, (and stepDetected)
-            if ( self->detectStep )
+            // Wait for the sample timer. Time out once in a while to see if
+            // we have been stopped
+            if ( self->waitSample( &sample, RUNCHECK_DELAY_MS ) != 0 )
             {
-                sample.step = stepDetected;
-                if ( stepDetected )
-                {
-                    stepDetected = false;
-                    attachInterrupt( STEP_PIN, stepDetectedInterrupt,
-                                     RISING ); // Reattach interrupt to pin
-                }
+                break;
             }
 
-            sample.timestamp = millis();
-            self->adxl343.readAcceleration(
-                &( sample.acceleration[AXIS_X] ), &( sample.acceleration[AXIS_Y] ), &( sample.acceleration[AXIS_Z] ) );
-
-            // Put data in queue
-            if ( os_queue_put( *( self->dataQueue ), &sample, QUEUE_TIMEOUT_MS, NULL ) )
-            {
-                Log.error( "Failed to put data in queue" );
-                System.reset();
-            }
-
-            // Delay for sample rate
-            delay( SAMPLE_DELAY_MS );
+            // Write data to stream. If a reader is full, the overload policy
+            // decides which sample is lost, so sampling is never blocked
+            overload_put( self->samples, &sample );
 
             break;
         }
@@ -98,9 +155,9 @@ void getMeasurement( void* arg )
 }
 
 /**************************************************************/
-accelerometer::accelerometer( os_queue_t* dataQueue )
+accelerometer::accelerometer( samplestream_t* samples )
 {
-    this->dataQueue = dataQueue;
+    this->samples = samples;
     state = ACCELEROMETER_STATE_IDLE;
 }
 
@@ -110,7 +167,11 @@ accelerometer::~accelerometer()
     // Stop thread, if still running
     if ( thread != NULL )
     {
-        delete thread;
+        arena_delete( thread );
+    }
+    if ( sampleTimer != NULL )
+    {
+        arena_delete( sampleTimer );
     }
 }
 
@@ -142,6 +203,7 @@ int accelerometer::init( bool captureStep )
         result = -1;
     }
 
+#if PIPELINE_MODE == PIPELINE_MODE_THREADS
     // Initialize state machine semaphore
     if ( result == 0 )
     {
@@ -151,17 +213,50 @@ int accelerometer::init( bool captureStep )
             result = -1;
         }
     }
+#endif
+
+    // Initialize sample timer semaphore
+    if ( result == 0 )
+    {
+        if ( os_semaphore_create( &sampleSemaphore, SEMAPHORE_MAX_COUNT, 0 ) != 0 )
+        {
+            Log.error( "Failed to initialize sample semaphore" );
+            result = -1;
+        }
+    }
+
+    // Initialize sample timer
+    if ( result == 0 )
+    {
+        sampleTimer =
+            arena_new<Timer>( ARENA_MODULE_ACCELEROMETER, SAMPLE_PERIOD_MS, &accelerometer::sampleTick, *this );
+        if ( sampleTimer == NULL )
+        {
+            Log.error( "Failed to create sample timer" );
+            result = -1;
+        }
+    }
 
-    // Initialize thread
+#if PIPELINE_MODE == PIPELINE_MODE_THREADS
+    // Initialize thread. In the event loop pipeline, the event loop takes the
+    // samples instead
     if ( result == 0 )
     {
-        thread = new Thread( "", getMeasurement, this, OS_THREAD_PRIORITY_DEFAULT, OS_THREAD_STACK_SIZE_DEFAULT );
+        thread = arena_new<Thread>( ARENA_MODULE_ACCELEROMETER,
+                                    "",
+                                    getMeasurement,
+                                    this,
+                                    ACCELEROMETER_THREAD_PRIORITY,
+                                    ACCELEROMETER_THREAD_STACK_SIZE );
         if ( thread == NULL )
         {
             Log.error( "Failed to create accelerometer thread" );
             result = -1;
         }
     }
+    TRACER_REGISTER( stateUpdateSemaphore, "accelerometer_state" );
+#endif
+    TRACER_REGISTER( sampleSemaphore, "sample_tick" );
 
     return result;
 }
@@ -169,14 +264,38 @@ int accelerometer::init( bool captureStep )
 /**************************************************************/
 int accelerometer::start()
 {
+    // Forget overload state from the previous measurement
+    overload_reset();
+
+    // Don't count the pause between measurements as an interval
+    resetTiming( &timing );
+    ticksServed = 0;
+
     // Set state to running
     state = ACCELEROMETER_STATE_RUNNING;
 
+#if PIPELINE_MODE == PIPELINE_MODE_THREADS
     // Signal thread to wake up
     if ( os_semaphore_give( stateUpdateSemaphore, 0 ) != 0 )
     {
         Log.error( "Acceleration: error in semaphore" );
     }
+#endif
+
+    // Forget a tick left from the previous measurement, which would be served
+    // as one of this measurement
+    while ( os_semaphore_take( sampleSemaphore, 0, 0 ) == 0 )
+    {
+        // Drain until empty
+    }
+
+    // Start taking samples
+    tickCount.store( 0, std::memory_order_relaxed );
+    if ( !sampleTimer->start() )
+    {
+        Log.error( "Acceleration: failed to start sample timer" );
+        return -1;
+    }
 
     return 0;
 }
@@ -185,5 +304,72 @@ int accelerometer::start()
 int accelerometer::stop()
 {
     state = ACCELEROMETER_STATE_IDLE;
+
+    // Stop taking samples
+    if ( !sampleTimer->stop() )
+    {
+        Log.error( "Acceleration: failed to stop sample timer" );
+        return -1;
+    }
+
     return 0;
-}
\ No newline at end of file
+}
+
+/**************************************************************/
+void accelerometer::sampleTick()
+{
+    // Wake up thread to take a sample
+    tickTimestamp.store( micros(), std::memory_order_relaxed );
+    tickCount.fetch_add( 1, std::memory_order_relaxed );
+    os_semaphore_give( sampleSemaphore, 0 );
+}
+
+/**************************************************************/
+int accelerometer::waitSample( acceleration_sample_t* sample, system_tick_t timeoutMs )
+{
+    if ( os_semaphore_take( sampleSemaphore, timeoutMs, 0 ) != 0 )
+    {
+        return -1;
+    }
+
+    // Get sample from accelerometer, built in timer, (and stepDetected)
+    if ( detectStep )
+    {
+        sample->step = stepDetected;
+        if ( stepDetected )
+        {
+            stepDetected = false;
+            attachInterrupt( STEP_PIN, stepDetectedInterrupt,
+                             RISING ); // Reattach interrupt to pin
+        }
+    }
+
+    sample->timestamp = micros();
+    updateTiming( &timing, sample->timestamp );
+
+    // If other ticks arrived before this one was served, their sample
+    // deadlines were missed. Count them, and serve from the latest tick on, as
+    // ticks are lost when the semaphore is full. Samples of ticks still given
+    // are served late, but were counted already. Otherwise, measure how long it
+    // took to respond to the tick
+    ticksServed++;
+    uint32_t ticks = tickCount.load( std::memory_order_relaxed );
+    if ( ticks != ticksServed )
+    {
+        int32_t skipped = ( int32_t )( ticks - ticksServed );
+        if ( skipped > 0 )
+        {
+            metrics_deadlineMiss( ( uint32_t )skipped );
+        }
+        ticksServed = ticks;
+    }
+    else
+    {
+        metrics_sampleLatency( sample->timestamp - tickTimestamp.load( std::memory_order_relaxed ) );
+    }
+
+    adxl343.readAcceleration(
+        &( sample->acceleration[AXIS_X] ), &( sample->acceleration[AXIS_Y] ), &( sample->acceleration[AXIS_Z] ) );
+
+    return 0;
+}
@@ -3,6 +3,11 @@
  * @author Simon Udsen
  * @date 2025-03-27
  * @brief Accelerometer data collection
+ * @details Samples are taken by a thread that is woken up by a periodic
+ * software timer, so the sample period does not drift with the time it takes
+ * to read the sensor. Samples are timestamped with micros(). With
+ * PIPELINE_MODE_EVENT_LOOP, no thread is created, and the event loop takes the
+ * samples with waitSample()
  */
 #ifndef ACCELEROMETER_H
 #define ACCELEROMETER_H
@@ -10,9 +15,12 @@
 /**************************************************************/
 /*                          Includes                          */
 /**************************************************************/
-#include "Particle.h" // Particle Device OS APIs
-#include "adxl343.h"  // ADXL343 accelerometer sensor
-#include "config.h"   // Project configuration
+#include <atomic> // Tick counter shared with sample timer
+
+#include "Particle.h"     // Particle Device OS APIs
+#include "adxl343.h"      // ADXL343 accelerometer sensor
+#include "config.h"       // Project configuration
+#include "samplestream.h" // Broadcast of samples to several readers
 
 /**************************************************************/
 /*                     Defines and macros                     */
@@ -29,6 +37,19 @@ typedef enum accelerometer_state_
     ACCELEROMETER_STATE_RUNNING,
 } accelerometer_state_t;
 
+// Statistics of the interval between samples
+typedef struct sample_timing_
+{
+    bool started;                 // A sample has been taken in this measurement
+    uint32_t first;               // Timestamp of first sample in microseconds
+    uint32_t previous;            // Timestamp of previous sample in microseconds
+    uint32_t count;               // Number of intervals measured
+    uint32_t min;                 // Shortest interval in microseconds
+    uint32_t max;                 // Longest interval in microseconds
+    int64_t sumDeviation;         // Sum of interval deviations from SAMPLE_PERIOD_US
+    uint64_t sumSquaredDeviation; // Sum of squared interval deviations from SAMPLE_PERIOD_US
+} sample_timing_t;
+
 class accelerometer
 {
   public:
@@ -37,9 +58,9 @@ class accelerometer
     /**************************************************************/
     /**
      * Object to read accelerometer data
-     * @param[in] dataQueue Queue to write accelerometer data to
+     * @param[in] samples Stream to write accelerometer data to
      */
-    accelerometer( os_queue_t* dataQueue );
+    accelerometer( samplestream_t* samples );
 
     /**
      * Deletes thread, if still initialized
@@ -54,7 +75,7 @@ class accelerometer
     int init( bool captureStep = false );
 
     /**
-     * Starts reading accelerometer data asynchronously to the queue
+     * Starts reading accelerometer data asynchronously to the stream
      * @returns Status
      * @retval 0: Success
      */
@@ -70,14 +91,36 @@ class accelerometer
     // Thread functions
     friend void getMeasurement( void* owner );
 
+    /**
+     * Sample timer callback, wakes up thread to take a sample
+     */
+    void sampleTick();
+
+    /**
+     * Waits for the next sample timer tick, and takes a sample. Used by the
+     * accelerometer thread, or by the event loop when it owns sampling
+     * @param[out] sample Sample taken. The dropped field is not touched
+     * @param[in] timeoutMs Time to wait for the sample timer
+     * @returns Status
+     * @retval 0: Sample taken
+     * @retval -1: Timed out
+     */
+    int waitSample( acceleration_sample_t* sample, system_tick_t timeoutMs );
+
   private:
     /**************************************************************/
     /*                          Private                           */
     /**************************************************************/
-    Thread* thread; // Thread for reading accelerometer data asynchronously
-    os_queue_t* dataQueue;       // Queue to write accelerometer data to
-    ADXL343 adxl343;             // Accelerometer object
-    accelerometer_state_t state; // State of accelerometer state machine
+    Thread* thread;                      // Thread for reading accelerometer data asynchronously
+    Timer* sampleTimer;                  // Timer that paces sampling
+    os_semaphore_t sampleSemaphore;      // Semaphore given by sample timer to take a sample
+    std::atomic<uint32_t> tickCount;     // Number of sample timer ticks since start
+    std::atomic<uint32_t> tickTimestamp; // Time of latest sample timer tick in microseconds
+    uint32_t ticksServed;                // Number of sample timer ticks served
+    sample_timing_t timing;              // Sample interval statistics
+    samplestream_t* samples;             // Stream to write accelerometer data to
+    ADXL343 adxl343;                     // Accelerometer object
+    accelerometer_state_t state;         // State of accelerometer state machine
     os_semaphore_t
         stateUpdateSemaphore; // Semaphore to wake up state machine thread
     bool detectStep;          // Flag to indicate if step detection is enabled
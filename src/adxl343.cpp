@@ -1,4 +1,28 @@
 #include "adxl343.h"
+#include "config.h"
+#include "profiler.h"
+
+// Output data rate code of BW_RATE for the sample rate. The sensor must
+// produce a new sample for every read, or the pipeline reads repeated samples
+#if ACCELEROMETER_SAMPLE_RATE_HZ == 25
+#define ADXL343_RATE_CODE 0x08
+#elif ACCELEROMETER_SAMPLE_RATE_HZ == 50
+#define ADXL343_RATE_CODE 0x09
+#elif ACCELEROMETER_SAMPLE_RATE_HZ == 100
+#define ADXL343_RATE_CODE 0x0A
+#elif ACCELEROMETER_SAMPLE_RATE_HZ == 200
+#define ADXL343_RATE_CODE 0x0B
+#elif ACCELEROMETER_SAMPLE_RATE_HZ == 400
+#define ADXL343_RATE_CODE 0x0C
+#elif ACCELEROMETER_SAMPLE_RATE_HZ == 800
+#define ADXL343_RATE_CODE 0x0D
+#elif ACCELEROMETER_SAMPLE_RATE_HZ == 1600
+#define ADXL343_RATE_CODE 0x0E
+#elif ACCELEROMETER_SAMPLE_RATE_HZ == 3200
+#define ADXL343_RATE_CODE 0x0F
+#else
+#error "ACCELEROMETER_SAMPLE_RATE_HZ must be an output data rate of the ADXL343, 25 Hz times a power of two"
+#endif
 
 ADXL343::ADXL343( TwoWire& wirePort, uint8_t address )
     : wire( wirePort ), i2cAddress( address )
@@ -25,6 +49,9 @@ bool ADXL343::begin()
     // Set data format to +/-2g, full resolution
     writeRegister8( REG_DATA_FORMAT, 0x08 );
 
+    // Set output data rate to the sample rate, in normal power mode
+    writeRegister8( REG_BW_RATE, ADXL343_RATE_CODE );
+
     // Enable measurements
     writeRegister8( REG_POWER_CTL, 0x08 );
 
@@ -34,6 +61,8 @@ bool ADXL343::begin()
 
 void ADXL343::readAcceleration( int16_t* x, int16_t* y, int16_t* z )
 {
+    PROFILER_SCOPE( PROFILER_REGION_ADXL343_READ );
+
     wire.beginTransmission( i2cAddress );
     wire.write( REG_DATAX0 );
     wire.endTransmission( false );
@@ -8,6 +8,7 @@
 
 // ADXL343 Registers
 #define REG_DEVID          0x00
+#define REG_BW_RATE        0x2C
 #define REG_POWER_CTL      0x2D
 #define REG_DATA_FORMAT    0x31
 #define REG_DATAX0         0x32
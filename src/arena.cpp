@@ -0,0 +1,254 @@
+/**
+ * @file arena.cpp
+ * @author Simon Udsen
+ * @date 2026-10-18
+ */
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include "arena.h" // Header file for this module
+
+#include "Particle.h"      // Particle Device OS APIs
+#include "accelerometer.h" // Accelerometer data collection
+#include "datarouter.h"    // Data router to TCP server
+#include "eventloop.h"     // Single thread prediction pipeline
+#include "samplestream.h"  // Broadcast of samples to several readers
+#include "stepcounter.h"   // Step counter
+
+#include <cstddef> // std::max_align_t
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+#define ARENA_ALIGN alignof( std::max_align_t ) // Alignment of every allocation
+#define ARENA_GUARD_WORDS 4                     // Words after the arena that must not change
+#define ARENA_GUARD_PATTERN 0xCAFEF00DUL        // Value of the guard words
+
+// Size of an allocation, padded to the alignment
+#define ARENA_BYTES( size ) ( ( ( size ) + ARENA_ALIGN - 1 ) / ARENA_ALIGN * ARENA_ALIGN )
+
+#define ARENA_THREADS ( PIPELINE_MODE == PIPELINE_MODE_THREADS )      // Pipeline of separate threads
+#define ARENA_TCP ( DATAROUTER_TRANSPORT == DATAROUTER_TRANSPORT_TCP ) // Datarouter has an uplink thread
+#define ARENA_STEPCOUNTER ( PREDICTION_ENABLED || !ARENA_THREADS )    // Step counter object exists
+
+// Readers of the sample stream
+#define ARENA_READERS ( ( DATA_COLLECTION_ENABLED ? 1 : 0 ) + ( PREDICTION_ENABLED ? 1 : 0 ) )
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+/**************************************************************/
+/*                          Private                           */
+/**************************************************************/
+
+/**************************************************************/
+// Bytes if a part of the pipeline is enabled, else none
+static constexpr size_t onlyIf( bool enabled, size_t bytes )
+{
+    return enabled ? bytes : 0;
+}
+
+// Budget of every module, in the order of arena_module_t. A thread takes a
+// Thread object in the arena, its stack, and a task control block
+static constexpr arena_budget_t budgets[ARENA_MODULE_COUNT] = {
+    // Application: state semaphore, and the queue of window results
+    {
+        0,
+        0,
+        0,
+        ARENA_RTOS_OBJECT_SIZE +
+            onlyIf( RESULT_STREAMING_ENABLED,
+                    ARENA_RTOS_OBJECT_SIZE + RESULT_QUEUE_SIZE * sizeof( window_result_t ) ),
+    },
+    // Sample stream: a semaphore per reader
+    {
+        onlyIf( ARENA_THREADS, ARENA_BYTES( sizeof( samplestream_t ) ) ),
+        0,
+        0,
+        onlyIf( ARENA_THREADS, ARENA_READERS * ARENA_RTOS_OBJECT_SIZE ),
+    },
+    // Accelerometer: sample timer and semaphore, and in the threads pipeline
+    // its thread and state semaphore
+    {
+        ARENA_BYTES( sizeof( accelerometer ) ) + ARENA_BYTES( sizeof( Timer ) ) +
+            onlyIf( ARENA_THREADS, ARENA_BYTES( sizeof( Thread ) ) ),
+        0,
+        onlyIf( ARENA_THREADS, ACCELEROMETER_THREAD_STACK_SIZE ),
+        2 * ARENA_RTOS_OBJECT_SIZE + onlyIf( ARENA_THREADS, 2 * ARENA_RTOS_OBJECT_SIZE ),
+    },
+    // Step counter: in the threads pipeline, buffer and predictor threads, and
+    // three semaphores
+    {
+        onlyIf( ARENA_STEPCOUNTER,
+                ARENA_BYTES( sizeof( stepcounter ) ) + onlyIf( ARENA_THREADS, 2 * ARENA_BYTES( sizeof( Thread ) ) ) ),
+        0,
+        onlyIf( ARENA_STEPCOUNTER && ARENA_THREADS, BUFFER_THREAD_STACK_SIZE + PREDICTOR_THREAD_STACK_SIZE ),
+        onlyIf( ARENA_STEPCOUNTER && ARENA_THREADS, 5 * ARENA_RTOS_OBJECT_SIZE ),
+    },
+    // Datarouter: its thread and state semaphore, and over TCP the uplink
+    // thread, store mutex and uplink semaphore
+    {
+        onlyIf( DATAROUTER_ENABLED,
+                ARENA_BYTES( sizeof( datarouter ) ) + ARENA_BYTES( sizeof( Thread ) ) +
+                    onlyIf( ARENA_TCP, ARENA_BYTES( sizeof( Thread ) ) ) ),
+        0,
+        onlyIf( DATAROUTER_ENABLED, DATAROUTER_THREAD_STACK_SIZE + onlyIf( ARENA_TCP, UPLINK_THREAD_STACK_SIZE ) ),
+        onlyIf( DATAROUTER_ENABLED, 2 * ARENA_RTOS_OBJECT_SIZE + onlyIf( ARENA_TCP, 3 * ARENA_RTOS_OBJECT_SIZE ) ),
+    },
+    // Event loop: its thread and state semaphore
+    {
+        onlyIf( !ARENA_THREADS, ARENA_BYTES( sizeof( eventloop ) ) + ARENA_BYTES( sizeof( Thread ) ) ),
+        0,
+        onlyIf( !ARENA_THREADS, EVENTLOOP_THREAD_STACK_SIZE ),
+        onlyIf( !ARENA_THREADS, 2 * ARENA_RTOS_OBJECT_SIZE ),
+    },
+};
+
+// Printable names of every module, in the order of arena_module_t
+static const char* const moduleNames[ARENA_MODULE_COUNT] = {
+    "application", "samplestream", "accelerometer", "stepcounter", "datarouter", "eventloop",
+};
+
+/**************************************************************/
+// Sum of the arena budgets
+static constexpr size_t totalArenaBytes()
+{
+    size_t total = 0;
+    for ( const arena_budget_t& budget : budgets )
+    {
+        total += budget.arenaBytes;
+    }
+    return total;
+}
+
+static constexpr size_t arenaSize = totalArenaBytes(); // Bytes of the arena
+
+// Arena, and the guard after it
+typedef struct arena_storage_
+{
+    alignas( std::max_align_t ) uint8_t bytes[arenaSize]; // Objects
+    uint32_t guard[ARENA_GUARD_WORDS];                    // Written when the first object is allocated
+} arena_storage_t;
+
+static arena_storage_t storage;                 // Arena, zero until used
+static size_t used[ARENA_MODULE_COUNT] = { 0 }; // Bytes every module allocated
+static size_t offset = 0;                       // Bytes of the arena allocated
+static bool guarded = false;                    // Guard is written
+static bool sealed = false;                     // Setup is done
+static uint32_t failedAllocations = 0;          // Allocations that failed
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+void* arena_alloc( arena_module_t module, size_t size )
+{
+    size_t bytes = ARENA_BYTES( size );
+
+    if ( sealed )
+    {
+        Log.error( "Arena: %s allocated %u bytes after setup", moduleNames[module], ( unsigned )size );
+        failedAllocations++;
+        return NULL;
+    }
+    if ( used[module] + bytes > budgets[module].arenaBytes )
+    {
+        Log.error( "Arena: %s needs %u bytes more than its budget of %u",
+                   moduleNames[module],
+                   ( unsigned )( used[module] + bytes - budgets[module].arenaBytes ),
+                   ( unsigned )budgets[module].arenaBytes );
+        failedAllocations++;
+        return NULL;
+    }
+
+    if ( !guarded )
+    {
+        for ( uint8_t i = 0; i < ARENA_GUARD_WORDS; i++ )
+        {
+            storage.guard[i] = ARENA_GUARD_PATTERN;
+        }
+        guarded = true;
+    }
+
+    // The budgets add up to the arena, so it can't run out
+    void* memory = &( storage.bytes[offset] );
+    offset += bytes;
+    used[module] += bytes;
+    return memory;
+}
+
+/**************************************************************/
+void arena_seal()
+{
+    sealed = true;
+}
+
+/**************************************************************/
+int arena_check()
+{
+    int result = 0;
+
+    for ( uint8_t i = 0; guarded && ( i < ARENA_GUARD_WORDS ); i++ )
+    {
+        if ( storage.guard[i] != ARENA_GUARD_PATTERN )
+        {
+            Log.error( "Arena: guard overwritten, an object wrote past the arena" );
+            result = -1;
+            break;
+        }
+    }
+    if ( failedAllocations > 0 )
+    {
+        Log.error( "Arena: %lu allocations failed", ( unsigned long )failedAllocations );
+        result = -1;
+    }
+
+    return result;
+}
+
+/**************************************************************/
+void arena_getBudget( arena_module_t module, arena_budget_t* budget )
+{
+    *budget = budgets[module];
+    budget->usedBytes = used[module];
+}
+
+/**************************************************************/
+const char* arena_getName( arena_module_t module )
+{
+    return moduleNames[module];
+}
+
+/**************************************************************/
+size_t arena_getSize()
+{
+    return arenaSize;
+}
+
+/**************************************************************/
+void arena_report()
+{
+    size_t stackBytes = 0;
+    size_t rtosBytes = 0;
+
+    Log.info( "Memory: %-14s %8s %8s %8s %8s", "module", "arena", "used", "stacks", "rtos" );
+    for ( uint8_t i = 0; i < ARENA_MODULE_COUNT; i++ )
+    {
+        Log.info( "Memory: %-14s %8u %8u %8u %8u",
+                  moduleNames[i],
+                  ( unsigned )budgets[i].arenaBytes,
+                  ( unsigned )used[i],
+                  ( unsigned )budgets[i].stackBytes,
+                  ( unsigned )budgets[i].rtosBytes );
+        stackBytes += budgets[i].stackBytes;
+        rtosBytes += budgets[i].rtosBytes;
+    }
+    Log.info( "Memory: %u bytes, %u in the arena, %u of stacks and %u of RTOS objects on the Device OS heap",
+              ( unsigned )( arenaSize + stackBytes + rtosBytes ),
+              ( unsigned )arenaSize,
+              ( unsigned )stackBytes,
+              ( unsigned )rtosBytes );
+}
@@ -0,0 +1,148 @@
+/**
+ * @file arena.h
+ * @author Simon Udsen
+ * @date 2026-10-18
+ * @brief Static arena for the objects of the pipeline
+ * @details The pipeline objects, and the Thread and Timer objects they create,
+ * are placed in one static arena instead of on the heap. The arena is sized at
+ * compile time from config.h, as the sum of a budget per module, so the RAM of
+ * the pipeline is known when it is built. A module that allocates more than
+ * its budget gets NULL, and fails to initialize.
+ *
+ * Everything is allocated during setup, which calls arena_seal at its end.
+ * Allocations after that fail, so the pipeline never allocates while it runs.
+ * arena_check verifies that none was tried, and that the guard after the
+ * arena is intact.
+ *
+ * Device OS allocates the thread stacks, semaphores, queues and mutexes on its
+ * own heap, during setup. They are not in the arena, but their bytes are in
+ * the budget too: the stack sizes of config.h, and about ARENA_RTOS_OBJECT_SIZE
+ * for every RTOS object and thread control block. arena_report logs the budget
+ * of every module, and host/tools/memreport.cpp prints it when the host tools
+ * are built.
+ */
+#ifndef ARENA_H
+#define ARENA_H
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include <stddef.h> // size_t
+
+#include <new>     // Placement new
+#include <utility> // std::forward
+
+#include "config.h" // Project configuration
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+#define ARENA_RTOS_OBJECT_SIZE 88 // FreeRTOS queue or task control block, with its heap header
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+// Modules with a budget
+typedef enum arena_module_
+{
+    ARENA_MODULE_APPLICATION,   // TinyML-step-counter.cpp
+    ARENA_MODULE_SAMPLESTREAM,  // samplestream_t
+    ARENA_MODULE_ACCELEROMETER, // accelerometer
+    ARENA_MODULE_STEPCOUNTER,   // stepcounter
+    ARENA_MODULE_DATAROUTER,    // datarouter
+    ARENA_MODULE_EVENTLOOP,     // eventloop
+    ARENA_MODULE_COUNT
+} arena_module_t;
+
+// Memory of a module
+typedef struct arena_budget_
+{
+    size_t arenaBytes; // Bytes of its objects in the arena
+    size_t usedBytes;  // Bytes of the arena allocated so far
+    size_t stackBytes; // Bytes of its thread stacks, on the Device OS heap
+    size_t rtosBytes;  // Bytes of its RTOS objects and queue items, on the Device OS heap
+} arena_budget_t;
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+/**
+ * Allocates memory from the budget of a module. Fails after arena_seal, or if
+ * the budget is used up, and logs why
+ * @param[in] module Module allocating
+ * @param[in] size Bytes to allocate
+ * @returns Memory, aligned for any type, or NULL on failure
+ */
+void* arena_alloc( arena_module_t module, size_t size );
+
+/**************************************************************/
+/**
+ * Ends setup. Every allocation after this fails
+ */
+void arena_seal();
+
+/**************************************************************/
+/**
+ * Checks the arena, and logs what is wrong
+ * @returns Status
+ * @retval 0: The guard is intact and no allocation has failed
+ * @retval -1: The guard is overwritten, or an allocation failed
+ */
+int arena_check();
+
+/**************************************************************/
+/**
+ * Gets the budget of a module
+ * @param[in] module Module
+ * @param[out] budget Budget, and the bytes used so far
+ */
+void arena_getBudget( arena_module_t module, arena_budget_t* budget );
+
+/**************************************************************/
+/**
+ * Gets the printable name of a module
+ * @param[in] module Module
+ * @returns Name of module
+ */
+const char* arena_getName( arena_module_t module );
+
+/**************************************************************/
+/**
+ * Gets the size of the arena
+ * @returns Bytes of the arena, without its guard
+ */
+size_t arena_getSize();
+
+/**************************************************************/
+/**
+ * Logs the budget of every module, and the totals
+ */
+void arena_report();
+
+/**************************************************************/
+/**
+ * Constructs an object in the budget of a module
+ * @param[in] module Module allocating
+ * @param[in] args Arguments of the constructor
+ * @returns Object, or NULL if the allocation failed
+ */
+template <typename T, typename... Args> T* arena_new( arena_module_t module, Args&&... args )
+{
+    void* memory = arena_alloc( module, sizeof( T ) );
+    return ( memory != NULL ) ? new ( memory ) T( std::forward<Args>( args )... ) : NULL;
+}
+
+/**************************************************************/
+/**
+ * Destroys an object made with arena_new. Its memory is not reused
+ * @param[in] object Object
+ */
+template <typename T> void arena_delete( T* object )
+{
+    object->~T();
+}
+
+#endif // ARENA_H
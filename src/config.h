@@ -12,6 +12,8 @@
 /**************************************************************/
 #include <stdint.h> // Standard integer types
 
+#include "window.h" // Compile-time shape of the windows
+
 /**************************************************************/
 /*                     Defines and macros                     */
 /**************************************************************/
@@ -21,19 +23,151 @@
 
 #define SEMAPHORE_MAX_COUNT 10
 
-#define DATA_COLLECTION_ENABLED false
-#define PREDICTION_ENABLED true
+// The profiler, tracer, pipeline mode, data collection, sample rate and sample stream size can be set with -D,
+// so host builds can simulate other configurations, see host/tools/pipesim.cpp
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED false // Profile hot functions with the cycle counter, see profiler.h
+#endif
+#ifndef TRACER_ENABLED
+#define TRACER_ENABLED false // Record a timeline of the pipeline, see tracer.h
+#endif
+#ifndef TRACER_SIZE
+#define TRACER_SIZE 1024 // Events the tracer keeps, a power of two
+#endif
+
+#define METRICS_PUBLISH_INTERVAL_MS ( 60 * 1000 ) // Interval between publishing health metrics while measuring
+
+// Thread priority and stack plan. Sampling gets the highest priority so it is
+// never delayed by inference, buffer piping the next, and inference and network
+// the lowest. Stack sizes can be tuned with the stack high-water marks in the
+// health metrics
+#define ACCELEROMETER_THREAD_PRIORITY ( OS_THREAD_PRIORITY_DEFAULT + 3 ) // Sampling
+#define BUFFER_THREAD_PRIORITY ( OS_THREAD_PRIORITY_DEFAULT + 1 )        // Buffer piping
+#define PREDICTOR_THREAD_PRIORITY OS_THREAD_PRIORITY_DEFAULT             // Inference
+#define DATAROUTER_THREAD_PRIORITY OS_THREAD_PRIORITY_DEFAULT            // Network
+#define UPLINK_THREAD_PRIORITY OS_THREAD_PRIORITY_DEFAULT                // Network
+
+#define ACCELEROMETER_THREAD_STACK_SIZE OS_THREAD_STACK_SIZE_DEFAULT
+#define BUFFER_THREAD_STACK_SIZE OS_THREAD_STACK_SIZE_DEFAULT
+#define PREDICTOR_THREAD_STACK_SIZE OS_THREAD_STACK_SIZE_DEFAULT
+#define DATAROUTER_THREAD_STACK_SIZE OS_THREAD_STACK_SIZE_DEFAULT
+#define UPLINK_THREAD_STACK_SIZE OS_THREAD_STACK_SIZE_DEFAULT
+
+// Pipeline modes, see eventloop.h
+#define PIPELINE_MODE_THREADS 0    // Separate threads for sampling, buffer piping and inference
+#define PIPELINE_MODE_EVENT_LOOP 1 // One thread for sampling, window assembly and inference
+
+#ifndef PIPELINE_MODE
+#define PIPELINE_MODE PIPELINE_MODE_THREADS // Structure of the prediction pipeline
+#endif
+
+#define EVENTLOOP_THREAD_PRIORITY ACCELEROMETER_THREAD_PRIORITY // Event loop samples, so it gets sampling priority
+#define EVENTLOOP_THREAD_STACK_SIZE OS_THREAD_STACK_SIZE_DEFAULT
+
+#define PREDICTOR_LOAD_TEST_US 0 // Busy-wait this long per window, to test that sampling survives a saturated predictor
+#if ( PIPELINE_MODE == PIPELINE_MODE_EVENT_LOOP ) && ( PREDICTOR_LOAD_TEST_US > 0 )
+#error "The event loop predicts on the sampling thread, so the predictor load test would only delay sampling"
+#endif
+
+#ifndef DATA_COLLECTION_ENABLED
+#define DATA_COLLECTION_ENABLED false // Send samples to the server, see datarouter.h
+#endif
+#define PREDICTION_ENABLED true        // Count steps, see stepcounter.h
+#define RESULT_STREAMING_ENABLED false // Send the features and steps of every window to the server, see datarouter.h
+
+#if !( PREDICTION_ENABLED || DATA_COLLECTION_ENABLED )
+#error "Prediction, data collection or both must be enabled"
+#endif
+
+#if DATA_COLLECTION_ENABLED && RESULT_STREAMING_ENABLED
+#error "The datarouter sends either samples or window results"
+#endif
+
+#if RESULT_STREAMING_ENABLED && !PREDICTION_ENABLED
+#error "Result streaming sends the results of prediction"
+#endif
+
+#define DATAROUTER_ENABLED ( DATA_COLLECTION_ENABLED || RESULT_STREAMING_ENABLED ) // Send samples or results
+
+#define DATAROUTER_RESULT_BATCH_WINDOWS 10       // Maximum window results sent in one frame
+#define DATAROUTER_RESULT_FLUSH_LATENCY_MS 10000 // Maximum time a window result waits before it is sent
+#define RESULT_QUEUE_MARGIN 4                    // Window results the queue holds while a frame is stored
+
+// Window results waiting for the datarouter, those of the flush latency and the margin
+#define RESULT_QUEUE_SIZE ( DATAROUTER_RESULT_FLUSH_LATENCY_MS / DATA_BUFFER_HOP_MS + RESULT_QUEUE_MARGIN )
+
+// Formats of data sent to the TCP server, see datarouter.h
+#define DATAROUTER_FORMAT_CSV 0   // One line of text per sample
+#define DATAROUTER_FORMAT_FRAME 1 // Binary frames of packed samples, see frame.h
+#define DATAROUTER_FORMAT_DELTA 2 // Binary frames of delta encoded samples, see samplecodec.h
+
+#define DATAROUTER_FORMAT DATAROUTER_FORMAT_DELTA // Format of data sent to the TCP server
+#define DATAROUTER_BATCH_SAMPLES 50               // Maximum samples sent in one write
+#define DATAROUTER_FLUSH_LATENCY_MS 100           // Maximum time a sample waits before it is sent
+
+// Transports to the server, see datarouter.h
+#define DATAROUTER_TRANSPORT_TCP 0 // Stream, frames are stored until acknowledged
+#define DATAROUTER_TRANSPORT_UDP 1 // Datagram per frame, lost frames are not sent again
 
-#if !( PREDICTION_ENABLED ^ DATA_COLLECTION_ENABLED )
-#error "Either prediction or data collection must be enabled, but not both"
+#define DATAROUTER_TRANSPORT DATAROUTER_TRANSPORT_TCP // Transport to the server
+#define DATAROUTER_UDP_MAX_DATAGRAM 1200              // Largest datagram, below the MTU of any path to the server
+
+#if ( DATAROUTER_TRANSPORT == DATAROUTER_TRANSPORT_UDP ) && ( DATAROUTER_FORMAT == DATAROUTER_FORMAT_CSV )
+#error "UDP needs sequence numbered frames to account for lost datagrams, not CSV text"
 #endif
 
-#define ACCELEROMETER_SAMPLE_RATE_HZ 100 // Sample rate of accelerometer in Hz
+#if RESULT_STREAMING_ENABLED && ( DATAROUTER_FORMAT != DATAROUTER_FORMAT_FRAME )
+#error "Window results are sent in binary frames, set DATAROUTER_FORMAT to DATAROUTER_FORMAT_FRAME"
+#endif
 
-#define DATA_BUFFER_SIZE_MS 1000 // Size of buffer for ML algorithm in milliseconds
+// Store-and-forward of frames the server has not acknowledged, see framestore.h
+#define DATAROUTER_STORE_SIZE ( 32 * 1024 )           // Bytes of unacknowledged frames kept in RAM
+#define DATAROUTER_STORE_FRAMES 256                   // Unacknowledged frames kept in RAM
+#define DATAROUTER_SPILL_ENABLED false                // Move frames to flash when the RAM store is full
+#define DATAROUTER_SPILL_PATH "/usr/datarouter.spill" // Spill file
+#define DATAROUTER_SPILL_MAX_BYTES ( 1024 * 1024 )    // Largest spill file
+#define DATAROUTER_BACKOFF_MIN_MS 250                 // First delay between TCP connection attempts
+#define DATAROUTER_BACKOFF_MAX_MS ( 16 * 1000 )       // Longest delay between TCP connection attempts
+#define DATAROUTER_FINISH_TIMEOUT_MS ( 10 * 1000 )    // Time to wait for the last frames to be acknowledged
 
-#define DATA_BUFFER_SIZE                                                                                               \
-    ( ( DATA_BUFFER_SIZE_MS * ACCELEROMETER_SAMPLE_RATE_HZ ) / 1000 ) // Size of buffer for ML algorithm in samples
+#if ( PIPELINE_MODE == PIPELINE_MODE_EVENT_LOOP ) && DATA_COLLECTION_ENABLED
+#error "The event loop pipeline only supports prediction, as network writes would block sampling"
+#endif
+
+// Policies of readers of the sample stream, see samplestream.h
+#define SAMPLESTREAM_POLICY_GATE 0    // Reader keeps its samples, and a full reader applies OVERLOAD_POLICY
+#define SAMPLESTREAM_POLICY_OVERRUN 1 // Reader skips the samples it falls too far behind on
+
+#ifndef SAMPLESTREAM_SIZE
+#define SAMPLESTREAM_SIZE 128 // Samples kept for the slowest reader, a power of two
+#endif
+#define STEPCOUNTER_SAMPLE_POLICY SAMPLESTREAM_POLICY_GATE // Step counter keeps every sample it can
+#if PREDICTION_ENABLED
+#define DATAROUTER_SAMPLE_POLICY SAMPLESTREAM_POLICY_OVERRUN // A slow network never costs the step counter samples
+#else
+#define DATAROUTER_SAMPLE_POLICY SAMPLESTREAM_POLICY_GATE // Only reader, so it applies OVERLOAD_POLICY
+#endif
+
+// Policies for handling a full sample stream, see overload.h
+#define OVERLOAD_POLICY_DROP_NEWEST 0
+#define OVERLOAD_POLICY_DROP_OLDEST 1
+#define OVERLOAD_POLICY_DECIMATE 2
+#define OVERLOAD_POLICY_DEGRADE 3
+
+#define OVERLOAD_POLICY OVERLOAD_POLICY_DROP_OLDEST // Policy used when the sample stream is full
+#define OVERLOAD_DECIMATION_FACTOR 2                // Keep every N'th sample with OVERLOAD_POLICY_DECIMATE
+#define OVERLOAD_DEGRADED_TREES 3                   // Trees used by the model with OVERLOAD_POLICY_DEGRADE
+
+#ifndef ACCELEROMETER_SAMPLE_RATE_HZ
+#define ACCELEROMETER_SAMPLE_RATE_HZ 100 // Sample rate in Hz, an ADXL343 data rate dividing 1000: 25, 50, 100 or 200
+#endif
+
+#define DATA_BUFFER_SIZE_MS 1000               // Size of buffer for ML algorithm in milliseconds
+#define DATA_BUFFER_HOP_MS DATA_BUFFER_SIZE_MS // Time between the starts of two windows, see data_window_t
+
+#define DATA_BUFFER_SIZE ( data_window_t::SIZE ) // Size of buffer for ML algorithm in samples
+
+#define WINDOW_RESULT_NUM_FEATURES 6 // Features in a window result, same as STATISTICALFEATURES_NUM_FEATURES
 
 #define STEP_PIN D2           // Pin to detect step
 #define STEP_REFERENCE_PIN D3 // Constant high to attach a button to STEP_PIN
@@ -45,10 +179,21 @@
 // Structure for storing acceleration samples
 typedef struct acceleration_sample_
 {
-    uint32_t timestamp;      // Timestamp in microseconds
+    uint32_t timestamp;      // Timestamp in microseconds, from micros()
     int16_t acceleration[3]; // X, Y, Z-acceleration
     bool step;               // Step in sample
+    uint8_t dropped;         // Number of samples lost right before this one
 } acceleration_sample_t;
+// Result of predicting a window, sent to the server with RESULT_STREAMING_ENABLED
+typedef struct window_result_
+{
+    uint32_t timestamp;                           // Timestamp of first sample in window, in microseconds
+    int16_t features[WINDOW_RESULT_NUM_FEATURES]; // Statistical features of window
+    uint16_t steps;                               // Steps predicted, extrapolated over lost samples
+    uint16_t dropped;                             // Samples lost in window
+} window_result_t;
+// Windows of the step counter, checked at compile time, see window.h
+typedef window_config_t<ACCELEROMETER_SAMPLE_RATE_HZ, DATA_BUFFER_SIZE_MS, DATA_BUFFER_HOP_MS> data_window_t;
 // Axis of accelerometer
 typedef enum axis_
 {
@@ -8,14 +8,20 @@
 /*                          Includes                          */
 /**************************************************************/
 #include "datarouter.h"
+#include "arena.h"       // Static arena for the pipeline objects
+#include "metrics.h"     // Runtime health metrics
+#include "profiler.h"    // Cycle counter profiling
+#include "samplecodec.h" // Sample compression
+
+#include <string.h> // memmove
 
 /**************************************************************/
 /*                     Defines and macros                     */
 /**************************************************************/
 #define SERVER_IP_ADRESS 192, 168, 136, 250 // IP address of TCP server
 #define SERVER_PORT 7123                    // Port of TCP server
-#define TCP_DELAY_MS 100                    // Delay between TCP connection attempts
-#define QUEUE_TIMEOUT_MS 500                // Timeout for queue operations
+#define QUEUE_TIMEOUT_MS 500                // Timeout for reading the source
+#define ACK_POLL_MS 50                      // Interval between checks for acknowledgements while idle
 
 /**************************************************************/
 /*                     Typedefs and enums                     */
@@ -25,30 +31,330 @@
 /*                          Private                           */
 /**************************************************************/
 /**************************************************************/
-// Forward data from queue to TCP server
+// Convert a hexadecimal character to its value
+static uint8_t hexValue( char c )
+{
+    if ( ( c >= '0' ) && ( c <= '9' ) )
+    {
+        return c - '0';
+    }
+    if ( ( c >= 'a' ) && ( c <= 'f' ) )
+    {
+        return c - 'a' + 10;
+    }
+    if ( ( c >= 'A' ) && ( c <= 'F' ) )
+    {
+        return c - 'A' + 10;
+    }
+    return 0;
+}
+
+/**************************************************************/
+// Put the transmit buffer in the store, for the uplink thread to send, or send
+// it as a datagram
+int datarouter::flush()
+{
+    if ( batchCount == 0 )
+    {
+        return 0;
+    }
+
+#if RESULT_STREAMING_ENABLED
+    size_t length = frame_finish(
+        txBuffer, deviceId, frameSequence, FRAME_ENCODING_RESULTS, batchCount, batchCount * FRAME_RESULT_SIZE );
+#elif DATAROUTER_FORMAT == DATAROUTER_FORMAT_DELTA
+    // Compress into the space the packed samples would take, and pack them if
+    // they don't fit
+    int payloadLength = 0;
+    {
+        PROFILER_SCOPE( PROFILER_REGION_SAMPLECODEC_ENCODE );
+        payloadLength = samplecodec_encode(
+            batch, batchCount, &( txBuffer[FRAME_HEADER_SIZE] ), batchCount * FRAME_SAMPLE_SIZE );
+    }
+    frame_encoding_t encoding = FRAME_ENCODING_DELTA;
+    if ( payloadLength < 0 )
+    {
+        for ( uint16_t i = 0; i < batchCount; i++ )
+        {
+            frame_putSample( txBuffer, i, &( batch[i] ) );
+        }
+        encoding = FRAME_ENCODING_PACKED;
+        payloadLength = batchCount * FRAME_SAMPLE_SIZE;
+    }
+    size_t length = frame_finish( txBuffer, deviceId, frameSequence, encoding, batchCount, payloadLength );
+#elif DATAROUTER_FORMAT == DATAROUTER_FORMAT_FRAME
+    size_t length = frame_finish(
+        txBuffer, deviceId, frameSequence, FRAME_ENCODING_PACKED, batchCount, batchCount * FRAME_SAMPLE_SIZE );
+#else
+    size_t length = txLength;
+#endif
+    batchCount = 0;
+    txLength = 0;
+
+#if DATAROUTER_TRANSPORT == DATAROUTER_TRANSPORT_UDP
+    // Fire and forget, the server counts the frames that don't arrive
+    if ( !connected )
+    {
+        connected = ( udp.begin( SERVER_PORT ) != 0 );
+    }
+    int sent = -1;
+    if ( connected )
+    {
+        PROFILER_SCOPE( PROFILER_REGION_DATAROUTER_WRITE );
+        sent = udp.sendPacket( txBuffer, length, serverAddr, serverPort );
+    }
+    frameSequence++;
+
+    if ( sent == ( int )length )
+    {
+        metrics_networkWrite( ( uint32_t )sent );
+    }
+    else
+    {
+        metrics_framesDropped( 1 );
+    }
+
+    return 0;
+#else
+    os_mutex_lock( storeMutex );
+    int status = framestore_push( &store, txBuffer, length, frameSequence );
+    uint32_t dropped = framestore_takeDropped( &store );
+    os_mutex_unlock( storeMutex );
+    frameSequence++;
+
+    if ( dropped > 0 )
+    {
+        metrics_framesDropped( dropped );
+    }
+    if ( os_semaphore_give( uplinkSemaphore, 0 ) != 0 )
+    {
+        Log.error( "Datarouter: error in semaphore" );
+    }
+
+    return status;
+#endif
+}
+
+/**************************************************************/
+// Wait for the last frames to be sent, and disconnect by setting state to idle
+void datarouter::finish()
+{
+#if DATAROUTER_TRANSPORT == DATAROUTER_TRANSPORT_UDP
+    udp.stop();
+    connected = false;
+    state = DATAROUTER_STATE_IDLE;
+#else
+    // Give the uplink thread time to send the rest, then let it disconnect
+    system_tick_t start = millis();
+    uint32_t frames = 0;
+    do
+    {
+        os_mutex_lock( storeMutex );
+        frames = framestore_count( &store );
+        os_mutex_unlock( storeMutex );
+        if ( frames > 0 )
+        {
+            delay( ACK_POLL_MS );
+        }
+    } while ( ( frames > 0 ) && ( millis() - start < DATAROUTER_FINISH_TIMEOUT_MS ) );
+    if ( frames > 0 )
+    {
+        Log.error( "Datarouter: %lu frames were not acknowledged", ( unsigned long )frames );
+    }
+
+    state = DATAROUTER_STATE_IDLE;
+    if ( os_semaphore_give( uplinkSemaphore, 0 ) != 0 )
+    {
+        Log.error( "Datarouter: error in semaphore" );
+    }
+#endif
+}
+
+#if DATAROUTER_TRANSPORT == DATAROUTER_TRANSPORT_TCP
+/**************************************************************/
+// Connect to the TCP server, and resume from the oldest frame not acknowledged
+int datarouter::connect()
+{
+    // Connecting blocks until it times out, so don't try without a network
+    if ( !WiFi.ready() || !client.connect( serverAddr, serverPort ) )
+    {
+        return -1;
+    }
+
+    os_mutex_lock( storeMutex );
+    framestore_rewind( &store );
+    uint32_t frames = framestore_count( &store );
+    os_mutex_unlock( storeMutex );
+
+    ackLength = 0;
+    connected = true;
+    metrics_reconnect();
+    Log.info( "Datarouter: connected to server, %lu frames to resend", ( unsigned long )frames );
+
+    return 0;
+}
+
+/**************************************************************/
+// Release the frames the server has acknowledged
+void datarouter::receiveAcks()
+{
+    while ( client.available() > 0 )
+    {
+        int length = client.read( &( ackBuffer[ackLength] ), FRAME_ACK_SIZE - ackLength );
+        if ( length <= 0 )
+        {
+            break;
+        }
+        ackLength += length;
+
+        uint32_t sequence = 0;
+        int status = frame_decodeAck( ackBuffer, ackLength, &sequence );
+        if ( status > 0 )
+        {
+            os_mutex_lock( storeMutex );
+            framestore_acknowledge( &store, sequence );
+            os_mutex_unlock( storeMutex );
+            ackLength = 0;
+        }
+        else if ( status < 0 )
+        {
+            // Skip a byte, to find the next acknowledgement
+            memmove( ackBuffer, &( ackBuffer[1] ), --ackLength );
+        }
+    }
+}
+
+/**************************************************************/
+// Send the next stored frame, or wait for one to be stored
+int datarouter::sendNext()
+{
+    receiveAcks();
+
+    uint32_t sequence = 0;
+    os_mutex_lock( storeMutex );
+    int length = framestore_next( &store, uplinkBuffer, sizeof( uplinkBuffer ), &sequence );
+    uint32_t dropped = framestore_takeDropped( &store );
+    os_mutex_unlock( storeMutex );
+
+    if ( dropped > 0 )
+    {
+        metrics_framesDropped( dropped );
+    }
+    if ( length < 0 )
+    {
+        Log.error( "Datarouter: failed to read stored frame" );
+        return 0;
+    }
+    if ( length == 0 )
+    {
+        // Wait for a frame, checking for acknowledgements and a closed connection
+        os_semaphore_take( uplinkSemaphore, ACK_POLL_MS, 0 );
+        return client.connected() ? 0 : -1;
+    }
+
+    int written = 0;
+    {
+        PROFILER_SCOPE( PROFILER_REGION_DATAROUTER_WRITE );
+        written = client.write( uplinkBuffer, length );
+    }
+    if ( written != length )
+    {
+        return ( written < 0 ) ? written : -1;
+    }
+    metrics_networkWrite( ( uint32_t )written );
+
+#if DATAROUTER_FORMAT == DATAROUTER_FORMAT_CSV
+    // There are no acknowledgements of CSV text
+    os_mutex_lock( storeMutex );
+    framestore_acknowledge( &store, sequence + 1 );
+    os_mutex_unlock( storeMutex );
+#endif
+
+    return 0;
+}
+#endif
+
+/**************************************************************/
+// Add a sample or window result to the transmit buffer, and flush it if full
+int datarouter::appendItem( const datarouter_item_t* item )
+{
+    {
+        PROFILER_SCOPE( PROFILER_REGION_DATAROUTER_FORWARD );
+
+#if RESULT_STREAMING_ENABLED
+        frame_putResult( txBuffer, batchCount, item );
+#elif DATAROUTER_FORMAT == DATAROUTER_FORMAT_DELTA
+        batch[batchCount] = *item;
+#elif DATAROUTER_FORMAT == DATAROUTER_FORMAT_FRAME
+        frame_putSample( txBuffer, batchCount, item );
+#else
+        txLength += datarouter_formatCsv( ( char* )&( txBuffer[txLength] ), item );
+#endif
+        batchCount++;
+    }
+
+    if ( batchCount == DATAROUTER_BATCH_SIZE )
+    {
+        return flush();
+    }
+    return 0;
+}
+
+/**************************************************************/
+// Read the next item from the source
+int datarouter::takeItem( datarouter_item_t* item, system_tick_t timeoutMs )
+{
+    PROFILER_SCOPE( PROFILER_REGION_DATAROUTER_TAKE );
+#if RESULT_STREAMING_ENABLED
+    return os_queue_take( *source, item, timeoutMs, NULL );
+#else
+    return samplestream_read( source, sampleReader, item, timeoutMs );
+#endif
+}
+
+/**************************************************************/
+// Forward a batch of data from source to TCP server
 int datarouter::forwardData()
 {
     // Status of operation
     int status = 0;
 
-    // Data to get from accelerometer
-    acceleration_sample_t sample = { 0 };
+    // Sample or window result to get from source
+    datarouter_item_t item = {};
 
-    // Data to send to TCP server
-    String data;
-
-    status = os_queue_take( *dataQueue, &sample, QUEUE_TIMEOUT_MS, NULL );
+    // Wait for the first item of the batch
+    status = takeItem( &item, QUEUE_TIMEOUT_MS );
+    if ( status != 0 )
+    {
+        return status;
+    }
+    system_tick_t start = millis();
+    status = appendItem( &item );
 
-    if ( status == 0 )
+    // Take the rest of the batch as it arrives, until the batch is full and
+    // flushed, or the first item has waited the latency. When finishing, the
+    // source is only drained
+    while ( ( status == 0 ) && ( batchCount > 0 ) )
     {
-        data = String::format( "%lu,%d,%d,%d,%d\n",
-                               sample.timestamp,
-                               sample.acceleration[AXIS_X],
-                               sample.acceleration[AXIS_Y],
-                               sample.acceleration[AXIS_Z],
-                               sample.step );
+        system_tick_t waitedMs = millis() - start;
+        if ( waitedMs >= DATAROUTER_BATCH_LATENCY_MS )
+        {
+            break;
+        }
 
-        status = client.write( ( ( const uint8_t* )data.c_str() ), data.length() );
+        system_tick_t timeoutMs = ( state == DATAROUTER_STATE_RUNNING ) ? DATAROUTER_BATCH_LATENCY_MS - waitedMs : 0;
+        if ( takeItem( &item, timeoutMs ) != 0 )
+        {
+            break;
+        }
+        status = appendItem( &item );
+    }
+
+    // Send a partial batch at the deadline, but only while connected. Full
+    // batches take less space in the store while the TCP server is unreachable
+    if ( ( status == 0 ) && connected )
+    {
+        status = flush();
     }
 
     return status;
@@ -62,24 +368,36 @@ void dataRouterFunc( void* owner )
 {
     datarouter* self = ( datarouter* )owner;
 
+    metrics_threadStart( METRICS_THREAD_DATAROUTER, DATAROUTER_THREAD_STACK_SIZE );
+    TRACER_REGISTER_THREAD( "datarouter" );
+
     while ( true )
     {
         switch ( self->state )
         {
         case DATAROUTER_STATE_BEGIN:
         {
-            // The system wants to begin, connect to TCP server and set state to
-            // running
-            if ( self->client.connect( self->serverAddr, self->serverPort ) )
-            {
-                self->state = DATAROUTER_STATE_RUNNING;
-                Log.info( "Datarouter: connected to server" );
-            }
-            else
+            // The system wants to begin, start a new session and let the uplink
+            // thread connect
+#if DATAROUTER_TRANSPORT == DATAROUTER_TRANSPORT_TCP
+            os_mutex_lock( self->storeMutex );
+            framestore_clear( &( self->store ) );
+            os_mutex_unlock( self->storeMutex );
+#else
+            self->connected = ( self->udp.begin( SERVER_PORT ) != 0 );
+#endif
+            self->txLength = 0;
+            self->batchCount = 0;
+            // A random first sequence number tells the server that this is a
+            // new session, and not frames sent again after a reconnect
+            self->frameSequence = HAL_RNG_GetRandomNumber();
+            self->state = DATAROUTER_STATE_RUNNING;
+#if DATAROUTER_TRANSPORT == DATAROUTER_TRANSPORT_TCP
+            if ( os_semaphore_give( self->uplinkSemaphore, 0 ) != 0 )
             {
-                Log.error( "Datarouter: failed to connect to server" );
-                self->state = DATAROUTER_STATE_IDLE;
+                Log.error( "Datarouter: error in semaphore" );
             }
+#endif
             break;
         }
         case DATAROUTER_STATE_RUNNING:
@@ -94,15 +412,12 @@ void dataRouterFunc( void* owner )
         }
         case DATAROUTER_STATE_FINISH:
         {
-            // Forward data until the queue is empty
+            // Forward data until the source is empty, including a partial batch
             while ( self->forwardData() == 0 )
             {
             }
-
-            // Disconnect from TCP server and set state to idle
-            self->client.stop();
-            self->state = DATAROUTER_STATE_IDLE;
-            Log.info( "Datarouter: disconnected from server" );
+            self->flush();
+            self->finish();
             break;
         }
         case DATAROUTER_STATE_IDLE:
@@ -119,15 +434,82 @@ void dataRouterFunc( void* owner )
     }
 }
 
+#if DATAROUTER_TRANSPORT == DATAROUTER_TRANSPORT_TCP
+/**************************************************************/
+void dataRouterUplinkFunc( void* owner )
+{
+    datarouter* self = ( datarouter* )owner;
+    uint32_t backoffMs = DATAROUTER_BACKOFF_MIN_MS;
+
+    metrics_threadStart( METRICS_THREAD_UPLINK, UPLINK_THREAD_STACK_SIZE );
+    TRACER_REGISTER_THREAD( "uplink" );
+
+    while ( true )
+    {
+        if ( self->state == DATAROUTER_STATE_IDLE )
+        {
+            // Not measuring, disconnect and go to sleep
+            if ( self->connected )
+            {
+                self->client.stop();
+                self->connected = false;
+                Log.info( "Datarouter: disconnected from server" );
+            }
+            backoffMs = DATAROUTER_BACKOFF_MIN_MS;
+            if ( os_semaphore_take( self->uplinkSemaphore, CONCURRENT_WAIT_FOREVER, 0 ) != 0 )
+            {
+                Log.error( "Datarouter uplink thread: error in semaphore" );
+            }
+        }
+        else if ( !self->connected )
+        {
+            if ( self->connect() == 0 )
+            {
+                backoffMs = DATAROUTER_BACKOFF_MIN_MS;
+            }
+            else
+            {
+                Log.warn( "Datarouter: failed to connect to server, retrying in %lu ms", ( unsigned long )backoffMs );
+                delay( backoffMs );
+                backoffMs = ( backoffMs * 2 > DATAROUTER_BACKOFF_MAX_MS ) ? DATAROUTER_BACKOFF_MAX_MS : backoffMs * 2;
+            }
+        }
+        else
+        {
+            int status = self->sendNext();
+            if ( status != 0 )
+            {
+                // Frames not acknowledged are sent again after reconnecting
+                Log.error( "Datarouter: connection lost, error %d", status );
+                self->client.stop();
+                self->connected = false;
+            }
+        }
+    }
+}
+
+#endif
+
 /**************************************************************/
-datarouter::datarouter( os_queue_t* dataQueue )
+datarouter::datarouter( datarouter_source_t* source )
 {
-    this->dataQueue = dataQueue;         // Queue to read accelerometer data from
+    this->source = source;               // Source to read accelerometer data or window results from
+    this->sampleReader = 0;              // Reader index in sample stream, added by init
     this->state = DATAROUTER_STATE_IDLE; // State of datarouter
 
     // Save server information
     serverAddr = IPAddress( SERVER_IP_ADRESS );
     serverPort = SERVER_PORT;
+
+    thread = NULL;
+    uplinkThread = NULL;
+    connected = false;
+#if DATAROUTER_TRANSPORT == DATAROUTER_TRANSPORT_TCP
+    ackLength = 0;
+#endif
+    txLength = 0;
+    batchCount = 0;
+    frameSequence = 0;
 }
 
 /**************************************************************/
@@ -135,6 +517,37 @@ int datarouter::init()
 {
     int result = 0;
 
+    // Device ID is 24 hexadecimal characters, sent as 12 bytes in every frame
+    String id = System.deviceID();
+    const char* idText = id.c_str();
+    for ( uint8_t i = 0; i < FRAME_DEVICE_ID_SIZE; i++ )
+    {
+        if ( ( idText[2 * i] == '\0' ) || ( idText[2 * i + 1] == '\0' ) )
+        {
+            Log.error( "Datarouter: device ID is too short" );
+            result = -1;
+            break;
+        }
+        deviceId[i] = ( hexValue( idText[2 * i] ) << 4 ) | hexValue( idText[2 * i + 1] );
+    }
+
+#if !RESULT_STREAMING_ENABLED
+    // Read every sample from the stream, starting with the next one
+    if ( result == 0 )
+    {
+        int reader = samplestream_addReader( source, DATAROUTER_SAMPLE_POLICY );
+        if ( reader < 0 )
+        {
+            Log.error( "Failed to add datarouter sample stream reader" );
+            result = -1;
+        }
+        else
+        {
+            sampleReader = ( uint8_t )reader;
+        }
+    }
+#endif
+
     // Initialize state machine semaphore
     if ( result == 0 )
     {
@@ -145,27 +558,75 @@ int datarouter::init()
         }
     }
 
-    // Initialize thread
+#if DATAROUTER_TRANSPORT == DATAROUTER_TRANSPORT_TCP
+    // Initialize store of unacknowledged frames. Without a spill file, frames
+    // are still kept in RAM
+    if ( result == 0 )
+    {
+        if ( ( os_mutex_create( &storeMutex ) != 0 ) ||
+             ( os_semaphore_create( &uplinkSemaphore, SEMAPHORE_MAX_COUNT, 0 ) != 0 ) )
+        {
+            Log.error( "Failed to initialize datarouter store" );
+            result = -1;
+        }
+#if DATAROUTER_SPILL_ENABLED
+        else if ( framestore_init( &store, DATAROUTER_SPILL_PATH, DATAROUTER_SPILL_MAX_BYTES ) != 0 )
+        {
+            Log.error( "Datarouter: failed to open spill file, frames are kept in RAM only" );
+        }
+#else
+        else
+        {
+            framestore_init( &store, NULL, 0 );
+        }
+#endif
+    }
+#endif
+
+    // Initialize threads
     if ( result == 0 )
     {
-        thread = new Thread( "", dataRouterFunc, this, OS_THREAD_PRIORITY_DEFAULT, OS_THREAD_STACK_SIZE_DEFAULT );
-        if ( thread == NULL )
+        thread = arena_new<Thread>( ARENA_MODULE_DATAROUTER,
+                                    "",
+                                    dataRouterFunc,
+                                    this,
+                                    DATAROUTER_THREAD_PRIORITY,
+                                    DATAROUTER_THREAD_STACK_SIZE );
+#if DATAROUTER_TRANSPORT == DATAROUTER_TRANSPORT_TCP
+        uplinkThread = arena_new<Thread>(
+            ARENA_MODULE_DATAROUTER, "", dataRouterUplinkFunc, this, UPLINK_THREAD_PRIORITY, UPLINK_THREAD_STACK_SIZE );
+        if ( uplinkThread == NULL )
+        {
+            result = -1;
+        }
+#endif
+        if ( ( thread == NULL ) || ( result != 0 ) )
         {
             Log.error( "Failed to create datarouter thread" );
             result = -1;
         }
     }
 
+    TRACER_REGISTER( stateUpdateSemaphore, "datarouter_state" );
+#if DATAROUTER_TRANSPORT == DATAROUTER_TRANSPORT_TCP
+    TRACER_REGISTER( storeMutex, "storeMutex" );
+    TRACER_REGISTER( uplinkSemaphore, "uplink" );
+#endif
+
     return result;
 }
 
 /**************************************************************/
 datarouter::~datarouter()
 {
-    // Stop thread, if still running
+    // Stop threads, if still running
     if ( thread != NULL )
     {
-        delete thread;
+        arena_delete( thread );
+    }
+    if ( uplinkThread != NULL )
+    {
+        arena_delete( uplinkThread );
     }
 }
 
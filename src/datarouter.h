@@ -3,6 +3,13 @@
  * @author Simon Udsen
  * @date 2025-03-27
  * @brief Sends data to TCP server
+ * @details Samples are sent in batches of DATAROUTER_FORMAT, written when
+ * DATAROUTER_BATCH_SAMPLES are buffered or the first has waited
+ * DATAROUTER_FLUSH_LATENCY_MS. Over TCP, frames are stored until the server
+ * acknowledges them and sent again after a reconnect, see framestore.h. Over
+ * UDP, every frame is one datagram, and a lost one is not sent again. With
+ * RESULT_STREAMING_ENABLED, the window results of the step counter are sent
+ * instead of samples.
  */
 #ifndef DATAROUTER_H
 #define DATAROUTER_H
@@ -10,17 +17,57 @@
 /**************************************************************/
 /*                          Includes                          */
 /**************************************************************/
-#include "Particle.h" // Particle Device OS APIs
-#include "config.h"   // Project configuration
+#include "Particle.h"     // Particle Device OS APIs
+#include "config.h"       // Project configuration
+#include "frame.h"        // Binary frames of samples
+#include "framestore.h"   // Unacknowledged frames
+#include "samplestream.h" // Broadcast of samples to several readers
+
+#include <stdio.h> // snprintf
 
 /**************************************************************/
 /*                     Defines and macros                     */
 /**************************************************************/
+#define DATAROUTER_CSV_LINE_SIZE 40 // Size of longest CSV line, with terminator
+
+#if RESULT_STREAMING_ENABLED
+#define DATAROUTER_BATCH_SIZE DATAROUTER_RESULT_BATCH_WINDOWS                 // Window results sent in one write
+#define DATAROUTER_BATCH_LATENCY_MS DATAROUTER_RESULT_FLUSH_LATENCY_MS        // Time a window result waits
+#define DATAROUTER_TX_BUFFER_SIZE FRAME_RESULTS_SIZE( DATAROUTER_BATCH_SIZE ) // Size of transmit buffer
+#else
+#define DATAROUTER_BATCH_SIZE DATAROUTER_BATCH_SAMPLES          // Samples sent in one write
+#define DATAROUTER_BATCH_LATENCY_MS DATAROUTER_FLUSH_LATENCY_MS // Time a sample waits
+#if DATAROUTER_FORMAT == DATAROUTER_FORMAT_CSV
+#define DATAROUTER_TX_BUFFER_SIZE ( DATAROUTER_BATCH_SAMPLES * DATAROUTER_CSV_LINE_SIZE ) // Size of transmit buffer
+#else
+#define DATAROUTER_TX_BUFFER_SIZE FRAME_SIZE( DATAROUTER_BATCH_SAMPLES ) // Size of transmit buffer
+#endif
+#endif
+
+static_assert( ( DATAROUTER_TRANSPORT != DATAROUTER_TRANSPORT_UDP ) ||
+                   ( DATAROUTER_TX_BUFFER_SIZE <= DATAROUTER_UDP_MAX_DATAGRAM ),
+               "A batch must fit in one datagram" );
+static_assert( RESULT_STREAMING_ENABLED ||
+                   ( DATAROUTER_FLUSH_LATENCY_MS * ACCELEROMETER_SAMPLE_RATE_HZ / 1000 < SAMPLESTREAM_SIZE ),
+               "Samples that build up during the flush latency must fit in the sample stream" );
+static_assert( !RESULT_STREAMING_ENABLED ||
+                   ( DATAROUTER_RESULT_FLUSH_LATENCY_MS / DATA_BUFFER_HOP_MS < RESULT_QUEUE_SIZE ),
+               "Window results that build up during the flush latency must fit in the result queue" );
 
 /**************************************************************/
 /*                     Typedefs and enums                     */
 /**************************************************************/
 
+// Item read from the source and sent to the server, and the source it is read
+// from
+#if RESULT_STREAMING_ENABLED
+typedef window_result_t datarouter_item_t;
+typedef os_queue_t datarouter_source_t;
+#else
+typedef acceleration_sample_t datarouter_item_t;
+typedef samplestream_t datarouter_source_t;
+#endif
+
 // Datarouter state machine states
 typedef enum datarouter_state_
 {
@@ -39,9 +86,10 @@ class datarouter
     /**************************************************************/
     /**
      * Object to send data to TCP server
-     * @param[in] dataQueue Queue to read accelerometer data from
+     * @param[in] source Stream to read accelerometer data from, or queue to read
+     * window results from with RESULT_STREAMING_ENABLED
      */
-    datarouter( os_queue_t* dataQueue );
+    datarouter( datarouter_source_t* source );
 
     /**
      * Deletes thread, if initialized
@@ -63,7 +111,7 @@ class datarouter
     int start();
 
     /**
-     * Finishes sending data in the queue and disconnects from TCP server
+     * Finishes sending the data read and disconnects from TCP server
      * @returns Status
      * @retval 0: Success
      */
@@ -71,24 +119,100 @@ class datarouter
 
     // Thread functions
     friend void dataRouterFunc( void* owner );
+    friend void dataRouterUplinkFunc( void* owner );
 
   private:
     /**************************************************************/
     /*                          Private                           */
     /**************************************************************/
-    Thread* thread; // Thread for sending data to TCP server asynchronously
-    os_queue_t* dataQueue; // Queue to read accelerometer data from
+    Thread* thread;              // Thread for reading data from the source into frames
+    Thread* uplinkThread;        // Thread for sending frames to TCP server
+    datarouter_source_t* source; // Source to read datarouter_item_t from
+    uint8_t sampleReader;        // Reader index in sample stream
     os_semaphore_t
         stateUpdateSemaphore; // Semaphore to wake up state machine thread
     datarouter_state_t state; // State of datarouter
 
-    // TCP client
-    TCPClient client;     // TCP client
+    // Server
     IPAddress serverAddr; // Server address
     uint16_t serverPort;  // Server port
+    bool connected;       // Connected to TCP server, or UDP socket open
+
+#if DATAROUTER_TRANSPORT == DATAROUTER_TRANSPORT_TCP
+    // TCP client, only used by uplink thread
+    TCPClient client;                                // TCP client
+    uint8_t ackBuffer[FRAME_ACK_SIZE];               // Acknowledgement being received
+    size_t ackLength;                                // Bytes in acknowledgement buffer
+    uint8_t uplinkBuffer[DATAROUTER_TX_BUFFER_SIZE]; // Frame being sent
+
+    // Frames not acknowledged yet, shared by both threads
+    os_mutex_t storeMutex;          // Mutex protecting store
+    os_semaphore_t uplinkSemaphore; // Semaphore to wake up uplink thread
+    framestore_t store;             // Frames not acknowledged yet
+#else
+    UDP udp;                        // UDP socket
+#endif
 
-    // Helper function to forward data from queue to TCP server
+    // Data being sent
+    uint8_t txBuffer[DATAROUTER_TX_BUFFER_SIZE];           // Transmit buffer
+    size_t txLength;                                       // Bytes of CSV text in transmit buffer
+#if DATAROUTER_FORMAT == DATAROUTER_FORMAT_DELTA
+    acceleration_sample_t batch[DATAROUTER_BATCH_SAMPLES]; // Samples to encode
+#endif
+    uint16_t batchCount;                                   // Samples or window results in transmit buffer
+    uint32_t frameSequence;                                // Sequence number of next frame
+    uint8_t deviceId[FRAME_DEVICE_ID_SIZE];                // Device ID sent in frames
+
+    // Helper function to forward a batch of data from source to TCP server
     int forwardData();
+
+    // Helper function to read the next item from the source
+    int takeItem( datarouter_item_t* item, system_tick_t timeoutMs );
+
+    // Helper function to add an item to the transmit buffer, flushing it if full
+    int appendItem( const datarouter_item_t* item );
+
+    // Helper function to put the transmit buffer in the store, or send it as a
+    // datagram
+    int flush();
+
+    // Helper function to wait for the last frames to be sent, and disconnect
+    void finish();
+
+#if DATAROUTER_TRANSPORT == DATAROUTER_TRANSPORT_TCP
+    // Helper function to connect to the TCP server, and resume sending frames
+    int connect();
+
+    // Helper function to send the next stored frame, or wait for one
+    int sendNext();
+
+    // Helper function to release the frames the server has acknowledged
+    void receiveAcks();
+#endif
 };
 
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+/**
+ * Formats a sample as a line of CSV text, the way DATAROUTER_FORMAT_CSV sends
+ * it. Inline, so host tools can use it without the network APIs
+ * @param[out] line Buffer of at least DATAROUTER_CSV_LINE_SIZE bytes
+ * @param[in] sample Sample to format
+ * @returns Length of line, without terminator
+ */
+static inline int datarouter_formatCsv( char* line, const acceleration_sample_t* sample )
+{
+    return snprintf( line,
+                     DATAROUTER_CSV_LINE_SIZE,
+                     "%lu,%d,%d,%d,%d\n",
+                     ( unsigned long )sample->timestamp,
+                     sample->acceleration[AXIS_X],
+                     sample->acceleration[AXIS_Y],
+                     sample->acceleration[AXIS_Z],
+                     sample->step );
+}
+
 #endif // DATAROUTER_H
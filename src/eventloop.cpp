@@ -0,0 +1,191 @@
+/**
+ * @file eventloop.cpp
+ * @author Simon Udsen
+ * @date 2026-10-18
+ */
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include "eventloop.h" // Header file for this module
+#include "arena.h"     // Static arena for the pipeline objects
+#include "metrics.h"   // Runtime health metrics
+#include "tracer.h"    // Timeline of the pipeline
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+#define RUNCHECK_DELAY_MS 100 // Delay between checks if state is "running"
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+/**************************************************************/
+/*                          Private                           */
+/**************************************************************/
+
+/**************************************************************/
+// Run one slice of deferred inference
+void eventloop::predictSlice()
+{
+    if ( windowFull )
+    {
+        // Features first, as the window buffer is overwritten after this
+        windowFull = false;
+        predicting = counter->beginWindow( &window );
+    }
+    else if ( predicting )
+    {
+        if ( counter->predictTree( &window ) )
+        {
+            counter->finishWindow( &window );
+            predicting = false;
+        }
+    }
+}
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+void eventLoop( void* owner )
+{
+    eventloop* self = ( eventloop* )owner;
+
+    metrics_threadStart( METRICS_THREAD_EVENTLOOP, EVENTLOOP_THREAD_STACK_SIZE );
+    TRACER_REGISTER_THREAD( "eventloop" );
+
+    // Sample to add to window
+    acceleration_sample_t sample = { 0 };
+
+    while ( true )
+    {
+        switch ( self->state )
+        {
+        case EVENTLOOP_STATE_RUNNING:
+        {
+            // Wait for the sample timer. Time out once in a while to see if
+            // we have been stopped
+            if ( self->accel->waitSample( &sample, RUNCHECK_DELAY_MS ) != 0 )
+            {
+                break;
+            }
+
+            self->predictSlice();
+
+            if ( self->counter->addSample( &sample ) )
+            {
+                self->windowFull = true;
+            }
+
+            break;
+        }
+        case EVENTLOOP_STATE_FINISH:
+        {
+            // Predict the last full window, as no more samples will arrive
+            while ( self->windowFull || self->predicting )
+            {
+                self->predictSlice();
+            }
+
+            self->state = EVENTLOOP_STATE_IDLE;
+            Log.info( "Event loop: stopped" );
+            break;
+        }
+        case EVENTLOOP_STATE_IDLE:
+        default:
+        {
+            // If we are not running, go to sleep
+            if ( os_semaphore_take( self->stateUpdateSemaphore, CONCURRENT_WAIT_FOREVER, 0 ) != 0 )
+            {
+                Log.error( "Event loop: error in semaphore" );
+            }
+            break;
+        }
+        }
+    }
+}
+
+/**************************************************************/
+eventloop::eventloop( accelerometer* accel, stepcounter* counter )
+{
+    this->accel = accel;
+    this->counter = counter;
+    state = EVENTLOOP_STATE_IDLE;
+    windowFull = false;
+    predicting = false;
+}
+
+/**************************************************************/
+eventloop::~eventloop()
+{
+    // Stop thread, if initialized
+    if ( thread != NULL )
+    {
+        arena_delete( thread );
+    }
+}
+
+/**************************************************************/
+int eventloop::init()
+{
+    int result = 0;
+
+    // Initialize state machine semaphore
+    if ( os_semaphore_create( &stateUpdateSemaphore, SEMAPHORE_MAX_COUNT, 0 ) != 0 )
+    {
+        Log.error( "Failed to initialize state update semaphore" );
+        result = -1;
+    }
+
+    // Initialize thread
+    if ( result == 0 )
+    {
+        thread = arena_new<Thread>(
+            ARENA_MODULE_EVENTLOOP, "", eventLoop, this, EVENTLOOP_THREAD_PRIORITY, EVENTLOOP_THREAD_STACK_SIZE );
+        if ( thread == NULL )
+        {
+            Log.error( "Failed to create event loop thread" );
+            result = -1;
+        }
+    }
+
+    TRACER_REGISTER( stateUpdateSemaphore, "eventloop_state" );
+
+    return result;
+}
+
+/**************************************************************/
+int eventloop::start()
+{
+    // Start from an empty window
+    counter->resetWindow();
+    windowFull = false;
+    predicting = false;
+
+    // Set state to running
+    state = EVENTLOOP_STATE_RUNNING;
+
+    // Signal thread to wake up
+    if ( os_semaphore_give( stateUpdateSemaphore, 0 ) != 0 )
+    {
+        Log.error( "Event loop: error in semaphore" );
+    }
+
+    // Start taking samples
+    return accel->start();
+}
+
+/**************************************************************/
+int eventloop::stop()
+{
+    // Stop taking samples
+    int result = accel->stop();
+
+    // Set state to finish
+    state = EVENTLOOP_STATE_FINISH;
+
+    return result;
+}
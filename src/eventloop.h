@@ -0,0 +1,101 @@
+/**
+ * @file eventloop.h
+ * @author Simon Udsen
+ * @date 2026-10-18
+ * @brief Single thread prediction pipeline
+ * @details With PIPELINE_MODE_EVENT_LOOP, one thread owns sampling, window
+ * assembly and inference, in place of the accelerometer, buffer piping and
+ * predictor threads. On every sample timer tick the loop takes the sample, runs
+ * one slice of the inference of the previous window, the features or a single
+ * model tree, and writes the sample to the window buffer. A slice must fit in a
+ * sample period, or sampling is delayed.
+ */
+#ifndef EVENTLOOP_H
+#define EVENTLOOP_H
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include "Particle.h"      // Particle Device OS APIs
+#include "accelerometer.h" // Accelerometer data collection
+#include "config.h"        // Project configuration
+#include "stepcounter.h"   // Step counter
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+// Event loop state machine states
+typedef enum eventloop_state_
+{
+    EVENTLOOP_STATE_IDLE,
+    EVENTLOOP_STATE_RUNNING,
+    EVENTLOOP_STATE_FINISH,
+} eventloop_state_t;
+
+class eventloop
+{
+  public:
+    /**************************************************************/
+    /*                           Public                           */
+    /**************************************************************/
+    /**
+     * Object to run the prediction pipeline in a single thread
+     * @param[in] accel Accelerometer to take samples from. Must be initialized
+     * @param[in] counter Step counter to predict steps with
+     */
+    eventloop( accelerometer* accel, stepcounter* counter );
+
+    /**
+     * Deletes thread, if initialized
+     */
+    ~eventloop();
+
+    /**
+     * Initializes member variables
+     * @returns Status
+     * @retval 0: Success
+     */
+    int init();
+
+    /**
+     * Starts sampling and predicting step count asynchronously
+     * @returns Status
+     * @retval 0: Success
+     */
+    int start();
+
+    /**
+     * Stops sampling. The last full window is still predicted
+     * @returns Status
+     * @retval 0: Success
+     */
+    int stop();
+
+    // Thread functions
+    friend void eventLoop( void* owner );
+
+  private:
+    /**************************************************************/
+    /*                          Private                           */
+    /**************************************************************/
+    accelerometer* accel; // Accelerometer to take samples from
+    stepcounter* counter; // Step counter to predict steps with
+
+    Thread* thread;                      // Thread running the event loop
+    os_semaphore_t stateUpdateSemaphore; // Semaphore to wake up state machine thread
+    eventloop_state_t state;             // State of event loop
+
+    stepcounter_window_t window; // Prediction of the previous window
+    bool windowFull;             // Window buffer is full, and its features are not calculated yet
+    bool predicting;             // Model trees of window are being evaluated
+
+    // Helper function to run one slice of deferred inference
+    void predictSlice();
+};
+
+#endif // EVENTLOOP_H
@@ -0,0 +1,233 @@
+/**
+ * @file frame.cpp
+ * @author Simon Udsen
+ * @date 2026-10-18
+ */
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include "frame.h" // Header file for this module
+
+#include <string.h> // memcpy
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+#define FRAME_CRC_OFFSET 28 // Offset of CRC in header
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+/**************************************************************/
+/*                          Private                           */
+/**************************************************************/
+
+// CRC32 of every nibble value, for the reflected polynomial 0xEDB88320. A
+// nibble table is 64 bytes instead of 1 KB for a byte table, at twice the
+// lookups per byte
+static const uint32_t crcTable[16] = {
+    0x00000000UL, 0x1DB71064UL, 0x3B6E20C8UL, 0x26D930ACUL, 0x76DC4190UL, 0x6B6B51F4UL, 0x4DB26158UL, 0x5005713CUL,
+    0xEDB88320UL, 0xF00F9344UL, 0xD6D6A3E8UL, 0xCB61B38CUL, 0x9B64C2B0UL, 0x86D3D2D4UL, 0xA00AE278UL, 0xBDBDF21CUL,
+};
+
+/**************************************************************/
+// Write little endian 16 bit value
+static void put16( uint8_t* buffer, uint16_t value )
+{
+    buffer[0] = ( uint8_t )value;
+    buffer[1] = ( uint8_t )( value >> 8 );
+}
+
+/**************************************************************/
+// Write little endian 32 bit value
+static void put32( uint8_t* buffer, uint32_t value )
+{
+    buffer[0] = ( uint8_t )value;
+    buffer[1] = ( uint8_t )( value >> 8 );
+    buffer[2] = ( uint8_t )( value >> 16 );
+    buffer[3] = ( uint8_t )( value >> 24 );
+}
+
+/**************************************************************/
+// Read little endian 16 bit value
+static uint16_t get16( const uint8_t* buffer )
+{
+    return ( uint16_t )( buffer[0] | ( buffer[1] << 8 ) );
+}
+
+/**************************************************************/
+// Read little endian 32 bit value
+static uint32_t get32( const uint8_t* buffer )
+{
+    return ( uint32_t )buffer[0] | ( ( uint32_t )buffer[1] << 8 ) | ( ( uint32_t )buffer[2] << 16 ) |
+           ( ( uint32_t )buffer[3] << 24 );
+}
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+uint32_t frame_crc32( uint32_t crc, const uint8_t* data, size_t length )
+{
+    crc = ~crc;
+    for ( size_t i = 0; i < length; i++ )
+    {
+        crc ^= data[i];
+        crc = ( crc >> 4 ) ^ crcTable[crc & 0x0F];
+        crc = ( crc >> 4 ) ^ crcTable[crc & 0x0F];
+    }
+    return ~crc;
+}
+
+/**************************************************************/
+void frame_putSample( uint8_t* buffer, uint16_t index, const acceleration_sample_t* sample )
+{
+    uint8_t* packed = buffer + FRAME_SIZE( index );
+
+    put32( &( packed[0] ), sample->timestamp );
+    put16( &( packed[4] ), ( uint16_t )sample->acceleration[AXIS_X] );
+    put16( &( packed[6] ), ( uint16_t )sample->acceleration[AXIS_Y] );
+    put16( &( packed[8] ), ( uint16_t )sample->acceleration[AXIS_Z] );
+    packed[10] = sample->step ? FRAME_FLAG_STEP : 0;
+    packed[11] = sample->dropped;
+}
+
+/**************************************************************/
+size_t frame_finish( uint8_t* buffer,
+                     const uint8_t* deviceId,
+                     uint32_t sequence,
+                     frame_encoding_t encoding,
+                     uint16_t sampleCount,
+                     size_t payloadLength )
+{
+    size_t size = FRAME_HEADER_SIZE + payloadLength;
+
+    put32( &( buffer[0] ), FRAME_MAGIC );
+    buffer[4] = FRAME_VERSION;
+    buffer[5] = ( uint8_t )encoding;
+    put16( &( buffer[6] ), sampleCount );
+    memcpy( &( buffer[8] ), deviceId, FRAME_DEVICE_ID_SIZE );
+    put32( &( buffer[20] ), sequence );
+    put32( &( buffer[24] ), ( uint32_t )payloadLength );
+
+    // CRC covers everything but itself
+    uint32_t crc = frame_crc32( 0, buffer, FRAME_CRC_OFFSET );
+    crc = frame_crc32( crc, buffer + FRAME_HEADER_SIZE, size - FRAME_HEADER_SIZE );
+    put32( &( buffer[FRAME_CRC_OFFSET] ), crc );
+
+    return size;
+}
+
+/**************************************************************/
+int frame_decodeHeader( const uint8_t* buffer, size_t length, frame_header_t* header )
+{
+    if ( length < FRAME_HEADER_SIZE )
+    {
+        return 0;
+    }
+
+    if ( ( get32( &( buffer[0] ) ) != FRAME_MAGIC ) || ( buffer[4] != FRAME_VERSION ) )
+    {
+        return -1;
+    }
+
+    header->version = buffer[4];
+    header->encoding = ( frame_encoding_t )buffer[5];
+    header->sampleCount = get16( &( buffer[6] ) );
+    memcpy( header->deviceId, &( buffer[8] ), FRAME_DEVICE_ID_SIZE );
+    header->sequence = get32( &( buffer[20] ) );
+    header->payloadLength = get32( &( buffer[24] ) );
+    header->crc = get32( &( buffer[FRAME_CRC_OFFSET] ) );
+
+    if ( ( header->payloadLength > FRAME_MAX_PAYLOAD ) ||
+         ( ( header->encoding == FRAME_ENCODING_PACKED ) &&
+           ( header->payloadLength != ( uint32_t )header->sampleCount * FRAME_SAMPLE_SIZE ) ) ||
+         ( ( header->encoding == FRAME_ENCODING_RESULTS ) &&
+           ( header->payloadLength != ( uint32_t )header->sampleCount * FRAME_RESULT_SIZE ) ) ||
+         ( header->encoding > FRAME_ENCODING_RESULTS ) )
+    {
+        return -1;
+    }
+
+    size_t size = FRAME_HEADER_SIZE + header->payloadLength;
+    if ( length < size )
+    {
+        return 0;
+    }
+
+    uint32_t crc = frame_crc32( 0, buffer, FRAME_CRC_OFFSET );
+    crc = frame_crc32( crc, buffer + FRAME_HEADER_SIZE, size - FRAME_HEADER_SIZE );
+    if ( crc != header->crc )
+    {
+        return -1;
+    }
+
+    return ( int )size;
+}
+
+/**************************************************************/
+void frame_getSample( const uint8_t* buffer, uint16_t index, acceleration_sample_t* sample )
+{
+    const uint8_t* packed = buffer + FRAME_SIZE( index );
+
+    sample->timestamp = get32( &( packed[0] ) );
+    sample->acceleration[AXIS_X] = ( int16_t )get16( &( packed[4] ) );
+    sample->acceleration[AXIS_Y] = ( int16_t )get16( &( packed[6] ) );
+    sample->acceleration[AXIS_Z] = ( int16_t )get16( &( packed[8] ) );
+    sample->step = ( packed[10] & FRAME_FLAG_STEP ) != 0;
+    sample->dropped = packed[11];
+}
+
+/**************************************************************/
+void frame_putResult( uint8_t* buffer, uint16_t index, const window_result_t* result )
+{
+    uint8_t* packed = buffer + FRAME_RESULTS_SIZE( index );
+
+    put32( &( packed[0] ), result->timestamp );
+    for ( uint8_t i = 0; i < WINDOW_RESULT_NUM_FEATURES; i++ )
+    {
+        put16( &( packed[4 + 2 * i] ), ( uint16_t )result->features[i] );
+    }
+    put16( &( packed[16] ), result->steps );
+    put16( &( packed[18] ), result->dropped );
+}
+
+/**************************************************************/
+void frame_getResult( const uint8_t* buffer, uint16_t index, window_result_t* result )
+{
+    const uint8_t* packed = buffer + FRAME_RESULTS_SIZE( index );
+
+    result->timestamp = get32( &( packed[0] ) );
+    for ( uint8_t i = 0; i < WINDOW_RESULT_NUM_FEATURES; i++ )
+    {
+        result->features[i] = ( int16_t )get16( &( packed[4 + 2 * i] ) );
+    }
+    result->steps = get16( &( packed[16] ) );
+    result->dropped = get16( &( packed[18] ) );
+}
+
+/**************************************************************/
+void frame_putAck( uint8_t* buffer, uint32_t sequence )
+{
+    put32( &( buffer[0] ), FRAME_ACK_MAGIC );
+    put32( &( buffer[4] ), sequence );
+}
+
+/**************************************************************/
+int frame_decodeAck( const uint8_t* buffer, size_t length, uint32_t* sequence )
+{
+    if ( length < FRAME_ACK_SIZE )
+    {
+        return 0;
+    }
+    if ( get32( &( buffer[0] ) ) != FRAME_ACK_MAGIC )
+    {
+        return -1;
+    }
+
+    *sequence = get32( &( buffer[4] ) );
+    return FRAME_ACK_SIZE;
+}
@@ -0,0 +1,208 @@
+/**
+ * @file frame.h
+ * @author Simon Udsen
+ * @date 2026-10-18
+ * @brief Binary frames of acceleration samples
+ * @details A frame is a header followed by a payload of samples, or of window
+ * results. All fields are little endian:
+ *
+ * | Offset | Size | Field                                        |
+ * |--------|------|----------------------------------------------|
+ * | 0      | 4    | Magic, "STPF"                                |
+ * | 4      | 1    | Version, FRAME_VERSION                       |
+ * | 5      | 1    | Payload encoding, FRAME_ENCODING_*           |
+ * | 6      | 2    | Sample count, or window count for results    |
+ * | 8      | 12   | Device ID                                    |
+ * | 20     | 4    | Sequence number, counting frames             |
+ * | 24     | 4    | Payload length in bytes                      |
+ * | 28     | 4    | CRC32 of header bytes 0-27 and the payload   |
+ *
+ * With FRAME_ENCODING_DELTA, the payload is encoded by samplecodec.h. With
+ * FRAME_ENCODING_PACKED, every sample is FRAME_SAMPLE_SIZE bytes:
+ *
+ * | Offset | Size | Field                                        |
+ * |--------|------|----------------------------------------------|
+ * | 0      | 4    | Timestamp in microseconds                    |
+ * | 4      | 6    | X, Y and Z acceleration                      |
+ * | 10     | 1    | Flags, bit 0 is step                         |
+ * | 11     | 1    | Samples lost right before this one           |
+ *
+ * With FRAME_ENCODING_RESULTS, every window result is FRAME_RESULT_SIZE bytes:
+ *
+ * | Offset | Size | Field                                        |
+ * |--------|------|----------------------------------------------|
+ * | 0      | 4    | Timestamp of first sample in microseconds    |
+ * | 4      | 12   | Statistical features, 6 signed 16 bit values |
+ * | 16     | 2    | Steps predicted                              |
+ * | 18     | 2    | Samples lost in window                       |
+ *
+ * The server acknowledges frames with an 8 byte message, that releases every
+ * frame before the sequence number in it:
+ *
+ * | Offset | Size | Field                                        |
+ * |--------|------|----------------------------------------------|
+ * | 0      | 4    | Magic, "STPA"                                |
+ * | 4      | 4    | Sequence number of next frame expected       |
+ *
+ * The module does not depend on Device OS, so frames can be built and checked
+ * on a host as well.
+ */
+#ifndef FRAME_H
+#define FRAME_H
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include <stddef.h> // size_t
+#include <stdint.h> // Standard integer types
+
+#include "config.h" // Project configuration
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+#define FRAME_MAGIC 0x46505453UL // "STPF" read as little endian
+#define FRAME_VERSION 2          // Version of frame layout
+#define FRAME_DEVICE_ID_SIZE 12  // Size of device ID in bytes
+#define FRAME_HEADER_SIZE 32     // Size of frame header in bytes
+#define FRAME_MAX_PAYLOAD 0xFFFF // Largest payload accepted by the decoder
+#define FRAME_SAMPLE_SIZE 12     // Size of a packed sample in bytes
+#define FRAME_FLAG_STEP 0x01     // Sample flag for step
+#define FRAME_RESULT_SIZE 20     // Size of a packed window result in bytes
+
+#define FRAME_ACK_MAGIC 0x41505453UL // "STPA" read as little endian
+#define FRAME_ACK_SIZE 8             // Size of acknowledgement in bytes
+
+#define FRAME_SIZE( sampleCount ) ( FRAME_HEADER_SIZE + ( sampleCount ) * FRAME_SAMPLE_SIZE ) // Size of a packed frame
+#define FRAME_RESULTS_SIZE( windowCount )                                                                              \
+    ( FRAME_HEADER_SIZE + ( windowCount ) * FRAME_RESULT_SIZE ) // Size of a frame of window results
+
+static_assert( 4 + WINDOW_RESULT_NUM_FEATURES * 2 + 4 == FRAME_RESULT_SIZE,
+               "Packed window result must have room for every feature" );
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+// Encodings of frame payload
+typedef enum frame_encoding_
+{
+    FRAME_ENCODING_PACKED = 0,  // FRAME_SAMPLE_SIZE bytes per sample
+    FRAME_ENCODING_DELTA = 1,   // Delta and varint encoded, see samplecodec.h
+    FRAME_ENCODING_RESULTS = 2, // FRAME_RESULT_SIZE bytes per window result
+} frame_encoding_t;
+
+// Decoded frame header
+typedef struct frame_header_
+{
+    uint8_t version;                        // Version of frame layout
+    frame_encoding_t encoding;              // Encoding of payload
+    uint16_t sampleCount;                   // Number of samples in frame
+    uint32_t payloadLength;                 // Length of payload in bytes
+    uint8_t deviceId[FRAME_DEVICE_ID_SIZE]; // ID of device that sent the frame
+    uint32_t sequence;                      // Sequence number of frame
+    uint32_t crc;                           // CRC32 of frame
+} frame_header_t;
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+/**
+ * Updates a CRC32 (IEEE 802.3, as used by zlib) with more data
+ * @param[in] crc CRC of previous data, or 0 for the first data
+ * @param[in] data Data to add
+ * @param[in] length Length of data in bytes
+ * @returns Updated CRC
+ */
+uint32_t frame_crc32( uint32_t crc, const uint8_t* data, size_t length );
+
+/**************************************************************/
+/**
+ * Packs a sample into a frame buffer
+ * @param[out] buffer Frame buffer, at least FRAME_SIZE( index + 1 ) bytes
+ * @param[in] index Index of sample in frame
+ * @param[in] sample Sample to pack
+ */
+void frame_putSample( uint8_t* buffer, uint16_t index, const acceleration_sample_t* sample );
+
+/**************************************************************/
+/**
+ * Writes the header of a frame, once its payload is in place
+ * @param[in,out] buffer Frame buffer, with the payload at FRAME_HEADER_SIZE
+ * @param[in] deviceId Device ID of FRAME_DEVICE_ID_SIZE bytes
+ * @param[in] sequence Sequence number of frame
+ * @param[in] encoding Encoding of payload
+ * @param[in] sampleCount Number of samples in payload
+ * @param[in] payloadLength Length of payload in bytes
+ * @returns Size of frame in bytes
+ */
+size_t frame_finish( uint8_t* buffer,
+                     const uint8_t* deviceId,
+                     uint32_t sequence,
+                     frame_encoding_t encoding,
+                     uint16_t sampleCount,
+                     size_t payloadLength );
+
+/**************************************************************/
+/**
+ * Decodes the header of a frame, and checks its CRC
+ * @param[in] buffer Received data, starting at a frame
+ * @param[in] length Length of received data in bytes
+ * @param[out] header Decoded header
+ * @returns Size of frame in bytes, 0 if more data is needed, or -1 if the
+ * data is not a valid frame
+ */
+int frame_decodeHeader( const uint8_t* buffer, size_t length, frame_header_t* header );
+
+/**************************************************************/
+/**
+ * Unpacks a sample from a FRAME_ENCODING_PACKED frame, that has been checked
+ * with frame_decodeHeader
+ * @param[in] buffer Frame buffer
+ * @param[in] index Index of sample in frame
+ * @param[out] sample Unpacked sample
+ */
+void frame_getSample( const uint8_t* buffer, uint16_t index, acceleration_sample_t* sample );
+
+/**************************************************************/
+/**
+ * Packs a window result into a frame buffer
+ * @param[out] buffer Frame buffer, at least FRAME_RESULTS_SIZE( index + 1 )
+ * bytes
+ * @param[in] index Index of window result in frame
+ * @param[in] result Window result to pack
+ */
+void frame_putResult( uint8_t* buffer, uint16_t index, const window_result_t* result );
+
+/**************************************************************/
+/**
+ * Unpacks a window result from a FRAME_ENCODING_RESULTS frame, that has been
+ * checked with frame_decodeHeader
+ * @param[in] buffer Frame buffer
+ * @param[in] index Index of window result in frame
+ * @param[out] result Unpacked window result
+ */
+void frame_getResult( const uint8_t* buffer, uint16_t index, window_result_t* result );
+
+/**************************************************************/
+/**
+ * Writes an acknowledgement
+ * @param[out] buffer Buffer of at least FRAME_ACK_SIZE bytes
+ * @param[in] sequence Sequence number of next frame expected
+ */
+void frame_putAck( uint8_t* buffer, uint32_t sequence );
+
+/**************************************************************/
+/**
+ * Decodes an acknowledgement
+ * @param[in] buffer Received data, starting at an acknowledgement
+ * @param[in] length Length of received data in bytes
+ * @param[out] sequence Sequence number of next frame expected
+ * @returns FRAME_ACK_SIZE if an acknowledgement was decoded, 0 if more data is
+ * needed, or -1 if the data is not an acknowledgement
+ */
+int frame_decodeAck( const uint8_t* buffer, size_t length, uint32_t* sequence );
+
+#endif // FRAME_H
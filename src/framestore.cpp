@@ -0,0 +1,352 @@
+/**
+ * @file framestore.cpp
+ * @author Simon Udsen
+ * @date 2026-10-18
+ */
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include "framestore.h" // Header file for this module
+
+#include <fcntl.h>  // open
+#include <string.h> // memcpy
+#include <unistd.h> // read, write, lseek, ftruncate
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+#define SPILL_RECORD_HEADER_SIZE 8 // Length and sequence number before every frame in spill file
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+/**************************************************************/
+/*                          Private                           */
+/**************************************************************/
+
+/**************************************************************/
+// Check if sequence number a comes before b, allowing for wrap around
+static inline bool isBefore( uint32_t a, uint32_t b )
+{
+    return ( int32_t )( a - b ) < 0;
+}
+
+/**************************************************************/
+// Write little endian 32 bit value
+static void put32( uint8_t* buffer, uint32_t value )
+{
+    buffer[0] = ( uint8_t )value;
+    buffer[1] = ( uint8_t )( value >> 8 );
+    buffer[2] = ( uint8_t )( value >> 16 );
+    buffer[3] = ( uint8_t )( value >> 24 );
+}
+
+/**************************************************************/
+// Read little endian 32 bit value
+static uint32_t get32( const uint8_t* buffer )
+{
+    return ( uint32_t )buffer[0] | ( ( uint32_t )buffer[1] << 8 ) | ( ( uint32_t )buffer[2] << 16 ) |
+           ( ( uint32_t )buffer[3] << 24 );
+}
+
+/**************************************************************/
+// Read from spill file at an offset
+static bool spillRead( framestore_t* store, uint32_t offset, uint8_t* buffer, size_t length )
+{
+    return ( lseek( store->spillFile, ( off_t )offset, SEEK_SET ) == ( off_t )offset ) &&
+           ( read( store->spillFile, buffer, length ) == ( ssize_t )length );
+}
+
+/**************************************************************/
+// Empty the spill file
+static void spillTruncate( framestore_t* store )
+{
+    if ( ( store->spillFile >= 0 ) && ( store->spillWrite > 0 ) )
+    {
+        ftruncate( store->spillFile, 0 );
+    }
+    store->spillRead = 0;
+    store->spillWrite = 0;
+    store->spillCount = 0;
+    store->cursorInSpill = false;
+}
+
+/**************************************************************/
+// Give up on the frames in the spill file, after it could not be read
+static void spillFailed( framestore_t* store )
+{
+    store->dropped += store->spillCount;
+    spillTruncate( store );
+}
+
+/**************************************************************/
+// Append a frame to the spill file
+static bool spillAppend( framestore_t* store, const framestore_entry_t* entry )
+{
+    if ( ( store->spillFile < 0 ) ||
+         ( store->spillWrite + SPILL_RECORD_HEADER_SIZE + entry->length > store->spillMax ) )
+    {
+        return false;
+    }
+
+    uint8_t record[SPILL_RECORD_HEADER_SIZE];
+    put32( &( record[0] ), entry->length );
+    put32( &( record[4] ), entry->sequence );
+
+    // A failed write leaves spillWrite unchanged, so the partial record is
+    // overwritten by the next one
+    if ( ( lseek( store->spillFile, ( off_t )store->spillWrite, SEEK_SET ) != ( off_t )store->spillWrite ) ||
+         ( write( store->spillFile, record, sizeof( record ) ) != ( ssize_t )sizeof( record ) ) ||
+         ( write( store->spillFile, &( store->ring[entry->offset] ), entry->length ) != ( ssize_t )entry->length ) )
+    {
+        return false;
+    }
+
+    // The cursor follows the frame to the file, if it has not been sent yet
+    if ( !store->cursorInSpill && !isBefore( entry->sequence, store->cursorSequence ) )
+    {
+        store->cursorInSpill = true;
+        store->cursorOffset = store->spillWrite;
+    }
+
+    store->spillWrite += SPILL_RECORD_HEADER_SIZE + entry->length;
+    store->spillCount++;
+    return true;
+}
+
+/**************************************************************/
+// Remove the oldest frame from the ring
+static void popOldest( framestore_t* store )
+{
+    store->first = ( store->first + 1 ) % DATAROUTER_STORE_FRAMES;
+    store->count--;
+    if ( store->count == 0 )
+    {
+        store->first = 0;
+        store->head = 0;
+    }
+}
+
+/**************************************************************/
+// Make space in the ring by moving the oldest frame to the spill file, or
+// dropping it
+static void evictOldest( framestore_t* store )
+{
+    if ( !spillAppend( store, &( store->entries[store->first] ) ) )
+    {
+        store->dropped++;
+    }
+    popOldest( store );
+}
+
+/**************************************************************/
+// Find the offset in the ring to write a frame at, or -1 if it does not fit.
+// Frames are never split at the end of the ring, and the head never catches up
+// with the oldest frame, so head > oldest means the frames do not wrap
+static int32_t ringPlace( const framestore_t* store, uint32_t length )
+{
+    if ( store->count == 0 )
+    {
+        return 0;
+    }
+
+    uint32_t oldest = store->entries[store->first].offset;
+    if ( store->head > oldest )
+    {
+        if ( store->head + length <= DATAROUTER_STORE_SIZE )
+        {
+            return ( int32_t )store->head;
+        }
+        return ( length < oldest ) ? 0 : -1;
+    }
+    return ( store->head + length < oldest ) ? ( int32_t )store->head : -1;
+}
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+int framestore_init( framestore_t* store, const char* spillPath, uint32_t spillMax )
+{
+    int result = 0;
+
+    store->spillFile = -1;
+    store->spillMax = spillMax;
+    store->spillWrite = 0;
+    if ( spillPath != NULL )
+    {
+        store->spillFile = open( spillPath, O_RDWR | O_CREAT | O_TRUNC, 0644 );
+        if ( store->spillFile < 0 )
+        {
+            result = -1;
+        }
+    }
+
+    framestore_clear( store );
+    return result;
+}
+
+/**************************************************************/
+void framestore_clear( framestore_t* store )
+{
+    store->first = 0;
+    store->count = 0;
+    store->head = 0;
+    spillTruncate( store );
+    store->cursorOffset = 0;
+    store->cursorSequence = 0;
+    store->dropped = 0;
+}
+
+/**************************************************************/
+int framestore_push( framestore_t* store, const uint8_t* frame, size_t length, uint32_t sequence )
+{
+    if ( ( length == 0 ) || ( length >= DATAROUTER_STORE_SIZE ) )
+    {
+        return -1;
+    }
+
+    // Every frame in an empty store has been sent, so the new one is next
+    if ( framestore_count( store ) == 0 )
+    {
+        store->cursorSequence = sequence;
+    }
+
+    int32_t offset = -1;
+    while ( true )
+    {
+        if ( store->count < DATAROUTER_STORE_FRAMES )
+        {
+            offset = ringPlace( store, ( uint32_t )length );
+            if ( offset >= 0 )
+            {
+                break;
+            }
+        }
+        evictOldest( store );
+    }
+
+    framestore_entry_t* entry = &( store->entries[( store->first + store->count ) % DATAROUTER_STORE_FRAMES] );
+    entry->offset = ( uint32_t )offset;
+    entry->length = ( uint32_t )length;
+    entry->sequence = sequence;
+    memcpy( &( store->ring[offset] ), frame, length );
+
+    store->head = ( uint32_t )offset + ( uint32_t )length;
+    store->count++;
+    return 0;
+}
+
+/**************************************************************/
+int framestore_next( framestore_t* store, uint8_t* buffer, size_t size, uint32_t* sequence )
+{
+    // Spilled frames are older than those in the ring, so they are sent first
+    if ( store->cursorInSpill )
+    {
+        if ( store->cursorOffset < store->spillWrite )
+        {
+            uint8_t record[SPILL_RECORD_HEADER_SIZE];
+            if ( !spillRead( store, store->cursorOffset, record, sizeof( record ) ) )
+            {
+                spillFailed( store );
+                return -1;
+            }
+            uint32_t length = get32( &( record[0] ) );
+            if ( ( length > size ) ||
+                 !spillRead( store, store->cursorOffset + SPILL_RECORD_HEADER_SIZE, buffer, length ) )
+            {
+                spillFailed( store );
+                return -1;
+            }
+
+            *sequence = get32( &( record[4] ) );
+            store->cursorOffset += SPILL_RECORD_HEADER_SIZE + length;
+            store->cursorSequence = *sequence + 1;
+            return ( int )length;
+        }
+        store->cursorInSpill = false;
+    }
+
+    for ( uint16_t i = 0; i < store->count; i++ )
+    {
+        const framestore_entry_t* entry = &( store->entries[( store->first + i ) % DATAROUTER_STORE_FRAMES] );
+        if ( !isBefore( entry->sequence, store->cursorSequence ) )
+        {
+            if ( entry->length > size )
+            {
+                return -1;
+            }
+            memcpy( buffer, &( store->ring[entry->offset] ), entry->length );
+            *sequence = entry->sequence;
+            store->cursorSequence = entry->sequence + 1;
+            return ( int )entry->length;
+        }
+    }
+
+    return 0;
+}
+
+/**************************************************************/
+void framestore_rewind( framestore_t* store )
+{
+    store->cursorInSpill = ( store->spillCount > 0 );
+    store->cursorOffset = store->spillRead;
+    if ( store->count > 0 )
+    {
+        store->cursorSequence = store->entries[store->first].sequence;
+    }
+}
+
+/**************************************************************/
+void framestore_acknowledge( framestore_t* store, uint32_t sequence )
+{
+    while ( store->spillCount > 0 )
+    {
+        uint8_t record[SPILL_RECORD_HEADER_SIZE];
+        if ( !spillRead( store, store->spillRead, record, sizeof( record ) ) )
+        {
+            spillFailed( store );
+            break;
+        }
+        if ( !isBefore( get32( &( record[4] ) ), sequence ) )
+        {
+            break;
+        }
+        store->spillRead += SPILL_RECORD_HEADER_SIZE + get32( &( record[0] ) );
+        store->spillCount--;
+    }
+    if ( store->spillCount == 0 )
+    {
+        spillTruncate( store );
+    }
+    else if ( store->cursorInSpill && ( store->cursorOffset < store->spillRead ) )
+    {
+        store->cursorOffset = store->spillRead;
+    }
+
+    while ( ( store->count > 0 ) && isBefore( store->entries[store->first].sequence, sequence ) )
+    {
+        popOldest( store );
+    }
+    if ( isBefore( store->cursorSequence, sequence ) )
+    {
+        store->cursorSequence = sequence;
+    }
+}
+
+/**************************************************************/
+uint32_t framestore_count( const framestore_t* store )
+{
+    return store->count + store->spillCount;
+}
+
+/**************************************************************/
+uint32_t framestore_takeDropped( framestore_t* store )
+{
+    uint32_t dropped = store->dropped;
+    store->dropped = 0;
+    return dropped;
+}
@@ -0,0 +1,153 @@
+/**
+ * @file framestore.h
+ * @author Simon Udsen
+ * @date 2026-10-18
+ * @brief Store of frames that the server has not acknowledged yet
+ * @details Frames are kept in a RAM ring until the server acknowledges them,
+ * so they can be sent again after a lost connection. Every frame is stored with
+ * its sequence number, and the server acknowledges by sending the sequence
+ * number it expects next, which releases every frame before it.
+ *
+ * When the ring is full, the oldest frame is moved to a spill file in flash if
+ * one is open, and dropped otherwise. Spilled frames are always older than the
+ * frames in RAM, so the file is only appended to and read in order, and it is
+ * truncated once every frame in it has been acknowledged. In the file, every
+ * frame is preceded by its length and sequence number, as 32 bit little endian
+ * values.
+ *
+ * A send cursor tracks the next frame to send. It moves forward as frames are
+ * read, and is rewound to the oldest frame after a reconnect.
+ *
+ * The module does not depend on Device OS, and is not thread safe.
+ */
+#ifndef FRAMESTORE_H
+#define FRAMESTORE_H
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include <stddef.h> // size_t
+#include <stdint.h> // Standard integer types
+
+#include "config.h" // Project configuration
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+// Frame in the RAM ring
+typedef struct framestore_entry_
+{
+    uint32_t offset;   // Offset of frame in ring
+    uint32_t length;   // Length of frame in bytes
+    uint32_t sequence; // Sequence number of frame
+} framestore_entry_t;
+
+// Store of unacknowledged frames
+typedef struct framestore_
+{
+    uint8_t ring[DATAROUTER_STORE_SIZE];                 // Frame data
+    framestore_entry_t entries[DATAROUTER_STORE_FRAMES]; // Frames in ring, oldest first from first
+    uint16_t first;                                      // Index of oldest entry
+    uint16_t count;                                      // Number of entries
+    uint32_t head;                                       // Offset in ring to write next frame at
+
+    int spillFile;       // File descriptor of spill file, or -1 without one
+    uint32_t spillRead;  // Offset of oldest frame in spill file
+    uint32_t spillWrite; // Offset to append next frame at
+    uint32_t spillCount; // Frames in spill file
+    uint32_t spillMax;   // Largest size of spill file in bytes
+
+    bool cursorInSpill;      // Next frame to send is in spill file
+    uint32_t cursorOffset;   // Offset of next frame to send in spill file
+    uint32_t cursorSequence; // Lowest sequence number to send next from ring
+
+    uint32_t dropped; // Frames dropped since framestore_takeDropped
+} framestore_t;
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+/**
+ * Initializes an empty store
+ * @param[out] store Store to initialize
+ * @param[in] spillPath Path of spill file, which is truncated, or NULL to keep
+ * frames in RAM only
+ * @param[in] spillMax Largest size of spill file in bytes
+ * @returns Status
+ * @retval 0: Success
+ * @retval -1: Spill file could not be opened, the store is RAM only
+ */
+int framestore_init( framestore_t* store, const char* spillPath, uint32_t spillMax );
+
+/**************************************************************/
+/**
+ * Removes all frames, and truncates the spill file
+ * @param[in,out] store Store to clear
+ */
+void framestore_clear( framestore_t* store );
+
+/**************************************************************/
+/**
+ * Adds a frame, moving or dropping the oldest frames if there is no space
+ * @param[in,out] store Store to add to
+ * @param[in] frame Frame to add
+ * @param[in] length Length of frame in bytes
+ * @param[in] sequence Sequence number of frame, one higher than the last one
+ * @returns Status
+ * @retval 0: Success
+ * @retval -1: Frame is larger than the ring
+ */
+int framestore_push( framestore_t* store, const uint8_t* frame, size_t length, uint32_t sequence );
+
+/**************************************************************/
+/**
+ * Copies the next frame to send, and moves the send cursor past it
+ * @param[in,out] store Store to read from
+ * @param[out] buffer Buffer to copy frame to
+ * @param[in] size Size of buffer
+ * @param[out] sequence Sequence number of frame
+ * @returns Length of frame, 0 if every frame has been sent, or -1 if the frame
+ * could not be read
+ */
+int framestore_next( framestore_t* store, uint8_t* buffer, size_t size, uint32_t* sequence );
+
+/**************************************************************/
+/**
+ * Moves the send cursor back to the oldest frame
+ * @param[in,out] store Store to rewind
+ */
+void framestore_rewind( framestore_t* store );
+
+/**************************************************************/
+/**
+ * Removes every frame before a sequence number
+ * @param[in,out] store Store to remove from
+ * @param[in] sequence Sequence number the server expects next
+ */
+void framestore_acknowledge( framestore_t* store, uint32_t sequence );
+
+/**************************************************************/
+/**
+ * Gets the number of frames in the store
+ * @param[in] store Store to count
+ * @returns Frames in RAM and in the spill file
+ */
+uint32_t framestore_count( const framestore_t* store );
+
+/**************************************************************/
+/**
+ * Gets the number of frames dropped because the store was full, or the spill
+ * file could not be read, and resets it
+ * @param[in,out] store Store to check
+ * @returns Frames dropped since the last call
+ */
+uint32_t framestore_takeDropped( framestore_t* store );
+
+#endif // FRAMESTORE_H
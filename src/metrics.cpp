@@ -0,0 +1,320 @@
+/**
+ * @file metrics.cpp
+ * @author Simon Udsen
+ * @date 2026-10-18
+ */
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include "metrics.h" // Header file for this module
+
+#include <atomic>  // Lock-free counters
+#include <stdio.h> // snprintf
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+#define STACK_PAINT_PATTERN 0xA5A5A5A5UL // Pattern written to unused stack
+#define STACK_PAINT_TOP_MARGIN 64        // Bytes below the current frame that are left alone
+#define STACK_PAINT_BOTTOM_MARGIN 512    // Bytes above the stack start that are left alone
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+// Painted region of a thread stack
+typedef struct metrics_stack_
+{
+    std::atomic<uintptr_t> base; // Stack pointer when the thread started
+    std::atomic<uintptr_t> low;  // Lowest painted address
+    std::atomic<uintptr_t> high; // Highest painted address (exclusive)
+} metrics_stack_t;
+
+/**************************************************************/
+/*                          Private                           */
+/**************************************************************/
+
+static std::atomic<uint32_t> queueDepth( 0 );
+static std::atomic<uint32_t> queueHighWater( 0 );
+static std::atomic<uint32_t> samplesDropped( 0 );
+static std::atomic<uint32_t> startupWindowsDiscarded( 0 );
+static std::atomic<uint32_t> periodOverruns( 0 );
+static std::atomic<uint32_t> overloadEvents( 0 );
+static std::atomic<uint32_t> samplesDecimated( 0 );
+static std::atomic<uint32_t> degradedWindows( 0 );
+static std::atomic<uint32_t> gapWindows( 0 );
+static std::atomic<uint32_t> periodMinUs( 0 );
+static std::atomic<uint32_t> periodMaxUs( 0 );
+static std::atomic<uint32_t> periodStdDevUs( 0 );
+static std::atomic<int32_t> driftUs( 0 );
+static std::atomic<uint32_t> deadlineMisses( 0 );
+static std::atomic<uint32_t> latencyMaxUs( 0 );
+static std::atomic<uint32_t> networkWrites( 0 );
+static std::atomic<uint32_t> networkBytes( 0 );
+static std::atomic<uint32_t> reconnects( 0 );
+static std::atomic<uint32_t> framesDropped( 0 );
+static std::atomic<uint32_t> resultsDropped( 0 );
+
+static metrics_stack_t stacks[METRICS_THREAD_COUNT];
+
+/**************************************************************/
+// Raise an atomic maximum to value, if it is lower
+static void updateMax( std::atomic<uint32_t>* max, uint32_t value )
+{
+    uint32_t current = max->load( std::memory_order_relaxed );
+    while ( ( value > current ) && !max->compare_exchange_weak( current, value, std::memory_order_relaxed ) )
+    {
+    }
+}
+
+/**************************************************************/
+// Find deepest stack usage of a thread by scanning for the first overwritten word
+static uint32_t stackHighWater( metrics_stack_t* stack )
+{
+    uintptr_t base = stack->base.load( std::memory_order_relaxed );
+    uintptr_t low = stack->low.load( std::memory_order_relaxed );
+    uintptr_t high = stack->high.load( std::memory_order_relaxed );
+
+    if ( base == 0 )
+    {
+        // Thread has not started
+        return 0;
+    }
+
+    for ( volatile uint32_t* word = ( volatile uint32_t* )low; ( uintptr_t )word < high; word++ )
+    {
+        if ( *word != STACK_PAINT_PATTERN )
+        {
+            return ( uint32_t )( base - ( uintptr_t )word );
+        }
+    }
+
+    return ( uint32_t )( base - high );
+}
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+void metrics_reset()
+{
+    queueHighWater.store( queueDepth.load( std::memory_order_relaxed ), std::memory_order_relaxed );
+    samplesDropped.store( 0, std::memory_order_relaxed );
+    startupWindowsDiscarded.store( 0, std::memory_order_relaxed );
+    periodOverruns.store( 0, std::memory_order_relaxed );
+    overloadEvents.store( 0, std::memory_order_relaxed );
+    samplesDecimated.store( 0, std::memory_order_relaxed );
+    degradedWindows.store( 0, std::memory_order_relaxed );
+    gapWindows.store( 0, std::memory_order_relaxed );
+    periodMinUs.store( 0, std::memory_order_relaxed );
+    periodMaxUs.store( 0, std::memory_order_relaxed );
+    periodStdDevUs.store( 0, std::memory_order_relaxed );
+    driftUs.store( 0, std::memory_order_relaxed );
+    deadlineMisses.store( 0, std::memory_order_relaxed );
+    latencyMaxUs.store( 0, std::memory_order_relaxed );
+    networkWrites.store( 0, std::memory_order_relaxed );
+    networkBytes.store( 0, std::memory_order_relaxed );
+    reconnects.store( 0, std::memory_order_relaxed );
+    framesDropped.store( 0, std::memory_order_relaxed );
+    resultsDropped.store( 0, std::memory_order_relaxed );
+}
+
+/**************************************************************/
+void metrics_queueLevel( uint32_t depth )
+{
+    queueDepth.store( depth, std::memory_order_relaxed );
+    updateMax( &queueHighWater, depth );
+}
+
+/**************************************************************/
+uint32_t metrics_queueDepth()
+{
+    return queueDepth.load( std::memory_order_relaxed );
+}
+
+/**************************************************************/
+void metrics_sampleDropped( uint32_t samples )
+{
+    samplesDropped.fetch_add( samples, std::memory_order_relaxed );
+}
+
+/**************************************************************/
+void metrics_overloadEvent()
+{
+    overloadEvents.fetch_add( 1, std::memory_order_relaxed );
+}
+
+/**************************************************************/
+void metrics_sampleDecimated()
+{
+    samplesDecimated.fetch_add( 1, std::memory_order_relaxed );
+}
+
+/**************************************************************/
+void metrics_degradedWindow()
+{
+    degradedWindows.fetch_add( 1, std::memory_order_relaxed );
+}
+
+/**************************************************************/
+void metrics_gapWindow()
+{
+    gapWindows.fetch_add( 1, std::memory_order_relaxed );
+}
+
+/**************************************************************/
+void metrics_startupWindowDiscarded()
+{
+    startupWindowsDiscarded.fetch_add( 1, std::memory_order_relaxed );
+}
+
+/**************************************************************/
+void metrics_periodOverrun()
+{
+    periodOverruns.fetch_add( 1, std::memory_order_relaxed );
+}
+
+/**************************************************************/
+void metrics_deadlineMiss( uint32_t ticks )
+{
+    deadlineMisses.fetch_add( ticks, std::memory_order_relaxed );
+}
+
+/**************************************************************/
+void metrics_sampleLatency( uint32_t latencyUs )
+{
+    updateMax( &latencyMaxUs, latencyUs );
+}
+
+/**************************************************************/
+void metrics_networkWrite( uint32_t bytes )
+{
+    networkWrites.fetch_add( 1, std::memory_order_relaxed );
+    networkBytes.fetch_add( bytes, std::memory_order_relaxed );
+}
+
+/**************************************************************/
+void metrics_reconnect()
+{
+    reconnects.fetch_add( 1, std::memory_order_relaxed );
+}
+
+/**************************************************************/
+void metrics_framesDropped( uint32_t frames )
+{
+    framesDropped.fetch_add( frames, std::memory_order_relaxed );
+}
+
+/**************************************************************/
+void metrics_resultDropped()
+{
+    resultsDropped.fetch_add( 1, std::memory_order_relaxed );
+}
+
+/**************************************************************/
+void metrics_setSampleTiming( uint32_t minUs, uint32_t maxUs, uint32_t stdDevUs, int32_t drift )
+{
+    periodMinUs.store( minUs, std::memory_order_relaxed );
+    periodMaxUs.store( maxUs, std::memory_order_relaxed );
+    periodStdDevUs.store( stdDevUs, std::memory_order_relaxed );
+    driftUs.store( drift, std::memory_order_relaxed );
+}
+
+/**************************************************************/
+void metrics_threadStart( metrics_thread_t thread, size_t stackSize )
+{
+    // The stack pointer on entry is close to the top of the stack, as this is
+    // called first thing in the thread function
+    uint32_t marker = 0;
+    uintptr_t base = ( uintptr_t )&marker;
+
+    uintptr_t high = ( base - STACK_PAINT_TOP_MARGIN ) & ~( uintptr_t )( sizeof( uint32_t ) - 1 );
+    uintptr_t low = ( base - stackSize + STACK_PAINT_BOTTOM_MARGIN ) & ~( uintptr_t )( sizeof( uint32_t ) - 1 );
+
+    for ( volatile uint32_t* word = ( volatile uint32_t* )low; ( uintptr_t )word < high; word++ )
+    {
+        *word = STACK_PAINT_PATTERN;
+    }
+
+    stacks[thread].low.store( low, std::memory_order_relaxed );
+    stacks[thread].high.store( high, std::memory_order_relaxed );
+    stacks[thread].base.store( base, std::memory_order_release );
+}
+
+/**************************************************************/
+void metrics_get( metrics_snapshot_t* snapshot )
+{
+    snapshot->queueDepth = metrics_queueDepth();
+    snapshot->queueHighWater = queueHighWater.load( std::memory_order_relaxed );
+    snapshot->samplesDropped = samplesDropped.load( std::memory_order_relaxed );
+    snapshot->startupWindowsDiscarded = startupWindowsDiscarded.load( std::memory_order_relaxed );
+    snapshot->periodOverruns = periodOverruns.load( std::memory_order_relaxed );
+    snapshot->overloadEvents = overloadEvents.load( std::memory_order_relaxed );
+    snapshot->samplesDecimated = samplesDecimated.load( std::memory_order_relaxed );
+    snapshot->degradedWindows = degradedWindows.load( std::memory_order_relaxed );
+    snapshot->gapWindows = gapWindows.load( std::memory_order_relaxed );
+    snapshot->periodMinUs = periodMinUs.load( std::memory_order_relaxed );
+    snapshot->periodMaxUs = periodMaxUs.load( std::memory_order_relaxed );
+    snapshot->periodStdDevUs = periodStdDevUs.load( std::memory_order_relaxed );
+    snapshot->driftUs = driftUs.load( std::memory_order_relaxed );
+    snapshot->deadlineMisses = deadlineMisses.load( std::memory_order_relaxed );
+    snapshot->latencyMaxUs = latencyMaxUs.load( std::memory_order_relaxed );
+    snapshot->networkWrites = networkWrites.load( std::memory_order_relaxed );
+    snapshot->networkBytes = networkBytes.load( std::memory_order_relaxed );
+    snapshot->reconnects = reconnects.load( std::memory_order_relaxed );
+    snapshot->framesDropped = framesDropped.load( std::memory_order_relaxed );
+    snapshot->resultsDropped = resultsDropped.load( std::memory_order_relaxed );
+
+    for ( uint8_t i = 0; i < METRICS_THREAD_COUNT; i++ )
+    {
+        snapshot->stackHighWater[i] = stackHighWater( &( stacks[i] ) );
+    }
+}
+
+/**************************************************************/
+int metrics_toJson( char* buffer, size_t size )
+{
+    metrics_snapshot_t snapshot;
+    metrics_get( &snapshot );
+
+    int length = snprintf( buffer,
+                           size,
+                           "{\"qd\":%lu,\"qhw\":%lu,\"drop\":%lu,\"disc\":%lu,\"ovr\":%lu,\"full\":%lu,\"dec\":%lu,"
+                           "\"deg\":%lu,\"gap\":%lu,\"per\":[%lu,%lu,%lu],\"drift\":%ld,"
+                           "\"miss\":%lu,\"lat\":%lu,\"seg\":%lu,\"tx\":%lu,\"rc\":%lu,\"fdrop\":%lu,\"rdrop\":%lu,"
+                           "\"stk\":[%lu,%lu,%lu,%lu,%lu,%lu]}",
+                           ( unsigned long )snapshot.queueDepth,
+                           ( unsigned long )snapshot.queueHighWater,
+                           ( unsigned long )snapshot.samplesDropped,
+                           ( unsigned long )snapshot.startupWindowsDiscarded,
+                           ( unsigned long )snapshot.periodOverruns,
+                           ( unsigned long )snapshot.overloadEvents,
+                           ( unsigned long )snapshot.samplesDecimated,
+                           ( unsigned long )snapshot.degradedWindows,
+                           ( unsigned long )snapshot.gapWindows,
+                           ( unsigned long )snapshot.periodMinUs,
+                           ( unsigned long )snapshot.periodMaxUs,
+                           ( unsigned long )snapshot.periodStdDevUs,
+                           ( long )snapshot.driftUs,
+                           ( unsigned long )snapshot.deadlineMisses,
+                           ( unsigned long )snapshot.latencyMaxUs,
+                           ( unsigned long )snapshot.networkWrites,
+                           ( unsigned long )snapshot.networkBytes,
+                           ( unsigned long )snapshot.reconnects,
+                           ( unsigned long )snapshot.framesDropped,
+                           ( unsigned long )snapshot.resultsDropped,
+                           ( unsigned long )snapshot.stackHighWater[METRICS_THREAD_ACCELEROMETER],
+                           ( unsigned long )snapshot.stackHighWater[METRICS_THREAD_DATAROUTER],
+                           ( unsigned long )snapshot.stackHighWater[METRICS_THREAD_BUFFER],
+                           ( unsigned long )snapshot.stackHighWater[METRICS_THREAD_PREDICTOR],
+                           ( unsigned long )snapshot.stackHighWater[METRICS_THREAD_EVENTLOOP],
+                           ( unsigned long )snapshot.stackHighWater[METRICS_THREAD_UPLINK] );
+
+    if ( ( length < 0 ) || ( ( size_t )length >= size ) )
+    {
+        return -1;
+    }
+    return length;
+}
@@ -0,0 +1,222 @@
+/**
+ * @file metrics.h
+ * @author Simon Udsen
+ * @date 2026-10-18
+ * @brief Runtime health metrics of the sampling pipeline
+ * @details Counts sample stream depth and high-water mark, dropped samples, startup
+ * windows discarded by the predictor, sampling period overruns, jitter and deadline
+ * misses, overload interventions, network writes and bytes, reconnects,
+ * frames dropped by the datarouter store, window results dropped from a full
+ * result queue, and the stack high-water mark of every pipeline thread. All
+ * counters are relaxed atomics, so they can be updated and read from any thread
+ * without locking.
+ *
+ * The stack high-water mark is found by painting the unused part of a thread's
+ * stack with a known pattern when the thread starts, and later scanning for the
+ * deepest word that has been overwritten.
+ */
+#ifndef METRICS_H
+#define METRICS_H
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include <stddef.h> // size_t
+
+#include "config.h" // Project configuration
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+// Threads of the pipeline, that stack usage is tracked for
+typedef enum metrics_thread_
+{
+    METRICS_THREAD_ACCELEROMETER, // getMeasurement
+    METRICS_THREAD_DATAROUTER,    // dataRouterFunc
+    METRICS_THREAD_BUFFER,        // bufferPiping
+    METRICS_THREAD_PREDICTOR,     // predictSteps
+    METRICS_THREAD_EVENTLOOP,     // eventLoop
+    METRICS_THREAD_UPLINK,        // dataRouterUplinkFunc
+    METRICS_THREAD_COUNT
+} metrics_thread_t;
+
+// Copy of all metrics at a single point in time
+typedef struct metrics_snapshot_
+{
+    uint32_t queueDepth;                           // Samples the slowest gating reader has not read
+    uint32_t queueHighWater;                       // Maximum sample stream depth since reset
+    uint32_t samplesDropped;                       // Samples lost before reaching a consumer
+    uint32_t startupWindowsDiscarded;              // First windows after a start, not predicted
+    uint32_t periodOverruns;                       // Sampling periods that took too long
+    uint32_t overloadEvents;                       // Times the sample stream was found full
+    uint32_t samplesDecimated;                     // Samples dropped by decimation
+    uint32_t degradedWindows;                      // Windows predicted with the cheaper model
+    uint32_t gapWindows;                           // Windows containing dropped samples
+    uint32_t periodMinUs;                          // Shortest sample interval
+    uint32_t periodMaxUs;                          // Longest sample interval
+    uint32_t periodStdDevUs;                       // Standard deviation of sample interval
+    int32_t driftUs;                               // Cumulative drift of sample clock from ideal
+    uint32_t deadlineMisses;                       // Sample timer ticks due before an earlier sample was taken
+    uint32_t latencyMaxUs;                         // Longest time from sample timer tick to sample
+    uint32_t networkWrites;                        // Writes to the TCP server, roughly TCP segments
+    uint32_t networkBytes;                         // Bytes written to the TCP server
+    uint32_t reconnects;                           // Connections made to the TCP server
+    uint32_t framesDropped;                        // Frames dropped before the server acknowledged them
+    uint32_t resultsDropped;                       // Window results dropped as the result queue was full
+    uint32_t stackHighWater[METRICS_THREAD_COUNT]; // Maximum stack usage of each thread in bytes
+} metrics_snapshot_t;
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+/**
+ * Clears all counters. Stack high-water marks are kept, as the stacks are only
+ * painted once when the threads start
+ */
+void metrics_reset();
+
+/**************************************************************/
+/**
+ * Records the depth of the sample stream, after a sample was written to it
+ * @param[in] depth Samples the slowest gating reader has not read
+ */
+void metrics_queueLevel( uint32_t depth );
+
+/**************************************************************/
+/**
+ * Gets the depth of the sample stream when it was last written to
+ * @returns Queue depth
+ */
+uint32_t metrics_queueDepth();
+
+/**************************************************************/
+/**
+ * Records samples dropped before reaching the sample stream, or lost by one
+ * of its readers
+ * @param[in] samples Samples dropped
+ */
+void metrics_sampleDropped( uint32_t samples );
+
+/**************************************************************/
+/**
+ * Records that the sample stream was found full, and an overload policy was
+ * applied
+ */
+void metrics_overloadEvent();
+
+/**************************************************************/
+/**
+ * Records that a sample was dropped by decimation
+ */
+void metrics_sampleDecimated();
+
+/**************************************************************/
+/**
+ * Records that a window was predicted with the cheaper model
+ */
+void metrics_degradedWindow();
+
+/**************************************************************/
+/**
+ * Records that a window contained dropped samples, and its step count was extrapolated
+ */
+void metrics_gapWindow();
+
+/**************************************************************/
+/**
+ * Records that the first window after a start was discarded without a
+ * prediction, as it may contain garbage data
+ */
+void metrics_startupWindowDiscarded();
+
+/**************************************************************/
+/**
+ * Records that a sampling period took longer than allowed
+ */
+void metrics_periodOverrun();
+
+/**************************************************************/
+/**
+ * Records sample timer ticks that arrived before the sample of an earlier
+ * tick was taken, so their samples were due before they could be taken
+ * @param[in] ticks Number of ticks
+ */
+void metrics_deadlineMiss( uint32_t ticks );
+
+/**************************************************************/
+/**
+ * Records the time from a sample timer tick until the sample was taken
+ * @param[in] latencyUs Latency in microseconds
+ */
+void metrics_sampleLatency( uint32_t latencyUs );
+
+/**************************************************************/
+/**
+ * Records a write to the TCP server
+ * @param[in] bytes Bytes written
+ */
+void metrics_networkWrite( uint32_t bytes );
+
+/**************************************************************/
+/**
+ * Records a connection to the TCP server
+ */
+void metrics_reconnect();
+
+/**************************************************************/
+/**
+ * Records frames dropped by the datarouter before they were acknowledged
+ * @param[in] frames Frames dropped
+ */
+void metrics_framesDropped( uint32_t frames );
+
+/**************************************************************/
+/**
+ * Records a window result dropped as the result queue was full
+ */
+void metrics_resultDropped();
+
+/**************************************************************/
+/**
+ * Updates the sample interval statistics of the current measurement
+ * @param[in] minUs Shortest sample interval in microseconds
+ * @param[in] maxUs Longest sample interval in microseconds
+ * @param[in] stdDevUs Standard deviation of sample interval in microseconds
+ * @param[in] driftUs Time the latest sample is behind an ideal sample clock in microseconds
+ */
+void metrics_setSampleTiming( uint32_t minUs, uint32_t maxUs, uint32_t stdDevUs, int32_t driftUs );
+
+/**************************************************************/
+/**
+ * Paints the unused stack of the calling thread. Must be called first thing in
+ * the thread function
+ * @param[in] thread Thread that is calling
+ * @param[in] stackSize Size of stack the thread was created with, in bytes
+ */
+void metrics_threadStart( metrics_thread_t thread, size_t stackSize );
+
+/**************************************************************/
+/**
+ * Takes a copy of all metrics
+ * @param[out] snapshot Copy of metrics
+ */
+void metrics_get( metrics_snapshot_t* snapshot );
+
+/**************************************************************/
+/**
+ * Formats all metrics as compact JSON
+ * @param[out] buffer Buffer to write JSON to
+ * @param[in] size Size of buffer
+ * @returns Number of characters written, excluding the terminator, or -1 if
+ * the buffer is too small
+ */
+int metrics_toJson( char* buffer, size_t size );
+
+#endif // METRICS_H
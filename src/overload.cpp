@@ -0,0 +1,156 @@
+/**
+ * @file overload.cpp
+ * @author Simon Udsen
+ * @date 2026-10-18
+ */
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include "overload.h" // Header file for this module
+
+#include <atomic> // Degraded flag shared with consumers
+
+#include "metrics.h"  // Runtime health metrics
+#include "profiler.h" // Cycle counter profiling
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+/**************************************************************/
+/*                          Private                           */
+/**************************************************************/
+
+// Only the accelerometer thread puts samples, so only the degraded flag is
+// shared with other threads
+static bool overloaded = false;             // Stream has been full, and has not drained yet
+static uint8_t pendingDropped = 0;          // Samples dropped since last sample written
+static uint8_t decimationCounter = 0;       // Counts samples while decimating
+static std::atomic<bool> degraded( false ); // Consumers should use a cheaper backend
+
+/**************************************************************/
+// Count a sample as lost, to be reported with the next sample written
+static void dropSample()
+{
+    metrics_sampleDropped( 1 );
+    if ( pendingDropped < UINT8_MAX )
+    {
+        pendingDropped++;
+    }
+}
+
+/**************************************************************/
+// Write sample to stream without blocking
+static int tryPut( samplestream_t* stream, acceleration_sample_t* sample )
+{
+    int status = 0;
+
+    sample->dropped = pendingDropped;
+
+    {
+        PROFILER_SCOPE( PROFILER_REGION_QUEUE_PUT );
+        status = samplestream_write( stream, sample );
+    }
+
+    if ( status == 0 )
+    {
+        pendingDropped = 0;
+        metrics_queueLevel( samplestream_depth( stream ) );
+    }
+
+    return status;
+}
+
+/**************************************************************/
+// Enter overload mode
+static void enterOverload()
+{
+    overloaded = true;
+    decimationCounter = 0;
+    metrics_overloadEvent();
+
+#if OVERLOAD_POLICY == OVERLOAD_POLICY_DEGRADE
+    degraded.store( true, std::memory_order_relaxed );
+#endif
+}
+
+/**************************************************************/
+// Leave overload mode, once the readers have caught up
+static void leaveOverload()
+{
+    overloaded = false;
+    degraded.store( false, std::memory_order_relaxed );
+}
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+void overload_reset()
+{
+    pendingDropped = 0;
+    leaveOverload();
+}
+
+/**************************************************************/
+int overload_put( samplestream_t* stream, acceleration_sample_t* sample )
+{
+    if ( overloaded && ( samplestream_depth( stream ) <= OVERLOAD_LOW_WATER ) )
+    {
+        leaveOverload();
+    }
+
+#if OVERLOAD_POLICY == OVERLOAD_POLICY_DECIMATE
+    // Keep only every OVERLOAD_DECIMATION_FACTOR'th sample while overloaded
+    if ( overloaded )
+    {
+        decimationCounter = ( decimationCounter + 1 ) % OVERLOAD_DECIMATION_FACTOR;
+        if ( decimationCounter != 0 )
+        {
+            metrics_sampleDecimated();
+            dropSample();
+            return 1;
+        }
+    }
+#endif
+
+    if ( tryPut( stream, sample ) == 0 )
+    {
+        return 0;
+    }
+
+    // A gating reader is full
+    if ( !overloaded )
+    {
+        enterOverload();
+    }
+
+#if OVERLOAD_POLICY == OVERLOAD_POLICY_DROP_OLDEST
+    // Make room by dropping the oldest sample of the full readers. Each of them
+    // reports the gap with its next sample, as only it has lost the sample.
+    // The samples lost right before the dropped one stay in the dropped total
+    // of the stream, so the gap includes them, saturating at UINT8_MAX like
+    // pendingDropped. Dropping fails if the reader took the sample first,
+    // which also makes room
+    metrics_sampleDropped( samplestream_dropOldest( stream ) );
+    if ( tryPut( stream, sample ) == 0 )
+    {
+        return 0;
+    }
+#endif
+
+    dropSample();
+    return 1;
+}
+
+/**************************************************************/
+bool overload_isDegraded()
+{
+    return degraded.load( std::memory_order_relaxed );
+}
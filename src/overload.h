@@ -0,0 +1,72 @@
+/**
+ * @file overload.h
+ * @author Simon Udsen
+ * @date 2026-10-18
+ * @brief Handling of a full sample stream
+ * @details When a gating reader of the sample stream falls behind, the
+ * accelerometer thread applies OVERLOAD_POLICY instead of blocking or resetting
+ * the device:
+ * - OVERLOAD_POLICY_DROP_NEWEST: The new sample is dropped
+ * - OVERLOAD_POLICY_DROP_OLDEST: The oldest sample of the full readers is
+ *   dropped
+ * - OVERLOAD_POLICY_DECIMATE: Only every OVERLOAD_DECIMATION_FACTOR'th sample
+ *   is kept, until the stream has drained to OVERLOAD_LOW_WATER
+ * - OVERLOAD_POLICY_DEGRADE: The new sample is dropped, and the step counter
+ *   uses a cheaper model, until the stream has drained to OVERLOAD_LOW_WATER
+ *
+ * Readers with SAMPLESTREAM_POLICY_OVERRUN never fill the stream, so they do
+ * not cause overload, see samplestream.h
+ *
+ * The number of samples lost right before a sample is carried in its dropped
+ * field, so consumers can account for gaps. Every intervention is counted in
+ * the health metrics.
+ */
+#ifndef OVERLOAD_H
+#define OVERLOAD_H
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include "Particle.h"     // Particle Device OS APIs
+#include "config.h"       // Project configuration
+#include "samplestream.h" // Broadcast of samples to several readers
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+#define OVERLOAD_LOW_WATER ( SAMPLESTREAM_SIZE / 4 ) // Stream depth at which overload mode ends
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+/**
+ * Leaves overload mode and forgets dropped samples. Call before sampling starts
+ */
+void overload_reset();
+
+/**************************************************************/
+/**
+ * Writes a sample to the stream without blocking, applying OVERLOAD_POLICY if a
+ * gating reader is full
+ * @param[in,out] stream Stream to write sample to
+ * @param[in,out] sample Sample to write. Its dropped field is set
+ * @returns Status
+ * @retval 0: Sample was written
+ * @retval 1: Sample was dropped by the overload policy
+ */
+int overload_put( samplestream_t* stream, acceleration_sample_t* sample );
+
+/**************************************************************/
+/**
+ * Checks if consumers should degrade to a cheaper backend
+ * @returns True if OVERLOAD_POLICY_DEGRADE is in effect
+ */
+bool overload_isDegraded();
+
+#endif // OVERLOAD_H
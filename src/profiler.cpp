@@ -0,0 +1,137 @@
+/**
+ * @file profiler.cpp
+ * @author Simon Udsen
+ * @date 2026-10-18
+ */
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include "profiler.h" // Header file for this module
+
+#if PROFILER_ENABLED
+
+#ifdef PLATFORM_ID
+#include "Particle.h" // Particle Device OS APIs
+#else
+#include <stdio.h> // printf
+#include <time.h>  // clock_gettime
+#endif
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+#ifdef PLATFORM_ID
+// Cortex-M33 debug registers used for the cycle counter
+#define PROFILER_DEMCR ( *( volatile uint32_t* )0xE000EDFC )      // Debug Exception and Monitor Control
+#define PROFILER_DWT_CTRL ( *( volatile uint32_t* )0xE0001000 )   // DWT control register
+#define PROFILER_DWT_CYCCNT ( *( volatile uint32_t* )0xE0001004 ) // DWT cycle counter
+#define PROFILER_DEMCR_TRCENA ( 1UL << 24 )                       // Enable DWT
+#define PROFILER_DWT_CTRL_CYCCNTENA ( 1UL << 0 )                  // Enable cycle counter
+#endif
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+/**************************************************************/
+/*                          Private                           */
+/**************************************************************/
+
+// Statistics for every region
+static profiler_stats_t profilerTable[PROFILER_REGION_COUNT];
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+void profiler_init()
+{
+#ifdef PLATFORM_ID
+    PROFILER_DEMCR |= PROFILER_DEMCR_TRCENA;
+    PROFILER_DWT_CYCCNT = 0;
+    PROFILER_DWT_CTRL |= PROFILER_DWT_CTRL_CYCCNTENA;
+#endif
+
+    profiler_reset();
+}
+
+/**************************************************************/
+void profiler_reset()
+{
+    for ( uint8_t i = 0; i < PROFILER_REGION_COUNT; i++ )
+    {
+        profilerTable[i].count = 0;
+        profilerTable[i].total = 0;
+        profilerTable[i].min = UINT32_MAX;
+        profilerTable[i].max = 0;
+    }
+}
+
+/**************************************************************/
+uint32_t profiler_now()
+{
+#ifdef PLATFORM_ID
+    return PROFILER_DWT_CYCCNT;
+#else
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ( uint32_t )( ( uint64_t )ts.tv_sec * 1000000000ULL + ( uint64_t )ts.tv_nsec );
+#endif
+}
+
+/**************************************************************/
+void profiler_record( profiler_region_t region, uint32_t cycles )
+{
+    profiler_stats_t* stats = &( profilerTable[region] );
+
+    stats->count++;
+    stats->total += cycles;
+    if ( cycles < stats->min )
+    {
+        stats->min = cycles;
+    }
+    if ( cycles > stats->max )
+    {
+        stats->max = cycles;
+    }
+}
+
+/**************************************************************/
+void profiler_getStats( profiler_region_t region, profiler_stats_t* stats )
+{
+    *stats = profilerTable[region];
+}
+
+/**************************************************************/
+void profiler_dump()
+{
+    for ( uint8_t i = 0; i < PROFILER_REGION_COUNT; i++ )
+    {
+        const profiler_stats_t* stats = &( profilerTable[i] );
+        if ( stats->count == 0 )
+        {
+            continue;
+        }
+
+        uint32_t average = ( uint32_t )( stats->total / stats->count );
+#ifdef PLATFORM_ID
+        Log.info( "Profiler: %-18s n=%lu avg=%lu min=%lu max=%lu",
+                  profiler_getName( ( profiler_region_t )i ),
+                  ( unsigned long )stats->count,
+                  ( unsigned long )average,
+                  ( unsigned long )stats->min,
+                  ( unsigned long )stats->max );
+#else
+        printf( "Profiler: %-18s n=%lu avg=%lu min=%lu max=%lu\n",
+                profiler_getName( ( profiler_region_t )i ),
+                ( unsigned long )stats->count,
+                ( unsigned long )average,
+                ( unsigned long )stats->min,
+                ( unsigned long )stats->max );
+#endif
+    }
+}
+
+#endif // PROFILER_ENABLED
@@ -0,0 +1,149 @@
+/**
+ * @file profiler.h
+ * @author Simon Udsen
+ * @date 2026-10-18
+ * @brief Cycle counter profiling of hot functions
+ * @details Scoped regions are bracketed with PROFILER_SCOPE( region ), which
+ * reads the cycle counter on entry and exit and aggregates call count, total,
+ * minimum and maximum cycles into a static table. On the device the Cortex-M33
+ * DWT CYCCNT is used, on a host build clock_gettime( CLOCK_MONOTONIC ) in
+ * nanoseconds is used instead. When PROFILER_ENABLED is false, the macro
+ * expands to nothing and the table is not compiled in.
+ *
+ * Each region is expected to be entered from a single thread only, so the
+ * table is updated without locking.
+ *
+ * With TRACER_ENABLED the begin and end of every region are also recorded in
+ * the timeline of tracer.h.
+ */
+#ifndef PROFILER_H
+#define PROFILER_H
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include "config.h" // Project configuration
+#include "tracer.h" // Timeline of begin and end of regions
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+#define PROFILER_MODEL_TREE_MAX 16 // Trees of the model with a region each
+
+#define PROFILER_CONCAT_( a, b ) a##b
+#define PROFILER_CONCAT( a, b ) PROFILER_CONCAT_( a, b )
+
+#if PROFILER_ENABLED
+// Profile the rest of the enclosing scope as the given region
+#define PROFILER_SCOPE( region ) profiler_scope PROFILER_CONCAT( profilerScope_, __LINE__ )( region )
+#else
+#define PROFILER_SCOPE( region )
+#endif
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+// Profiled regions
+typedef enum profiler_region_
+{
+    PROFILER_REGION_ADXL343_READ,       // ADXL343::readAcceleration
+    PROFILER_REGION_QUEUE_PUT,          // samplestream_write in accelerometer thread
+    PROFILER_REGION_QUEUE_TAKE,         // samplestream_read in buffer thread
+    PROFILER_REGION_GET_FEATURES,       // statisticalfeatures_getFeatures
+    PROFILER_REGION_MODEL_TREE_0,       // step_counter_model_tree_0, and the trees after it
+    PROFILER_REGION_MODEL_TREE_LAST = PROFILER_REGION_MODEL_TREE_0 + PROFILER_MODEL_TREE_MAX - 1,
+    PROFILER_REGION_DATAROUTER_TAKE,    // Sample or result read in datarouter::takeItem
+    PROFILER_REGION_DATAROUTER_FORWARD, // Formatting a sample or result in datarouter::appendItem
+    PROFILER_REGION_DATAROUTER_WRITE,   // TCPClient::write in datarouter::flush
+    PROFILER_REGION_SAMPLECODEC_ENCODE, // samplecodec_encode of a batch in datarouter::flush
+    PROFILER_REGION_COUNT
+} profiler_region_t;
+
+// Aggregated statistics for a single region
+typedef struct profiler_stats_
+{
+    uint32_t count; // Number of times the region was entered
+    uint64_t total; // Total cycles spent in region
+    uint32_t min;   // Minimum cycles of a single call
+    uint32_t max;   // Maximum cycles of a single call
+} profiler_stats_t;
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+/**
+ * Enables the cycle counter and clears the statistics table
+ */
+void profiler_init();
+
+/**************************************************************/
+/**
+ * Clears the statistics table
+ */
+void profiler_reset();
+
+/**************************************************************/
+/**
+ * Reads the current value of the cycle counter
+ * @returns Cycles on the device, nanoseconds on a host build
+ */
+uint32_t profiler_now();
+
+/**************************************************************/
+/**
+ * Adds a single measurement to the statistics of a region
+ * @param[in] region Region to record measurement for
+ * @param[in] cycles Number of cycles spent in region
+ */
+void profiler_record( profiler_region_t region, uint32_t cycles );
+
+/**************************************************************/
+/**
+ * Gets the statistics of a region
+ * @param[in] region Region to get statistics for
+ * @param[out] stats Statistics of region
+ */
+void profiler_getStats( profiler_region_t region, profiler_stats_t* stats );
+
+/**************************************************************/
+/**
+ * Gets the printable name of a region
+ * @param[in] region Region to get name of
+ * @returns Name of region
+ */
+const char* profiler_getName( profiler_region_t region );
+
+/**************************************************************/
+/**
+ * Logs the statistics table, one line per region that has been entered
+ */
+void profiler_dump();
+
+// Scope guard recording the time between construction and destruction
+class profiler_scope
+{
+  public:
+    profiler_scope( profiler_region_t region ) : region( region ), start( profiler_now() )
+    {
+#if TRACER_ENABLED
+        tracer_begin( ( uint16_t )region );
+#endif
+    }
+
+    ~profiler_scope()
+    {
+        profiler_record( region, profiler_now() - start );
+#if TRACER_ENABLED
+        tracer_end( ( uint16_t )region );
+#endif
+    }
+
+  private:
+    profiler_region_t region; // Region being profiled
+    uint32_t start;           // Cycle counter at start of scope
+};
+
+#endif // PROFILER_H
@@ -0,0 +1,69 @@
+/**
+ * @file profilernames.cpp
+ * @author Simon Udsen
+ * @date 2026-10-18
+ * @brief Printable names of the profiler regions
+ * @details Kept apart from profiler.cpp, so host/tools/pipesim can link the
+ * names with its own virtual-time profiler table.
+ */
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include "profiler.h" // Profiled regions
+
+#if PROFILER_ENABLED
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+/**************************************************************/
+/*                          Private                           */
+/**************************************************************/
+
+// Printable names of every region, in the order of profiler_region_t
+static const char* const profilerNames[] = {
+    "adxl343_read",
+    "queue_put",
+    "queue_take",
+    "get_features",
+    "model_tree_0",
+    "model_tree_1",
+    "model_tree_2",
+    "model_tree_3",
+    "model_tree_4",
+    "model_tree_5",
+    "model_tree_6",
+    "model_tree_7",
+    "model_tree_8",
+    "model_tree_9",
+    "model_tree_10",
+    "model_tree_11",
+    "model_tree_12",
+    "model_tree_13",
+    "model_tree_14",
+    "model_tree_15",
+    "datarouter_take",
+    "datarouter_forward",
+    "datarouter_write",
+    "samplecodec_encode",
+};
+static_assert( sizeof( profilerNames ) / sizeof( profilerNames[0] ) == PROFILER_REGION_COUNT,
+               "Every profiler region needs a name" );
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+const char* profiler_getName( profiler_region_t region )
+{
+    return profilerNames[region];
+}
+
+#endif // PROFILER_ENABLED
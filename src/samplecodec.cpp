@@ -0,0 +1,223 @@
+/**
+ * @file samplecodec.cpp
+ * @author Simon Udsen
+ * @date 2026-10-18
+ */
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include "samplecodec.h" // Header file for this module
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+// Position in a buffer being written or read
+typedef struct samplecodec_cursor_
+{
+    uint8_t* write;      // Next byte to write, when encoding
+    const uint8_t* read; // Next byte to read, when decoding
+    const uint8_t* end;  // End of buffer
+    bool overflow;       // Buffer ended before all data was written or read
+} samplecodec_cursor_t;
+
+/**************************************************************/
+/*                          Private                           */
+/**************************************************************/
+
+/**************************************************************/
+// Map signed to unsigned, so small magnitudes give small values
+static inline uint32_t zigzag( int32_t value )
+{
+    return ( ( uint32_t )value << 1 ) ^ ( uint32_t )( value >> 31 );
+}
+
+/**************************************************************/
+// Inverse of zigzag
+static inline int32_t unzigzag( uint32_t value )
+{
+    return ( int32_t )( value >> 1 ) ^ -( int32_t )( value & 1 );
+}
+
+/**************************************************************/
+// Write an unsigned varint
+static inline void putVarint( samplecodec_cursor_t* cursor, uint32_t value )
+{
+    while ( value >= 0x80 )
+    {
+        if ( cursor->write >= cursor->end )
+        {
+            cursor->overflow = true;
+            return;
+        }
+        *( cursor->write++ ) = ( uint8_t )( value | 0x80 );
+        value >>= 7;
+    }
+    if ( cursor->write >= cursor->end )
+    {
+        cursor->overflow = true;
+        return;
+    }
+    *( cursor->write++ ) = ( uint8_t )value;
+}
+
+/**************************************************************/
+// Read an unsigned varint of at most 5 bytes
+static inline uint32_t getVarint( samplecodec_cursor_t* cursor )
+{
+    uint32_t value = 0;
+    for ( uint8_t shift = 0; shift < 35; shift += 7 )
+    {
+        if ( cursor->read >= cursor->end )
+        {
+            cursor->overflow = true;
+            return 0;
+        }
+        uint8_t byte = *( cursor->read++ );
+        value |= ( uint32_t )( byte & 0x7F ) << shift;
+        if ( ( byte & 0x80 ) == 0 )
+        {
+            return value;
+        }
+    }
+    cursor->overflow = true;
+    return 0;
+}
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+int samplecodec_encode( const acceleration_sample_t* samples, uint16_t count, uint8_t* buffer, size_t size )
+{
+    samplecodec_cursor_t cursor = { buffer, NULL, buffer + size, false };
+
+    // Step runs, starting with a run without steps
+    bool step = false;
+    uint32_t run = 0;
+    for ( uint16_t i = 0; i < count; i++ )
+    {
+        if ( samples[i].step != step )
+        {
+            putVarint( &cursor, run );
+            step = samples[i].step;
+            run = 0;
+        }
+        run++;
+    }
+    if ( count > 0 )
+    {
+        putVarint( &cursor, run );
+    }
+
+    // Samples with lost samples before them
+    uint32_t lostCount = 0;
+    for ( uint16_t i = 0; i < count; i++ )
+    {
+        lostCount += ( samples[i].dropped > 0 );
+    }
+    putVarint( &cursor, lostCount );
+    uint16_t previousIndex = 0;
+    for ( uint16_t i = 0; i < count; i++ )
+    {
+        if ( samples[i].dropped > 0 )
+        {
+            putVarint( &cursor, i - previousIndex );
+            putVarint( &cursor, samples[i].dropped );
+            previousIndex = i;
+        }
+    }
+
+    // Timestamps and acceleration
+    uint32_t timestamp = 0;
+    uint32_t delta = 0;
+    int16_t acceleration[3] = { 0, 0, 0 };
+    for ( uint16_t i = 0; i < count; i++ )
+    {
+        uint32_t nextDelta = samples[i].timestamp - timestamp;
+        putVarint( &cursor, zigzag( ( int32_t )( nextDelta - delta ) ) );
+        timestamp = samples[i].timestamp;
+        delta = nextDelta;
+
+        for ( uint8_t axis = AXIS_X; axis <= AXIS_Z; axis++ )
+        {
+            putVarint( &cursor, zigzag( ( int32_t )samples[i].acceleration[axis] - acceleration[axis] ) );
+            acceleration[axis] = samples[i].acceleration[axis];
+        }
+    }
+
+    if ( cursor.overflow )
+    {
+        return -1;
+    }
+    return ( int )( cursor.write - buffer );
+}
+
+/**************************************************************/
+int samplecodec_decode( const uint8_t* buffer, size_t length, acceleration_sample_t* samples, uint16_t count )
+{
+    samplecodec_cursor_t cursor = { NULL, buffer, buffer + length, false };
+
+    // Step runs
+    bool step = false;
+    uint16_t index = 0;
+    while ( ( index < count ) && !cursor.overflow )
+    {
+        uint32_t run = getVarint( &cursor );
+        if ( run > ( uint32_t )( count - index ) )
+        {
+            return -1;
+        }
+        for ( uint32_t i = 0; i < run; i++ )
+        {
+            samples[index].step = step;
+            samples[index].dropped = 0;
+            index++;
+        }
+        step = !step;
+    }
+
+    // Samples with lost samples before them
+    uint32_t lostCount = getVarint( &cursor );
+    index = 0;
+    for ( uint32_t i = 0; ( i < lostCount ) && !cursor.overflow; i++ )
+    {
+        uint32_t nextIndex = index + getVarint( &cursor );
+        uint32_t dropped = getVarint( &cursor );
+        if ( ( nextIndex >= count ) || ( dropped > UINT8_MAX ) )
+        {
+            return -1;
+        }
+        index = ( uint16_t )nextIndex;
+        samples[index].dropped = ( uint8_t )dropped;
+    }
+
+    // Timestamps and acceleration
+    uint32_t timestamp = 0;
+    uint32_t delta = 0;
+    int16_t acceleration[3] = { 0, 0, 0 };
+    for ( uint16_t i = 0; ( i < count ) && !cursor.overflow; i++ )
+    {
+        delta += ( uint32_t )unzigzag( getVarint( &cursor ) );
+        timestamp += delta;
+        samples[i].timestamp = timestamp;
+
+        for ( uint8_t axis = AXIS_X; axis <= AXIS_Z; axis++ )
+        {
+            acceleration[axis] = ( int16_t )( acceleration[axis] + unzigzag( getVarint( &cursor ) ) );
+            samples[i].acceleration[axis] = acceleration[axis];
+        }
+    }
+
+    if ( cursor.overflow )
+    {
+        return -1;
+    }
+    return ( int )( cursor.read - buffer );
+}
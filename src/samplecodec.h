@@ -0,0 +1,69 @@
+/**
+ * @file samplecodec.h
+ * @author Simon Udsen
+ * @date 2026-10-18
+ * @brief Lossless compression of acceleration samples
+ * @details Consecutive samples barely change, so a block of samples is encoded
+ * as differences, with small numbers taking few bytes. Every block can be
+ * decoded on its own, so a lost frame does not affect the next. A block of n
+ * samples is:
+ * 1. Step runs: varints of alternating run lengths, starting with a run of
+ *    samples without a step, that may be empty, until the runs add up to n
+ * 2. Lost samples: varint count of samples with dropped > 0, followed by a
+ *    varint index (relative to the previous one) and varint dropped for each
+ * 3. For every sample: zigzag varint of the change in timestamp delta, then
+ *    zigzag varints of the X, Y and Z deltas. The first sample is relative to
+ *    a timestamp, delta and acceleration of 0
+ *
+ * Varints are unsigned LEB128, 7 bits per byte with the high bit set on all but
+ * the last byte. Zigzag maps signed to unsigned, so -1 is 1 and 1 is 2. With a
+ * steady sample clock and a still sensor, a sample takes 4 bytes.
+ *
+ * The module does not depend on Device OS, and does not allocate memory.
+ */
+#ifndef SAMPLECODEC_H
+#define SAMPLECODEC_H
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include <stddef.h> // size_t
+#include <stdint.h> // Standard integer types
+
+#include "config.h" // Project configuration
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+/**
+ * Encodes a block of samples
+ * @param[in] samples Samples to encode
+ * @param[in] count Number of samples
+ * @param[out] buffer Buffer to write encoded block to
+ * @param[in] size Size of buffer
+ * @returns Length of encoded block in bytes, or -1 if it does not fit in buffer
+ */
+int samplecodec_encode( const acceleration_sample_t* samples, uint16_t count, uint8_t* buffer, size_t size );
+
+/**************************************************************/
+/**
+ * Decodes a block of samples
+ * @param[in] buffer Encoded block
+ * @param[in] length Length of encoded block in bytes
+ * @param[out] samples Decoded samples
+ * @param[in] count Number of samples in block
+ * @returns Number of bytes decoded, or -1 if the block is corrupt
+ */
+int samplecodec_decode( const uint8_t* buffer, size_t length, acceleration_sample_t* samples, uint16_t count );
+
+#endif // SAMPLECODEC_H
@@ -0,0 +1,211 @@
+/**
+ * @file samplestream.cpp
+ * @author Simon Udsen
+ * @date 2026-10-18
+ */
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include "samplestream.h" // Header file for this module
+
+#include "metrics.h" // Runtime health metrics
+#include "tracer.h"  // Timeline of the pipeline
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+#define RING_MASK ( SAMPLESTREAM_SIZE - 1 ) // Mask from sample count to ring index
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+/**************************************************************/
+/*                          Private                           */
+/**************************************************************/
+
+/**************************************************************/
+// Copy a sample for a reader, with the samples it lost since the last one it
+// read in the dropped field, saturating
+static void copySample( samplestream_reader_t* reader, const samplestream_slot_t* slot, uint32_t cursor,
+                        acceleration_sample_t* sample )
+{
+    uint32_t lost = ( cursor - reader->next ) + ( slot->droppedTotal - reader->droppedTotal );
+
+    *sample = slot->sample;
+    sample->dropped = ( lost > UINT8_MAX ) ? UINT8_MAX : ( uint8_t )lost;
+
+    reader->next = cursor + 1;
+    reader->droppedTotal = slot->droppedTotal;
+}
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+void samplestream_init( samplestream_t* stream )
+{
+    stream->head.store( 0, std::memory_order_relaxed );
+    stream->droppedTotal = 0;
+    stream->readerCount = 0;
+}
+
+/**************************************************************/
+int samplestream_addReader( samplestream_t* stream, uint8_t policy )
+{
+    if ( stream->readerCount >= SAMPLESTREAM_MAX_READERS )
+    {
+        return -1;
+    }
+
+    samplestream_reader_t* reader = &( stream->readers[stream->readerCount] );
+    if ( os_semaphore_create( &( reader->semaphore ), SAMPLESTREAM_SIZE, 0 ) != 0 )
+    {
+        return -1;
+    }
+    TRACER_REGISTER( reader->semaphore, "samplestream_reader" );
+    uint32_t head = stream->head.load( std::memory_order_relaxed );
+    reader->cursor.store( head, std::memory_order_relaxed );
+    reader->next = head;
+    reader->droppedTotal = stream->droppedTotal;
+    reader->policy = policy;
+
+    return stream->readerCount++;
+}
+
+/**************************************************************/
+int samplestream_write( samplestream_t* stream, const acceleration_sample_t* sample )
+{
+    uint32_t head = stream->head.load( std::memory_order_relaxed );
+
+    for ( uint8_t i = 0; i < stream->readerCount; i++ )
+    {
+        samplestream_reader_t* reader = &( stream->readers[i] );
+        if ( ( reader->policy == SAMPLESTREAM_POLICY_GATE ) &&
+             ( head - reader->cursor.load( std::memory_order_acquire ) >= SAMPLESTREAM_SIZE ) )
+        {
+            return -1;
+        }
+    }
+
+    stream->droppedTotal += sample->dropped;
+
+    samplestream_slot_t* slot = &( stream->ring[head & RING_MASK] );
+    slot->sample = *sample;
+    slot->droppedTotal = stream->droppedTotal;
+    stream->head.store( head + 1, std::memory_order_release );
+
+    // A semaphore at its maximum count fails to be given, but then its reader
+    // has plenty to read
+    for ( uint8_t i = 0; i < stream->readerCount; i++ )
+    {
+        os_semaphore_give( stream->readers[i].semaphore, 0 );
+    }
+
+    return 0;
+}
+
+/**************************************************************/
+uint8_t samplestream_dropOldest( samplestream_t* stream )
+{
+    uint32_t head = stream->head.load( std::memory_order_relaxed );
+    uint8_t dropped = 0;
+
+    for ( uint8_t i = 0; i < stream->readerCount; i++ )
+    {
+        samplestream_reader_t* reader = &( stream->readers[i] );
+        uint32_t cursor = reader->cursor.load( std::memory_order_acquire );
+        if ( ( reader->policy != SAMPLESTREAM_POLICY_GATE ) || ( head - cursor < SAMPLESTREAM_SIZE ) )
+        {
+            continue;
+        }
+
+        // Fails if the reader just read the sample, which also makes room. The
+        // dropped field of the sample is already in the dropped total, so
+        // copySample counts it for the reader's next sample
+        if ( reader->cursor.compare_exchange_strong( cursor, cursor + 1, std::memory_order_acq_rel ) )
+        {
+            dropped++;
+        }
+    }
+
+    return dropped;
+}
+
+/**************************************************************/
+int samplestream_read( samplestream_t* stream, uint8_t index, acceleration_sample_t* sample, system_tick_t timeoutMs )
+{
+    samplestream_reader_t* reader = &( stream->readers[index] );
+
+    while ( true )
+    {
+        uint32_t cursor = reader->cursor.load( std::memory_order_acquire );
+        uint32_t head = stream->head.load( std::memory_order_acquire );
+        if ( head == cursor )
+        {
+            if ( os_semaphore_take( reader->semaphore, timeoutMs, 0 ) != 0 )
+            {
+                return 1;
+            }
+            continue;
+        }
+
+        if ( reader->policy == SAMPLESTREAM_POLICY_OVERRUN )
+        {
+            // Skip the samples that have been overwritten, or may be soon
+            if ( head - cursor > SAMPLESTREAM_SIZE - 1 )
+            {
+                uint32_t skipped = head - cursor - ( SAMPLESTREAM_SIZE - 1 );
+                metrics_sampleDropped( skipped );
+                cursor += skipped;
+                reader->cursor.store( cursor, std::memory_order_relaxed );
+            }
+
+            samplestream_slot_t slot = stream->ring[cursor & RING_MASK];
+
+            // The writer may have lapped the reader while the sample was copied
+            std::atomic_thread_fence( std::memory_order_acquire );
+            if ( stream->head.load( std::memory_order_acquire ) - cursor > SAMPLESTREAM_SIZE - 1 )
+            {
+                continue;
+            }
+            reader->cursor.store( cursor + 1, std::memory_order_release );
+            copySample( reader, &slot, cursor, sample );
+        }
+        else
+        {
+            samplestream_slot_t slot = stream->ring[cursor & RING_MASK];
+
+            // The writer only overwrites the sample after moving the cursor past
+            // it, and then the copy is stale
+            if ( !reader->cursor.compare_exchange_strong( cursor, cursor + 1, std::memory_order_acq_rel ) )
+            {
+                continue;
+            }
+            copySample( reader, &slot, cursor, sample );
+        }
+
+        return 0;
+    }
+}
+
+/**************************************************************/
+uint32_t samplestream_depth( const samplestream_t* stream )
+{
+    uint32_t head = stream->head.load( std::memory_order_acquire );
+    uint32_t depth = 0;
+
+    for ( uint8_t i = 0; i < stream->readerCount; i++ )
+    {
+        const samplestream_reader_t* reader = &( stream->readers[i] );
+        if ( reader->policy == SAMPLESTREAM_POLICY_GATE )
+        {
+            uint32_t lag = head - reader->cursor.load( std::memory_order_acquire );
+            depth = ( lag > depth ) ? lag : depth;
+        }
+    }
+
+    return depth;
+}
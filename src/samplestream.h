@@ -0,0 +1,152 @@
+/**
+ * @file samplestream.h
+ * @author Simon Udsen
+ * @date 2026-10-18
+ * @brief Broadcast of samples from the accelerometer to several readers
+ * @details The accelerometer thread writes every sample once to a ring of
+ * SAMPLESTREAM_SIZE samples, and every reader has its own read cursor, so the
+ * datarouter and the step counter can both consume the same samples without a
+ * queue each. The ring counts samples written with a free running 32 bit
+ * counter, and the size is a power of two, so an index is the counter masked.
+ *
+ * Every reader has its own policy for when it falls SAMPLESTREAM_SIZE samples
+ * behind:
+ * - SAMPLESTREAM_POLICY_GATE: The writer does not overwrite samples the reader
+ *   has not read. The write fails instead, and the writer applies
+ *   OVERLOAD_POLICY, which affects every reader, see overload.h
+ * - SAMPLESTREAM_POLICY_OVERRUN: The writer overwrites samples the reader has
+ *   not read, and the reader skips to the oldest sample left. Only this reader
+ *   loses samples. One slot is kept free, as the writer may be writing it, so
+ *   the reader falls behind after SAMPLESTREAM_SIZE - 1 samples
+ *
+ * The writer keeps a running total of the dropped fields of the samples it
+ * writes, and stores it with every sample. A reader sets the dropped field of
+ * a sample to the samples it skipped, plus the increase of the total since the
+ * last sample it read. This way, samples the writer dropped before a sample the
+ * reader skipped are not forgotten, and consumers see gaps the same way under
+ * both policies.
+ *
+ * There is one writer, and a reader is only read by one thread. Cursors are
+ * atomics, so no locks are taken. A gating reader's cursor is only moved by
+ * the writer with a compare and swap, when OVERLOAD_POLICY_DROP_OLDEST drops
+ * its oldest sample, so a reader that loses the race knows its copy is stale,
+ * and the reader finds the dropped sample from its cursor.
+ */
+#ifndef SAMPLESTREAM_H
+#define SAMPLESTREAM_H
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include "Particle.h" // Particle Device OS APIs
+#include "config.h"   // Project configuration
+
+#include <atomic> // Lock-free cursors
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+#define SAMPLESTREAM_MAX_READERS 2 // Datarouter and step counter
+
+static_assert( ( SAMPLESTREAM_SIZE & ( SAMPLESTREAM_SIZE - 1 ) ) == 0, "Sample stream size must be a power of two" );
+static_assert( SAMPLESTREAM_SIZE >= DATA_BUFFER_SIZE, "Sample stream must buffer as many samples as a window" );
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+// Sample in the ring
+typedef struct samplestream_slot_
+{
+    acceleration_sample_t sample; // Sample written
+    uint32_t droppedTotal;        // Samples dropped before it, since the stream was initialized
+} samplestream_slot_t;
+
+// Reader of a sample stream
+typedef struct samplestream_reader_
+{
+    std::atomic<uint32_t> cursor; // Count of next sample to read
+    uint32_t next;                // Count after the last sample read, only used by the reader
+    uint32_t droppedTotal;        // Dropped total of the last sample read, only used by the reader
+    uint8_t policy;               // SAMPLESTREAM_POLICY_*
+    os_semaphore_t semaphore;     // Given for every sample written
+} samplestream_reader_t;
+
+// Stream of samples to several readers
+typedef struct samplestream_
+{
+    samplestream_slot_t ring[SAMPLESTREAM_SIZE];             // Samples, indexed by count masked
+    std::atomic<uint32_t> head;                              // Count of samples written
+    uint32_t droppedTotal;                                   // Running total of dropped fields written
+    samplestream_reader_t readers[SAMPLESTREAM_MAX_READERS]; // Readers
+    uint8_t readerCount;                                     // Readers added
+} samplestream_t;
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+/**
+ * Initializes an empty stream without readers
+ * @param[out] stream Stream to initialize
+ */
+void samplestream_init( samplestream_t* stream );
+
+/**************************************************************/
+/**
+ * Adds a reader, that starts at the next sample written. Must be called before
+ * sampling starts
+ * @param[in,out] stream Stream to read from
+ * @param[in] policy SAMPLESTREAM_POLICY_* of reader
+ * @returns Reader index, or -1 if there are SAMPLESTREAM_MAX_READERS readers, or
+ * its semaphore could not be created
+ */
+int samplestream_addReader( samplestream_t* stream, uint8_t policy );
+
+/**************************************************************/
+/**
+ * Writes a sample, and wakes up every reader. Only called by the writer
+ * @param[in,out] stream Stream to write to
+ * @param[in] sample Sample to write, with the samples the writer dropped right
+ * before it in its dropped field
+ * @returns Status
+ * @retval 0: Sample written
+ * @retval -1: A gating reader is full, nothing was written
+ */
+int samplestream_write( samplestream_t* stream, const acceleration_sample_t* sample );
+
+/**************************************************************/
+/**
+ * Drops the oldest sample of every full gating reader, to make room for a
+ * write. The reader reports the dropped sample with its next one, together
+ * with the dropped field of the dropped sample, which is kept in the dropped
+ * total. Only called by the writer
+ * @param[in,out] stream Stream to drop from
+ * @returns Number of readers that dropped a sample
+ */
+uint8_t samplestream_dropOldest( samplestream_t* stream );
+
+/**************************************************************/
+/**
+ * Copies the next sample of a reader, waiting for one to be written
+ * @param[in,out] stream Stream to read from
+ * @param[in] reader Reader index from samplestream_addReader
+ * @param[out] sample Copy of sample, with the samples this reader lost right
+ * before it in its dropped field
+ * @param[in] timeoutMs Time to wait for a sample
+ * @returns Status
+ * @retval 0: Sample read
+ * @retval 1: Timed out
+ */
+int samplestream_read( samplestream_t* stream, uint8_t reader, acceleration_sample_t* sample, system_tick_t timeoutMs );
+
+/**************************************************************/
+/**
+ * Gets the number of samples the slowest gating reader has not read
+ * @param[in] stream Stream to check
+ * @returns Depth, between 0 and SAMPLESTREAM_SIZE
+ */
+uint32_t samplestream_depth( const samplestream_t* stream );
+
+#endif // SAMPLESTREAM_H
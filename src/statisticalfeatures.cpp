@@ -10,14 +10,24 @@
 /**************************************************************/
 #include "statisticalfeatures.h" // Header file for this module
 
+#include <type_traits> // std::conditional
+
 /**************************************************************/
 /*                     Defines and macros                     */
 /**************************************************************/
+#define STATISTICALFEATURES_MAX_SAMPLE 32768ULL    // Largest magnitude of an axis
+#define STATISTICALFEATURES_MAX_DIFF 65535ULL      // Largest difference of two samples of an axis
+#define STATISTICALFEATURES_MAX_MAGNITUDE 56756ULL // Largest magnitude of acceleration, 32768 * sqrt( 3 ) rounded up
 
 /**************************************************************/
 /*                     Typedefs and enums                     */
 /**************************************************************/
 
+// Accumulator of a sum of up to Count terms of at most MaxTerm: int32_t if it
+// can't overflow, as 64-bit adds and divisions are slower on the device
+template <uint64_t MaxTerm, uint16_t Count>
+using statisticalfeatures_sum_t = typename std::conditional<( MaxTerm * Count <= INT32_MAX ), int32_t, int64_t>::type;
+
 /**************************************************************/
 /*                          Private                           */
 /**************************************************************/
@@ -31,12 +41,13 @@
  * @param axis Axis to calculate mean for (X, Y, or Z)
  * @returns Mean value of the specified axis
  */
-static int16_t statisticalfeatures_mean( acceleration_sample_t* samples, uint8_t size, AXIS_T axis )
+template <uint16_t MaxSize>
+static int16_t statisticalfeatures_mean( acceleration_sample_t* samples, uint16_t size, AXIS_T axis )
 {
-    int32_t sum = 0;
-    for ( uint8_t i = 0; i < size; i++ )
+    statisticalfeatures_sum_t<STATISTICALFEATURES_MAX_SAMPLE, MaxSize> sum = 0;
+    for ( uint16_t i = 0; i < size; i++ )
     {
-        sum += ( int32_t )samples[i].acceleration[axis];
+        sum += samples[i].acceleration[axis];
     }
     return ( int16_t )( sum / size );
 }
@@ -50,11 +61,11 @@ static int16_t statisticalfeatures_mean( acceleration_sample_t* samples, uint8_t
  * @param axis Axis to calculate max for (X, Y, or Z)
  * @returns Maximum value of the specified axis
  */
-static int16_t statisticalfeatures_max( acceleration_sample_t* samples, uint8_t size, AXIS_T axis )
+static int16_t statisticalfeatures_max( acceleration_sample_t* samples, uint16_t size, AXIS_T axis )
 {
     int16_t maxVal = samples[0].acceleration[axis];
 
-    for ( uint8_t i = 1; i < size; i++ )
+    for ( uint16_t i = 1; i < size; i++ )
     {
         if ( ( samples[i].acceleration[axis] ) > ( maxVal ) )
         {
@@ -73,11 +84,11 @@ static int16_t statisticalfeatures_max( acceleration_sample_t* samples, uint8_t
  * @param axis Axis to calculate min for (X, Y, or Z)
  * @returns Minimum value of the specified axis
  */
-static int16_t statisticalfeatures_min( acceleration_sample_t* samples, uint8_t size, AXIS_T axis )
+static int16_t statisticalfeatures_min( acceleration_sample_t* samples, uint16_t size, AXIS_T axis )
 {
     int16_t minVal = samples[0].acceleration[axis];
 
-    for ( uint8_t i = 1; i < size; i++ )
+    for ( uint16_t i = 1; i < size; i++ )
     {
         if ( ( samples[i].acceleration[axis] ) < ( minVal ) )
         {
@@ -97,12 +108,14 @@ static int16_t statisticalfeatures_min( acceleration_sample_t* samples, uint8_t
  * @param mean Mean value of the specified axis
  * @returns Standard deviation of the specified axis
  */
-static int16_t statisticalfeatures_std( acceleration_sample_t* samples, uint8_t size, AXIS_T axis, int16_t mean )
+template <uint16_t MaxSize>
+static int16_t statisticalfeatures_std( acceleration_sample_t* samples, uint16_t size, AXIS_T axis, int16_t mean )
 {
-    int64_t sum = 0;
-    for ( uint8_t i = 0; i < size; i++ )
+    typedef statisticalfeatures_sum_t<STATISTICALFEATURES_MAX_DIFF * STATISTICALFEATURES_MAX_DIFF, MaxSize> sum_t;
+    sum_t sum = 0;
+    for ( uint16_t i = 0; i < size; i++ )
     {
-        sum += ( int64_t )( samples[i].acceleration[axis] - mean ) * ( samples[i].acceleration[axis] - mean );
+        sum += ( sum_t )( samples[i].acceleration[axis] - mean ) * ( samples[i].acceleration[axis] - mean );
     }
     return ( int16_t )( sum / ( size - 1 ) );
 }
@@ -117,13 +130,14 @@ static int16_t statisticalfeatures_std( acceleration_sample_t* samples, uint8_t
  * @param mean Mean value of the specified axis
  * @returns Mean absolute difference of the specified axis
  */
+template <uint16_t MaxSize>
 static int16_t statisticalfeatures_mean_abs_diff( acceleration_sample_t* samples,
-                                                  uint8_t size,
+                                                  uint16_t size,
                                                   AXIS_T axis,
                                                   int16_t mean )
 {
-    int32_t sum = 0;
-    for ( uint8_t i = 0; i < size; i++ )
+    statisticalfeatures_sum_t<STATISTICALFEATURES_MAX_DIFF, MaxSize> sum = 0;
+    for ( uint16_t i = 0; i < size; i++ )
     {
         int32_t diff =
             ( int32_t )( ( samples[i].acceleration[axis] > mean ) ? ( samples[i].acceleration[axis] - mean )
@@ -142,7 +156,7 @@ static int16_t statisticalfeatures_mean_abs_diff( acceleration_sample_t* samples
  * @param axis Axis to calculate max - min diff for (X, Y, or Z)
  * @returns Maximum - minimum difference of the specified axis
  */
-static int16_t statisticalfeatures_max_min_diff( acceleration_sample_t* samples, uint8_t size, AXIS_T axis )
+static int16_t statisticalfeatures_max_min_diff( acceleration_sample_t* samples, uint16_t size, AXIS_T axis )
 {
     int16_t maxVal = statisticalfeatures_max( samples, size, axis );
     int16_t minVal = statisticalfeatures_min( samples, size, axis );
@@ -159,14 +173,13 @@ static int16_t statisticalfeatures_max_min_diff( acceleration_sample_t* samples,
  * @param mean Mean value of the specified axis
  * @returns Count of samples above the mean for the specified axis
  */
-/* UNUSED - SAVE FOR (POSSIBLE) LATER USE
-static int16_t statisticalfeatures_above_mean_count( acceleration_sample_t* samples,
-                                                     uint8_t size,
-                                                     AXIS_T axis,
-                                                     int16_t mean )
-{
-    int16_t count = 0;
-    for ( uint8_t i = 0; i < size; i++ )
+static uint16_t statisticalfeatures_above_mean_count( acceleration_sample_t* samples,
+                                                      uint16_t size,
+                                                      AXIS_T axis,
+                                                      int16_t mean )
+{
+    uint16_t count = 0;
+    for ( uint16_t i = 0; i < size; i++ )
     {
         if ( ( samples[i].acceleration[axis] ) > mean )
         {
@@ -174,32 +187,270 @@ static int16_t statisticalfeatures_above_mean_count( acceleration_sample_t* samp
         }
     }
     return count;
-}*/
+}
 
 /**************************************************************/
-/*                           Public                           */
+/**
+ * Negative count
+ * Counts the number of negative samples for the specified axis.
+ * @param samples Pointer to array of samples
+ * @param size Number of samples in array
+ * @param axis Axis to count negative samples for (X, Y, or Z)
+ * @returns Count of negative samples for the specified axis
+ */
+static uint16_t statisticalfeatures_neg_count( acceleration_sample_t* samples, uint16_t size, AXIS_T axis )
+{
+    uint16_t count = 0;
+    for ( uint16_t i = 0; i < size; i++ )
+    {
+        if ( ( samples[i].acceleration[axis] ) < 0 )
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
 /**************************************************************/
+/**
+ * Positive count
+ * Counts the number of positive samples for the specified axis.
+ * @param samples Pointer to array of samples
+ * @param size Number of samples in array
+ * @param axis Axis to count positive samples for (X, Y, or Z)
+ * @returns Count of positive samples for the specified axis
+ */
+static uint16_t statisticalfeatures_pos_count( acceleration_sample_t* samples, uint16_t size, AXIS_T axis )
+{
+    return statisticalfeatures_above_mean_count( samples, size, axis, 0 );
+}
 
+/**************************************************************/
 /**
- * 'mean_abs_diff_z'
- * 'min_y'
- * 'max_x'
- * 'max_min_diff_x'
- * 'max_min_diff_y'
- * 'max_min_diff_z'
+ * Energy
+ * Calculates the sum of squares of the given samples for the specified axis.
+ * @param samples Pointer to array of samples
+ * @param size Number of samples in array
+ * @param axis Axis to calculate energy for (X, Y, or Z)
+ * @returns Energy of the specified axis
  */
+template <uint16_t MaxSize>
+static int64_t statisticalfeatures_energy( acceleration_sample_t* samples, uint16_t size, AXIS_T axis )
+{
+    statisticalfeatures_sum_t<STATISTICALFEATURES_MAX_SAMPLE * STATISTICALFEATURES_MAX_SAMPLE, MaxSize> sum = 0;
+    for ( uint16_t i = 0; i < size; i++ )
+    {
+        sum += ( int32_t )samples[i].acceleration[axis] * samples[i].acceleration[axis];
+    }
+    return sum;
+}
 
 /**************************************************************/
-uint8_t statisticalfeatures_getFeatures( acceleration_sample_t* samples, uint16_t size, int16_t* features )
+/**
+ * Square root
+ * Calculates the integer square root, rounded down, one bit at a time.
+ * @param value Value to calculate square root of
+ * @returns Square root of value
+ */
+static uint32_t statisticalfeatures_sqrt( uint32_t value )
+{
+    uint32_t root = 0;
+    uint32_t bit = 1UL << 30;
+
+    while ( bit > value )
+    {
+        bit >>= 2;
+    }
+    while ( bit != 0 )
+    {
+        if ( value >= root + bit )
+        {
+            value -= root + bit;
+            root = ( root >> 1 ) + bit;
+        }
+        else
+        {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+/**************************************************************/
+/**
+ * Signal magnitude area
+ * Calculates the sum of the magnitudes of acceleration of the given samples.
+ * @param samples Pointer to array of samples
+ * @param size Number of samples in array
+ * @returns Sum of magnitudes
+ */
+template <uint16_t MaxSize>
+static statisticalfeatures_sum_t<STATISTICALFEATURES_MAX_MAGNITUDE, MaxSize> statisticalfeatures_sma(
+    acceleration_sample_t* samples,
+    uint16_t size )
+{
+    statisticalfeatures_sum_t<STATISTICALFEATURES_MAX_MAGNITUDE, MaxSize> sum = 0;
+    for ( uint16_t i = 0; i < size; i++ )
+    {
+        // Each square fits 2^30, so their sum fits uint32_t
+        uint32_t square = 0;
+        for ( uint8_t axis = AXIS_X; axis <= AXIS_Z; axis++ )
+        {
+            square += ( uint32_t )( ( int32_t )samples[i].acceleration[axis] * samples[i].acceleration[axis] );
+        }
+        sum += statisticalfeatures_sqrt( square );
+    }
+    return sum;
+}
+
+// Names of candidate features, indexed by statisticalfeatures_candidate_t
+static const char* const statisticalfeatures_candidateNames[STATISTICALFEATURES_CANDIDATES] = {
+    "mean_x", "mean_y", "mean_z",
+    "std_x", "std_y", "std_z",
+    "mean_abs_diff_x", "mean_abs_diff_y", "mean_abs_diff_z",
+    "min_x", "min_y", "min_z",
+    "max_x", "max_y", "max_z",
+    "max_min_diff_x", "max_min_diff_y", "max_min_diff_z",
+    "neg_count_x", "neg_count_y", "neg_count_z",
+    "pos_count_x", "pos_count_y", "pos_count_z",
+    "above_mean_count_x", "above_mean_count_y", "above_mean_count_z",
+    "energy_x", "energy_y", "energy_z",
+    "avg_resultant",
+    "sma" };
+
+// Candidate feature of each feature of statisticalfeatures_getFeatures
+static const statisticalfeatures_candidate_t statisticalfeatures_modelCandidates[STATISTICALFEATURES_NUM_FEATURES] = {
+    STATISTICALFEATURES_STD_Z,          STATISTICALFEATURES_MEAN_ABS_DIFF_Z, STATISTICALFEATURES_MIN_Y,
+    STATISTICALFEATURES_MAX_MIN_DIFF_X, STATISTICALFEATURES_MAX_MIN_DIFF_Y,  STATISTICALFEATURES_MAX_MIN_DIFF_Z };
+
+/**************************************************************/
+/**
+ * Features
+ * Calculates the features of the model, with accumulators for MaxSize samples.
+ * @param samples Pointer to array of samples
+ * @param size Number of samples in array, at most MaxSize
+ * @param features Pointer to array of STATISTICALFEATURES_NUM_FEATURES features
+ * @returns Status
+ */
+template <uint16_t MaxSize>
+static uint8_t statisticalfeatures_features( acceleration_sample_t* samples, uint16_t size, int16_t* features )
 {
-    int16_t mean_z_val = statisticalfeatures_mean( samples, size, AXIS_Z );
+    int16_t mean_z_val = statisticalfeatures_mean<MaxSize>( samples, size, AXIS_Z );
 
-    features[0] = statisticalfeatures_std( samples, size, AXIS_Z, mean_z_val );
-    features[1] = statisticalfeatures_mean_abs_diff( samples, size, AXIS_Z, mean_z_val );
+    features[0] = statisticalfeatures_std<MaxSize>( samples, size, AXIS_Z, mean_z_val );
+    features[1] = statisticalfeatures_mean_abs_diff<MaxSize>( samples, size, AXIS_Z, mean_z_val );
     features[2] = statisticalfeatures_min( samples, size, AXIS_Y );
     features[3] = statisticalfeatures_max_min_diff( samples, size, AXIS_X );
     features[4] = statisticalfeatures_max_min_diff( samples, size, AXIS_Y );
     features[5] = statisticalfeatures_max_min_diff( samples, size, AXIS_Z );
 
     return 0;
-}
\ No newline at end of file
+}
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+template <uint16_t Size> uint8_t statisticalfeatures_getFeatures( acceleration_sample_t* samples, int16_t* features )
+{
+    return statisticalfeatures_features<Size>( samples, Size, features );
+}
+
+// The window of the step counter, see data_window_t
+template uint8_t statisticalfeatures_getFeatures<DATA_BUFFER_SIZE>( acceleration_sample_t* samples, int16_t* features );
+
+/**************************************************************/
+uint8_t statisticalfeatures_getFeatures( acceleration_sample_t* samples, uint16_t size, int16_t* features )
+{
+    return statisticalfeatures_features<WINDOW_MAX_SIZE>( samples, size, features );
+}
+
+/**************************************************************/
+uint8_t statisticalfeatures_getCandidates( acceleration_sample_t* samples, uint16_t size, int64_t* candidates )
+{
+    for ( uint8_t axis = AXIS_X; axis <= AXIS_Z; axis++ )
+    {
+        int16_t mean = statisticalfeatures_mean<WINDOW_MAX_SIZE>( samples, size, ( AXIS_T )axis );
+
+        candidates[STATISTICALFEATURES_MEAN_X + axis] = mean;
+        candidates[STATISTICALFEATURES_STD_X + axis] =
+            statisticalfeatures_std<WINDOW_MAX_SIZE>( samples, size, ( AXIS_T )axis, mean );
+        candidates[STATISTICALFEATURES_MEAN_ABS_DIFF_X + axis] =
+            statisticalfeatures_mean_abs_diff<WINDOW_MAX_SIZE>( samples, size, ( AXIS_T )axis, mean );
+        candidates[STATISTICALFEATURES_MIN_X + axis] = statisticalfeatures_min( samples, size, ( AXIS_T )axis );
+        candidates[STATISTICALFEATURES_MAX_X + axis] = statisticalfeatures_max( samples, size, ( AXIS_T )axis );
+        candidates[STATISTICALFEATURES_MAX_MIN_DIFF_X + axis] =
+            statisticalfeatures_max_min_diff( samples, size, ( AXIS_T )axis );
+        candidates[STATISTICALFEATURES_NEG_COUNT_X + axis] =
+            statisticalfeatures_neg_count( samples, size, ( AXIS_T )axis );
+        candidates[STATISTICALFEATURES_POS_COUNT_X + axis] =
+            statisticalfeatures_pos_count( samples, size, ( AXIS_T )axis );
+        candidates[STATISTICALFEATURES_ABOVE_MEAN_COUNT_X + axis] =
+            statisticalfeatures_above_mean_count( samples, size, ( AXIS_T )axis, mean );
+        candidates[STATISTICALFEATURES_ENERGY_X + axis] =
+            statisticalfeatures_energy<WINDOW_MAX_SIZE>( samples, size, ( AXIS_T )axis );
+    }
+
+    int64_t sma = statisticalfeatures_sma<WINDOW_MAX_SIZE>( samples, size );
+    candidates[STATISTICALFEATURES_AVG_RESULTANT] = sma / size;
+    candidates[STATISTICALFEATURES_SMA] = sma;
+
+    return 0;
+}
+
+/**************************************************************/
+int64_t statisticalfeatures_getCandidate( acceleration_sample_t* samples,
+                                          uint16_t size,
+                                          statisticalfeatures_candidate_t candidate )
+{
+    if ( candidate >= STATISTICALFEATURES_AVG_RESULTANT )
+    {
+        int64_t sma = statisticalfeatures_sma<WINDOW_MAX_SIZE>( samples, size );
+        return ( candidate == STATISTICALFEATURES_AVG_RESULTANT ) ? sma / size : sma;
+    }
+
+    // Per axis features come in groups of three, one per axis
+    AXIS_T axis = ( AXIS_T )( candidate % 3 );
+    switch ( ( statisticalfeatures_candidate_t )( candidate - axis ) )
+    {
+    case STATISTICALFEATURES_MEAN_X:
+        return statisticalfeatures_mean<WINDOW_MAX_SIZE>( samples, size, axis );
+    case STATISTICALFEATURES_STD_X:
+        return statisticalfeatures_std<WINDOW_MAX_SIZE>(
+            samples, size, axis, statisticalfeatures_mean<WINDOW_MAX_SIZE>( samples, size, axis ) );
+    case STATISTICALFEATURES_MEAN_ABS_DIFF_X:
+        return statisticalfeatures_mean_abs_diff<WINDOW_MAX_SIZE>(
+            samples, size, axis, statisticalfeatures_mean<WINDOW_MAX_SIZE>( samples, size, axis ) );
+    case STATISTICALFEATURES_MIN_X:
+        return statisticalfeatures_min( samples, size, axis );
+    case STATISTICALFEATURES_MAX_X:
+        return statisticalfeatures_max( samples, size, axis );
+    case STATISTICALFEATURES_MAX_MIN_DIFF_X:
+        return statisticalfeatures_max_min_diff( samples, size, axis );
+    case STATISTICALFEATURES_NEG_COUNT_X:
+        return statisticalfeatures_neg_count( samples, size, axis );
+    case STATISTICALFEATURES_POS_COUNT_X:
+        return statisticalfeatures_pos_count( samples, size, axis );
+    case STATISTICALFEATURES_ABOVE_MEAN_COUNT_X:
+        return statisticalfeatures_above_mean_count(
+            samples, size, axis, statisticalfeatures_mean<WINDOW_MAX_SIZE>( samples, size, axis ) );
+    case STATISTICALFEATURES_ENERGY_X:
+        return statisticalfeatures_energy<WINDOW_MAX_SIZE>( samples, size, axis );
+    default:
+        return 0;
+    }
+}
+
+/**************************************************************/
+const char* statisticalfeatures_candidateName( statisticalfeatures_candidate_t candidate )
+{
+    return statisticalfeatures_candidateNames[candidate];
+}
+
+/**************************************************************/
+statisticalfeatures_candidate_t statisticalfeatures_modelCandidate( uint8_t feature )
+{
+    return statisticalfeatures_modelCandidates[feature];
+}
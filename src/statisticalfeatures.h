@@ -11,6 +11,19 @@
  * - Maximum - minimum difference of x-axis
  * - Maximum - minimum difference of y-axis
  * - Maximum - minimum difference of z-axis
+ *
+ * The same helpers also calculate every candidate feature the model can be
+ * trained on, see statisticalfeatures_getCandidates, so features of the host
+ * training tools match the firmware bit for bit. Note that the standard
+ * deviation is the sample variance, truncated to int16_t, like the firmware
+ * has always calculated it.
+ *
+ * Windows hold up to WINDOW_MAX_SIZE samples. Every sum is accumulated in
+ * int32_t where it can't overflow for the window size, and in int64_t where it
+ * can, which is chosen at compile time. The firmware passes its window size
+ * as a template argument, so it gets the narrowest accumulators and a constant
+ * divisor. The host tools pass the size at run time, and get accumulators for
+ * the largest window. Both calculate the same features.
  */
 #ifndef STATISTICALFEATURES_H
 #define STATISTICALFEATURES_H
@@ -30,6 +43,45 @@
 /*                     Typedefs and enums                     */
 /**************************************************************/
 
+// Candidate features. Features calculated per axis come in groups of three, in
+// the order of AXIS_T, starting at a multiple of three
+typedef enum statisticalfeatures_candidate_
+{
+    STATISTICALFEATURES_MEAN_X,
+    STATISTICALFEATURES_MEAN_Y,
+    STATISTICALFEATURES_MEAN_Z,
+    STATISTICALFEATURES_STD_X,
+    STATISTICALFEATURES_STD_Y,
+    STATISTICALFEATURES_STD_Z,
+    STATISTICALFEATURES_MEAN_ABS_DIFF_X,
+    STATISTICALFEATURES_MEAN_ABS_DIFF_Y,
+    STATISTICALFEATURES_MEAN_ABS_DIFF_Z,
+    STATISTICALFEATURES_MIN_X,
+    STATISTICALFEATURES_MIN_Y,
+    STATISTICALFEATURES_MIN_Z,
+    STATISTICALFEATURES_MAX_X,
+    STATISTICALFEATURES_MAX_Y,
+    STATISTICALFEATURES_MAX_Z,
+    STATISTICALFEATURES_MAX_MIN_DIFF_X,
+    STATISTICALFEATURES_MAX_MIN_DIFF_Y,
+    STATISTICALFEATURES_MAX_MIN_DIFF_Z,
+    STATISTICALFEATURES_NEG_COUNT_X,
+    STATISTICALFEATURES_NEG_COUNT_Y,
+    STATISTICALFEATURES_NEG_COUNT_Z,
+    STATISTICALFEATURES_POS_COUNT_X,
+    STATISTICALFEATURES_POS_COUNT_Y,
+    STATISTICALFEATURES_POS_COUNT_Z,
+    STATISTICALFEATURES_ABOVE_MEAN_COUNT_X,
+    STATISTICALFEATURES_ABOVE_MEAN_COUNT_Y,
+    STATISTICALFEATURES_ABOVE_MEAN_COUNT_Z,
+    STATISTICALFEATURES_ENERGY_X,
+    STATISTICALFEATURES_ENERGY_Y,
+    STATISTICALFEATURES_ENERGY_Z,
+    STATISTICALFEATURES_AVG_RESULTANT, // Mean magnitude of acceleration
+    STATISTICALFEATURES_SMA,           // Signal magnitude area, sum of magnitudes
+    STATISTICALFEATURES_CANDIDATES
+} statisticalfeatures_candidate_t;
+
 /**************************************************************/
 /*                          Private                           */
 /**************************************************************/
@@ -40,9 +92,22 @@
 
 /**************************************************************/
 /**
- * Calculates statistical features
+ * Calculates statistical features of a window of Size samples. Instantiated
+ * for the window of the step counter, DATA_BUFFER_SIZE
+ * @param[in] samples Pointer to array of Size samples
+ * @param[out] features Pointer to array of features. Should be
+ * STATISTICALFEATURES_NUM_FEATURES features
+ * @returns Status
+ * @retval 0: Success
+ */
+template <uint16_t Size> uint8_t statisticalfeatures_getFeatures( acceleration_sample_t* samples, int16_t* features );
+
+/**************************************************************/
+/**
+ * Calculates statistical features of a window of any size
  * @param[in] samples Pointer to array of samples
- * @param[in] size Number of samples in array
+ * @param[in] size Number of samples in array, from WINDOW_MIN_SIZE to
+ * WINDOW_MAX_SIZE
  * @param[out] features Pointer to array of features. Should be
  * STATISTICALFEATURES_NUM_FEATURES features
  * @returns Status
@@ -50,4 +115,49 @@
  */
 uint8_t statisticalfeatures_getFeatures( acceleration_sample_t* samples, uint16_t size, int16_t* features );
 
+/**************************************************************/
+/**
+ * Calculates every candidate feature, with the same arithmetic as
+ * statisticalfeatures_getFeatures
+ * @param[in] samples Pointer to array of samples
+ * @param[in] size Number of samples in array
+ * @param[out] candidates Pointer to array of features, indexed by
+ * statisticalfeatures_candidate_t. Should be STATISTICALFEATURES_CANDIDATES
+ * features
+ * @returns Status
+ * @retval 0: Success
+ */
+uint8_t statisticalfeatures_getCandidates( acceleration_sample_t* samples, uint16_t size, int64_t* candidates );
+
+/**************************************************************/
+/**
+ * Calculates one candidate feature, with only the helpers it needs, so each
+ * helper can be timed on its own. Features of the mean of an axis calculate
+ * the mean too
+ * @param[in] samples Pointer to array of samples
+ * @param[in] size Number of samples in array
+ * @param[in] candidate Candidate feature
+ * @returns Value of feature, the same as statisticalfeatures_getCandidates
+ */
+int64_t statisticalfeatures_getCandidate( acceleration_sample_t* samples,
+                                          uint16_t size,
+                                          statisticalfeatures_candidate_t candidate );
+
+/**************************************************************/
+/**
+ * Gets the name of a candidate feature, like the feature names of the training
+ * notebook, "std_z" for example
+ * @param[in] candidate Candidate feature
+ * @returns Name of feature
+ */
+const char* statisticalfeatures_candidateName( statisticalfeatures_candidate_t candidate );
+
+/**************************************************************/
+/**
+ * Gets the candidate feature of each feature of statisticalfeatures_getFeatures
+ * @param[in] feature Index of feature, less than STATISTICALFEATURES_NUM_FEATURES
+ * @returns Candidate feature
+ */
+statisticalfeatures_candidate_t statisticalfeatures_modelCandidate( uint8_t feature );
+
 #endif // STATISTICALFEATURES_H
@@ -0,0 +1,43 @@
+/**
+ * @file step_counter_trees.h
+ * @author Simon Udsen
+ * @date 2026-10-18
+ * @brief Table of the trees of the step counter model
+ * @details Includes step_counter_model.h, and gives the firmware its tree count
+ * STEP_COUNTER_MODEL_TREE_COUNT and the table step_counter_model_trees of its
+ * tree functions, so every tree can be profiled and run on its own. A header
+ * written by host/tools/trainforest has both. The header emlearn writes, from
+ * python/train_model_randomForestRegressor.ipynb, has neither, so they are
+ * given here, and the build fails if the model has another number of trees.
+ */
+#ifndef STEP_COUNTER_TREES_H
+#define STEP_COUNTER_TREES_H
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include "step_counter_model.h" // Step counter model
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+#ifndef STEP_COUNTER_MODEL_TREE_COUNT
+#define STEP_COUNTER_MODEL_TREE_COUNT 7 // Trees of the model emlearn wrote
+
+// Tree functions of the model emlearn wrote
+static int32_t ( *const step_counter_model_trees[STEP_COUNTER_MODEL_TREE_COUNT] )( const int16_t*, int32_t ) = {
+    step_counter_model_tree_0,
+    step_counter_model_tree_1,
+    step_counter_model_tree_2,
+    step_counter_model_tree_3,
+    step_counter_model_tree_4,
+    step_counter_model_tree_5,
+    step_counter_model_tree_6,
+};
+#endif
+
+static_assert( sizeof( step_counter_model_tree_roots ) / sizeof( step_counter_model_tree_roots[0] ) ==
+                   STEP_COUNTER_MODEL_TREE_COUNT,
+               "The model has another number of trees, update the table of step_counter_trees.h" );
+
+#endif // STEP_COUNTER_TREES_H
@@ -7,14 +7,22 @@
 /**************************************************************/
 /*                          Includes                          */
 /**************************************************************/
-#include "stepcounter.h"         // Header file for this module
-#include "statisticalfeatures.h" // Statistical features
-#include "step_counter_model.h"  // Step counter model
+#include "stepcounter.h"        // Header file for this module
+#include "step_counter_trees.h" // Trees of the step counter model
+#include "arena.h"              // Static arena for the pipeline objects
+#include "metrics.h"            // Runtime health metrics
+#include "overload.h"           // Handling of full sample stream
+#include "profiler.h"           // Cycle counter profiling
 
 /**************************************************************/
 /*                     Defines and macros                     */
 /**************************************************************/
-#define QUEUE_TIMEOUT_MS 500 // Timeout for queue operations
+#define QUEUE_TIMEOUT_MS 500 // Timeout for sample stream reads
+
+// Log every window. The event loop predicts on the sampling thread, where a
+// log line on the serial port would delay the next sample, so it only counts
+// windows in the metrics
+#define STEPCOUNTER_LOG_WINDOWS ( PIPELINE_MODE == PIPELINE_MODE_THREADS )
 
 /**************************************************************/
 /*                     Typedefs and enums                     */
@@ -25,27 +33,32 @@
 /**************************************************************/
 /**************************************************************/
 
-/**************************************************************/
-// Use ML algorithm to detect how many steps a buffer of size DATA_BUFFER_SIZE contains
+// Trees of the model, from the table of step_counter_trees.h, so each of them
+// can be profiled separately, and a subset can be used as a cheaper model when
+// overloaded
+#define MODEL_TREE_COUNT STEP_COUNTER_MODEL_TREE_COUNT
 
-int countSteps( acceleration_sample_t* buffer )
-{
-    // Calculate statistical features
-    int16_t features[STATISTICALFEATURES_NUM_FEATURES] = { 0 };
-    statisticalfeatures_getFeatures( buffer, DATA_BUFFER_SIZE, features );
+// A model with fewer trees than OVERLOAD_DEGRADED_TREES is degraded to all of them
+#define MODEL_DEGRADED_TREE_COUNT \
+    ( ( OVERLOAD_DEGRADED_TREES < MODEL_TREE_COUNT ) ? OVERLOAD_DEGRADED_TREES : MODEL_TREE_COUNT )
 
-    Log.info(
-        "Features: %d %d %d %d %d %d", features[0], features[1], features[2], features[3], features[4], features[5] );
+static_assert( ( MODEL_TREE_COUNT > 0 ) && ( MODEL_TREE_COUNT <= PROFILER_MODEL_TREE_MAX ),
+               "Every model tree needs a profiler region, retrain with fewer trees" );
+static_assert( OVERLOAD_DEGRADED_TREES > 0, "Degraded model must use at least one tree" );
 
-    // Predict number of steps
-    int steps = ( int )step_counter_model_predict( features, STATISTICALFEATURES_NUM_FEATURES );
+static_assert( WINDOW_RESULT_NUM_FEATURES == STATISTICALFEATURES_NUM_FEATURES,
+               "Window results must carry every feature" );
 
-    Log.info( "Predicted steps: %d", steps );
-    return steps;
-}
+// Steps are counted per window, so overlapping windows would count them twice
+static_assert( data_window_t::HOP == data_window_t::SIZE,
+               "The step counter predicts back to back windows, so the hop must be the window length" );
+
+// The event loop evaluates one tree per sample, after the features, so a window
+// must be predicted before the next one is full
+static_assert( MODEL_TREE_COUNT + 1 < DATA_BUFFER_SIZE, "Window is too short to predict it one tree per sample" );
 
 /**************************************************************/
-// Forward data from queue to double buffer
+// Forward data from stream to double buffer
 int stepcounter::forwardData()
 {
     // Status of operation
@@ -54,21 +67,15 @@ int stepcounter::forwardData()
     // Data to get from accelerometer
     acceleration_sample_t sample = { 0 };
 
-    // Data to send to TCP server
-    String data;
-
-    status = os_queue_take( *dataQueue, &sample, QUEUE_TIMEOUT_MS, NULL );
+    {
+        PROFILER_SCOPE( PROFILER_REGION_QUEUE_TAKE );
+        status = samplestream_read( samples, sampleReader, &sample, QUEUE_TIMEOUT_MS );
+    }
 
     if ( status == 0 )
     {
-        // Write data to dual buffer
-        buffer[bufferWriteIndex] = sample;
-
-        // Increment write index
-        bufferWriteIndex = ( bufferWriteIndex + 1 ) % DATA_BUFFER_SIZE;
-
         // If buffer is full, signal to process data
-        if ( bufferWriteIndex == 0 )
+        if ( addSample( &sample ) )
         {
             // Signal to process data, and wait until it is done
             if ( os_semaphore_give( bufferReadySemaphore, 0 ) != 0 )
@@ -93,13 +100,16 @@ void bufferPiping( void* owner )
 {
     stepcounter* self = ( stepcounter* )owner;
 
+    metrics_threadStart( METRICS_THREAD_BUFFER, BUFFER_THREAD_STACK_SIZE );
+    TRACER_REGISTER_THREAD( "buffer" );
+
     while ( true )
     {
         switch ( self->state )
         {
         case STEPCOUNTER_STATE_BEGIN:
         {
-            self->firstBufferFilled = false;
+            self->resetWindow();
             self->state = STEPCOUNTER_STATE_RUNNING;
             break;
         }
@@ -144,6 +154,9 @@ void predictSteps( void* owner )
 {
     stepcounter* self = ( stepcounter* )owner;
 
+    metrics_threadStart( METRICS_THREAD_PREDICTOR, PREDICTOR_THREAD_STACK_SIZE );
+    TRACER_REGISTER_THREAD( "predictor" );
+
     while ( true )
     {
         // Wait for signal to process data
@@ -152,14 +165,13 @@ void predictSteps( void* owner )
             Log.error( "Stepcounter: error in semaphore" );
         }
 
-        if ( self->firstBufferFilled )
-        {
-            self->stepCount += countSteps( self->buffer );
-        }
-        else
+        stepcounter_window_t window;
+        if ( self->beginWindow( &window ) )
         {
-            // Ignore first buffer, as it may contain garbage data
-            self->firstBufferFilled = true;
+            while ( !self->predictTree( &window ) )
+            {
+            }
+            self->finishWindow( &window );
         }
 
         // Signal that data processing is done
@@ -171,10 +183,14 @@ void predictSteps( void* owner )
 }
 
 /**************************************************************/
-stepcounter::stepcounter( os_queue_t* dataQueue )
+stepcounter::stepcounter( samplestream_t* samples, os_queue_t* resultQueue )
 {
-    // Queue to read accelerometer data from
-    this->dataQueue = dataQueue;
+    // Stream to read accelerometer data from
+    this->samples = samples;
+    this->sampleReader = 0;
+
+    // Queue to put window results in
+    this->resultQueue = resultQueue;
 
     // State of stepcounter
     this->state = STEPCOUNTER_STATE_IDLE;
@@ -183,11 +199,172 @@ stepcounter::stepcounter( os_queue_t* dataQueue )
     memset( &( this->buffer ), 0x00, sizeof( this->buffer ) );
 }
 
+/**************************************************************/
+void stepcounter::resetWindow()
+{
+    bufferWriteIndex = 0;
+    bufferDropped = 0;
+    firstBufferFilled = false;
+}
+
+/**************************************************************/
+bool stepcounter::addSample( const acceleration_sample_t* sample )
+{
+    // Count samples lost in this window. A long window can lose more samples
+    // than the count holds, so it saturates
+    uint32_t dropped = ( uint32_t )bufferDropped + sample->dropped;
+    bufferDropped = ( dropped < UINT16_MAX ) ? ( uint16_t )dropped : UINT16_MAX;
+
+    // Write data to buffer
+    buffer[bufferWriteIndex] = *sample;
+
+    // Increment write index
+    bufferWriteIndex = ( bufferWriteIndex + 1 ) % DATA_BUFFER_SIZE;
+
+    return bufferWriteIndex == 0;
+}
+
+/**************************************************************/
+bool stepcounter::beginWindow( stepcounter_window_t* window )
+{
+    // Take the samples lost in this window, so the next window starts without
+    window->dropped = bufferDropped;
+    window->timestamp = buffer[0].timestamp;
+    bufferDropped = 0;
+
+    if ( !firstBufferFilled )
+    {
+        // Ignore first buffer, as it may contain garbage data
+        firstBufferFilled = true;
+        metrics_startupWindowDiscarded();
+        return false;
+    }
+
+    // Calculate statistical features
+    memset( window->features, 0x00, sizeof( window->features ) );
+    {
+        PROFILER_SCOPE( PROFILER_REGION_GET_FEATURES );
+        statisticalfeatures_getFeatures<DATA_BUFFER_SIZE>( buffer, window->features );
+    }
+
+#if STEPCOUNTER_LOG_WINDOWS
+    Log.info( "Features: %d %d %d %d %d %d",
+              window->features[0],
+              window->features[1],
+              window->features[2],
+              window->features[3],
+              window->features[4],
+              window->features[5] );
+#endif
+
+    // Predict with fewer trees if the pipeline is overloaded
+    window->treeCount = MODEL_TREE_COUNT;
+    if ( overload_isDegraded() )
+    {
+        window->treeCount = MODEL_DEGRADED_TREE_COUNT;
+        metrics_degradedWindow();
+    }
+    window->treeIndex = 0;
+    window->treeSum = 0;
+
+    return true;
+}
+
+/**************************************************************/
+bool stepcounter::predictTree( stepcounter_window_t* window )
+{
+    // Same as step_counter_model_predict, but with every tree profiled
+    if ( window->treeIndex < window->treeCount )
+    {
+        PROFILER_SCOPE( ( profiler_region_t )( PROFILER_REGION_MODEL_TREE_0 + window->treeIndex ) );
+        window->treeSum +=
+            step_counter_model_trees[window->treeIndex]( window->features, STATISTICALFEATURES_NUM_FEATURES );
+        window->treeIndex++;
+    }
+
+    return window->treeIndex >= window->treeCount;
+}
+
+/**************************************************************/
+uint8_t stepcounter::getTreeCount()
+{
+    return MODEL_TREE_COUNT;
+}
+
+/**************************************************************/
+void stepcounter::finishWindow( stepcounter_window_t* window )
+{
+    int predicted = ( int )( window->treeSum / window->treeCount );
+#if STEPCOUNTER_LOG_WINDOWS
+    Log.info( "Predicted steps: %d", predicted );
+#endif
+
+    uint32_t steps = predicted;
+
+#if PREDICTOR_LOAD_TEST_US > 0
+    // Simulate a more expensive model, to test that sampling is not delayed
+    uint32_t loadStart = micros();
+    while ( ( micros() - loadStart ) < PREDICTOR_LOAD_TEST_US )
+    {
+    }
+#endif
+
+    // The window spans more time than DATA_BUFFER_SIZE samples if samples were
+    // lost, so extrapolate the steps to the lost samples
+    if ( window->dropped > 0 )
+    {
+        steps = ( steps * ( DATA_BUFFER_SIZE + window->dropped ) + DATA_BUFFER_SIZE / 2 ) / DATA_BUFFER_SIZE;
+        metrics_gapWindow();
+#if STEPCOUNTER_LOG_WINDOWS
+        Log.info( "Stepcounter: %u samples lost in window, extrapolated to %lu steps",
+                  window->dropped,
+                  ( unsigned long )steps );
+#endif
+    }
+
+    stepCount += steps;
+
+    // Stream the result without waiting, a full queue means the datarouter is
+    // behind
+    if ( resultQueue != NULL )
+    {
+        window_result_t result;
+        result.timestamp = window->timestamp;
+        memcpy( result.features, window->features, sizeof( result.features ) );
+        result.steps = ( uint16_t )steps;
+        result.dropped = window->dropped;
+        if ( os_queue_put( *resultQueue, &result, 0, NULL ) != 0 )
+        {
+            metrics_resultDropped();
+#if STEPCOUNTER_LOG_WINDOWS
+            Log.warn( "Stepcounter: result queue full, window result dropped" );
+#endif
+        }
+    }
+}
+
 /**************************************************************/
 int stepcounter::init()
 {
     int result = 0;
 
+#if PIPELINE_MODE == PIPELINE_MODE_EVENT_LOOP
+    // The event loop drives the window functions, so no threads are needed
+    return result;
+#endif
+
+    // Read every sample from the stream, starting with the next one
+    int reader = samplestream_addReader( samples, STEPCOUNTER_SAMPLE_POLICY );
+    if ( reader < 0 )
+    {
+        Log.error( "Failed to add stepcounter sample stream reader" );
+        result = -1;
+    }
+    else
+    {
+        sampleReader = ( uint8_t )reader;
+    }
+
     // Initialize state machine semaphore
     if ( result == 0 )
     {
@@ -219,7 +396,8 @@ int stepcounter::init()
     // Initialize bufferThread
     if ( result == 0 )
     {
-        bufferThread = new Thread( "", bufferPiping, this, OS_THREAD_PRIORITY_DEFAULT, OS_THREAD_STACK_SIZE_DEFAULT );
+        bufferThread = arena_new<Thread>(
+            ARENA_MODULE_STEPCOUNTER, "", bufferPiping, this, BUFFER_THREAD_PRIORITY, BUFFER_THREAD_STACK_SIZE );
         if ( bufferThread == NULL )
         {
             Log.error( "Failed to create stepcounter buffer thread" );
@@ -230,8 +408,8 @@ int stepcounter::init()
     // Initialize predictorThread
     if ( result == 0 )
     {
-        predictorThread =
-            new Thread( "", predictSteps, this, OS_THREAD_PRIORITY_DEFAULT, OS_THREAD_STACK_SIZE_DEFAULT );
+        predictorThread = arena_new<Thread>(
+            ARENA_MODULE_STEPCOUNTER, "", predictSteps, this, PREDICTOR_THREAD_PRIORITY, PREDICTOR_THREAD_STACK_SIZE );
         if ( predictorThread == NULL )
         {
             Log.error( "Failed to create stepcounter predictor thread" );
@@ -239,6 +417,10 @@ int stepcounter::init()
         }
     }
 
+    TRACER_REGISTER( stateUpdateSemaphore, "stepcounter_state" );
+    TRACER_REGISTER( bufferReadySemaphore, "bufferReady" );
+    TRACER_REGISTER( bufferProcessedSemaphore, "bufferProcessed" );
+
     return result;
 }
 
@@ -248,11 +430,11 @@ stepcounter::~stepcounter()
     // Stop threads, if initialized
     if ( bufferThread != NULL )
     {
-        delete bufferThread;
+        arena_delete( bufferThread );
     }
     if ( predictorThread != NULL )
     {
-        delete predictorThread;
+        arena_delete( predictorThread );
     }
 }
 
@@ -3,6 +3,14 @@
  * @author Simon Udsen
  * @date 2025-03-27
  * @brief Predict step count from accelerometer data
+ * @details With PIPELINE_MODE_THREADS, a buffer thread moves samples from the
+ * sample stream to the window buffer, and a predictor thread predicts full windows.
+ * With PIPELINE_MODE_EVENT_LOOP, no threads are created, and the event loop
+ * calls the window functions instead
+ *
+ * With RESULT_STREAMING_ENABLED, the features and steps of every window are
+ * put in a result queue as a window_result_t, for the datarouter to send. A
+ * full result queue drops the result, so prediction never waits for the network
  */
 
 #ifndef STEPCOUNTER_H
@@ -13,6 +21,8 @@
 /**************************************************************/
 #include "Particle.h"
 #include "config.h"
+#include "samplestream.h"        // Broadcast of samples to several readers
+#include "statisticalfeatures.h" // Statistical features
 
 /**************************************************************/
 /*                     Defines and macros                     */
@@ -31,6 +41,17 @@ typedef enum stepcounter_state_
     STEPCOUNTER_STATE_FINISH,
 } stepcounter_state_t;
 
+// Prediction of a single window, so it can be run one slice at a time
+typedef struct stepcounter_window_
+{
+    int16_t features[STATISTICALFEATURES_NUM_FEATURES]; // Statistical features of window
+    uint8_t treeCount;                                  // Number of model trees to evaluate
+    uint8_t treeIndex;                                  // Next model tree to evaluate
+    uint16_t dropped;                                   // Samples lost in window, at most UINT16_MAX
+    uint32_t timestamp;                                 // Timestamp of first sample in window
+    float treeSum;                                      // Sum of evaluated model trees
+} stepcounter_window_t;
+
 class stepcounter
 {
   public:
@@ -40,9 +61,12 @@ class stepcounter
     uint32_t stepCount; // Number of steps counted
     /**
      * Object to predict step count from accelerometer data
-     * @param[in] dataQueue Queue to read accelerometer data from
+     * @param[in] samples Stream to read accelerometer data from, or NULL when
+     * the event loop adds the samples
+     * @param[in] resultQueue Queue to put window results in, or NULL to not
+     * stream results
      */
-    stepcounter( os_queue_t* dataQueue ); // Constructor
+    stepcounter( samplestream_t* samples, os_queue_t* resultQueue = NULL ); // Constructor
 
     /**
      * Deletes thread, if initialized
@@ -70,6 +94,47 @@ class stepcounter
      */
     int stop();
 
+    /**
+     * Forgets the window being filled, and skips the next full window, as it
+     * may contain garbage data. Called when a measurement begins
+     */
+    void resetWindow();
+
+    /**
+     * Writes a sample to the window buffer
+     * @param[in] sample Sample to write
+     * @returns True if the window is full, and must be predicted before the
+     * next sample is added
+     */
+    bool addSample( const acceleration_sample_t* sample );
+
+    /**
+     * Starts predicting the full window, by calculating its features
+     * @param[out] window Prediction of the window
+     * @returns True if the window must be predicted, false if it is skipped
+     */
+    bool beginWindow( stepcounter_window_t* window );
+
+    /**
+     * Evaluates the next model tree of a window. The window buffer may be
+     * reused once beginWindow has returned
+     * @param[in,out] window Prediction of the window
+     * @returns True if all trees have been evaluated
+     */
+    bool predictTree( stepcounter_window_t* window );
+
+    /**
+     * Adds the steps predicted for a window to the step count
+     * @param[in] window Prediction of the window, with all trees evaluated
+     */
+    void finishWindow( stepcounter_window_t* window );
+
+    /**
+     * Gets the number of trees of the model
+     * @returns Trees a window is predicted with, when not degraded
+     */
+    static uint8_t getTreeCount();
+
     // Thread functions
     friend void bufferPiping( void* owner );
     friend void predictSteps( void* owner );
@@ -78,14 +143,17 @@ class stepcounter
     /**************************************************************/
     /*                          Private                           */
     /**************************************************************/
-    os_queue_t* dataQueue; // Queue to read accelerometer data from
+    samplestream_t* samples; // Stream to read accelerometer data from
+    uint8_t sampleReader;    // Reader index in sample stream
+    os_queue_t* resultQueue; // Queue to put window results in, or NULL
 
     Thread* predictorThread;             // Thread for predicting step count asynchronously
-    Thread* bufferThread;                // Thread for piping data from queue to dual buffer
+    Thread* bufferThread;                // Thread for piping data from stream to dual buffer
     os_semaphore_t stateUpdateSemaphore; // Semaphore to wake up state machine thread
 
     acceleration_sample_t buffer[DATA_BUFFER_SIZE]; // Buffer for storing acceleration samples
     uint16_t bufferWriteIndex;                      // Write index for buffer
+    uint16_t bufferDropped;                         // Samples lost while filling buffer, at most UINT16_MAX
     os_semaphore_t bufferReadySemaphore;            // Signal that a buffer is full
     os_semaphore_t bufferProcessedSemaphore;        // Signal that a buffer is processed
 
@@ -93,7 +161,7 @@ class stepcounter
     bool firstBufferFilled; // Flag to indicate if buffer has been filled once before. This avoids processing the first
                             // buffer, which may contain garbage data
 
-    // Helper function to forward data from queue to double buffer
+    // Helper function to forward data from stream to double buffer
     int forwardData();
 };
 
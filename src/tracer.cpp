@@ -0,0 +1,372 @@
+/**
+ * @file tracer.cpp
+ * @author Simon Udsen
+ * @date 2026-10-18
+ */
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include "tracer.h" // Header file for this module
+
+#if TRACER_ENABLED
+
+#include "Particle.h" // Particle Device OS APIs
+#include "profiler.h" // Names of the profiler regions
+
+#include <atomic>   // Lock-free ring
+#include <stdarg.h> // va_list
+#include <stdio.h>  // vsnprintf
+#include <string.h> // strlen
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+#define TRACER_MASK ( TRACER_SIZE - 1 ) // Mask from event count to ring index
+#define TRACER_THREAD_COUNT 16          // Threads the export tells apart, the rest share the last row
+#define TRACER_LINE_SIZE 192            // Longest JSON of one event
+#define TRACER_PID 1                    // Process of every event in the export
+#define TRACER_CPU_TID 0                // Row of the running thread
+
+static_assert( ( TRACER_SIZE & TRACER_MASK ) == 0, "TRACER_SIZE must be a power of two" );
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+// Recorded event
+typedef struct tracer_event_
+{
+    uint32_t timeUs;    // micros() when recorded
+    uint8_t type;       // Kind of event, a tracer_event_type_t
+    uint16_t value;     // Meaning depends on type
+    const void* thread; // Thread the event happened in
+    const void* object; // Semaphore, queue or mutex, or NULL
+} tracer_event_t;
+
+// Name of a thread or object
+typedef struct tracer_name_
+{
+    const void* object; // Handle
+    const char* name;   // Name
+} tracer_name_t;
+
+// State of an export
+typedef struct tracer_exporter_
+{
+    tracer_write_t write;                     // Sink of the JSON
+    void* context;                            // Argument of write
+    bool first;                               // No event written yet
+    const void* threads[TRACER_THREAD_COUNT]; // Threads seen, row is index + 1
+    uint8_t threadCount;                      // Threads seen
+} tracer_exporter_t;
+
+/**************************************************************/
+/*                          Private                           */
+/**************************************************************/
+static tracer_event_t events[TRACER_SIZE];     // Ring of events
+static std::atomic<uint32_t> head( 0 );        // Events recorded since tracer_start
+static std::atomic<bool> recording( false );   // Events are recorded
+static tracer_name_t names[TRACER_NAME_COUNT]; // Names given, oldest first
+static std::atomic<uint32_t> nameCount( 0 );   // Names given
+
+/**************************************************************/
+// Get the name of a thread or object, or its address if it has none
+static const char* nameOf( const void* object, char* buffer, size_t size )
+{
+    uint32_t count = nameCount.load( std::memory_order_acquire );
+    count = ( count < TRACER_NAME_COUNT ) ? count : TRACER_NAME_COUNT;
+
+    // The newest name wins, so an object can be renamed
+    for ( uint32_t i = count; i > 0; i-- )
+    {
+        if ( names[i - 1].object == object )
+        {
+            return names[i - 1].name;
+        }
+    }
+    snprintf( buffer, size, "0x%lx", ( unsigned long )( uintptr_t )object );
+    return buffer;
+}
+
+/**************************************************************/
+// Write one event of the JSON array
+static void emit( tracer_exporter_t* exporter, const char* format, ... )
+{
+    char line[TRACER_LINE_SIZE];
+    size_t length = 0;
+    if ( !exporter->first )
+    {
+        line[length++] = ',';
+    }
+    exporter->first = false;
+
+    va_list args;
+    va_start( args, format );
+    int written = vsnprintf( line + length, sizeof( line ) - length, format, args );
+    va_end( args );
+    if ( written < 0 )
+    {
+        return;
+    }
+    length += ( ( size_t )written < sizeof( line ) - length ) ? ( size_t )written : sizeof( line ) - length - 1;
+    line[length++] = '\n';
+    exporter->write( line, length, exporter->context );
+}
+
+/**************************************************************/
+// Get the row of a thread, naming the row the first time it is seen
+static int threadRow( tracer_exporter_t* exporter, const void* thread )
+{
+    for ( uint8_t i = 0; i < exporter->threadCount; i++ )
+    {
+        if ( exporter->threads[i] == thread )
+        {
+            return i + 1;
+        }
+    }
+    if ( exporter->threadCount == TRACER_THREAD_COUNT )
+    {
+        return TRACER_THREAD_COUNT;
+    }
+
+    exporter->threads[exporter->threadCount++] = thread;
+    char buffer[24];
+    emit( exporter,
+          "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+          TRACER_PID,
+          exporter->threadCount,
+          nameOf( thread, buffer, sizeof( buffer ) ) );
+    return exporter->threadCount;
+}
+
+/**************************************************************/
+// Write a slice of the cpu row, for the time a thread ran
+static void emitRun( tracer_exporter_t* exporter, const void* thread, uint64_t startUs, uint64_t endUs )
+{
+    char buffer[24];
+    emit( exporter,
+          "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,\"pid\":%d,\"tid\":%d}",
+          nameOf( thread, buffer, sizeof( buffer ) ),
+          ( unsigned long long )startUs,
+          ( unsigned long long )( ( endUs > startUs ) ? endUs - startUs : 0 ),
+          TRACER_PID,
+          TRACER_CPU_TID );
+}
+
+/**************************************************************/
+// Write an event that isn't a switch
+static void emitEvent( tracer_exporter_t* exporter, const tracer_event_t* event, uint64_t timeUs )
+{
+    // RTOS calls, as "<verb> <object>" instant events, in tracer_event_type_t order
+    static const char* const verbs[TRACER_EVENT_COUNT] = {
+        NULL, NULL, NULL, NULL, NULL, "give", "take", "put", "take", "lock", "unlock",
+    };
+
+    int tid = threadRow( exporter, event->thread );
+    unsigned long long ts = ( unsigned long long )timeUs;
+    char buffer[24];
+
+    switch ( event->type )
+    {
+    case TRACER_EVENT_BEGIN:
+    case TRACER_EVENT_END:
+        emit( exporter,
+              "{\"name\":\"%s\",\"ph\":\"%s\",\"ts\":%llu,\"pid\":%d,\"tid\":%d}",
+              profiler_getName( ( profiler_region_t )( event->value % PROFILER_REGION_COUNT ) ),
+              ( event->type == TRACER_EVENT_BEGIN ) ? "B" : "E",
+              ts,
+              TRACER_PID,
+              tid );
+        break;
+
+    case TRACER_EVENT_WAIT:
+        emit( exporter,
+              "{\"name\":\"%s%s\",\"ph\":\"B\",\"ts\":%llu,\"pid\":%d,\"tid\":%d}",
+              ( event->object == NULL ) ? "delay" : "wait ",
+              ( event->object == NULL ) ? "" : nameOf( event->object, buffer, sizeof( buffer ) ),
+              ts,
+              TRACER_PID,
+              tid );
+        break;
+
+    case TRACER_EVENT_WAKE:
+        emit( exporter,
+              "{\"ph\":\"E\",\"ts\":%llu,\"pid\":%d,\"tid\":%d,\"args\":{\"timed_out\":%u}}",
+              ts,
+              TRACER_PID,
+              tid,
+              ( unsigned )event->value );
+        break;
+
+    case TRACER_EVENT_MUTEX_LOCK:
+    case TRACER_EVENT_MUTEX_UNLOCK:
+        emit( exporter,
+              "{\"name\":\"%s %s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%llu,\"pid\":%d,\"tid\":%d}",
+              verbs[event->type],
+              nameOf( event->object, buffer, sizeof( buffer ) ),
+              ts,
+              TRACER_PID,
+              tid );
+        break;
+
+    case TRACER_EVENT_SEMAPHORE_GIVE:
+    case TRACER_EVENT_SEMAPHORE_TAKE:
+    case TRACER_EVENT_QUEUE_PUT:
+    case TRACER_EVENT_QUEUE_TAKE:
+        emit( exporter,
+              "{\"name\":\"%s %s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%llu,\"pid\":%d,\"tid\":%d,"
+              "\"args\":{\"count\":%u}}",
+              verbs[event->type],
+              nameOf( event->object, buffer, sizeof( buffer ) ),
+              ts,
+              TRACER_PID,
+              tid,
+              ( unsigned )event->value );
+        break;
+
+    default:
+        break;
+    }
+}
+
+/**************************************************************/
+// Write a piece of the JSON that isn't an event
+static void writeText( tracer_exporter_t* exporter, const char* text )
+{
+    exporter->write( text, strlen( text ), exporter->context );
+}
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+void tracer_start()
+{
+    recording.store( false, std::memory_order_relaxed );
+    head.store( 0, std::memory_order_relaxed );
+    recording.store( true, std::memory_order_release );
+}
+
+/**************************************************************/
+void tracer_stop()
+{
+    recording.store( false, std::memory_order_release );
+}
+
+/**************************************************************/
+void tracer_record( tracer_event_type_t type, const void* thread, const void* object, uint16_t value )
+{
+    if ( !recording.load( std::memory_order_relaxed ) )
+    {
+        return;
+    }
+
+    tracer_event_t* event = &( events[head.fetch_add( 1, std::memory_order_relaxed ) & TRACER_MASK] );
+    event->timeUs = micros();
+    event->type = ( uint8_t )type;
+    event->value = value;
+    event->thread = thread;
+    event->object = object;
+}
+
+/**************************************************************/
+void tracer_begin( uint16_t region )
+{
+    tracer_record( TRACER_EVENT_BEGIN, os_thread_current( NULL ), NULL, region );
+}
+
+/**************************************************************/
+void tracer_end( uint16_t region )
+{
+    tracer_record( TRACER_EVENT_END, os_thread_current( NULL ), NULL, region );
+}
+
+/**************************************************************/
+void tracer_register( const void* object, const char* name )
+{
+    uint32_t slot = nameCount.load( std::memory_order_relaxed );
+    if ( slot >= TRACER_NAME_COUNT )
+    {
+        return;
+    }
+    names[slot].object = object;
+    names[slot].name = name;
+    nameCount.store( slot + 1, std::memory_order_release );
+}
+
+/**************************************************************/
+void tracer_registerThread( const char* name )
+{
+    tracer_register( os_thread_current( NULL ), name );
+}
+
+/**************************************************************/
+uint32_t tracer_export( tracer_write_t write, void* context )
+{
+    tracer_exporter_t exporter = {};
+    exporter.write = write;
+    exporter.context = context;
+    exporter.first = true;
+
+    writeText( &exporter, "{\"traceEvents\":[\n" );
+    emit( &exporter,
+          "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"TinyML step counter\"}}",
+          TRACER_PID );
+    emit( &exporter,
+          "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"cpu\"}}",
+          TRACER_PID,
+          TRACER_CPU_TID );
+
+    const uint32_t count = head.load( std::memory_order_acquire );
+    const uint32_t oldest = ( count > TRACER_SIZE ) ? count - TRACER_SIZE : 0;
+
+    // Times are unwrapped from 32 bits by adding the difference to the event
+    // before, which is signed as threads may record slightly out of order
+    uint64_t timeUs = ( count > oldest ) ? events[oldest & TRACER_MASK].timeUs : 0;
+    uint32_t previousUs = ( uint32_t )timeUs;
+    const void* running = NULL;
+    uint64_t runningSinceUs = 0;
+
+    for ( uint32_t i = oldest; i != count; i++ )
+    {
+        const tracer_event_t* event = &( events[i & TRACER_MASK] );
+        timeUs += ( int64_t )( int32_t )( event->timeUs - previousUs );
+        previousUs = event->timeUs;
+
+        if ( event->type != TRACER_EVENT_SWITCH )
+        {
+            emitEvent( &exporter, event, timeUs );
+            continue;
+        }
+        if ( running != NULL )
+        {
+            emitRun( &exporter, running, runningSinceUs, timeUs );
+        }
+        running = event->thread;
+        runningSinceUs = timeUs;
+    }
+    if ( running != NULL )
+    {
+        emitRun( &exporter, running, runningSinceUs, timeUs );
+    }
+
+    char footer[96];
+    snprintf( footer,
+              sizeof( footer ),
+              "],\"displayTimeUnit\":\"ms\",\"otherData\":{\"events\":%lu,\"overwritten\":%lu}}\n",
+              ( unsigned long )( count - oldest ),
+              ( unsigned long )oldest );
+    writeText( &exporter, footer );
+    return count - oldest;
+}
+
+/**************************************************************/
+uint32_t tracer_getOverwritten()
+{
+    uint32_t count = head.load( std::memory_order_acquire );
+    return ( count > TRACER_SIZE ) ? count - TRACER_SIZE : 0;
+}
+
+#endif // TRACER_ENABLED
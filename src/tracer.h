@@ -0,0 +1,155 @@
+/**
+ * @file tracer.h
+ * @author Simon Udsen
+ * @date 2026-10-18
+ * @brief Timeline of the pipeline, exported as Chrome trace JSON
+ * @details Events are written to a fixed-size ring of TRACER_SIZE events. A
+ * writer claims a slot with an atomic increment, so any thread or timer can
+ * record without locking, and when the ring is full the oldest events are
+ * overwritten. Every event has the time in microseconds and the thread that
+ * recorded it.
+ *
+ * The profiler regions of profiler.h record their begin and end, so feature
+ * extraction, every tree of the model, I2C reads and TCP writes show up as
+ * slices on the row of their thread. Device OS has no hook into the scheduler
+ * or the RTOS calls, so thread switches and semaphore, queue and mutex events
+ * are only recorded by the virtual-time Device OS of host/particle, which
+ * calls tracer_record. Names given with tracer_register label the threads and
+ * objects in the export.
+ *
+ * The export is the JSON object format of the Chrome trace viewer, which
+ * chrome://tracing and ui.perfetto.dev open. Running threads are shown on a
+ * "cpu" row, waits for a semaphore, queue or mutex as "wait" slices, and the
+ * other RTOS calls as instant events. Events are exported while recording is
+ * stopped, as a slot being written would be read half done.
+ *
+ * The profiler region names are used, so the tracer needs PROFILER_ENABLED.
+ */
+#ifndef TRACER_H
+#define TRACER_H
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include <stddef.h> // size_t
+
+#include "config.h" // Project configuration
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+#define TRACER_NAME_COUNT 32 // Threads and objects that can be named
+
+#if TRACER_ENABLED && !PROFILER_ENABLED
+#error "The tracer records the profiler regions, so it needs PROFILER_ENABLED"
+#endif
+
+#if TRACER_ENABLED
+// Name a semaphore, queue or mutex in the export
+#define TRACER_REGISTER( object, name ) tracer_register( object, name )
+// Name the calling thread in the export
+#define TRACER_REGISTER_THREAD( name ) tracer_registerThread( name )
+#else
+#define TRACER_REGISTER( object, name )
+#define TRACER_REGISTER_THREAD( name )
+#endif
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+// Kinds of events
+typedef enum tracer_event_type_
+{
+    TRACER_EVENT_SWITCH,         // Thread switched to, NULL when idle
+    TRACER_EVENT_BEGIN,          // Profiler region entered, value is the region
+    TRACER_EVENT_END,            // Profiler region left, value is the region
+    TRACER_EVENT_WAIT,           // Thread blocks on object, NULL for a delay
+    TRACER_EVENT_WAKE,           // Thread unblocks, value is 1 if it timed out
+    TRACER_EVENT_SEMAPHORE_GIVE, // Semaphore given, value is the count after
+    TRACER_EVENT_SEMAPHORE_TAKE, // Semaphore taken, value is the count after
+    TRACER_EVENT_QUEUE_PUT,      // Item put in queue, value is the items after
+    TRACER_EVENT_QUEUE_TAKE,     // Item taken from queue, value is the items after
+    TRACER_EVENT_MUTEX_LOCK,     // Mutex locked
+    TRACER_EVENT_MUTEX_UNLOCK,   // Mutex unlocked
+    TRACER_EVENT_COUNT
+} tracer_event_type_t;
+
+// Sink of the export, called with consecutive pieces of the JSON
+typedef void ( *tracer_write_t )( const char* text, size_t length, void* context );
+
+/**************************************************************/
+/*                           Public                           */
+/**************************************************************/
+
+/**************************************************************/
+/**
+ * Clears the ring and starts recording
+ */
+void tracer_start();
+
+/**************************************************************/
+/**
+ * Stops recording, so the ring can be exported
+ */
+void tracer_stop();
+
+/**************************************************************/
+/**
+ * Records an event, if recording
+ * @param[in] type Kind of event
+ * @param[in] thread Thread the event happened in
+ * @param[in] object Semaphore, queue or mutex, or NULL
+ * @param[in] value Meaning depends on type
+ */
+void tracer_record( tracer_event_type_t type, const void* thread, const void* object, uint16_t value );
+
+/**************************************************************/
+/**
+ * Records the start of a profiler region in the calling thread
+ * @param[in] region Region entered, a profiler_region_t
+ */
+void tracer_begin( uint16_t region );
+
+/**************************************************************/
+/**
+ * Records the end of a profiler region in the calling thread
+ * @param[in] region Region left, a profiler_region_t
+ */
+void tracer_end( uint16_t region );
+
+/**************************************************************/
+/**
+ * Names a thread, semaphore, queue or mutex in the export. Names are kept
+ * across tracer_start, and once TRACER_NAME_COUNT are given the rest are
+ * ignored
+ * @param[in] object Handle of the object
+ * @param[in] name Name, which must outlive the tracer
+ */
+void tracer_register( const void* object, const char* name );
+
+/**************************************************************/
+/**
+ * Names the calling thread in the export
+ * @param[in] name Name, which must outlive the tracer
+ */
+void tracer_registerThread( const char* name );
+
+/**************************************************************/
+/**
+ * Writes the recorded events as Chrome trace JSON. Must be called while
+ * recording is stopped
+ * @param[in] write Sink of the JSON
+ * @param[in] context Argument of write
+ * @returns Number of events exported
+ */
+uint32_t tracer_export( tracer_write_t write, void* context );
+
+/**************************************************************/
+/**
+ * Gets the number of events overwritten because the ring was full
+ * @returns Events lost since tracer_start
+ */
+uint32_t tracer_getOverwritten();
+
+#endif // TRACER_H
@@ -0,0 +1,54 @@
+/**
+ * @file window.h
+ * @author Simon Udsen
+ * @date 2026-10-18
+ * @brief Compile-time shape of the windows the model predicts
+ * @details A window is given by the sample rate, its length and the hop
+ * between the starts of two windows, in milliseconds. window_config_t turns
+ * them into samples at compile time, and fails the build if a window would
+ * not be a whole number of samples, would be shorter than the features need,
+ * or longer than the uint16_t sample counts of the pipeline hold. Every size
+ * of the pipeline is derived from data_window_t of config.h, so changing the
+ * rate or window length can't truncate a size on the way.
+ *
+ * statisticalfeatures_getFeatures takes the window size as a template
+ * argument too, and picks 32-bit accumulators where its sums can't overflow
+ * them, see statisticalfeatures.cpp.
+ */
+#ifndef WINDOW_H
+#define WINDOW_H
+
+/**************************************************************/
+/*                          Includes                          */
+/**************************************************************/
+#include <stdint.h> // Standard integer types
+
+/**************************************************************/
+/*                     Defines and macros                     */
+/**************************************************************/
+#define WINDOW_MIN_SIZE 2          // The standard deviation divides by one sample less
+#define WINDOW_MAX_SIZE UINT16_MAX // Samples a window holds at most
+
+/**************************************************************/
+/*                     Typedefs and enums                     */
+/**************************************************************/
+
+// Window of LengthMs milliseconds, sampled at SampleRateHz, starting every
+// HopMs milliseconds
+template <uint32_t SampleRateHz, uint32_t LengthMs, uint32_t HopMs> struct window_config_t
+{
+    static_assert( SampleRateHz > 0, "Sample rate must be positive" );
+    static_assert( ( ( uint64_t )LengthMs * SampleRateHz ) % 1000 == 0, "Window must be a whole number of samples" );
+    static_assert( ( ( uint64_t )HopMs * SampleRateHz ) % 1000 == 0, "Hop must be a whole number of samples" );
+    static_assert( ( ( uint64_t )LengthMs * SampleRateHz ) / 1000 >= WINDOW_MIN_SIZE, "Window is too short" );
+    static_assert( ( ( uint64_t )LengthMs * SampleRateHz ) / 1000 <= WINDOW_MAX_SIZE, "Window is too long" );
+    static_assert( ( HopMs > 0 ) && ( HopMs <= LengthMs ), "Hop must be between one sample and the window" );
+
+    static constexpr uint32_t SAMPLE_RATE_HZ = SampleRateHz;                             // Samples per second
+    static constexpr uint32_t LENGTH_MS = LengthMs;                                      // Length in milliseconds
+    static constexpr uint32_t HOP_MS = HopMs;                                            // Hop in milliseconds
+    static constexpr uint16_t SIZE = ( uint16_t )( ( LengthMs * SampleRateHz ) / 1000 ); // Samples per window
+    static constexpr uint16_t HOP = ( uint16_t )( ( HopMs * SampleRateHz ) / 1000 );     // Samples between windows
+};
+
+#endif // WINDOW_H
@@ -0,0 +1,253 @@
+// Decoder for the binary frames sent by the datarouter, see src/frame.h
+
+const samplecodec = require( './samplecodec' );
+
+const FRAME_MAGIC = Buffer.from( "STPF" );
+const FRAME_VERSION = 2;
+const FRAME_HEADER_SIZE = 32;
+const FRAME_MAX_PAYLOAD = 0xFFFF;
+const FRAME_SAMPLE_SIZE = 12;
+const FRAME_CRC_OFFSET = 28;
+const FRAME_FLAG_STEP = 0x01;
+const FRAME_ENCODING_PACKED = 0;
+const FRAME_ENCODING_DELTA = 1;
+const FRAME_ENCODING_RESULTS = 2;
+const FRAME_RESULT_SIZE = 20;
+const FRAME_RESULT_FEATURES = 6;
+const FRAME_ACK_MAGIC = Buffer.from( "STPA" );
+
+// CRC32 table for the reflected polynomial 0xEDB88320, same CRC as zlib
+const crcTable = new Uint32Array( 256 );
+for ( let n = 0; n < 256; n++ )
+{
+    let c = n;
+    for ( let k = 0; k < 8; k++ )
+    {
+        c = ( c & 1 ) ? ( 0xEDB88320 ^ ( c >>> 1 ) ) : ( c >>> 1 );
+    }
+    crcTable[n] = c >>> 0;
+}
+
+function crc32( crc, data )
+{
+    crc = ~crc >>> 0;
+    for ( let i = 0; i < data.length; i++ )
+    {
+        crc = crcTable[( crc ^ data[i] ) & 0xFF] ^ ( crc >>> 8 );
+    }
+    return ~crc >>> 0;
+}
+
+// Check if data starts like a frame
+function isFrameStart( data )
+{
+    const length = Math.min( data.length, FRAME_MAGIC.length );
+    return data.subarray( 0, length ).equals( FRAME_MAGIC.subarray( 0, length ) );
+}
+
+// Acknowledgement of every frame before sequence
+function encodeAck( sequence )
+{
+    const ack = Buffer.alloc( 8 );
+    FRAME_ACK_MAGIC.copy( ack, 0 );
+    ack.writeUInt32LE( sequence >>> 0, 4 );
+    return ack;
+}
+
+// Decode the samples, or window results, of a frame payload
+function decodePayload( payload, encoding, sampleCount )
+{
+    if ( encoding === FRAME_ENCODING_DELTA )
+    {
+        return samplecodec.decode( payload, sampleCount );
+    }
+    if ( encoding === FRAME_ENCODING_RESULTS )
+    {
+        const results = [];
+        for ( let i = 0; i < sampleCount; i++ )
+        {
+            const offset = i * FRAME_RESULT_SIZE;
+            const features = [];
+            for ( let f = 0; f < FRAME_RESULT_FEATURES; f++ )
+            {
+                features.push( payload.readInt16LE( offset + 4 + 2 * f ) );
+            }
+            results.push( {
+                timestamp : payload.readUInt32LE( offset ),
+                features : features,
+                steps : payload.readUInt16LE( offset + 16 ),
+                dropped : payload.readUInt16LE( offset + 18 ),
+            } );
+        }
+        return results;
+    }
+
+    const samples = [];
+    for ( let i = 0; i < sampleCount; i++ )
+    {
+        const offset = i * FRAME_SAMPLE_SIZE;
+        samples.push( {
+            timestamp : payload.readUInt32LE( offset ),
+            accX : payload.readInt16LE( offset + 4 ),
+            accY : payload.readInt16LE( offset + 6 ),
+            accZ : payload.readInt16LE( offset + 8 ),
+            step : ( payload[offset + 10] & FRAME_FLAG_STEP ) ? 1 : 0,
+            dropped : payload[offset + 11],
+        } );
+    }
+    return samples;
+}
+
+// Size of the frame at the start of data, 0 if more data is needed to tell,
+// or -1 if data does not start with a valid header
+function frameSize( data )
+{
+    if ( data.length < FRAME_HEADER_SIZE )
+    {
+        return isFrameStart( data ) ? 0 : -1;
+    }
+    if ( !isFrameStart( data ) || ( data[4] !== FRAME_VERSION ) )
+    {
+        return -1;
+    }
+
+    const encoding = data[5];
+    const sampleCount = data.readUInt16LE( 6 );
+    const payloadLength = data.readUInt32LE( 24 );
+    if ( ( payloadLength > FRAME_MAX_PAYLOAD ) ||
+         ( ( encoding === FRAME_ENCODING_PACKED ) && ( payloadLength !== sampleCount * FRAME_SAMPLE_SIZE ) ) ||
+         ( ( encoding === FRAME_ENCODING_RESULTS ) && ( payloadLength !== sampleCount * FRAME_RESULT_SIZE ) ) ||
+         ( encoding > FRAME_ENCODING_RESULTS ) )
+    {
+        return -1;
+    }
+
+    const size = FRAME_HEADER_SIZE + payloadLength;
+    return ( data.length < size ) ? 0 : size;
+}
+
+// Decode a complete frame of frameSize bytes. Returns null if the CRC does not
+// match, and samples is null if the payload does not decode
+function decodeFrame( frame )
+{
+    let crc = crc32( 0, frame.subarray( 0, FRAME_CRC_OFFSET ) );
+    crc = crc32( crc, frame.subarray( FRAME_HEADER_SIZE ) );
+    if ( crc !== frame.readUInt32LE( FRAME_CRC_OFFSET ) )
+    {
+        return null;
+    }
+
+    const header = {
+        encoding : frame[5],
+        sampleCount : frame.readUInt16LE( 6 ),
+        deviceId : frame.subarray( 8, 20 ).toString( 'hex' ),
+        sequence : frame.readUInt32LE( 20 ),
+        payloadLength : frame.length - FRAME_HEADER_SIZE,
+    };
+
+    // The CRC matched, so a payload that does not decode was encoded wrong
+    let samples = null;
+    try
+    {
+        samples = decodePayload( frame.subarray( FRAME_HEADER_SIZE ), header.encoding, header.sampleCount );
+    }
+    catch ( error )
+    {
+        samples = null;
+    }
+    return { header, samples };
+}
+
+// Decodes frames from a byte stream, that may split frames anywhere
+class FrameDecoder
+{
+    constructor()
+    {
+        this.pending = Buffer.alloc( 0 );
+        this.expectedSequence = null;
+        this.deviceId = null;
+        this.frames = 0;
+        this.samples = 0;
+        this.crcErrors = 0;
+        this.decodeErrors = 0;
+        this.payloadBytes = 0;
+        this.lostFrames = 0;
+        this.repeatedFrames = 0;
+    }
+
+    // Add received data, and call onFrame( header, samples ) for every
+    // complete frame, where samples are window results in a results frame.
+    // Corrupt data is skipped until the next frame magic
+    push( data, onFrame )
+    {
+        this.pending = Buffer.concat( [ this.pending, data ] );
+
+        while ( this.pending.length >= FRAME_HEADER_SIZE )
+        {
+            const size = frameSize( this.pending );
+            if ( size < 0 )
+            {
+                this.resync();
+                continue;
+            }
+            if ( size === 0 )
+            {
+                break;
+            }
+
+            const decoded = decodeFrame( this.pending.subarray( 0, size ) );
+            if ( !decoded )
+            {
+                this.crcErrors++;
+                this.resync();
+                continue;
+            }
+            const header = decoded.header;
+
+            let repeated = false;
+            if ( this.expectedSequence !== null )
+            {
+                // Sequence numbers wrap, so a gap of more than half the range
+                // is an old frame sent again
+                const gap = ( header.sequence - this.expectedSequence ) >>> 0;
+                if ( gap < 0x80000000 )
+                {
+                    this.lostFrames += gap;
+                }
+                else
+                {
+                    this.repeatedFrames++;
+                    repeated = true;
+                }
+            }
+            if ( !repeated )
+            {
+                this.expectedSequence = ( header.sequence + 1 ) >>> 0;
+            }
+            this.deviceId = header.deviceId;
+
+            this.pending = this.pending.subarray( size );
+
+            // Only this frame is dropped if its payload does not decode
+            if ( !decoded.samples )
+            {
+                this.decodeErrors++;
+                continue;
+            }
+
+            this.frames++;
+            this.samples += header.sampleCount;
+            this.payloadBytes += header.payloadLength;
+            onFrame( header, decoded.samples );
+        }
+    }
+
+    // Skip to the next possible frame magic
+    resync()
+    {
+        const next = this.pending.indexOf( FRAME_MAGIC, 1 );
+        this.pending = this.pending.subarray( ( next < 0 ) ? this.pending.length - FRAME_MAGIC.length + 1 : next );
+    }
+}
+
+module.exports = { FrameDecoder, frameSize, decodeFrame, isFrameStart, encodeAck, crc32, FRAME_ENCODING_RESULTS };
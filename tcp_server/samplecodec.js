@@ -0,0 +1,99 @@
+// Decoder for blocks of delta encoded samples, see src/samplecodec.h
+
+// Reads unsigned varints from a buffer, throwing if it ends early
+class VarintReader
+{
+    constructor( data )
+    {
+        this.data = data;
+        this.offset = 0;
+    }
+
+    next()
+    {
+        let value = 0;
+        for ( let shift = 0; shift < 35; shift += 7 )
+        {
+            if ( this.offset >= this.data.length )
+            {
+                throw new Error( "Block ended inside a varint" );
+            }
+            const byte = this.data[this.offset++];
+            value = ( value | ( ( byte & 0x7F ) << shift ) ) >>> 0;
+            if ( ( byte & 0x80 ) === 0 )
+            {
+                return value;
+            }
+        }
+        throw new Error( "Varint longer than 5 bytes" );
+    }
+
+    // Next varint, mapped back from zigzag to signed
+    nextSigned()
+    {
+        const value = this.next();
+        return ( value >>> 1 ) ^ -( value & 1 );
+    }
+}
+
+// Decode a block of count samples, throwing if it is corrupt
+function decode( data, count )
+{
+    const reader = new VarintReader( data );
+    const samples = [];
+
+    // Step runs
+    let step = 0;
+    while ( samples.length < count )
+    {
+        const run = reader.next();
+        if ( run > count - samples.length )
+        {
+            throw new Error( "Step runs longer than block" );
+        }
+        for ( let i = 0; i < run; i++ )
+        {
+            samples.push( { timestamp : 0, accX : 0, accY : 0, accZ : 0, step : step, dropped : 0 } );
+        }
+        step = step ? 0 : 1;
+    }
+
+    // Samples with lost samples before them
+    const lostCount = reader.next();
+    let index = 0;
+    for ( let i = 0; i < lostCount; i++ )
+    {
+        index += reader.next();
+        const dropped = reader.next();
+        if ( ( index >= count ) || ( dropped > 0xFF ) )
+        {
+            throw new Error( "Lost samples outside block" );
+        }
+        samples[index].dropped = dropped;
+    }
+
+    // Timestamps and acceleration, wrapping like the integer types on the device
+    let timestamp = 0;
+    let delta = 0;
+    let accX = 0, accY = 0, accZ = 0;
+    for ( const sample of samples )
+    {
+        delta = ( delta + reader.nextSigned() ) >>> 0;
+        timestamp = ( timestamp + delta ) >>> 0;
+        accX = ( ( accX + reader.nextSigned() ) << 16 ) >> 16;
+        accY = ( ( accY + reader.nextSigned() ) << 16 ) >> 16;
+        accZ = ( ( accZ + reader.nextSigned() ) << 16 ) >> 16;
+        sample.timestamp = timestamp;
+        sample.accX = accX;
+        sample.accY = accY;
+        sample.accZ = accZ;
+    }
+
+    if ( reader.offset !== data.length )
+    {
+        throw new Error( "Data after end of block" );
+    }
+    return samples;
+}
+
+module.exports = { decode };
@@ -2,6 +2,8 @@ const fs = require( 'fs' );
 const path = require( 'path' );
 const os = require( 'os' );
 const net = require( 'net' );
+const dgram = require( 'dgram' );
+const { FrameDecoder, frameSize, decodeFrame, isFrameStart, encodeAck, FRAME_ENCODING_RESULTS } = require( './frame' );
 
 // Logging available IP addresses
 let addresses = [];
@@ -26,6 +28,11 @@ const argv = yargs( hideBin( process.argv ) )
                      description : 'Port to listen on for incoming data',
                      default : 7123,
                  } )
+                 .option( 'udp-port', {
+                     type : 'number',
+                     description : 'Port to listen on for datagrams, the same as --port by default',
+                     default : null,
+                 } )
                  .option( 'label', {
                      alias : 'l',
                      type : 'string',
@@ -38,6 +45,7 @@ const argv = yargs( hideBin( process.argv ) )
 
 const outputDir = path.join( __dirname, "out" );
 const dataPort = argv.port;
+const datagramPort = ( argv['udp-port'] !== null ) ? argv['udp-port'] : dataPort;
 const label = argv.label;
 
 // Create the output directory if it does not exist
@@ -50,15 +58,15 @@ catch ( e )
     // Directory exists
 }
 
-// Generate a unique file path
+// Generate a unique file path, with a suffix before the extension
 let lastNum = 0;
-function getUniqueOutputPath()
+function getUniqueOutputPath( suffix )
 {
     for ( let i = lastNum + 1; i < 99999; i++ )
     {
         const filename = label
-                             ? `${label}.${i.toString().padStart( 5, '0' )}.csv`
-                             : `${i.toString().padStart( 5, '0' )}.csv`;
+                             ? `${label}.${i.toString().padStart( 5, '0' )}${suffix}.csv`
+                             : `${i.toString().padStart( 5, '0' )}${suffix}.csv`;
 
         const outPath = path.join( outputDir, filename );
         try
@@ -75,28 +83,373 @@ function getUniqueOutputPath()
     throw new Error( "Exceeded maximum file numbering range" );
 }
 
+// Streams a device can send, with the suffix of their files and CSV header.
+// Window results are written to a separate file from samples
+const STREAMS = {
+    samples : { suffix : "", header : "timestamp,accX,accY,accZ,step\n" },
+    results : { suffix : ".results", header : "timestamp,stdZ,madZ,minY,rangeX,rangeY,rangeZ,steps,dropped\n" },
+};
+
+// Create a new output file, with the CSV header
+function openOutput( stream = 'samples' )
+{
+    const outPath = getUniqueOutputPath( STREAMS[stream].suffix );
+    const writer = fs.createWriteStream( outPath );
+    writer.write( STREAMS[stream].header );
+    return { outPath, writer };
+}
+
+// Write a decoded frame as CSV to the file of its stream, opened on first use.
+// Samples are written the same as the text format
+function writeFrame( session, header, records )
+{
+    const stream = ( header.encoding === FRAME_ENCODING_RESULTS ) ? 'results' : 'samples';
+    if ( !session.outputs[stream] )
+    {
+        session.outputs[stream] = openOutput( stream );
+        console.log( `Session of device ${session.deviceId}: writing ${stream} to ${session.outputs[stream].outPath}` );
+    }
+
+    let lines = "";
+    for ( const record of records )
+    {
+        if ( stream === 'results' )
+        {
+            lines += `${record.timestamp},${record.features.join( ',' )},${record.steps},${record.dropped}\n`;
+        }
+        else
+        {
+            lines += `${record.timestamp},${record.accX},${record.accY},${record.accZ},${record.step}\n`;
+        }
+    }
+    session.outputs[stream].writer.write( lines );
+}
+
+// Close the files of a session, and list them
+function closeOutputs( session )
+{
+    const paths = [];
+    for ( const output of Object.values( session.outputs ) )
+    {
+        output.writer.end();
+        paths.push( output.outPath );
+    }
+    return ( paths.length > 0 ) ? paths.join( ', ' ) : "nothing";
+}
+
+// Recording sessions of devices sending frames, by device ID. A session
+// outlives its connection, so a device that reconnects continues the same files,
+// and frames it sends again are only written once. Every session on a device
+// starts at a random sequence number, so a number far from the expected one is
+// a new session
+const SESSION_WINDOW = 0x100000;      // Frames a sequence number may be from the expected one
+const SESSION_TIMEOUT_MS = 60 * 1000; // Time a session waits for its device to reconnect
+const sessions = new Map();
+
+function closeSession( session )
+{
+    clearTimeout( session.timer );
+    sessions.delete( session.deviceId );
+    console.log( `Session of device ${session.deviceId}: ${session.frames} frames, ${session.lostFrames} lost, ` +
+                 `${session.duplicateFrames} duplicates, ${session.connections} connections. ` +
+                 `Data saved to ${closeOutputs( session )}` );
+}
+
+function getSession( header )
+{
+    let session = sessions.get( header.deviceId );
+    if ( session )
+    {
+        const ahead = ( header.sequence - session.nextSequence ) >>> 0;
+        const behind = ( session.nextSequence - header.sequence ) >>> 0;
+        if ( ( ahead > SESSION_WINDOW ) && ( behind > SESSION_WINDOW ) )
+        {
+            closeSession( session );
+            session = null;
+        }
+    }
+    if ( !session )
+    {
+        session = {
+            deviceId : header.deviceId,
+            outputs : {},
+            nextSequence : header.sequence,
+            frames : 0,
+            lostFrames : 0,
+            duplicateFrames : 0,
+            connections : 0,
+            activeConnections : 0,
+            timer : null,
+        };
+        sessions.set( header.deviceId, session );
+        console.log( `New session of device ${header.deviceId}` );
+    }
+    return session;
+}
+
+// Move a connection from one session to another
+function switchSession( from, to )
+{
+    if ( from && ( --from.activeConnections === 0 ) && ( sessions.get( from.deviceId ) === from ) )
+    {
+        // The device may reconnect and continue the session
+        from.timer = setTimeout( function() { closeSession( from ); }, SESSION_TIMEOUT_MS );
+    }
+    if ( to )
+    {
+        clearTimeout( to.timer );
+        to.connections++;
+        to.activeConnections++;
+    }
+    return to;
+}
+
+// Recording sessions of devices sending datagrams, by device ID. Nothing is
+// sent again, so every frame that does not arrive is counted as lost, until a
+// reordered frame fills the gap. Frames are written as they arrive, so a
+// reordered frame is written after the frames that overtook it
+const DATAGRAM_WINDOW = 1024;        // Frames behind the newest one that are still accepted
+const DATAGRAM_STATS_MS = 10 * 1000; // Time between statistics of active devices
+const datagramSessions = new Map();
+
+function printDatagramSession( session )
+{
+    const expected = session.frames + session.lostFrames;
+    const lossPercent = ( 100 * session.lostFrames / Math.max( expected, 1 ) ).toFixed( 2 );
+    console.log( `Device ${session.deviceId} over UDP: ${session.frames} frames, ${session.records} records, ` +
+                 `${session.lostFrames} lost (${lossPercent}%), ${session.reorderedFrames} reordered, ` +
+                 `${session.duplicateFrames} duplicates, ${session.lateFrames} too late, ` +
+                 `${session.decodeErrors} decode errors` );
+}
+
+function closeDatagramSession( session )
+{
+    clearTimeout( session.timer );
+    datagramSessions.delete( session.deviceId );
+    printDatagramSession( session );
+    console.log( `Data saved to ${closeOutputs( session )}` );
+}
+
+function getDatagramSession( header )
+{
+    let session = datagramSessions.get( header.deviceId );
+    if ( session )
+    {
+        const ahead = ( header.sequence - session.nextSequence ) >>> 0;
+        const behind = ( session.nextSequence - header.sequence ) >>> 0;
+        if ( ( ahead > SESSION_WINDOW ) && ( behind > SESSION_WINDOW ) )
+        {
+            closeDatagramSession( session );
+            session = null;
+        }
+    }
+    if ( !session )
+    {
+        session = {
+            deviceId : header.deviceId,
+            outputs : {},
+            nextSequence : header.sequence,
+            received : new Array( DATAGRAM_WINDOW ).fill( null ),
+            frames : 0,
+            records : 0,
+            lostFrames : 0,
+            reorderedFrames : 0,
+            duplicateFrames : 0,
+            lateFrames : 0,
+            decodeErrors : 0,
+            changed : false,
+            timer : null,
+        };
+        datagramSessions.set( header.deviceId, session );
+        console.log( `New session of device ${header.deviceId} over UDP` );
+    }
+
+    // The session ends when the device has been quiet for a while
+    clearTimeout( session.timer );
+    session.timer = setTimeout( function() { closeDatagramSession( session ); }, SESSION_TIMEOUT_MS );
+    return session;
+}
+
+// Account for a frame received as a datagram, and check if it is new
+function acceptDatagram( session, sequence )
+{
+    const slot = sequence % DATAGRAM_WINDOW;
+    const ahead = ( sequence - session.nextSequence ) >>> 0;
+    if ( ahead <= SESSION_WINDOW )
+    {
+        // Newest frame so far, every frame it skipped is lost for now
+        session.lostFrames += ahead;
+        session.nextSequence = ( sequence + 1 ) >>> 0;
+    }
+    else if ( ( ( session.nextSequence - sequence ) >>> 0 ) > DATAGRAM_WINDOW )
+    {
+        session.lateFrames++;
+        return false;
+    }
+    else if ( session.received[slot] === sequence )
+    {
+        session.duplicateFrames++;
+        return false;
+    }
+    else
+    {
+        // Fills a gap that was counted as lost
+        session.reorderedFrames++;
+        session.lostFrames--;
+    }
+    session.received[slot] = sequence;
+    return true;
+}
+
+// Start a UDP server, for every device sending to the same socket
+let datagramErrors = 0;
+const datagramSocket = dgram.createSocket( 'udp4' );
+datagramSocket.on( 'message', function( message, remote ) {
+    // Every datagram carries exactly one frame
+    const decoded = ( frameSize( message ) === message.length ) ? decodeFrame( message ) : null;
+    if ( !decoded )
+    {
+        if ( datagramErrors++ === 0 )
+        {
+            console.log( `Datagram from ${remote.address} is not a valid frame` );
+        }
+        return;
+    }
+
+    const session = getDatagramSession( decoded.header );
+    if ( !acceptDatagram( session, decoded.header.sequence ) )
+    {
+        return;
+    }
+    session.changed = true;
+    if ( !decoded.samples )
+    {
+        session.decodeErrors++;
+        return;
+    }
+    session.frames++;
+    session.records += decoded.header.sampleCount;
+    writeFrame( session, decoded.header, decoded.samples );
+} );
+
+datagramSocket.on( 'error', function( error ) {
+    console.log( `UDP server failed: ${error.message}` );
+    datagramSocket.close();
+} );
+
+setInterval( function() {
+    for ( const session of datagramSessions.values() )
+    {
+        if ( session.changed )
+        {
+            session.changed = false;
+            printDatagramSession( session );
+        }
+    }
+    if ( datagramErrors > 0 )
+    {
+        console.log( `${datagramErrors} datagrams were not valid frames` );
+        datagramErrors = 0;
+    }
+}, DATAGRAM_STATS_MS ).unref();
+
+datagramSocket.bind( datagramPort );
+
 // Start a TCP Server
 net.createServer( function( socket ) {
        console.log( 'Data connection started from ' + socket.remoteAddress );
 
-       // Generate a new file for this connection
-       const outPath = getUniqueOutputPath();
-       const writer = fs.createWriteStream( outPath );
+       // CSV text goes to a new file for every connection, frames go to the
+       // session of the device
+       let output = null;
+       let session = null;
 
-       // Write header for the CSV file
-       writer.write( "timestamp,accX,accY,accZ,step\n" );
+       // The first bytes tell if the device sends binary frames or CSV text
+       let decoder = null;
+       let csv = false;
+       let head = Buffer.alloc( 0 );
 
        socket.on( 'data', function( data ) {
-           // Handle plain text CSV data
-           const textData = data.toString(); // Convert buffer to string
-           writer.write( textData );         // Write to CSV
+           if ( !decoder && !csv )
+           {
+               head = Buffer.concat( [ head, data ] );
+               if ( isFrameStart( head ) && ( head.length < 4 ) )
+               {
+                   // Need more data to decide
+                   return;
+               }
+               data = head;
+               if ( isFrameStart( head ) )
+               {
+                   decoder = new FrameDecoder();
+                   console.log( 'Receiving binary frames' );
+               }
+               else
+               {
+                   csv = true;
+               }
+           }
+
+           if ( csv )
+           {
+               // Handle plain text CSV data
+               if ( !output )
+               {
+                   output = openOutput();
+               }
+               const textData = data.toString(); // Convert buffer to string
+               output.writer.write( textData );  // Write to CSV
+               return;
+           }
+
+           // Write decoded frames, and acknowledge them once this data is
+           // handled
+           let received = false;
+           decoder.push( data, function( header, samples ) {
+               const current = getSession( header );
+               if ( current !== session )
+               {
+                   session = switchSession( session, current );
+               }
+               received = true;
+
+               const gap = ( header.sequence - session.nextSequence ) >>> 0;
+               if ( gap > SESSION_WINDOW )
+               {
+                   session.duplicateFrames++;
+                   return;
+               }
+               session.lostFrames += gap;
+               session.frames++;
+               session.nextSequence = ( header.sequence + 1 ) >>> 0;
+               writeFrame( session, header, samples );
+           } );
+           if ( received )
+           {
+               socket.write( encodeAck( session.nextSequence ) );
+           }
+       } );
+
+       socket.on( 'error', function( error ) {
+           console.log( `Data connection from ${socket.remoteAddress} failed: ${error.message}` );
        } );
 
-       socket.on( 'end', function() {
-           console.log( `Transmission complete. Data saved to ${outPath}` );
-           writer.end(); // Close the writer
+       socket.on( 'close', function() {
+           if ( decoder )
+           {
+               console.log( `Device ${decoder.deviceId}: ${decoder.frames} frames, ${decoder.samples} samples, ` +
+                            `${decoder.lostFrames} frames lost, ${decoder.repeatedFrames} repeated, ` +
+                            `${decoder.crcErrors} CRC errors, ${decoder.decodeErrors} decode errors, ` +
+                            `${( decoder.payloadBytes / Math.max( decoder.samples, 1 ) ).toFixed( 2 )} payload bytes/sample` );
+           }
+           session = switchSession( session, null );
+           if ( output )
+           {
+               console.log( `Transmission complete. Data saved to ${output.outPath}` );
+               output.writer.end(); // Close the writer
+           }
        } );
    } )
     .listen( dataPort );
 
-console.log( `Server listening on port ${dataPort}` );
\ No newline at end of file
+console.log( `Server listening on port ${dataPort}, and for datagrams on port ${datagramPort}` );
\ No newline at end of file